@@ -0,0 +1,385 @@
+/*
+ * vim:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* mem_data.c
+ * File data for FSAL_MEM
+ *
+ * Without Data_Extents, a file keeps the first Inode_Size bytes written to
+ * it and reads back filler past that.  With Data_Extents, all the data is
+ * kept in fixed size extents, mapped by offset so that a write never moves
+ * the data already there.  Extents are carved from large slabs, backed by
+ * huge pages when the system has some, and recycled through a free list.
+ * Slabs are only given back when the module is unloaded.
+ *
+ * A file's data is protected by its data_lock, readers share it.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "mem_int.h"
+
+struct mem_slab {
+	struct glist_head list;
+	void *base;
+	size_t len;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct glist_head slabs;
+	void *free_list;	/*< Freed extents, linked by their first word */
+	char *next;		/*< Not yet used part of the newest slab */
+	char *end;
+	uint32_t extent_shift;
+	uint64_t nslabs;
+	uint64_t nslabs_hugetlb;
+	uint64_t extents_used;
+} mem_slab;
+
+/**
+ * @brief Map a new slab
+ *
+ * Explicit huge pages are tried first, then transparent ones.
+ *
+ * @return The slab, or NULL if out of memory.
+ */
+static struct mem_slab *mem_slab_map(void)
+{
+	struct mem_slab *slab;
+	size_t len = MEM.slab_size;
+	void *base = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (base != MAP_FAILED)
+		mem_slab.nslabs_hugetlb++;
+#endif
+
+	if (base == MAP_FAILED) {
+		base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED) {
+			LogMajor(COMPONENT_FSAL,
+				 "Could not map a %zu byte data slab: %s",
+				 len, strerror(errno));
+			return NULL;
+		}
+#ifdef MADV_HUGEPAGE
+		(void)madvise(base, len, MADV_HUGEPAGE);
+#endif
+	}
+
+	slab = gsh_malloc(sizeof(*slab));
+	slab->base = base;
+	slab->len = len;
+	glist_add_tail(&mem_slab.slabs, &slab->list);
+	mem_slab.nslabs++;
+
+	return slab;
+}
+
+/**
+ * @brief Get a zeroed extent
+ *
+ * @return The extent, or NULL if out of memory.
+ */
+static void *mem_extent_alloc(void)
+{
+	struct mem_slab *slab;
+	void *ext = NULL;
+	bool recycled = false;
+
+	PTHREAD_MUTEX_lock(&mem_slab.lock);
+
+	if (mem_slab.free_list != NULL) {
+		ext = mem_slab.free_list;
+		mem_slab.free_list = *(void **)ext;
+		recycled = true;
+	} else {
+		if (mem_slab.next == mem_slab.end) {
+			slab = mem_slab_map();
+			if (slab != NULL) {
+				mem_slab.next = slab->base;
+				mem_slab.end = mem_slab.next + slab->len;
+			}
+		}
+
+		if (mem_slab.next != mem_slab.end) {
+			ext = mem_slab.next;
+			mem_slab.next += MEM.extent_size;
+		}
+	}
+
+	if (ext != NULL)
+		mem_slab.extents_used++;
+
+	PTHREAD_MUTEX_unlock(&mem_slab.lock);
+
+	/* Fresh slabs are already zeroed */
+	if (recycled)
+		memset(ext, 0, MEM.extent_size);
+
+	return ext;
+}
+
+static void mem_extent_free(void *ext)
+{
+	PTHREAD_MUTEX_lock(&mem_slab.lock);
+	*(void **)ext = mem_slab.free_list;
+	mem_slab.free_list = ext;
+	mem_slab.extents_used--;
+	PTHREAD_MUTEX_unlock(&mem_slab.lock);
+}
+
+/**
+ * @brief Set up the data of a new regular file
+ *
+ * @param[in] hdl	File
+ */
+void mem_data_init(struct mem_fsal_obj_handle *hdl)
+{
+	PTHREAD_RWLOCK_init(&hdl->mh_file.data_lock, NULL);
+	hdl->mh_file.extents = NULL;
+	hdl->mh_file.nextents = 0;
+}
+
+/**
+ * @brief Free the data of a regular file
+ *
+ * @param[in] hdl	File being freed
+ */
+void mem_data_free(struct mem_fsal_obj_handle *hdl)
+{
+	mem_data_truncate(hdl, 0);
+	gsh_free(hdl->mh_file.extents);
+	hdl->mh_file.extents = NULL;
+	PTHREAD_RWLOCK_destroy(&hdl->mh_file.data_lock);
+}
+
+/**
+ * @brief Read file data, holes read as zeroes
+ *
+ * @note Caller must hold the data_lock
+ *
+ * @param[in]  hdl	File to read
+ * @param[out] buf	Buffer to read into
+ * @param[in]  len	Bytes to read
+ * @param[in]  offset	Where to read from
+ */
+void mem_data_read(struct mem_fsal_obj_handle *hdl, void *buf, size_t len,
+		   uint64_t offset)
+{
+	uint64_t idx;
+	size_t in_ext, n;
+
+	while (len > 0) {
+		idx = offset >> mem_slab.extent_shift;
+		in_ext = offset & (MEM.extent_size - 1);
+		n = MIN(len, MEM.extent_size - in_ext);
+
+		if (idx < hdl->mh_file.nextents &&
+		    hdl->mh_file.extents[idx] != NULL)
+			memcpy(buf, (char *)hdl->mh_file.extents[idx] + in_ext,
+			       n);
+		else
+			memset(buf, 0, n);
+
+		buf = (char *)buf + n;
+		offset += n;
+		len -= n;
+	}
+}
+
+/**
+ * @brief Write file data, allocating extents as needed
+ *
+ * @note Caller must hold the data_lock for write
+ *
+ * @param[in] hdl	File to write
+ * @param[in] buf	Data to write
+ * @param[in] len	Bytes to write
+ * @param[in] offset	Where to write
+ *
+ * @return FSAL status, ERR_FSAL_NOSPC if extents could not be allocated.
+ */
+fsal_status_t mem_data_write(struct mem_fsal_obj_handle *hdl,
+			     const void *buf, size_t len, uint64_t offset)
+{
+	uint64_t idx, last, nextents;
+	size_t in_ext, n;
+
+	if (len == 0)
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	last = (offset + len - 1) >> mem_slab.extent_shift;
+	if (last >= hdl->mh_file.nextents) {
+		nextents = MAX(last + 1, 2 * hdl->mh_file.nextents);
+		hdl->mh_file.extents = gsh_realloc(hdl->mh_file.extents,
+				nextents * sizeof(*hdl->mh_file.extents));
+		memset(hdl->mh_file.extents + hdl->mh_file.nextents, 0,
+		       (nextents - hdl->mh_file.nextents) *
+		       sizeof(*hdl->mh_file.extents));
+		hdl->mh_file.nextents = nextents;
+	}
+
+	while (len > 0) {
+		idx = offset >> mem_slab.extent_shift;
+		in_ext = offset & (MEM.extent_size - 1);
+		n = MIN(len, MEM.extent_size - in_ext);
+
+		if (hdl->mh_file.extents[idx] == NULL) {
+			hdl->mh_file.extents[idx] = mem_extent_alloc();
+			if (hdl->mh_file.extents[idx] == NULL)
+				return fsalstat(ERR_FSAL_NOSPC, ENOSPC);
+		}
+
+		memcpy((char *)hdl->mh_file.extents[idx] + in_ext, buf, n);
+
+		buf = (const char *)buf + n;
+		offset += n;
+		len -= n;
+	}
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Drop file data past a new size
+ *
+ * Extents past @a size are freed and the end of the last one zeroed, so
+ * the file reads back zeroes if it grows again.
+ *
+ * @param[in] hdl	File being truncated
+ * @param[in] size	New size
+ */
+void mem_data_truncate(struct mem_fsal_obj_handle *hdl, uint64_t size)
+{
+	uint64_t idx, keep;
+	size_t in_ext;
+
+	if (!MEM.data_extents)
+		return;
+
+	PTHREAD_RWLOCK_wrlock(&hdl->mh_file.data_lock);
+
+	keep = (size + MEM.extent_size - 1) >> mem_slab.extent_shift;
+
+	for (idx = keep; idx < hdl->mh_file.nextents; idx++) {
+		if (hdl->mh_file.extents[idx] != NULL) {
+			mem_extent_free(hdl->mh_file.extents[idx]);
+			hdl->mh_file.extents[idx] = NULL;
+		}
+	}
+
+	in_ext = size & (MEM.extent_size - 1);
+	if (in_ext != 0 && keep <= hdl->mh_file.nextents &&
+	    hdl->mh_file.extents[keep - 1] != NULL)
+		memset((char *)hdl->mh_file.extents[keep - 1] + in_ext, 0,
+		       MEM.extent_size - in_ext);
+
+	PTHREAD_RWLOCK_unlock(&hdl->mh_file.data_lock);
+}
+
+static uint32_t mem_round_pow2(uint32_t val)
+{
+	uint32_t pow2 = 1;
+
+	while (pow2 <= val / 2)
+		pow2 <<= 1;
+
+	return pow2;
+}
+
+/**
+ * @brief Check the data and directory settings
+ *
+ * Shard counts and sizes are rounded down to powers of two.
+ *
+ * @return FSAL status
+ */
+fsal_status_t mem_data_pkginit(void)
+{
+	MEM.dir_shards = mem_round_pow2(MEM.dir_shards);
+	MEM.dir_shard_bits = 0;
+	while ((1U << MEM.dir_shard_bits) < MEM.dir_shards)
+		MEM.dir_shard_bits++;
+
+	if (!MEM.data_extents)
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	MEM.extent_size = mem_round_pow2(MEM.extent_size);
+	MEM.slab_size = mem_round_pow2(MEM.slab_size);
+	if (MEM.slab_size < MEM.extent_size)
+		MEM.slab_size = MEM.extent_size;
+
+	mem_slab.extent_shift = 0;
+	while ((1U << mem_slab.extent_shift) < MEM.extent_size)
+		mem_slab.extent_shift++;
+
+	PTHREAD_MUTEX_init(&mem_slab.lock, NULL);
+	glist_init(&mem_slab.slabs);
+
+	LogEvent(COMPONENT_FSAL,
+		 "FSAL_MEM keeping file data in %"PRIu32" byte extents from %"
+		 PRIu32" byte slabs, %"PRIu32" shards per directory",
+		 MEM.extent_size, MEM.slab_size, MEM.dir_shards);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Unmap all the data slabs
+ *
+ * @return FSAL status
+ */
+fsal_status_t mem_data_pkgshutdown(void)
+{
+	struct glist_head *glist, *glistn;
+	struct mem_slab *slab;
+
+	if (!MEM.data_extents)
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	LogEvent(COMPONENT_FSAL,
+		 "FSAL_MEM used %"PRIu64" data slabs, %"PRIu64
+		 " of huge pages, %"PRIu64" extents still in use",
+		 mem_slab.nslabs, mem_slab.nslabs_hugetlb,
+		 mem_slab.extents_used);
+
+	glist_for_each_safe(glist, glistn, &mem_slab.slabs) {
+		slab = glist_entry(glist, struct mem_slab, list);
+		glist_del(&slab->list);
+		(void)munmap(slab->base, slab->len);
+		gsh_free(slab);
+	}
+
+	mem_slab.free_list = NULL;
+	mem_slab.next = mem_slab.end = NULL;
+	PTHREAD_MUTEX_destroy(&mem_slab.lock);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
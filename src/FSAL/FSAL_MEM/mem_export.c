@@ -88,6 +88,10 @@ static void mem_release_export(struct fsal_export *exp_hdl)
 
 	glist_del(&myself->export_entry);
 
+	mem_latency_release(myself);
+
+	gsh_free(myself->meta_latency);
+	gsh_free(myself->data_latency);
 	gsh_free(myself->export_path);
 	gsh_free(myself);
 }
@@ -222,6 +226,16 @@ static struct config_item mem_export_params[] = {
 			mem_fsal_export, async_type),
 	CONF_ITEM_UI32("Async_Stall_Delay", 0, 1000, 0,
 		       mem_fsal_export, async_stall_delay),
+	CONF_ITEM_STR("Meta_Latency", 0, 1024, NULL,
+		      mem_fsal_export, meta_latency),
+	CONF_ITEM_STR("Data_Latency", 0, 1024, NULL,
+		      mem_fsal_export, data_latency),
+	CONF_ITEM_UI64("Throughput_Cap", 0, UINT64_MAX, 0,
+		       mem_fsal_export, throughput_cap),
+	CONF_ITEM_UI32("Stall_Interval", 0, 86400, 0,
+		       mem_fsal_export, stall_interval),
+	CONF_ITEM_UI32("Stall_Duration", 0, 60000, 0,
+		       mem_fsal_export, stall_duration),
 	CONFIG_EOL
 };
 
@@ -261,6 +275,7 @@ fsal_status_t mem_create_export(struct fsal_module *fsal_hdl,
 #endif
 	PTHREAD_RWLOCK_init(&myself->mfe_exp_lock, &attrs);
 	pthread_rwlockattr_destroy(&attrs);
+	PTHREAD_MUTEX_init(&myself->pace_lock, NULL);
 	fsal_export_init(&myself->export);
 	mem_export_ops_init(&myself->export.exp_ops);
 
@@ -275,6 +290,11 @@ fsal_status_t mem_create_export(struct fsal_module *fsal_hdl,
 		goto err_free;	/* seriously bad */
 	}
 
+	if (mem_latency_config(myself, myself) != 0) {
+		fsal_status = posix2fsal_status(EINVAL);
+		goto err_free;
+	}
+
 	retval = fsal_attach_export(fsal_hdl, &myself->export.exports);
 
 	if (retval != 0) {
@@ -302,6 +322,9 @@ fsal_status_t mem_create_export(struct fsal_module *fsal_hdl,
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 
 err_free:
+	mem_latency_release(myself);
+	gsh_free(myself->meta_latency);
+	gsh_free(myself->data_latency);
 	free_export_ops(&myself->export);
 	gsh_free(myself);	/* elvis has left the building */
 	return fsal_status;
@@ -364,6 +387,14 @@ fsal_status_t mem_update_export(struct fsal_module *fsal_hdl,
 		return posix2fsal_status(EINVAL);
 	}
 
+	retval = mem_latency_config(orig, &myself);
+
+	gsh_free(myself.meta_latency);
+	gsh_free(myself.data_latency);
+
+	if (retval != 0)
+		return posix2fsal_status(retval);
+
 	/* Update the async parameters */
 	atomic_store_uint32_t(&orig->async_delay, myself.async_delay);
 	atomic_store_uint32_t(&orig->async_stall_delay,
@@ -82,6 +82,69 @@ mem_i_cmpf(const struct avltree_node *lhs,
 	return 1;
 }
 
+/**
+ * @brief Find the shard of a directory holding an index
+ *
+ * @param[in] dir	Directory
+ * @param[in] index	d_index of a dirent, or a readdir cookie
+ * @return Shard covering @a index
+ */
+static inline struct mem_dir_shard *
+mem_dir_shard(struct mem_fsal_obj_handle *dir, uint64_t index)
+{
+	if (MEM.dir_shard_bits == 0)
+		return dir->mh_dir.shards;
+
+	return &dir->mh_dir.shards[index >> (64 - MEM.dir_shard_bits)];
+}
+
+/**
+ * @brief Find the shard of a directory a name belongs to
+ *
+ * @param[in] dir	Directory
+ * @param[in] name	Name in @a dir
+ * @return Shard to lock for @a name
+ */
+static inline struct mem_dir_shard *
+mem_dir_shard_by_name(struct mem_fsal_obj_handle *dir, const char *name)
+{
+	/* Index is hash of the name */
+	return mem_dir_shard(dir, CityHash64(name, strlen(name)));
+}
+
+static void mem_alloc_dir_shards(struct mem_fsal_obj_handle *dir)
+{
+	uint32_t i;
+
+	dir->mh_dir.shards = gsh_calloc(MEM.dir_shards,
+					sizeof(*dir->mh_dir.shards));
+
+	for (i = 0; i < MEM.dir_shards; i++) {
+		PTHREAD_RWLOCK_init(&dir->mh_dir.shards[i].lock, NULL);
+		avltree_init(&dir->mh_dir.shards[i].avl_name, mem_n_cmpf, 0);
+		avltree_init(&dir->mh_dir.shards[i].avl_index, mem_i_cmpf, 0);
+	}
+}
+
+/**
+ * @brief Free the shards of an empty directory
+ *
+ * @param[in] dir	Directory being freed
+ */
+void mem_free_dir_shards(struct mem_fsal_obj_handle *dir)
+{
+	uint32_t i;
+
+	if (dir->mh_dir.shards == NULL)
+		return;
+
+	for (i = 0; i < MEM.dir_shards; i++)
+		PTHREAD_RWLOCK_destroy(&dir->mh_dir.shards[i].lock);
+
+	gsh_free(dir->mh_dir.shards);
+	dir->mh_dir.shards = NULL;
+}
+
 /**
  * @brief Clean up and free an object handle
  *
@@ -249,6 +312,7 @@ static void mem_insert_obj(struct mem_fsal_obj_handle *parent,
 			   const char *name)
 {
 	struct mem_dirent *dirent;
+	struct mem_dir_shard *shard;
 	uint32_t numkids;
 
 	dirent = gsh_calloc(1, sizeof(*dirent));
@@ -265,22 +329,25 @@ static void mem_insert_obj(struct mem_fsal_obj_handle *parent,
 	PTHREAD_RWLOCK_unlock(&child->obj_handle.obj_lock);
 
 	/* Link into parent */
-	PTHREAD_RWLOCK_wrlock(&parent->obj_handle.obj_lock);
+	shard = mem_dir_shard(parent, dirent->d_index);
+	PTHREAD_RWLOCK_wrlock(&shard->lock);
 	/* Name tree */
-	avltree_insert(&dirent->avl_n, &parent->mh_dir.avl_name);
+	avltree_insert(&dirent->avl_n, &shard->avl_name);
 	/* Index tree */
-	avltree_insert(&dirent->avl_i, &parent->mh_dir.avl_index);
+	avltree_insert(&dirent->avl_i, &shard->avl_index);
 	/* Update numkids */
 	numkids = atomic_inc_uint32_t(&parent->mh_dir.numkids);
 	LogFullDebug(COMPONENT_FSAL, "%s numkids %"PRIu32, parent->m_name,
 		     numkids);
 
-	PTHREAD_RWLOCK_unlock(&parent->obj_handle.obj_lock);
+	PTHREAD_RWLOCK_unlock(&shard->lock);
 }
 
 /**
  * @brief Find the dirent pointing to a name in a directory
  *
+ * @note Caller should hold the lock on the name's shard
+ *
  * @param[in] dir	Directory to search
  * @param[in] name	Name to look up
  * @return Dirent on success, NULL on failure
@@ -293,7 +360,8 @@ mem_dirent_lookup(struct mem_fsal_obj_handle *dir, const char *name)
 
 	key.d_name = name;
 
-	node = avltree_lookup(&key.avl_n, &dir->mh_dir.avl_name);
+	node = avltree_lookup(&key.avl_n,
+			      &mem_dir_shard_by_name(dir, name)->avl_name);
 	if (!node) {
 		/* it's not there */
 		return NULL;
@@ -303,12 +371,12 @@ mem_dirent_lookup(struct mem_fsal_obj_handle *dir, const char *name)
 }
 
 /**
- * @brief Get the next dirent in a directory
+ * @brief Get the next dirent in a directory shard
  *
- * @note Caller must hold the obj_lock on the obj
+ * @note Caller must hold the lock on the dirent's shard
  *
  * @param[in] dirent	Current dirent
- * @return Next dirent, or NULL if at EOD
+ * @return Next dirent, or NULL if at the end of the shard
  */
 static struct mem_dirent *
 mem_dirent_next(struct mem_dirent *dirent)
@@ -324,18 +392,49 @@ mem_dirent_next(struct mem_dirent *dirent)
 }
 
 /**
- * @brief Seek to a location in a directory
+ * @brief Get the index of the first dirent after a shard
+ *
+ * @note Shards are only ever locked in ascending order while another is held
+ *
+ * @param[in] dir	Directory
+ * @param[in] from	First shard to look in
+ * @return d_index of the next dirent, or UINT64_MAX if at EOD
+ */
+static uint64_t mem_dir_next_index(struct mem_fsal_obj_handle *dir,
+				   uint32_t from)
+{
+	struct mem_dir_shard *shard;
+	struct avltree_node *node = NULL;
+	uint64_t index = UINT64_MAX;
+	uint32_t i;
+
+	for (i = from; i < MEM.dir_shards && node == NULL; i++) {
+		shard = &dir->mh_dir.shards[i];
+
+		PTHREAD_RWLOCK_rdlock(&shard->lock);
+		node = avltree_first(&shard->avl_index);
+		if (node)
+			index = avltree_container_of(node, struct mem_dirent,
+						     avl_i)->d_index;
+		PTHREAD_RWLOCK_unlock(&shard->lock);
+	}
+
+	return index;
+}
+
+/**
+ * @brief Seek to a location in a directory shard
  *
  * Handle normal vs whence-is-name directories.
  *
- * @note Caller must hold the obj_lock on the obj
+ * @note Caller must hold the lock on the shard
  *
- * @param[in] dir	Directory to seek in
- * @param[in] seekloc	Location to seek to
+ * @param[in] shard	Directory shard to seek in
+ * @param[in] seekloc	Location to seek to, 0 for the start of the shard
  * @return Dirent associated with seekloc
  */
 static struct mem_dirent *
-mem_readdir_seekloc(struct mem_fsal_obj_handle *dir, fsal_cookie_t seekloc)
+mem_readdir_seekloc(struct mem_dir_shard *shard, fsal_cookie_t seekloc)
 {
 	struct mem_dirent *dirent;
 	struct avltree_node *node;
@@ -344,7 +443,7 @@ mem_readdir_seekloc(struct mem_fsal_obj_handle *dir, fsal_cookie_t seekloc)
 	if (!seekloc) {
 		/* Start from the beginning.  We walk the index tree, so always
 		 * grab from the index tree. */
-		node = avltree_first(&dir->mh_dir.avl_index);
+		node = avltree_first(&shard->avl_index);
 		if (!node) {
 			return NULL;
 		}
@@ -355,10 +454,10 @@ mem_readdir_seekloc(struct mem_fsal_obj_handle *dir, fsal_cookie_t seekloc)
 
 
 	key.d_index = seekloc;
-	node = avltree_lookup(&key.avl_i, &dir->mh_dir.avl_index);
+	node = avltree_lookup(&key.avl_i, &shard->avl_index);
 	if (!node) {
 		/* Dirent was probably deleted.  Find the next one */
-		node = avltree_sup(&key.avl_i, &dir->mh_dir.avl_index);
+		node = avltree_sup(&key.avl_i, &shard->avl_index);
 	}
 	if (!node) {
 		/* Done */
@@ -387,7 +486,7 @@ static void mem_update_change_locked(struct mem_fsal_obj_handle *obj)
 /**
  * @brief Remove an obj from it's parent's tree
  *
- * @note Caller must hold the obj_lock on the parent
+ * @note Caller must hold the lock on the dirent's shard
  *
  * @param[in] parent	Parent directory
  * @param[in] dirent	Dirent to remove
@@ -396,11 +495,12 @@ static void mem_update_change_locked(struct mem_fsal_obj_handle *obj)
 static void mem_remove_dirent_locked(struct mem_fsal_obj_handle *parent,
 				     struct mem_dirent *dirent)
 {
+	struct mem_dir_shard *shard = mem_dir_shard(parent, dirent->d_index);
 	struct mem_fsal_obj_handle *child;
 	uint32_t numkids;
 
-	avltree_remove(&dirent->avl_n, &parent->mh_dir.avl_name);
-	avltree_remove(&dirent->avl_i, &parent->mh_dir.avl_index);
+	avltree_remove(&dirent->avl_n, &shard->avl_name);
+	avltree_remove(&dirent->avl_i, &shard->avl_index);
 
 	/* Take the child lock, to remove from the child.  This should not race
 	 * with @r mem_insert_obj since that takes the locks seqentially */
@@ -419,7 +519,10 @@ static void mem_remove_dirent_locked(struct mem_fsal_obj_handle *parent,
 
 	mem_int_put_ref(child);
 
+	/* Other shards may be changing the directory too */
+	PTHREAD_RWLOCK_wrlock(&parent->obj_handle.obj_lock);
 	mem_update_change_locked(parent);
+	PTHREAD_RWLOCK_unlock(&parent->obj_handle.obj_lock);
 }
 
 /**
@@ -431,15 +534,16 @@ static void mem_remove_dirent_locked(struct mem_fsal_obj_handle *parent,
 static void mem_remove_dirent(struct mem_fsal_obj_handle *parent,
 			      const char *name)
 {
+	struct mem_dir_shard *shard = mem_dir_shard_by_name(parent, name);
 	struct mem_dirent *dirent;
 
-	PTHREAD_RWLOCK_wrlock(&parent->obj_handle.obj_lock);
+	PTHREAD_RWLOCK_wrlock(&shard->lock);
 
 	dirent = mem_dirent_lookup(parent, name);
 	if (dirent)
 		mem_remove_dirent_locked(parent, dirent);
 
-	PTHREAD_RWLOCK_unlock(&parent->obj_handle.obj_lock);
+	PTHREAD_RWLOCK_unlock(&shard->lock);
 }
 
 /**
@@ -453,24 +557,31 @@ static void mem_remove_dirent(struct mem_fsal_obj_handle *parent,
 void mem_clean_export(struct mem_fsal_obj_handle *root)
 {
 	struct mem_fsal_obj_handle *child;
+	struct mem_dir_shard *shard;
 	struct avltree_node *node;
 	struct mem_dirent *dirent;
+	uint32_t i;
 
 #ifdef USE_LTTNG
 	tracepoint(fsalmem, mem_inuse, __func__, __LINE__, &root->obj_handle,
 		   root->attrs.numlinks, root->is_export);
 #endif
-	while ((node = avltree_first(&root->mh_dir.avl_name))) {
-		dirent = avltree_container_of(node, struct mem_dirent, avl_n);
+	for (i = 0; i < MEM.dir_shards; i++) {
+		shard = &root->mh_dir.shards[i];
 
-		child = dirent->hdl;
-		if (child->obj_handle.type == DIRECTORY) {
-			mem_clean_export(child);
-		}
+		while ((node = avltree_first(&shard->avl_name))) {
+			dirent = avltree_container_of(node, struct mem_dirent,
+						      avl_n);
+
+			child = dirent->hdl;
+			if (child->obj_handle.type == DIRECTORY) {
+				mem_clean_export(child);
+			}
 
-		PTHREAD_RWLOCK_wrlock(&root->obj_handle.obj_lock);
-		mem_remove_dirent_locked(root, dirent);
-		PTHREAD_RWLOCK_unlock(&root->obj_handle.obj_lock);
+			PTHREAD_RWLOCK_wrlock(&shard->lock);
+			mem_remove_dirent_locked(root, dirent);
+			PTHREAD_RWLOCK_unlock(&shard->lock);
+		}
 	}
 
 }
@@ -482,17 +593,24 @@ void mem_clean_export(struct mem_fsal_obj_handle *root)
  */
 void mem_clean_all_dirents(struct mem_fsal_obj_handle *parent)
 {
+	struct mem_dir_shard *shard;
 	struct avltree_node *node;
 	struct mem_dirent *dirent;
+	uint32_t i;
 
-	PTHREAD_RWLOCK_wrlock(&parent->obj_handle.obj_lock);
+	for (i = 0; i < MEM.dir_shards; i++) {
+		shard = &parent->mh_dir.shards[i];
 
-	while ((node = avltree_first(&parent->mh_dir.avl_name))) {
-		dirent = avltree_container_of(node, struct mem_dirent, avl_n);
-		mem_remove_dirent_locked(parent, dirent);
-	}
+		PTHREAD_RWLOCK_wrlock(&shard->lock);
 
-	PTHREAD_RWLOCK_unlock(&parent->obj_handle.obj_lock);
+		while ((node = avltree_first(&shard->avl_name))) {
+			dirent = avltree_container_of(node, struct mem_dirent,
+						      avl_n);
+			mem_remove_dirent_locked(parent, dirent);
+		}
+
+		PTHREAD_RWLOCK_unlock(&shard->lock);
+	}
 }
 
 static void mem_copy_attrs_mask(struct attrlist *attrs_in,
@@ -725,6 +843,7 @@ _mem_alloc_handle(struct mem_fsal_obj_handle *parent,
 			hdl->attrs.spaceused = 0;
 		}
 		hdl->attrs.numlinks = 1;
+		mem_data_init(hdl);
 		break;
 	case BLOCK_FILE:
 	case CHARACTER_FILE:
@@ -738,8 +857,7 @@ _mem_alloc_handle(struct mem_fsal_obj_handle *parent,
 		hdl->attrs.numlinks = 1;
 		break;
 	case DIRECTORY:
-		avltree_init(&hdl->mh_dir.avl_name, mem_n_cmpf, 0);
-		avltree_init(&hdl->mh_dir.avl_index, mem_i_cmpf, 0);
+		mem_alloc_dir_shards(hdl);
 		hdl->attrs.numlinks = 2;
 		hdl->mh_dir.numkids = 2;
 		hdl->mh_dir.parent = parent;
@@ -871,7 +989,7 @@ static fsal_status_t mem_create_obj(struct mem_fsal_obj_handle *parent,
  */
 
 /**
- * @brief Lookup a file
+ * @brief Lookup a file, without backend latency
  *
  * @param[in] parent	Parent directory
  * @param[in] path	Path to lookup
@@ -879,23 +997,25 @@ static fsal_status_t mem_create_obj(struct mem_fsal_obj_handle *parent,
  * @param[out] attrs_out	Attributes of found handle
  * @return FSAL status
  */
-static fsal_status_t mem_lookup(struct fsal_obj_handle *parent,
-				const char *path,
-				struct fsal_obj_handle **handle,
-				struct attrlist *attrs_out)
+static fsal_status_t mem_do_lookup(struct fsal_obj_handle *parent,
+				   const char *path,
+				   struct fsal_obj_handle **handle,
+				   struct attrlist *attrs_out)
 {
 	struct mem_fsal_obj_handle *myself, *hdl = NULL;
+	struct mem_dir_shard *shard;
 	fsal_status_t status;
 
 	myself = container_of(parent,
 			      struct mem_fsal_obj_handle,
 			      obj_handle);
+	shard = mem_dir_shard_by_name(myself, path);
 
 	/* Check if this context already holds the lock on
-	 * this directory.
+	 * this part of the directory.
 	 */
-	if (op_ctx->fsal_private != parent)
-		PTHREAD_RWLOCK_rdlock(&parent->obj_lock);
+	if (op_ctx->fsal_private != shard)
+		PTHREAD_RWLOCK_rdlock(&shard->lock);
 	else
 		LogFullDebug(COMPONENT_FSAL,
 			     "Skipping lock for %s",
@@ -910,8 +1030,8 @@ static fsal_status_t mem_lookup(struct fsal_obj_handle *parent,
 	mem_int_get_ref(hdl);
 
 out:
-	if (op_ctx->fsal_private != parent)
-		PTHREAD_RWLOCK_unlock(&parent->obj_lock);
+	if (op_ctx->fsal_private != shard)
+		PTHREAD_RWLOCK_unlock(&shard->lock);
 
 	if (!FSAL_IS_ERROR(status) && attrs_out != NULL) {
 		/* This is unlocked, however, for the most part, attributes
@@ -923,6 +1043,27 @@ out:
 	return status;
 }
 
+/**
+ * @brief Lookup a file
+ *
+ * @param[in] parent	Parent directory
+ * @param[in] path	Path to lookup
+ * @param[out] handle	Found handle, on success
+ * @param[out] attrs_out	Attributes of found handle
+ * @return FSAL status
+ */
+static fsal_status_t mem_lookup(struct fsal_obj_handle *parent,
+				const char *path,
+				struct fsal_obj_handle **handle,
+				struct attrlist *attrs_out)
+{
+	/* Lookups from within readdir come with it */
+	if (op_ctx->fsal_private == NULL)
+		mem_latency_wait(MEM_LAT_META, 0);
+
+	return mem_do_lookup(parent, path, handle, attrs_out);
+}
+
 /**
  * @brief Read a directory
  *
@@ -942,15 +1083,20 @@ static fsal_status_t mem_readdir(struct fsal_obj_handle *dir_hdl,
 {
 	struct mem_fsal_obj_handle *myself;
 	struct mem_dirent *dirent, *dirent_next;
+	struct mem_dir_shard *shard;
 	fsal_cookie_t cookie = 0;
 	struct attrlist attrs;
 	enum fsal_dir_result cb_rc;
 	int count = 0;
+	uint32_t i;
+	bool done = false;
 
 	myself = container_of(dir_hdl,
 			      struct mem_fsal_obj_handle,
 			      obj_handle);
 
+	mem_latency_wait(MEM_LAT_META, 0);
+
 	if (whence != NULL)
 		cookie = *whence;
 
@@ -963,55 +1109,69 @@ static fsal_status_t mem_readdir(struct fsal_obj_handle *dir_hdl,
 	LogFullDebug(COMPONENT_FSAL, "hdl=%p, name=%s",
 		     myself, myself->m_name);
 
-	PTHREAD_RWLOCK_rdlock(&dir_hdl->obj_lock);
+	/* Walk the shards from the one holding the cookie, in index order */
+	shard = mem_dir_shard(myself, cookie);
 
-	/* Use fsal_private to signal to lookup that we hold
-	 * the lock.
-	 */
-	op_ctx->fsal_private = dir_hdl;
+	for (i = shard - myself->mh_dir.shards;
+	     i < MEM.dir_shards && !done;
+	     i++) {
+		shard = &myself->mh_dir.shards[i];
 
-	dirent = mem_readdir_seekloc(myself, cookie);
+		PTHREAD_RWLOCK_rdlock(&shard->lock);
 
-	/* Always run in index order */
-	for (;
-	     dirent != NULL;
-	     dirent = dirent_next) {
-
-		if (count >= 2 * mdcache_param.dir.avl_chunk) {
-			LogFullDebug(COMPONENT_FSAL, "readahead done %d",
-				     count);
-			/* Limit readahead to 1 chunk */
-			*eof = false;
-			break;
-		}
+		/* Use fsal_private to signal to lookup that we hold
+		 * the lock.
+		 */
+		op_ctx->fsal_private = shard;
+
+		dirent = mem_readdir_seekloc(shard, cookie);
+
+		/* Always run in index order */
+		for (;
+		     dirent != NULL;
+		     dirent = dirent_next) {
+
+			if (count >= 2 * mdcache_param.dir.avl_chunk) {
+				LogFullDebug(COMPONENT_FSAL,
+					     "readahead done %d", count);
+				/* Limit readahead to 1 chunk */
+				*eof = false;
+				done = true;
+				break;
+			}
 
-		dirent_next = mem_dirent_next(dirent);
-		if (dirent_next) {
-			cookie = dirent_next->d_index;
-		} else {
-			cookie = UINT64_MAX;
-		}
+			dirent_next = mem_dirent_next(dirent);
+			if (dirent_next) {
+				cookie = dirent_next->d_index;
+			} else {
+				cookie = mem_dir_next_index(myself, i + 1);
+			}
 
-		fsal_prepare_attrs(&attrs, attrmask);
-		fsal_copy_attrs(&attrs, &dirent->hdl->attrs, false);
-		mem_int_get_ref(dirent->hdl);
+			fsal_prepare_attrs(&attrs, attrmask);
+			fsal_copy_attrs(&attrs, &dirent->hdl->attrs, false);
+			mem_int_get_ref(dirent->hdl);
 
-		cb_rc = cb(dirent->d_name, &dirent->hdl->obj_handle, &attrs,
-			   dir_state, cookie);
+			cb_rc = cb(dirent->d_name, &dirent->hdl->obj_handle,
+				   &attrs, dir_state, cookie);
 
-		fsal_release_attrs(&attrs);
+			fsal_release_attrs(&attrs);
 
-		count++;
+			count++;
 
-		if (cb_rc >= DIR_TERMINATE) {
-			*eof = false;
-			break;
+			if (cb_rc >= DIR_TERMINATE) {
+				*eof = false;
+				done = true;
+				break;
+			}
 		}
-	}
 
-	op_ctx->fsal_private = NULL;
+		op_ctx->fsal_private = NULL;
 
-	PTHREAD_RWLOCK_unlock(&dir_hdl->obj_lock);
+		PTHREAD_RWLOCK_unlock(&shard->lock);
+
+		/* Later shards are read from their start */
+		cookie = 0;
+	}
 
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
@@ -1047,6 +1207,8 @@ static fsal_status_t mem_mkdir(struct fsal_obj_handle *dir_hdl,
 
 	LogDebug(COMPONENT_FSAL, "mkdir %s", name);
 
+	mem_latency_wait(MEM_LAT_META, 0);
+
 #ifdef USE_LTTNG
 	tracepoint(fsalmem, mem_mkdir, __func__, __LINE__, dir_hdl,
 		   parent->m_name, name);
@@ -1080,6 +1242,8 @@ static fsal_status_t mem_mknode(struct fsal_obj_handle *dir_hdl,
 
 	LogDebug(COMPONENT_FSAL, "mknode %s", name);
 
+	mem_latency_wait(MEM_LAT_META, 0);
+
 	status = mem_create_obj(parent, nodetype, name, attrs_in, new_obj,
 				attrs_out);
 	if (unlikely(FSAL_IS_ERROR(status)))
@@ -1117,6 +1281,8 @@ static fsal_status_t mem_symlink(struct fsal_obj_handle *dir_hdl,
 
 	LogDebug(COMPONENT_FSAL, "symlink %s", name);
 
+	mem_latency_wait(MEM_LAT_META, 0);
+
 	status = mem_create_obj(parent, SYMBOLIC_LINK, name, attrs_in, new_obj,
 				attrs_out);
 	if (unlikely(FSAL_IS_ERROR(status)))
@@ -1151,6 +1317,8 @@ static fsal_status_t mem_readlink(struct fsal_obj_handle *obj_hdl,
 		return fsalstat(ERR_FSAL_INVAL, 0);
 	}
 
+	mem_latency_wait(MEM_LAT_META, 0);
+
 	link_content->len = strlen(myself->mh_symlink.link_contents) + 1;
 	link_content->addr = gsh_strdup(myself->mh_symlink.link_contents);
 
@@ -1158,14 +1326,14 @@ static fsal_status_t mem_readlink(struct fsal_obj_handle *obj_hdl,
 }
 
 /**
- * @brief Get attributes for a file
+ * @brief Get attributes for a file, without backend latency
  *
  * @param[in] obj_hdl	File to get
  * @param[out] outattrs	Attributes for file
  * @return FSAL status
  */
-static fsal_status_t mem_getattrs(struct fsal_obj_handle *obj_hdl,
-				  struct attrlist *outattrs)
+static fsal_status_t mem_do_getattrs(struct fsal_obj_handle *obj_hdl,
+				     struct attrlist *outattrs)
 {
 	struct mem_fsal_obj_handle *myself =
 		container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
@@ -1200,6 +1368,21 @@ static fsal_status_t mem_getattrs(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
+/**
+ * @brief Get attributes for a file
+ *
+ * @param[in] obj_hdl	File to get
+ * @param[out] outattrs	Attributes for file
+ * @return FSAL status
+ */
+static fsal_status_t mem_getattrs(struct fsal_obj_handle *obj_hdl,
+				  struct attrlist *outattrs)
+{
+	mem_latency_wait(MEM_LAT_META, 0);
+
+	return mem_do_getattrs(obj_hdl, outattrs);
+}
+
 /**
  * @brief Set attributes on an object
  *
@@ -1236,6 +1419,11 @@ fsal_status_t mem_setattr2(struct fsal_obj_handle *obj_hdl,
 		return fsalstat(ERR_FSAL_INVAL, EINVAL);
 	}
 
+	mem_latency_wait(MEM_LAT_META, 0);
+
+	if (FSAL_TEST_MASK(attrs_set->valid_mask, ATTR_SIZE))
+		mem_data_truncate(myself, attrs_set->filesize);
+
 	mem_copy_attrs_mask(attrs_set, &myself->attrs);
 
 #ifdef USE_LTTNG
@@ -1266,6 +1454,8 @@ fsal_status_t mem_link(struct fsal_obj_handle *obj_hdl,
 	struct mem_fsal_obj_handle *hdl;
 	fsal_status_t status = {0, 0};
 
+	mem_latency_wait(MEM_LAT_META, 0);
+
 	status = mem_int_lookup(dir, name, &hdl);
 	if (!FSAL_IS_ERROR(status)) {
 		/* It already exists */
@@ -1303,6 +1493,7 @@ static fsal_status_t mem_unlink(struct fsal_obj_handle *dir_hdl,
 	fsal_status_t status = {0, 0};
 	uint32_t numkids;
 	struct mem_dirent *dirent;
+	struct mem_dir_shard *shard;
 
 	parent = container_of(dir_hdl,
 			      struct mem_fsal_obj_handle,
@@ -1317,7 +1508,10 @@ static fsal_status_t mem_unlink(struct fsal_obj_handle *dir_hdl,
 		   myself->attrs.numlinks);
 #endif
 
-	PTHREAD_RWLOCK_wrlock(&dir_hdl->obj_lock);
+	mem_latency_wait(MEM_LAT_META, 0);
+
+	shard = mem_dir_shard_by_name(parent, name);
+	PTHREAD_RWLOCK_wrlock(&shard->lock);
 
 	switch (obj_hdl->type) {
 	case DIRECTORY:
@@ -1358,7 +1552,7 @@ static fsal_status_t mem_unlink(struct fsal_obj_handle *dir_hdl,
 	}
 
 unlock:
-	PTHREAD_RWLOCK_unlock(&dir_hdl->obj_lock);
+	PTHREAD_RWLOCK_unlock(&shard->lock);
 
 	return status;
 }
@@ -1421,6 +1615,8 @@ static fsal_status_t mem_rename(struct fsal_obj_handle *obj_hdl,
 	struct mem_fsal_obj_handle *mem_lookup_dst = NULL;
 	fsal_status_t status;
 
+	mem_latency_wait(MEM_LAT_META, 0);
+
 	status = mem_int_lookup(mem_newdir, new_name, &mem_lookup_dst);
 	if (!FSAL_IS_ERROR(status)) {
 		uint32_t numkids;
@@ -1514,6 +1710,8 @@ fsal_status_t mem_open2(struct fsal_obj_handle *obj_hdl,
 
 	myself = container_of(obj_hdl, struct mem_fsal_obj_handle, obj_handle);
 
+	mem_latency_wait(MEM_LAT_META, 0);
+
 	if (setattrs)
 		LogAttrlist(COMPONENT_FSAL, NIV_FULL_DEBUG,
 			    "attrs_set ", attrs_set, false);
@@ -1575,8 +1773,10 @@ fsal_status_t mem_open2(struct fsal_obj_handle *obj_hdl,
 			openflags |= FSAL_O_READ;
 		mem_open_my_fd(my_fd, openflags);
 
-		if (truncated)
+		if (truncated) {
+			mem_data_truncate(myself, 0);
 			myself->attrs.filesize = myself->attrs.spaceused = 0;
+		}
 
 		/* Now check verifier for exclusive, but not for
 		 * FSAL_EXCLUSIVE_9P.
@@ -1678,6 +1878,8 @@ fsal_status_t mem_open2(struct fsal_obj_handle *obj_hdl,
 		/* Create sets and gets attributes, so only do this if not
 		 * creating */
 		if (setattrs && attrs_set->valid_mask != 0) {
+			if (FSAL_TEST_MASK(attrs_set->valid_mask, ATTR_SIZE))
+				mem_data_truncate(hdl, attrs_set->filesize);
 			mem_copy_attrs_mask(attrs_set, &hdl->attrs);
 		}
 
@@ -1766,19 +1968,23 @@ fsal_status_t mem_reopen2(struct fsal_obj_handle *obj_hdl,
 	PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
 
 	mem_open_my_fd(my_fd, openflags);
-	if (openflags & FSAL_O_TRUNC)
+	if (openflags & FSAL_O_TRUNC) {
+		mem_data_truncate(myself, 0);
 		myself->attrs.filesize = myself->attrs.spaceused = 0;
+	}
 
 	return status;
 }
 
 struct mem_async_arg {
 	struct fsal_obj_handle *obj_hdl;
-	struct fsal_io_arg *io_arg;
+	fsal_status_t status;
+	void *obj_data;
 	fsal_async_cb done_cb;
 	void *caller_arg;
 	struct gsh_export *ctx_export;
 	struct fsal_export *fsal_export;
+	uint64_t lat_usec;
 };
 
 static void
@@ -1791,14 +1997,15 @@ mem_async_complete(struct fridgethr_context *ctx)
 	uint32_t async_delay = atomic_fetch_uint32_t(&mem_export->async_delay);
 
 	/* Now check if we need to delay the call back */
-	if (atomic_fetch_uint32_t(&mem_export->async_type) != MEM_FIXED) {
+	if (atomic_fetch_uint32_t(&mem_export->async_type) != MEM_FIXED &&
+	    async_delay != 0) {
 		/* Randomize delay */
 		async_delay = random() % async_delay;
 	}
 
-	if (async_delay != 0) {
+	if (async_delay != 0 || async_arg->lat_usec != 0) {
 		/* Now actually delay call back */
-		usleep(async_delay);
+		mem_latency_sleep(async_delay + async_arg->lat_usec);
 	}
 
 	/* Need an op context for the call back */
@@ -1806,14 +2013,136 @@ mem_async_complete(struct fridgethr_context *ctx)
 			     async_arg->fsal_export, 0, 0,
 			     UNKNOWN_REQUEST);
 
-	async_arg->done_cb(async_arg->obj_hdl, fsalstat(ERR_FSAL_NO_ERROR, 0),
-			   async_arg->io_arg, async_arg->caller_arg);
+	async_arg->done_cb(async_arg->obj_hdl, async_arg->status,
+			   async_arg->obj_data, async_arg->caller_arg);
 
 	release_root_op_context();
 
 	gsh_free(async_arg);
 }
 
+/**
+ * @brief Deliver the result of an async method
+ *
+ * Depending on Async_Type, the callback is made inline or from the async
+ * fridge after Async_Delay.  Either way the calling thread is then stalled
+ * for Async_Stall_Delay.  The simulated backend latency of the operation
+ * delays the callback too, holding the calling thread when it is inline.
+ *
+ * @param[in] obj_hdl		Object acted on
+ * @param[in] status		Result of the call
+ * @param[in] obj_data		Data for callback
+ * @param[in] done_cb		Callback to call
+ * @param[in] caller_arg	Opaque arg from the caller for callback
+ * @param[in] lat_usec		Backend latency of the operation
+ */
+static void mem_async_done(struct fsal_obj_handle *obj_hdl,
+			   fsal_status_t status, void *obj_data,
+			   fsal_async_cb done_cb, void *caller_arg,
+			   uint64_t lat_usec)
+{
+	struct mem_fsal_export *mem_export =
+	      container_of(op_ctx->fsal_export, struct mem_fsal_export, export);
+	uint32_t async_type = atomic_fetch_uint32_t(&mem_export->async_type);
+	uint32_t async_stall_delay =
+			atomic_fetch_uint32_t(&mem_export->async_stall_delay);
+
+	if (async_type > MEM_RANDOM_OR_INLINE ||
+	    ((async_type == MEM_RANDOM_OR_INLINE) && ((random() % 2) == 1))) {
+		struct mem_async_arg *async_arg;
+
+		/* Was MEM_FIXED, MEM_RANDOM, or MEM_RANDOM_OR_INLINE and we
+		 * scored a non-inline.
+		 */
+		async_arg = gsh_malloc(sizeof(*async_arg));
+
+		async_arg->obj_hdl = obj_hdl;
+		async_arg->status = status;
+		async_arg->obj_data = obj_data;
+		async_arg->caller_arg = caller_arg;
+		async_arg->done_cb = done_cb;
+		async_arg->ctx_export = op_ctx->ctx_export;
+		async_arg->fsal_export = op_ctx->fsal_export;
+		async_arg->lat_usec = lat_usec;
+
+		if (fridgethr_submit(mem_async_fridge,
+				     mem_async_complete,
+				     async_arg) == 0) {
+			/* Async fired off... */
+			goto out;
+		}
+
+		/* Could not schedule, fall through and do an immediate
+		 * call back.
+		 */
+		gsh_free(async_arg);
+	}
+
+	if (lat_usec != 0)
+		mem_latency_sleep(lat_usec);
+
+	done_cb(obj_hdl, status, obj_data, caller_arg);
+
+out:
+
+	if (async_stall_delay > 0) {
+		/* We have been asked to stall the calling thread, whether we
+		 * issued an inline or async callback.
+		 */
+		usleep(async_stall_delay);
+	}
+}
+
+/**
+ * @brief Get attributes for a file asynchronously
+ *
+ * The attributes are fetched right away, the callback is subject to
+ * Async_Type and Async_Delay like read2 and write2.
+ *
+ * @param[in]     obj_hdl	File to get
+ * @param[in,out] attrs		Attributes for file
+ * @param[in]     done_cb	Callback to call when done
+ * @param[in]     caller_arg	Opaque arg from the caller for callback
+ */
+static void mem_getattrs_async(struct fsal_obj_handle *obj_hdl,
+			       struct attrlist *attrs,
+			       fsal_async_cb done_cb,
+			       void *caller_arg)
+{
+	struct mem_fsal_export *mfe =
+	      container_of(op_ctx->fsal_export, struct mem_fsal_export, export);
+	fsal_status_t status = mem_do_getattrs(obj_hdl, attrs);
+
+	mem_async_done(obj_hdl, status, attrs, done_cb, caller_arg,
+		       mem_latency_get(mfe, MEM_LAT_META, 0));
+}
+
+/**
+ * @brief Look up a name asynchronously
+ *
+ * The lookup is done right away, the callback is subject to Async_Type and
+ * Async_Delay like read2 and write2.
+ *
+ * @param[in]     parent	Parent directory
+ * @param[in]     path		Path to lookup
+ * @param[in,out] attrs_out	Attributes of found handle
+ * @param[in]     done_cb	Callback to call when done
+ * @param[in]     caller_arg	Opaque arg from the caller for callback
+ */
+static void mem_lookup_async(struct fsal_obj_handle *parent,
+			     const char *path,
+			     struct attrlist *attrs_out,
+			     fsal_async_cb done_cb,
+			     void *caller_arg)
+{
+	struct mem_fsal_export *mfe =
+	      container_of(op_ctx->fsal_export, struct mem_fsal_export, export);
+	struct fsal_obj_handle *obj = NULL;
+	fsal_status_t status = mem_do_lookup(parent, path, &obj, attrs_out);
+
+	mem_async_done(parent, status, obj, done_cb, caller_arg,
+		       mem_latency_get(mfe, MEM_LAT_META, 0));
+}
 
 /**
  * @brief Read data from a file
@@ -1842,17 +2171,14 @@ void mem_read2(struct fsal_obj_handle *obj_hdl,
 {
 	struct mem_fsal_obj_handle *myself = container_of(obj_hdl,
 				  struct mem_fsal_obj_handle, obj_handle);
+	struct mem_fsal_export *mfe =
+	      container_of(op_ctx->fsal_export, struct mem_fsal_export, export);
 	struct fsal_fd *fsal_fd;
 	bool has_lock, closefd = false;
 	fsal_status_t status = {ERR_FSAL_NO_ERROR, 0};
 	bool reusing_open_state_fd = false;
 	uint64_t offset = read_arg->offset;
 	int i;
-	struct mem_fsal_export *mem_export =
-	      container_of(op_ctx->fsal_export, struct mem_fsal_export, export);
-	uint32_t async_type = atomic_fetch_uint32_t(&mem_export->async_type);
-	uint32_t async_stall_delay =
-			atomic_fetch_uint32_t(&mem_export->async_stall_delay);
 
 	if (read_arg->info != NULL) {
 		/* Currently we don't support READ_PLUS */
@@ -1874,6 +2200,9 @@ void mem_read2(struct fsal_obj_handle *obj_hdl,
 
 	read_arg->io_amount = 0;
 
+	/* Readers run concurrently, writers are kept out */
+	PTHREAD_RWLOCK_rdlock(&myself->mh_file.data_lock);
+
 	for (i = 0; i < read_arg->iov_count; i++) {
 		size_t bufsize;
 
@@ -1887,7 +2216,10 @@ void mem_read2(struct fsal_obj_handle *obj_hdl,
 		if (offset +  bufsize > myself->attrs.filesize) {
 			bufsize = myself->attrs.filesize - offset;
 		}
-		if (offset < myself->datasize) {
+		if (MEM.data_extents) {
+			mem_data_read(myself, read_arg->iov[i].iov_base,
+				      bufsize, offset);
+		} else if (offset < myself->datasize) {
 			size_t readsize;
 
 			/* Data to read */
@@ -1904,6 +2236,8 @@ void mem_read2(struct fsal_obj_handle *obj_hdl,
 		offset += bufsize;
 	}
 
+	PTHREAD_RWLOCK_unlock(&myself->mh_file.data_lock);
+
 #ifdef USE_LTTNG
 	tracepoint(fsalmem, mem_read, __func__, __LINE__, obj_hdl,
 		   myself->m_name, read_arg->state, myself->attrs.filesize,
@@ -1915,45 +2249,10 @@ void mem_read2(struct fsal_obj_handle *obj_hdl,
 	if (has_lock)
 		PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
 
-	if (async_type > MEM_RANDOM_OR_INLINE ||
-	    ((async_type == MEM_RANDOM_OR_INLINE) && ((random() % 1) == 1))) {
-		struct mem_async_arg *async_arg;
-
-		/* Was MEM_FIXED, MEM_RANDOM, or MEM_RANDOM_OR_INLINE and we
-		 * scored a non-inline.
-		 */
-		async_arg = gsh_malloc(sizeof(*async_arg));
-
-		async_arg->obj_hdl = obj_hdl;
-		async_arg->io_arg = read_arg;
-		async_arg->caller_arg = caller_arg;
-		async_arg->done_cb = done_cb;
-		async_arg->ctx_export = op_ctx->ctx_export;
-		async_arg->fsal_export = op_ctx->fsal_export;
-
-		if (fridgethr_submit(mem_async_fridge,
-				     mem_async_complete,
-				     async_arg) == 0) {
-			/* Async fired off... */
-			goto out;
-		}
-
-		/* Could not schedule, fall through and do an immediate
-		 * call back.
-		 */
-		gsh_free(async_arg);
-	}
-
-	done_cb(obj_hdl, fsalstat(ERR_FSAL_NO_ERROR, 0), read_arg, caller_arg);
-
-out:
-
-	if (async_stall_delay > 0) {
-		/* We have been asked to stall the calling thread, whether we
-		 * issued an inline or async callback.
-		 */
-		usleep(async_stall_delay);
-	}
+	mem_async_done(obj_hdl, fsalstat(ERR_FSAL_NO_ERROR, 0), read_arg,
+		       done_cb, caller_arg,
+		       mem_latency_get(mfe, MEM_LAT_DATA,
+				       read_arg->io_amount));
 }
 
 /**
@@ -1983,17 +2282,14 @@ void mem_write2(struct fsal_obj_handle *obj_hdl,
 {
 	struct mem_fsal_obj_handle *myself = container_of(obj_hdl,
 				  struct mem_fsal_obj_handle, obj_handle);
+	struct mem_fsal_export *mfe =
+	      container_of(op_ctx->fsal_export, struct mem_fsal_export, export);
 	struct fsal_fd *fsal_fd;
 	bool has_lock, closefd = false;
 	fsal_status_t status = {ERR_FSAL_NO_ERROR, 0};
 	bool reusing_open_state_fd = false;
 	uint64_t offset = write_arg->offset;
 	int i;
-	struct mem_fsal_export *mem_export =
-	      container_of(op_ctx->fsal_export, struct mem_fsal_export, export);
-	uint32_t async_type = atomic_fetch_uint32_t(&mem_export->async_type);
-	uint32_t async_stall_delay =
-			atomic_fetch_uint32_t(&mem_export->async_stall_delay);
 
 	if (obj_hdl->type != REGULAR_FILE) {
 		/* Currently can only write to a file */
@@ -2013,15 +2309,24 @@ void mem_write2(struct fsal_obj_handle *obj_hdl,
 		return;
 	}
 
+	PTHREAD_RWLOCK_wrlock(&myself->mh_file.data_lock);
+
 	for (i = 0; i < write_arg->iov_count; i++) {
 		size_t bufsize;
 
 		bufsize = write_arg->iov[i].iov_len;
+		if (MEM.data_extents) {
+			status = mem_data_write(myself,
+						write_arg->iov[i].iov_base,
+						bufsize, offset);
+			if (FSAL_IS_ERROR(status))
+				break;
+		}
 		if (offset +  bufsize > myself->attrs.filesize) {
 			myself->attrs.filesize = myself->attrs.spaceused =
 				offset + bufsize;
 		}
-		if (offset < myself->datasize) {
+		if (!MEM.data_extents && offset < myself->datasize) {
 			size_t writesize;
 
 			/* Data to write */
@@ -2033,6 +2338,8 @@ void mem_write2(struct fsal_obj_handle *obj_hdl,
 		offset += bufsize;
 	}
 
+	PTHREAD_RWLOCK_unlock(&myself->mh_file.data_lock);
+
 #ifdef USE_LTTNG
 	tracepoint(fsalmem, mem_write, __func__, __LINE__, obj_hdl,
 			   myself->m_name, write_arg->state,
@@ -2052,45 +2359,13 @@ void mem_write2(struct fsal_obj_handle *obj_hdl,
 	if (has_lock)
 		PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
 
-	if (async_type > MEM_RANDOM_OR_INLINE ||
-	    ((async_type == MEM_RANDOM_OR_INLINE) && ((random() % 1) == 1))) {
-		struct mem_async_arg *async_arg;
-
-		/* Was MEM_FIXED, MEM_RANDOM, or MEM_RANDOM_OR_INLINE and we
-		 * scored a non-inline.
-		 */
-		async_arg = gsh_malloc(sizeof(*async_arg));
-
-		async_arg->obj_hdl = obj_hdl;
-		async_arg->io_arg = write_arg;
-		async_arg->caller_arg = caller_arg;
-		async_arg->done_cb = done_cb;
-		async_arg->ctx_export = op_ctx->ctx_export;
-		async_arg->fsal_export = op_ctx->fsal_export;
+	/* Out of memory part way is a short write */
+	if (write_arg->io_amount != 0)
+		status = fsalstat(ERR_FSAL_NO_ERROR, 0);
 
-		if (fridgethr_submit(mem_async_fridge,
-				     mem_async_complete,
-				     async_arg) == 0) {
-			/* Async fired off... */
-			goto out;
-		}
-
-		/* Could not schedule, fall through and do an immediate
-		 * call back.
-		 */
-		gsh_free(async_arg);
-	}
-
-	done_cb(obj_hdl, fsalstat(ERR_FSAL_NO_ERROR, 0), write_arg, caller_arg);
-
-out:
-
-	if (async_stall_delay > 0) {
-		/* We have been asked to stall the calling thread, whether we
-		 * issued an inline or async callback.
-		 */
-		usleep(async_stall_delay);
-	}
+	mem_async_done(obj_hdl, status, write_arg, done_cb, caller_arg,
+		       mem_latency_get(mfe, MEM_LAT_DATA,
+				       write_arg->io_amount));
 }
 
 /**
@@ -2114,6 +2389,8 @@ fsal_status_t mem_commit2(struct fsal_obj_handle *obj_hdl,
 			  off_t offset,
 			  size_t len)
 {
+	mem_latency_wait(MEM_LAT_DATA, 0);
+
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
@@ -2431,6 +2708,8 @@ void mem_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->commit2 = mem_commit2;
 	ops->lock_op2 = mem_lock_op2;
 	ops->close2 = mem_close2;
+	ops->getattrs_async = mem_getattrs_async;
+	ops->lookup_async = mem_lookup_async;
 	ops->handle_to_wire = mem_handle_to_wire;
 	ops->handle_to_key = mem_handle_to_key;
 }
@@ -41,6 +41,15 @@ enum async_types {
 	MEM_FIXED,
 };
 
+/** Classes of operations with their own latency model */
+enum mem_lat_class {
+	MEM_LAT_META,
+	MEM_LAT_DATA,
+	MEM_LAT_CLASSES
+};
+
+struct mem_latency;
+
 /**
  * MEM internal export
  */
@@ -63,6 +72,29 @@ struct mem_fsal_export {
 	uint32_t async_stall_delay;
 	/** Type of async */
 	uint32_t async_type;
+	/** Config - latency model of metadata operations */
+	char *meta_latency;
+	/** Config - latency model of data operations */
+	char *data_latency;
+	/** Config - data throughput in bytes per second, 0 for no cap */
+	uint64_t throughput_cap;
+	/** Config - seconds between backend stalls, 0 for none */
+	uint32_t stall_interval;
+	/** Config - length of backend stalls in ms */
+	uint32_t stall_duration;
+	/** Parsed latency models */
+	struct mem_latency *lat[MEM_LAT_CLASSES];
+	/** Models replaced by update_export, freed with the export */
+	struct mem_latency *lat_retired;
+	/** Lock protecting pace_next and lat_retired */
+	pthread_mutex_t pace_lock;
+	/** When the data transfers queued under the cap are done, in ns */
+	uint64_t pace_next;
+	/** Latency counters */
+	uint64_t lat_ops[MEM_LAT_CLASSES];
+	uint64_t lat_usec[MEM_LAT_CLASSES];
+	uint64_t pace_usec;
+	uint64_t stalls;
 };
 
 fsal_status_t mem_lookup_path(struct fsal_export *exp_hdl,
@@ -81,6 +113,18 @@ fsal_status_t mem_create_handle(struct fsal_export *exp_hdl,
 
 #define V4_FH_OPAQUE_SIZE 58 /* Size of state_obj digest */
 
+/**
+ * @brief One independently locked part of a directory
+ *
+ * A dirent lives in the shard covering the top bits of its d_index, so
+ * walking the shards in order walks the directory in cookie order.
+ */
+struct mem_dir_shard {
+	pthread_rwlock_t lock;		/**< Protects both trees */
+	struct avltree avl_name;
+	struct avltree avl_index;
+};
+
 struct mem_fsal_obj_handle {
 	struct fsal_obj_handle obj_handle;
 	struct attrlist attrs;
@@ -89,13 +133,15 @@ struct mem_fsal_obj_handle {
 	union {
 		struct {
 			struct mem_fsal_obj_handle *parent;
-			struct avltree avl_name;
-			struct avltree avl_index;
+			struct mem_dir_shard *shards;	/**< Dir_Shards of them */
 			uint32_t numkids;
 		} mh_dir;
 		struct {
 			struct fsal_share share;
 			struct fsal_fd fd;
+			pthread_rwlock_t data_lock;	/**< Data and size */
+			void **extents;		/**< Data_Extents, NULL for holes */
+			uint64_t nextents;	/**< Slots in extents */
 		} mh_file;
 		struct {
 			object_file_type_t nodetype;
@@ -156,6 +202,28 @@ fsal_status_t mem_update_export(struct fsal_module *fsal_hdl,
 
 const char *str_async_type(uint32_t async_type);
 
+void mem_free_dir_shards(struct mem_fsal_obj_handle *dir);
+
+/* File data, mem_data.c */
+void mem_data_init(struct mem_fsal_obj_handle *hdl);
+void mem_data_free(struct mem_fsal_obj_handle *hdl);
+void mem_data_read(struct mem_fsal_obj_handle *hdl, void *buf, size_t len,
+		   uint64_t offset);
+fsal_status_t mem_data_write(struct mem_fsal_obj_handle *hdl,
+			     const void *buf, size_t len, uint64_t offset);
+void mem_data_truncate(struct mem_fsal_obj_handle *hdl, uint64_t size);
+fsal_status_t mem_data_pkginit(void);
+fsal_status_t mem_data_pkgshutdown(void);
+
+/* Simulated backend latency, mem_latency.c */
+int mem_latency_config(struct mem_fsal_export *exp,
+		       struct mem_fsal_export *conf);
+void mem_latency_release(struct mem_fsal_export *exp);
+uint64_t mem_latency_get(struct mem_fsal_export *exp,
+			 enum mem_lat_class class, uint64_t bytes);
+void mem_latency_sleep(uint64_t usec);
+void mem_latency_wait(enum mem_lat_class class, uint64_t bytes);
+
 #define mem_free_handle(h) _mem_free_handle(h, __func__, __LINE__)
 /**
  * @brief Free a MEM handle
@@ -173,6 +241,11 @@ static inline void _mem_free_handle(struct mem_fsal_obj_handle *hdl,
 	glist_del(&hdl->mfo_exp_entry);
 	hdl->mfo_exp = NULL;
 
+	if (hdl->obj_handle.type == DIRECTORY)
+		mem_free_dir_shards(hdl);
+	else if (hdl->obj_handle.type == REGULAR_FILE)
+		mem_data_free(hdl);
+
 	if (hdl->m_name != NULL) {
 		gsh_free(hdl->m_name);
 		hdl->m_name = NULL;
@@ -204,6 +277,16 @@ struct mem_fsal_module {
 	uint32_t async_threads;
 	/** Config - whether so use whence-is-name */
 	bool whence_is_name;
+	/** Config - number of locked parts of each directory */
+	uint32_t dir_shards;
+	/** log2 of dir_shards */
+	uint32_t dir_shard_bits;
+	/** Config - keep all file data, in extents allocated from slabs */
+	bool data_extents;
+	/** Config - size of a data extent */
+	uint32_t extent_size;
+	/** Config - size of the slabs extents are carved from */
+	uint32_t slab_size;
 };
 
 /* ASYNC testing */
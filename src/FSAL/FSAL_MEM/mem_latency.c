@@ -0,0 +1,462 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* mem_latency.c
+ * MEM FSAL simulated backend latency
+ *
+ * Each export may give a latency model for metadata operations and one for
+ * data operations, a cap on the data throughput and periodic stalls of the
+ * whole backend.  Together they make MEM behave like a slow or erratic
+ * server, so MDCACHE, the worker pools and the async paths can be measured
+ * against one without leaving the machine.
+ *
+ * Models are written as a name followed by its parameters, times are in
+ * microseconds:
+ *
+ *	none
+ *	fixed USEC
+ *	uniform MIN MAX
+ *	lognormal MEDIAN SIGMA
+ *	bimodal FAST SLOW SLOW_PERCENT
+ *	percentiles PCT:USEC [PCT:USEC ...]
+ *
+ * percentiles interpolates linearly between the points given, typically
+ * taken from a trace of the real backend.  Below the first point the first
+ * value is used, above the last point the last value.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fsal.h"
+#include "mem_int.h"
+
+#define MEM_LAT_POINTS 32
+
+enum mem_lat_model {
+	MEM_LAT_FIXED,
+	MEM_LAT_UNIFORM,
+	MEM_LAT_LOGNORMAL,
+	MEM_LAT_BIMODAL,
+	MEM_LAT_PERCENTILES,
+};
+
+struct mem_latency {
+	enum mem_lat_model model;
+	/** fixed, uniform min, lognormal median, bimodal fast */
+	double usec1;
+	/** uniform max, bimodal slow */
+	double usec2;
+	/** lognormal sigma, bimodal slow percent */
+	double param;
+	uint32_t npoints;
+	double pct[MEM_LAT_POINTS];
+	double usec[MEM_LAT_POINTS];
+	/** Next model retired by update_export */
+	struct mem_latency *retired;
+};
+
+/** Per thread xorshift64* state, seeded on first use */
+static __thread uint64_t mem_lat_rng;
+
+/**
+ * @brief Draw a number uniformly in (0, 1)
+ */
+static double mem_lat_random(void)
+{
+	uint64_t x = mem_lat_rng;
+
+	if (x == 0) {
+		struct timespec ts;
+
+		now(&ts);
+		x = ((uint64_t) pthread_self() ^ timespec_to_nsecs(&ts)) | 1;
+	}
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	mem_lat_rng = x;
+
+	/* 53 bits of the xorshift64* output, the mantissa of a double */
+	return (((x * 0x2545F4914F6CDD1DULL) >> 11) + 0.5) /
+	       9007199254740992.0;
+}
+
+static double mem_lat_sample(const struct mem_latency *lat)
+{
+	double u, z;
+	uint32_t i;
+
+	switch (lat->model) {
+	case MEM_LAT_FIXED:
+		return lat->usec1;
+
+	case MEM_LAT_UNIFORM:
+		return lat->usec1 +
+		       (lat->usec2 - lat->usec1) * mem_lat_random();
+
+	case MEM_LAT_LOGNORMAL:
+		/* Box-Muller */
+		u = mem_lat_random();
+		z = sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * mem_lat_random());
+		return lat->usec1 * exp(lat->param * z);
+
+	case MEM_LAT_BIMODAL:
+		return mem_lat_random() * 100.0 < lat->param
+			? lat->usec2 : lat->usec1;
+
+	case MEM_LAT_PERCENTILES:
+		u = mem_lat_random() * 100.0;
+
+		if (u <= lat->pct[0])
+			return lat->usec[0];
+
+		for (i = 1; i < lat->npoints; i++) {
+			if (u <= lat->pct[i])
+				return lat->usec[i - 1] +
+				       (lat->usec[i] - lat->usec[i - 1]) *
+				       (u - lat->pct[i - 1]) /
+				       (lat->pct[i] - lat->pct[i - 1]);
+		}
+
+		return lat->usec[lat->npoints - 1];
+	}
+
+	return 0;
+}
+
+static bool mem_lat_number(const char *tok, double *val)
+{
+	char *end;
+
+	if (tok == NULL)
+		return false;
+
+	errno = 0;
+	*val = strtod(tok, &end);
+
+	return errno == 0 && end != tok && *end == '\0' && *val >= 0 &&
+	       isfinite(*val);
+}
+
+static bool mem_lat_parse_points(struct mem_latency *lat, char *tok,
+				 char **save)
+{
+	char *colon;
+
+	for (; tok != NULL; tok = strtok_r(NULL, " \t", save)) {
+		if (lat->npoints == MEM_LAT_POINTS)
+			return false;
+
+		colon = strchr(tok, ':');
+		if (colon == NULL)
+			return false;
+		*colon = '\0';
+
+		if (!mem_lat_number(tok, &lat->pct[lat->npoints]) ||
+		    !mem_lat_number(colon + 1, &lat->usec[lat->npoints]) ||
+		    lat->pct[lat->npoints] > 100)
+			return false;
+
+		/* Points must go up in percentile and time */
+		if (lat->npoints > 0 &&
+		    (lat->pct[lat->npoints] <= lat->pct[lat->npoints - 1] ||
+		     lat->usec[lat->npoints] < lat->usec[lat->npoints - 1]))
+			return false;
+
+		lat->npoints++;
+	}
+
+	return lat->npoints > 0;
+}
+
+/**
+ * @brief Parse a latency model
+ *
+ * @param[in]  spec	Model as written in the config, may be NULL
+ * @param[out] lat	The model, NULL for none
+ *
+ * @return 0 or EINVAL.
+ */
+static int mem_latency_parse(const char *spec, struct mem_latency **lat)
+{
+	struct mem_latency *new;
+	char *copy, *tok, *save;
+	bool ok = false;
+
+	*lat = NULL;
+
+	if (spec == NULL)
+		return 0;
+
+	copy = gsh_strdup(spec);
+	tok = strtok_r(copy, " \t", &save);
+
+	if (tok == NULL || strcasecmp(tok, "none") == 0) {
+		gsh_free(copy);
+		return 0;
+	}
+
+	new = gsh_calloc(1, sizeof(*new));
+
+	if (strcasecmp(tok, "fixed") == 0) {
+		new->model = MEM_LAT_FIXED;
+		ok = mem_lat_number(strtok_r(NULL, " \t", &save),
+				    &new->usec1);
+	} else if (strcasecmp(tok, "uniform") == 0) {
+		new->model = MEM_LAT_UNIFORM;
+		ok = mem_lat_number(strtok_r(NULL, " \t", &save),
+				    &new->usec1) &&
+		     mem_lat_number(strtok_r(NULL, " \t", &save),
+				    &new->usec2) &&
+		     new->usec1 <= new->usec2;
+	} else if (strcasecmp(tok, "lognormal") == 0) {
+		new->model = MEM_LAT_LOGNORMAL;
+		ok = mem_lat_number(strtok_r(NULL, " \t", &save),
+				    &new->usec1) &&
+		     mem_lat_number(strtok_r(NULL, " \t", &save),
+				    &new->param);
+	} else if (strcasecmp(tok, "bimodal") == 0) {
+		new->model = MEM_LAT_BIMODAL;
+		ok = mem_lat_number(strtok_r(NULL, " \t", &save),
+				    &new->usec1) &&
+		     mem_lat_number(strtok_r(NULL, " \t", &save),
+				    &new->usec2) &&
+		     mem_lat_number(strtok_r(NULL, " \t", &save),
+				    &new->param) &&
+		     new->param <= 100;
+	} else if (strcasecmp(tok, "percentiles") == 0) {
+		new->model = MEM_LAT_PERCENTILES;
+		ok = mem_lat_parse_points(new,
+					  strtok_r(NULL, " \t", &save), &save);
+	}
+
+	/* Nothing may follow the parameters */
+	if (ok && strtok_r(NULL, " \t", &save) != NULL)
+		ok = false;
+
+	gsh_free(copy);
+
+	if (!ok) {
+		LogCrit(COMPONENT_FSAL, "Invalid latency model \"%s\"", spec);
+		gsh_free(new);
+		return EINVAL;
+	}
+
+	*lat = new;
+	return 0;
+}
+
+/**
+ * @brief Set up the latency models of an export from its config
+ *
+ * On update, the models in use are replaced and kept until the export is
+ * released, as other threads may still be sampling them.  pace_lock must
+ * have been initialized.
+ *
+ * @param[in] exp	Export to set up
+ * @param[in] conf	Export config, @a exp itself when it is created
+ *
+ * @return 0 or EINVAL, in which case @a exp is left unchanged.
+ */
+int mem_latency_config(struct mem_fsal_export *exp,
+		       struct mem_fsal_export *conf)
+{
+	struct mem_latency *lat[MEM_LAT_CLASSES], *old;
+	int i;
+
+	if (mem_latency_parse(conf->meta_latency, &lat[MEM_LAT_META]) != 0)
+		return EINVAL;
+
+	if (mem_latency_parse(conf->data_latency, &lat[MEM_LAT_DATA]) != 0) {
+		gsh_free(lat[MEM_LAT_META]);
+		return EINVAL;
+	}
+
+	PTHREAD_MUTEX_lock(&exp->pace_lock);
+
+	for (i = 0; i < MEM_LAT_CLASSES; i++) {
+		old = atomic_fetch_voidptr((void **)&exp->lat[i]);
+		if (old != NULL) {
+			old->retired = exp->lat_retired;
+			exp->lat_retired = old;
+		}
+		atomic_store_voidptr((void **)&exp->lat[i], lat[i]);
+	}
+
+	PTHREAD_MUTEX_unlock(&exp->pace_lock);
+
+	atomic_store_uint64_t(&exp->throughput_cap, conf->throughput_cap);
+	atomic_store_uint32_t(&exp->stall_interval, conf->stall_interval);
+	atomic_store_uint32_t(&exp->stall_duration, conf->stall_duration);
+
+	/* Quiet for the plain exports, always heard on update */
+	LogAtLevel(COMPONENT_FSAL,
+		   exp != conf || lat[MEM_LAT_META] != NULL ||
+		   lat[MEM_LAT_DATA] != NULL || conf->throughput_cap != 0 ||
+		   conf->stall_interval != 0 ? NIV_EVENT : NIV_DEBUG,
+		   "FSAL_MEM latency meta=\"%s\" data=\"%s\" throughput_cap=%"
+		   PRIu64" stall=%"PRIu32"ms every %"PRIu32"s",
+		   conf->meta_latency ? conf->meta_latency : "none",
+		   conf->data_latency ? conf->data_latency : "none",
+		   conf->throughput_cap, conf->stall_duration,
+		   conf->stall_interval);
+
+	return 0;
+}
+
+/**
+ * @brief Log the latency counters of an export and free its models
+ *
+ * @param[in] exp	Export being released
+ */
+void mem_latency_release(struct mem_fsal_export *exp)
+{
+	struct mem_latency *lat;
+	int i;
+
+	if (exp->lat_ops[MEM_LAT_META] != 0 ||
+	    exp->lat_ops[MEM_LAT_DATA] != 0 || exp->stalls != 0)
+		LogEvent(COMPONENT_FSAL,
+			 "FSAL_MEM export %"PRIu16" delayed %"PRIu64
+			 " metadata ops by %"PRIu64"us, %"PRIu64
+			 " data ops by %"PRIu64"us (%"PRIu64
+			 "us throughput cap), %"PRIu64" stalls",
+			 exp->export.export_id,
+			 exp->lat_ops[MEM_LAT_META],
+			 exp->lat_usec[MEM_LAT_META],
+			 exp->lat_ops[MEM_LAT_DATA],
+			 exp->lat_usec[MEM_LAT_DATA],
+			 exp->pace_usec, exp->stalls);
+
+	for (i = 0; i < MEM_LAT_CLASSES; i++) {
+		gsh_free(exp->lat[i]);
+		exp->lat[i] = NULL;
+	}
+
+	while (exp->lat_retired != NULL) {
+		lat = exp->lat_retired;
+		exp->lat_retired = lat->retired;
+		gsh_free(lat);
+	}
+
+	PTHREAD_MUTEX_destroy(&exp->pace_lock);
+}
+
+/**
+ * @brief Work out how long an operation takes on the simulated backend
+ *
+ * @param[in] exp	Export of the operation
+ * @param[in] class	Metadata or data
+ * @param[in] bytes	Data moved by the operation
+ *
+ * @return The delay in microseconds.
+ */
+uint64_t mem_latency_get(struct mem_fsal_export *exp,
+			 enum mem_lat_class class, uint64_t bytes)
+{
+	struct mem_latency *lat =
+		atomic_fetch_voidptr((void **)&exp->lat[class]);
+	uint64_t cap = atomic_fetch_uint64_t(&exp->throughput_cap);
+	uint32_t interval = atomic_fetch_uint32_t(&exp->stall_interval);
+	uint32_t duration = atomic_fetch_uint32_t(&exp->stall_duration);
+	uint64_t usec = 0, pace = 0, nsecs, start, phase;
+	struct timespec ts;
+
+	if (lat == NULL && (cap == 0 || bytes == 0) &&
+	    (interval == 0 || duration == 0))
+		return 0;
+
+	now(&ts);
+	nsecs = timespec_to_nsecs(&ts);
+
+	if (lat != NULL)
+		usec = mem_lat_sample(lat);
+
+	if (cap != 0 && bytes != 0) {
+		/* Transfers go one after the other at the capped rate, this
+		 * one is done when all those queued before it are.
+		 */
+		PTHREAD_MUTEX_lock(&exp->pace_lock);
+		start = exp->pace_next > nsecs ? exp->pace_next : nsecs;
+		exp->pace_next = start + bytes * NS_PER_SEC / cap;
+		pace = (exp->pace_next - nsecs) / NS_PER_USEC;
+		PTHREAD_MUTEX_unlock(&exp->pace_lock);
+
+		(void)atomic_add_uint64_t(&exp->pace_usec, pace);
+		usec += pace;
+	}
+
+	if (interval != 0 && duration != 0) {
+		/* The backend is stuck for the first duration ms of each
+		 * interval, anything reaching it then waits it out.
+		 */
+		phase = (nsecs / NS_PER_MSEC) % ((uint64_t) interval * 1000);
+		if (phase < duration) {
+			(void)atomic_inc_uint64_t(&exp->stalls);
+			usec += (duration - phase) * 1000;
+		}
+	}
+
+	if (usec != 0) {
+		(void)atomic_inc_uint64_t(&exp->lat_ops[class]);
+		(void)atomic_add_uint64_t(&exp->lat_usec[class], usec);
+	}
+
+	return usec;
+}
+
+/**
+ * @brief Sleep for a delay, which may be longer than usleep allows
+ *
+ * @param[in] usec	Delay in microseconds
+ */
+void mem_latency_sleep(uint64_t usec)
+{
+	struct timespec ts;
+
+	ts.tv_sec = usec / 1000000;
+	ts.tv_nsec = (usec % 1000000) * NS_PER_USEC;
+
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+/**
+ * @brief Hold the calling thread for the time an operation takes
+ *
+ * @param[in] class	Metadata or data
+ * @param[in] bytes	Data moved by the operation
+ */
+void mem_latency_wait(enum mem_lat_class class, uint64_t bytes)
+{
+	struct mem_fsal_export *exp =
+	      container_of(op_ctx->fsal_export, struct mem_fsal_export, export);
+	uint64_t usec = mem_latency_get(exp, class, bytes);
+
+	if (usec != 0)
+		mem_latency_sleep(usec);
+}
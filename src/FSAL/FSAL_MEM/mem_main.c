@@ -89,6 +89,14 @@ static struct config_item mem_items[] = {
 		       mem_fsal_module, async_threads),
 	CONF_ITEM_BOOL("Whence_is_name", false,
 		       mem_fsal_module, whence_is_name),
+	CONF_ITEM_UI32("Dir_Shards", 1, 1024, 1,
+		       mem_fsal_module, dir_shards),
+	CONF_ITEM_BOOL("Data_Extents", false,
+		       mem_fsal_module, data_extents),
+	CONF_ITEM_UI32("Extent_Size", 4096, 0x200000, 0x10000,
+		       mem_fsal_module, extent_size),
+	CONF_ITEM_UI32("Slab_Size", 0x200000, 0x40000000, 0x200000,
+		       mem_fsal_module, slab_size),
 	CONFIG_EOL
 };
 
@@ -222,6 +230,15 @@ static fsal_status_t mem_init_config(struct fsal_module *fsal_hdl,
 		return status;
 	}
 
+	/* Initialize file data and directory layout */
+	status = mem_data_pkginit();
+	if (FSAL_IS_ERROR(status)) {
+		LogMajor(COMPONENT_FSAL,
+			 "Failed to initialize FSAL_MEM data package %s",
+			 fsal_err_txt(status));
+		return status;
+	}
+
 	/* Set whence_is_name in fsinfo */
 	mem_me->fsal.fs_info.whence_is_name = mem_me->whence_is_name;
 
@@ -285,6 +302,9 @@ MODULE_FINI void finish(void)
 	/* Shutdown ASYNC threads */
 	mem_async_pkgshutdown();
 
+	/* Release file data slabs */
+	mem_data_pkgshutdown();
+
 	retval = unregister_fsal(&MEM.fsal);
 	if (retval != 0) {
 		LogCrit(COMPONENT_FSAL,
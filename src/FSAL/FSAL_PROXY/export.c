@@ -65,6 +65,10 @@ static struct config_item proxy_export_params[] = {
 		       pxy_client_params, use_privileged_client_port),
 	CONF_ITEM_UI32("RPC_Client_Timeout", 1, 60*4, 60,
 		       pxy_client_params, srv_timeout),
+	CONF_ITEM_UI32("Connections", 1, PXY_MAX_CONNECTIONS, 1,
+		       pxy_client_params, srv_connections),
+	CONF_ITEM_UI32("Session_Slots", 1, 256, NB_RPC_SLOT,
+		       pxy_client_params, srv_slots),
 #ifdef _USE_GSSRPC
 	CONF_ITEM_STR("Remote_PrincipalName", 0, MAXNAMLEN, NULL,
 		      pxy_client_params, remote_principal),
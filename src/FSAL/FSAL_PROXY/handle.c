@@ -49,7 +49,6 @@
 
 #define FSAL_PROXY_NFS_V4 4
 #define FSAL_PROXY_NFS_V4_MINOR 1
-#define NB_RPC_SLOT 16
 #define NB_MAX_OPERATIONS 10
 
 /* NB! nfs_prog is just an easy way to get this info into the call
@@ -71,6 +70,7 @@ struct pxy_rpc_io_context {
 	char *recvbuf;
 	slotid4 slotid;
 	sequenceid4 seqid;
+	uint32_t session_gen;
 };
 
 /* Use this to estimate storage requirements for fattr4 blob */
@@ -397,7 +397,7 @@ static int pxy_got_rpc_reply(struct pxy_rpc_io_context *ctx, int sock, int sz,
 	return size;
 }
 
-static int pxy_rpc_read_reply(struct pxy_export *pxy_exp)
+static int pxy_rpc_read_reply(struct pxy_rpc_conn *conn)
 {
 	struct {
 		uint recmark;
@@ -409,10 +409,12 @@ static int pxy_rpc_read_reply(struct pxy_export *pxy_exp)
 	int cnt = 0;
 
 	while (cnt < 8) {
-		int bc = read(pxy_exp->rpc.rpc_sock, buf + cnt, 8 - cnt);
+		int bc = read(conn->sock, buf + cnt, 8 - cnt);
 
 		if (bc < 0)
 			return -errno;
+		if (bc == 0)
+			return -ECONNRESET;
 		cnt += bc;
 	}
 
@@ -423,19 +425,20 @@ static int pxy_rpc_read_reply(struct pxy_export *pxy_exp)
 	LogDebug(COMPONENT_FSAL, "Recmark %x, xid %u\n", h.recmark, h.xid);
 	h.recmark &= ~(1U << 31);
 
-	PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
-	glist_for_each(c, &pxy_exp->rpc.rpc_calls) {
+	PTHREAD_MUTEX_lock(&conn->lock);
+	glist_for_each(c, &conn->calls) {
 		struct pxy_rpc_io_context *ctx =
 		    container_of(c, struct pxy_rpc_io_context, calls);
 
 		if (ctx->rpc_xid == h.xid) {
 			glist_del(c);
-			PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
-			return pxy_got_rpc_reply(ctx, pxy_exp->rpc.rpc_sock,
-						 h.recmark, h.xid);
+			(void)atomic_dec_uint32_t(&conn->pending);
+			PTHREAD_MUTEX_unlock(&conn->lock);
+			return pxy_got_rpc_reply(ctx, conn->sock, h.recmark,
+						 h.xid);
 		}
 	}
-	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+	PTHREAD_MUTEX_unlock(&conn->lock);
 
 	cnt = h.recmark - 4;
 	LogDebug(COMPONENT_FSAL, "xid %u is not on the list, skip %d bytes\n",
@@ -443,7 +446,7 @@ static int pxy_rpc_read_reply(struct pxy_export *pxy_exp)
 	while (cnt > 0) {
 		int rb = (cnt > sizeof(sink)) ? sizeof(sink) : cnt;
 
-		rb = read(pxy_exp->rpc.rpc_sock, sink, rb);
+		rb = read(conn->sock, sink, rb);
 		if (rb <= 0)
 			return -errno;
 		cnt -= rb;
@@ -452,14 +455,41 @@ static int pxy_rpc_read_reply(struct pxy_export *pxy_exp)
 	return 0;
 }
 
-/* called with listlock */
-static void pxy_new_socket_ready(struct pxy_export *pxy_exp)
+static void pxy_new_socket_ready(struct pxy_rpc_conn *conn, int sock)
 {
+	struct pxy_export *pxy_exp = conn->pxy_exp;
+
+	PTHREAD_MUTEX_lock(&conn->lock);
+	conn->sock = sock;
+	PTHREAD_MUTEX_unlock(&conn->lock);
+
+	/* If there is anyone waiting for the socket then tell them
+	 * it's ready */
+	PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
+	if (pxy_exp->rpc.nb_connected++ == 0)
+		pxy_exp->rpc.reconnected = true;
+	pthread_cond_broadcast(&pxy_exp->rpc.sockless);
+	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+}
+
+static void pxy_rpc_conn_lost(struct pxy_rpc_conn *conn)
+{
+	struct pxy_export *pxy_exp = conn->pxy_exp;
 	struct glist_head *nxt;
 	struct glist_head *c;
 
-	/* If there are any outstanding calls then tell them to resend */
-	glist_for_each_safe(c, nxt, &pxy_exp->rpc.rpc_calls) {
+	PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
+	pxy_exp->rpc.nb_connected--;
+	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+
+	PTHREAD_MUTEX_lock(&conn->lock);
+	close(conn->sock);
+	conn->sock = -1;
+
+	/* If there are any outstanding calls then tell them to resend,
+	 * they will go to another connection if there is one.
+	 */
+	glist_for_each_safe(c, nxt, &conn->calls) {
 		struct pxy_rpc_io_context *ctx =
 		    container_of(c, struct pxy_rpc_io_context, calls);
 
@@ -471,117 +501,123 @@ static void pxy_new_socket_ready(struct pxy_export *pxy_exp)
 		pthread_cond_signal(&ctx->iowait);
 		PTHREAD_MUTEX_unlock(&ctx->iolock);
 	}
-
-	/* If there is anyone waiting for the socket then tell them
-	 * it's ready */
-	pthread_cond_broadcast(&pxy_exp->rpc.sockless);
+	atomic_store_uint32_t(&conn->pending, 0);
+	PTHREAD_MUTEX_unlock(&conn->lock);
 }
 
-/* called with listlock */
 static int pxy_connect(struct pxy_export *pxy_exp,
 		       sockaddr_t *dest, uint16_t port)
 {
+	sockaddr_t addr;
 	int sock;
 	int socklen;
 
+	/* Every receiver thread connects, work on a copy */
+	memcpy(&addr, dest, sizeof(addr));
+
 	if (pxy_exp->info.use_privileged_client_port) {
 		int priv_port = 0;
 
-		sock = rresvport_af(&priv_port, dest->ss_family);
+		sock = rresvport_af(&priv_port, addr.ss_family);
 		if (sock < 0)
 			LogCrit(COMPONENT_FSAL,
 				"Cannot create TCP socket on privileged port");
 	} else {
-		sock = socket(dest->ss_family, SOCK_STREAM, IPPROTO_TCP);
+		sock = socket(addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
 		if (sock < 0)
 			LogCrit(COMPONENT_FSAL, "Cannot create TCP socket - %d",
 				errno);
 	}
 
-	switch (dest->ss_family) {
+	switch (addr.ss_family) {
 	case AF_INET:
-		((struct sockaddr_in *)dest)->sin_port = htons(port);
+		((struct sockaddr_in *)&addr)->sin_port = htons(port);
 		socklen = sizeof(struct sockaddr_in);
 		break;
 	case AF_INET6:
-		((struct sockaddr_in6 *)dest)->sin6_port = htons(port);
+		((struct sockaddr_in6 *)&addr)->sin6_port = htons(port);
 		socklen = sizeof(struct sockaddr_in6);
 		break;
 	default:
 		LogCrit(COMPONENT_FSAL, "Unknown address family %d",
-			dest->ss_family);
+			addr.ss_family);
 		close(sock);
 		return -1;
 	}
 
 	if (sock >= 0) {
-		if (connect(sock, (struct sockaddr *)dest, socklen) < 0) {
+		if (connect(sock, (struct sockaddr *)&addr, socklen) < 0) {
 			close(sock);
 			sock = -1;
-		} else {
-			pxy_new_socket_ready(pxy_exp);
 		}
 	}
 	return sock;
 }
 
 /*
- * NB! rpc_sock can be closed by the sending thread but it will not be
- *     changing its value. Only this function will change rpc_sock which
- *     means that it can look at the value without holding the lock.
+ * NB! conn->sock can be shut down by the sending threads but only this
+ *     function changes its value, which means that it can look at it
+ *     without holding the lock.
  */
 static void *pxy_rpc_recv(void *arg)
 {
-	struct pxy_export *pxy_exp = arg;
+	struct pxy_rpc_conn *conn = arg;
+	struct pxy_export *pxy_exp = conn->pxy_exp;
 	char addr[INET6_ADDRSTRLEN];
+	char thr_name[16];
 	struct pollfd pfd;
 	int millisec = pxy_exp->info.srv_timeout * 1000;
+	int sock;
 
-	SetNameFunction("pxy_rcv_thread");
+	(void)snprintf(thr_name, sizeof(thr_name), "pxy_rcv_%"PRIu32,
+		       conn->index);
+	SetNameFunction(thr_name);
 
 	rcu_register_thread();
 	while (!pxy_exp->rpc.close_thread) {
 		int nsleeps = 0;
 
-		PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
 		do {
-			pxy_exp->rpc.rpc_sock = pxy_connect(pxy_exp,
-						&pxy_exp->info.srv_addr,
-						pxy_exp->info.srv_port);
+			sock = pxy_connect(pxy_exp, &pxy_exp->info.srv_addr,
+					   pxy_exp->info.srv_port);
 			/* early stop test */
 			if (pxy_exp->rpc.close_thread) {
-				PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+				if (sock >= 0)
+					close(sock);
 				goto out;
 			}
-			if (pxy_exp->rpc.rpc_sock < 0) {
-				if (nsleeps == 0)
+			if (sock < 0) {
+				if (nsleeps == 0) {
 					sprint_sockaddr(&pxy_exp->info.srv_addr,
 							addr, sizeof(addr));
 					LogCrit(COMPONENT_FSAL,
 						"Cannot connect to server %s:%u",
 						addr, pxy_exp->info.srv_port);
-				PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+				}
 				sleep(pxy_exp->info.retry_sleeptime);
 				nsleeps++;
-				PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
 			} else {
 				LogDebug(COMPONENT_FSAL,
-					 "Connected after %d sleeps, resending outstanding calls",
-					 nsleeps);
+					 "Connection %"PRIu32
+					 " up after %d sleeps",
+					 conn->index, nsleeps);
 			}
-		} while (pxy_exp->rpc.rpc_sock < 0 &&
-						!pxy_exp->rpc.close_thread);
-		PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+		} while (sock < 0 && !pxy_exp->rpc.close_thread);
 		/* early stop test */
 		if (pxy_exp->rpc.close_thread)
 			goto out;
 
-		pfd.fd = pxy_exp->rpc.rpc_sock;
+		pxy_new_socket_ready(conn, sock);
+
+		pfd.fd = sock;
 		pfd.events = POLLIN | POLLRDHUP;
 
-		while (pxy_exp->rpc.rpc_sock >= 0) {
+		while (conn->sock >= 0) {
 			switch (poll(&pfd, 1, millisec)) {
 			case 0:
+				/* Connected while the threads were stopped */
+				if (pxy_exp->rpc.close_thread)
+					break;
 				LogDebug(COMPONENT_FSAL,
 					 "Timeout, wait again...");
 				continue;
@@ -597,16 +633,13 @@ static void *pxy_rpc_recv(void *arg)
 					LogEvent(COMPONENT_FSAL,
 						 "Socket is closed");
 				} else {
-					if (pxy_rpc_read_reply(pxy_exp) >= 0)
+					if (pxy_rpc_read_reply(conn) >= 0)
 						continue;
 				}
 				break;
 			}
 
-			PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
-			close(pxy_exp->rpc.rpc_sock);
-			pxy_exp->rpc.rpc_sock = -1;
-			PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+			pxy_rpc_conn_lost(conn);
 		}
 	}
 out:
@@ -702,28 +735,64 @@ static enum clnt_stat pxy_process_reply(struct pxy_rpc_io_context *ctx,
 static inline int pxy_rpc_need_sock(struct pxy_export *pxy_exp)
 {
 	PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
-	while (pxy_exp->rpc.rpc_sock < 0 && !pxy_exp->rpc.close_thread)
+	while (pxy_exp->rpc.nb_connected == 0 && !pxy_exp->rpc.close_thread)
 		pthread_cond_wait(&pxy_exp->rpc.sockless,
 				  &pxy_exp->rpc.listlock);
 	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
 	return pxy_exp->rpc.close_thread;
 }
 
+/**
+ * @brief Wait for the session to need renewing
+ *
+ * @return true when the lease is about to expire, false when the server
+ *	   was reconnected to after all connections were lost.
+ */
 static inline int pxy_rpc_renewer_wait(int timeout, struct pxy_export *pxy_exp)
 {
 	struct timespec ts;
-	int rc;
+	int rc = 0;
 
 	PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
 	ts.tv_sec = time(NULL) + timeout;
 	ts.tv_nsec = 0;
 
-	rc = pthread_cond_timedwait(&pxy_exp->rpc.sockless,
-				    &pxy_exp->rpc.listlock, &ts);
+	while (!pxy_exp->rpc.reconnected && !pxy_exp->rpc.close_thread &&
+	       rc != ETIMEDOUT)
+		rc = pthread_cond_timedwait(&pxy_exp->rpc.sockless,
+					    &pxy_exp->rpc.listlock, &ts);
 	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
 	return (rc == ETIMEDOUT);
 }
 
+/**
+ * @brief Choose the connection for a call
+ *
+ * The connected socket with the fewest replies outstanding is used, ties
+ * go round with the xid.  This is only a hint, the caller checks the
+ * socket under the connection lock.
+ *
+ * @return The connection, or NULL if none is connected.
+ */
+static struct pxy_rpc_conn *pxy_rpc_pick_conn(struct pxy_export *pxy_exp,
+					      uint32_t xid)
+{
+	struct pxy_rpc_conn *conn, *best = NULL;
+	uint32_t i, n = pxy_exp->rpc.nb_conns;
+
+	for (i = 0; i < n; i++) {
+		conn = &pxy_exp->rpc.conns[(xid + i) % n];
+		if (conn->sock < 0)
+			continue;
+		if (best == NULL ||
+		    atomic_fetch_uint32_t(&conn->pending) <
+		    atomic_fetch_uint32_t(&best->pending))
+			best = conn;
+	}
+
+	return best;
+}
+
 static int pxy_compoundv4_call(struct pxy_rpc_io_context *pcontext,
 			       const struct user_cred *cred,
 			       COMPOUND4args *args, COMPOUND4res *res,
@@ -734,9 +803,7 @@ static int pxy_compoundv4_call(struct pxy_rpc_io_context *pcontext,
 	AUTH *au;
 	enum clnt_stat rc;
 
-	PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
-	rmsg.rm_xid = pxy_exp->rpc.rpc_xid++;
-	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+	rmsg.rm_xid = atomic_inc_uint32_t(&pxy_exp->rpc.rpc_xid);
 	rmsg.rm_direction = CALL;
 
 	rmsg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
@@ -770,6 +837,7 @@ static int pxy_compoundv4_call(struct pxy_rpc_io_context *pcontext,
 		u_int pos = xdr_getpos(&x);
 		u_int recmark = ntohl(pos | (1U << 31));
 		int first_try = 1;
+		struct pxy_rpc_conn *conn = NULL;
 
 		pcontext->rpc_xid = rmsg.rm_xid;
 
@@ -780,16 +848,41 @@ static int pxy_compoundv4_call(struct pxy_rpc_io_context *pcontext,
 			int bc = 0;
 			char *buf = pcontext->sendbuf;
 
-			LogDebug(COMPONENT_FSAL, "%ssend XID %u with %d bytes",
+			if (conn != NULL) {
+				/* Timed out, unless the reply is coming in
+				 * resend, maybe on another connection.
+				 */
+				PTHREAD_MUTEX_lock(&conn->lock);
+				if (glist_null(&pcontext->calls)) {
+					PTHREAD_MUTEX_unlock(&conn->lock);
+					rc = pxy_process_reply(pcontext, res);
+					continue;
+				}
+				glist_del(&pcontext->calls);
+				(void)atomic_dec_uint32_t(&conn->pending);
+				PTHREAD_MUTEX_unlock(&conn->lock);
+			}
+
+			conn = pxy_rpc_pick_conn(pxy_exp, rmsg.rm_xid);
+			if (conn == NULL) {
+				rc = RPC_CANTSEND;
+				break;
+			}
+
+			LogDebug(COMPONENT_FSAL,
+				 "%ssend XID %u with %d bytes on connection %"
+				 PRIu32,
 				 (first_try ? "First attempt to " : "Re"),
-				 rmsg.rm_xid, pos);
-			PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
-			while (bc < pos) {
-				int wc = write(pxy_exp->rpc.rpc_sock, buf,
-					       pos - bc);
+				 rmsg.rm_xid, pos, conn->index);
+			first_try = 0;
+
+			PTHREAD_MUTEX_lock(&conn->lock);
+			while (conn->sock >= 0 && bc < pos) {
+				int wc = write(conn->sock, buf, pos - bc);
 
 				if (wc <= 0) {
-					close(pxy_exp->rpc.rpc_sock);
+					/* The receiver thread cleans up */
+					shutdown(conn->sock, SHUT_RDWR);
 					break;
 				}
 				bc += wc;
@@ -797,16 +890,11 @@ static int pxy_compoundv4_call(struct pxy_rpc_io_context *pcontext,
 			}
 
 			if (bc == pos) {
-				if (first_try) {
-					glist_add_tail(&pxy_exp->rpc.rpc_calls,
-						       &pcontext->calls);
-					first_try = 0;
-				}
-			} else {
-				if (!first_try)
-					glist_del(&pcontext->calls);
+				glist_add_tail(&conn->calls, &pcontext->calls);
+				(void)atomic_inc_uint32_t(&conn->pending);
+				conn->sent++;
 			}
-			PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+			PTHREAD_MUTEX_unlock(&conn->lock);
 
 			if (bc == pos)
 				rc = pxy_process_reply(pcontext, res);
@@ -821,12 +909,69 @@ static int pxy_compoundv4_call(struct pxy_rpc_io_context *pcontext,
 	return rc;
 }
 
+/**
+ * @brief Take a free io context, with a slot of the session
+ *
+ * Must be called with context_lock held.
+ *
+ * @return The context, or NULL if all those of usable slots are busy.
+ */
+static struct pxy_rpc_io_context *pxy_rpc_get_context(
+						struct pxy_export *pxy_exp)
+{
+	struct pxy_rpc_io_context *ctx;
+	struct glist_head *c;
+
+	glist_for_each(c, &pxy_exp->rpc.free_contexts) {
+		ctx = container_of(c, struct pxy_rpc_io_context, calls);
+
+		/* The server may grant fewer slots than asked for */
+		if (ctx->slotid >= pxy_exp->rpc.nb_slots)
+			continue;
+
+		glist_del(c);
+
+		/* Slots of a new session start over */
+		if (ctx->session_gen != pxy_exp->rpc.session_gen) {
+			ctx->session_gen = pxy_exp->rpc.session_gen;
+			ctx->seqid = 0;
+		}
+
+		return ctx;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Start using a new session
+ *
+ * @param[in] slots	Slots granted by the server
+ */
+static void pxy_rpc_new_session(struct pxy_export *pxy_exp, uint32_t slots)
+{
+	if (slots == 0 || slots > pxy_exp->info.srv_slots)
+		slots = pxy_exp->info.srv_slots;
+
+	if (slots < pxy_exp->info.srv_slots)
+		LogInfo(COMPONENT_FSAL,
+			"Server granted %"PRIu32" session slots of %"PRIu32,
+			slots, pxy_exp->info.srv_slots);
+
+	PTHREAD_MUTEX_lock(&pxy_exp->rpc.context_lock);
+	pxy_exp->rpc.nb_slots = slots;
+	pxy_exp->rpc.session_gen++;
+	pthread_cond_broadcast(&pxy_exp->rpc.need_context);
+	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.context_lock);
+}
+
 int pxy_compoundv4_execute(const char *caller, const struct user_cred *creds,
 			   uint32_t cnt, nfs_argop4 *argoparray,
 			   nfs_resop4 *resoparray, struct pxy_export *pxy_exp)
 {
 	enum clnt_stat rc;
 	struct pxy_rpc_io_context *ctx;
+	uint32_t nb_slots;
 	COMPOUND4args arg = {
 		.minorversion = FSAL_PROXY_NFS_V4_MINOR,
 		.argarray.argarray_val = argoparray,
@@ -838,13 +983,10 @@ int pxy_compoundv4_execute(const char *caller, const struct user_cred *creds,
 	};
 
 	PTHREAD_MUTEX_lock(&pxy_exp->rpc.context_lock);
-	while (glist_empty(&pxy_exp->rpc.free_contexts))
+	while ((ctx = pxy_rpc_get_context(pxy_exp)) == NULL)
 		pthread_cond_wait(&pxy_exp->rpc.need_context,
 				  &pxy_exp->rpc.context_lock);
-	ctx =
-	    glist_first_entry(&pxy_exp->rpc.free_contexts,
-			      struct pxy_rpc_io_context, calls);
-	glist_del(&ctx->calls);
+	nb_slots = pxy_exp->rpc.nb_slots;
 	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.context_lock);
 
 	/* fill slotid and sequenceid */
@@ -854,6 +996,7 @@ int pxy_compoundv4_execute(const char *caller, const struct user_cred *creds,
 
 		/* set slotid */
 		opsequence->sa_slotid = ctx->slotid;
+		opsequence->sa_highest_slotid = nb_slots - 1;
 		/* increment and set sequence id */
 		opsequence->sa_sequenceid = ++ctx->seqid;
 	}
@@ -981,6 +1124,9 @@ static int pxy_setsessionid(sessionid4 new_sessionid, uint32_t *lease_time,
 	       res_ok->csr_sessionid,
 	       sizeof(sessionid4));
 
+	pxy_rpc_new_session(pxy_exp,
+			    res_ok->csr_fore_chan_attrs.ca_maxrequests);
+
 	/* Get the lease time */
 	opcnt = 0;
 	COMPOUNDV4_ARG_ADD_OP_SEQUENCE(opcnt, arg, new_sessionid, NB_RPC_SLOT);
@@ -1023,13 +1169,21 @@ static int pxy_setclientid(clientid4 *new_clientid, sequenceid4 *new_seqid,
 	struct sockaddr_in sin;
 	socklen_t slen = sizeof(sin);
 	char addrbuf[sizeof("255.255.255.255")];
+	struct pxy_rpc_conn *conn;
 
 	LogEvent(COMPONENT_FSAL,
 		 "Negotiating a new ClientId with the remote server");
 
 	/* prepare input */
-	if (getsockname(pxy_exp->rpc.rpc_sock, &sin, &slen))
-		return -errno;
+	conn = pxy_rpc_pick_conn(pxy_exp, 0);
+	if (conn == NULL)
+		return -ENOTCONN;
+
+	PTHREAD_MUTEX_lock(&conn->lock);
+	rc = getsockname(conn->sock, &sin, &slen) ? -errno : 0;
+	PTHREAD_MUTEX_unlock(&conn->lock);
+	if (rc)
+		return rc;
 
 	snprintf(clientid_name, MAXNAMLEN, "%s(%d) - GANESHA NFSv4 Proxy",
 		 inet_ntop(AF_INET, &sin.sin_addr, addrbuf, sizeof(addrbuf)),
@@ -1145,6 +1299,11 @@ static void *pxy_clientid_renewer(void *arg)
 			/* early stop test */
 			break;
 
+		/* What we negotiate now covers the reconnection */
+		PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
+		pxy_exp->rpc.reconnected = false;
+		PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+
 		/* We need a new session_id */
 		if (!clientid_needed) {
 			sessionid4 new_sessionid;
@@ -1200,8 +1359,32 @@ static void free_io_contexts(struct pxy_export *pxy_exp)
 	}
 }
 
-int pxy_close_thread(struct pxy_export *pxy_exp)
+static void pxy_free_conns(struct pxy_export *pxy_exp)
+{
+	uint32_t i;
+
+	for (i = 0; i < pxy_exp->rpc.nb_conns; i++)
+		PTHREAD_MUTEX_destroy(&pxy_exp->rpc.conns[i].lock);
+
+	gsh_free(pxy_exp->rpc.conns);
+	pxy_exp->rpc.conns = NULL;
+	pxy_exp->rpc.nb_conns = 0;
+}
+
+/**
+ * @brief Stop the threads of an export and wait for them
+ *
+ * @param[in] pxy_exp	Export
+ * @param[in] nb_recv	Number of receiver threads started
+ * @param[in] renewer	Whether the renewer thread was started
+ *
+ * @return 0 or the error of pthread_join.
+ */
+static int pxy_stop_threads(struct pxy_export *pxy_exp, uint32_t nb_recv,
+			    bool renewer)
 {
+	struct pxy_rpc_conn *conn;
+	uint32_t i;
 	int rc;
 
 	/* setting boolean to stop thread */
@@ -1209,39 +1392,73 @@ int pxy_close_thread(struct pxy_export *pxy_exp)
 
 	/* waiting threads ends */
 	/* pxy_clientid_renewer is usually waiting on sockless cond : wake up */
-	/* pxy_rpc_recv is usually polling rpc_sock : wake up by closing it */
 	PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
 	pthread_cond_broadcast(&pxy_exp->rpc.sockless);
-	close(pxy_exp->rpc.rpc_sock);
 	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
-	rc = pthread_join(pxy_exp->rpc.pxy_renewer_thread, NULL);
-	if (rc) {
-		LogWarn(COMPONENT_FSAL,
-			"Error on waiting the pxy_renewer_thread end : %d", rc);
-		return rc;
+
+	/* pxy_rpc_recv is usually polling its socket : wake up by shutting
+	 * it down
+	 */
+	for (i = 0; i < nb_recv; i++) {
+		conn = &pxy_exp->rpc.conns[i];
+		PTHREAD_MUTEX_lock(&conn->lock);
+		if (conn->sock >= 0)
+			shutdown(conn->sock, SHUT_RDWR);
+		PTHREAD_MUTEX_unlock(&conn->lock);
 	}
 
-	rc = pthread_join(pxy_exp->rpc.pxy_recv_thread, NULL);
-	if (rc) {
-		LogWarn(COMPONENT_FSAL,
-			"Error on waiting the pxy_recv_thread end : %d", rc);
-		return rc;
+	if (renewer) {
+		rc = pthread_join(pxy_exp->rpc.pxy_renewer_thread, NULL);
+		if (rc) {
+			LogWarn(COMPONENT_FSAL,
+				"Error on waiting the pxy_renewer_thread end : %d",
+				rc);
+			return rc;
+		}
+	}
+
+	for (i = 0; i < nb_recv; i++) {
+		conn = &pxy_exp->rpc.conns[i];
+		rc = pthread_join(conn->recv_thread, NULL);
+		if (rc) {
+			LogWarn(COMPONENT_FSAL,
+				"Error on waiting the pxy_recv_thread end : %d",
+				rc);
+			return rc;
+		}
+
+		if (conn->sock >= 0)
+			close(conn->sock);
+
+		LogEvent(COMPONENT_FSAL,
+			 "PROXY connection %"PRIu32" sent %"PRIu64" calls",
+			 i, conn->sent);
 	}
 
 	return 0;
 }
 
+int pxy_close_thread(struct pxy_export *pxy_exp)
+{
+	int rc = pxy_stop_threads(pxy_exp, pxy_exp->rpc.nb_conns, true);
+
+	if (rc == 0) {
+		pxy_free_conns(pxy_exp);
+		free_io_contexts(pxy_exp);
+	}
+
+	return rc;
+}
+
 int pxy_init_rpc(struct pxy_export *pxy_exp)
 {
 	int rc;
-	int i = NB_RPC_SLOT-1;
-
-	PTHREAD_MUTEX_lock(&pxy_exp->rpc.listlock);
-	glist_init(&pxy_exp->rpc.rpc_calls);
-	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.listlock);
+	int i;
+	uint32_t n;
 
 	PTHREAD_MUTEX_lock(&pxy_exp->rpc.context_lock);
 	glist_init(&pxy_exp->rpc.free_contexts);
+	pxy_exp->rpc.nb_slots = pxy_exp->info.srv_slots;
 	PTHREAD_MUTEX_unlock(&pxy_exp->rpc.context_lock);
 
 /**
@@ -1259,7 +1476,7 @@ int pxy_init_rpc(struct pxy_export *pxy_exp)
 		strlcpy(pxy_exp->rpc.pxy_hostname, "NFS-GANESHA/Proxy",
 			sizeof(pxy_exp->rpc.pxy_hostname));
 
-	for (i = NB_RPC_SLOT-1; i >= 0; i--) {
+	for (i = pxy_exp->info.srv_slots - 1; i >= 0; i--) {
 		struct pxy_rpc_io_context *c =
 		    gsh_malloc(sizeof(*c) + pxy_exp->info.srv_sendsize +
 			       pxy_exp->info.srv_recvsize);
@@ -1272,6 +1489,7 @@ int pxy_init_rpc(struct pxy_export *pxy_exp)
 		c->recvbuf = c->sendbuf + c->sendbuf_sz;
 		c->slotid = i;
 		c->seqid = 0;
+		c->session_gen = 0;
 		c->iodone = false;
 
 		PTHREAD_MUTEX_lock(&pxy_exp->rpc.context_lock);
@@ -1279,14 +1497,29 @@ int pxy_init_rpc(struct pxy_export *pxy_exp)
 		PTHREAD_MUTEX_unlock(&pxy_exp->rpc.context_lock);
 	}
 
-	rc = pthread_create(&pxy_exp->rpc.pxy_recv_thread, NULL, pxy_rpc_recv,
-			    (void *)pxy_exp);
-	if (rc) {
-		LogCrit(COMPONENT_FSAL,
-			"Cannot create proxy rpc receiver thread - %s",
-			strerror(rc));
-		free_io_contexts(pxy_exp);
-		return rc;
+	pxy_exp->rpc.nb_conns = pxy_exp->info.srv_connections;
+	pxy_exp->rpc.conns = gsh_calloc(pxy_exp->rpc.nb_conns,
+					sizeof(struct pxy_rpc_conn));
+
+	for (n = 0; n < pxy_exp->rpc.nb_conns; n++) {
+		struct pxy_rpc_conn *conn = &pxy_exp->rpc.conns[n];
+
+		conn->pxy_exp = pxy_exp;
+		conn->index = n;
+		conn->sock = -1;
+		glist_init(&conn->calls);
+		PTHREAD_MUTEX_init(&conn->lock, NULL);
+	}
+
+	for (n = 0; n < pxy_exp->rpc.nb_conns; n++) {
+		rc = pthread_create(&pxy_exp->rpc.conns[n].recv_thread, NULL,
+				    pxy_rpc_recv, &pxy_exp->rpc.conns[n]);
+		if (rc) {
+			LogCrit(COMPONENT_FSAL,
+				"Cannot create proxy rpc receiver thread - %s",
+				strerror(rc));
+			goto err;
+		}
 	}
 
 	rc = pthread_create(&pxy_exp->rpc.pxy_renewer_thread, NULL,
@@ -1295,8 +1528,15 @@ int pxy_init_rpc(struct pxy_export *pxy_exp)
 		LogCrit(COMPONENT_FSAL,
 			"Cannot create proxy clientid renewer thread - %s",
 			strerror(rc));
-		free_io_contexts(pxy_exp);
+		goto err;
 	}
+
+	return 0;
+
+err:
+	(void)pxy_stop_threads(pxy_exp, n, false);
+	pxy_free_conns(pxy_exp);
+	free_io_contexts(pxy_exp);
 	return rc;
 }
 
@@ -36,6 +36,10 @@
 #define SEND_RECV_HEADER_SPACE 512
 /*1MB of default maxsize*/
 #define DEFAULT_MAX_WRITE_READ 1048576
+/* Default number of session slots, i.e. of calls in flight */
+#define NB_RPC_SLOT 16
+/* Most connections a server binds to one session */
+#define PXY_MAX_CONNECTIONS 16
 
 #include <pthread.h>
 #include <dirent.h>
@@ -56,6 +60,8 @@ struct pxy_client_params {
 	uint64_t srv_recvsize;
 	uint32_t srv_timeout;
 	uint16_t srv_port;
+	uint32_t srv_connections;
+	uint32_t srv_slots;
 	bool use_privileged_client_port;
 	char *remote_principal;
 	char *keytab;
@@ -71,6 +77,27 @@ struct pxy_client_params {
 #endif
 };
 
+struct pxy_export;
+
+/**
+ * A connection to the server.  All of them carry the one session, calls go
+ * to the connection with the fewest replies outstanding.
+ *
+ * lock protects sock and the calls list, and serializes the sends.  Only
+ * the receiver thread of the connection changes sock.
+ */
+struct pxy_rpc_conn {
+	struct pxy_export *pxy_exp;
+	uint32_t index;
+	int sock;
+	struct glist_head calls;
+	pthread_mutex_t lock;
+	pthread_t recv_thread;
+	/* Calls waiting for a reply, used to choose a connection */
+	uint32_t pending;
+	uint64_t sent;
+};
+
 struct pxy_export_rpc {
 /**
  * pxy_clientid_mutex protects pxy_clientid, pxy_client_seqid,
@@ -84,26 +111,33 @@ struct pxy_export_rpc {
 	pthread_mutex_t pxy_clientid_mutex;
 
 	char pxy_hostname[MAXNAMLEN + 1];
-	pthread_t pxy_recv_thread;
 	pthread_t pxy_renewer_thread;
 
+	struct pxy_rpc_conn *conns;
+	uint32_t nb_conns;
+	uint32_t rpc_xid;
+
 	/**
-	 * listlock protects rpc_sock and rpc_xid values, sockless condition and
-	 * rpc_calls list.
+	 * listlock protects nb_connected, reconnected and the sockless
+	 * condition, signaled when a connection is established.
+	 * reconnected is set when one is after all were lost.
 	 */
-	struct glist_head rpc_calls;
-	int rpc_sock;
-	uint32_t rpc_xid;
+	uint32_t nb_connected;
+	bool reconnected;
 	pthread_mutex_t listlock;
 	pthread_cond_t sockless;
 	bool close_thread;
 
 	/*
-	 * context_lock protects free_contexts list and need_context condition.
+	 * context_lock protects free_contexts list, need_context condition,
+	 * nb_slots and session_gen.  nb_slots is the number of slots the
+	 * server granted to the session, at most srv_slots contexts.
 	 */
 	struct glist_head free_contexts;
 	pthread_cond_t need_context;
 	pthread_mutex_t context_lock;
+	uint32_t nb_slots;
+	uint32_t session_gen;
 };
 
 struct pxy_export {
@@ -117,7 +151,6 @@ static inline void pxy_export_init(struct pxy_export *pxy_exp)
 	pxy_exp->rpc.no_sessionid = true;
 	pthread_mutex_init(&pxy_exp->rpc.pxy_clientid_mutex, NULL);
 	pthread_cond_init(&pxy_exp->rpc.cond_sessionid, NULL);
-	pxy_exp->rpc.rpc_sock = -1;
 	pthread_mutex_init(&pxy_exp->rpc.listlock, NULL);
 	pthread_cond_init(&pxy_exp->rpc.sockless, NULL);
 	pthread_cond_init(&pxy_exp->rpc.need_context, NULL);
@@ -0,0 +1,558 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* async_io.c
+ * VFS asynchronous read and write engine
+ *
+ * With Async_IO set, read2 and write2 hand the I/O to an engine and
+ * return; the done callback is made from the engine's thread once the
+ * I/O completes, and the protocol layer resumes the request from there.
+ *
+ * The engine is io_uring when built with liburing and the kernel allows
+ * it, a reaper thread collects the completions.  Otherwise a pool of
+ * Async_IO_Threads threads issues the plain system calls.  Either way at
+ * most Async_IO_Depth requests are in flight, past that the I/O is done
+ * synchronously by the caller as before.  COMMIT keeps its synchronous
+ * interface, write_gather.c already shares one sync between COMMITs.
+ *
+ * The engine works on its own file descriptor, a dup of the one found
+ * for the request, so none of the locks protecting the object's or the
+ * state's descriptor are held while the I/O is in flight.
+ *
+ * Writes must be done with the client's credentials, for quotas and for
+ * the kernel to clear setuid and setgid bits.  io_uring takes the
+ * credentials of the submitting thread, so write2 starts the request
+ * before restoring Ganesha's; the thread pool sets a copy of them around
+ * each write.
+ *
+ * Should the reaper stop, the engine is disabled and I/O is done
+ * synchronously from then on.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#ifdef USE_IO_URING
+#include <liburing.h>
+#endif
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "fridgethr.h"
+#include "nfs_core.h"
+#include "vfs_methods.h"
+
+struct vfs_aio_req {
+	struct fsal_obj_handle *obj_hdl;
+	struct vfs_write_gather *wg;	/*< Set for unstable writes */
+	fsal_async_cb done_cb;
+	struct fsal_io_arg *io_arg;
+	void *caller_arg;
+	struct gsh_export *ctx_export;
+	struct fsal_export *fsal_export;
+	int fd;				/*< Owned by the request */
+	bool write;
+	bool stable;			/*< Write followed by fsync */
+	uint32_t slots;			/*< Depth used by the request */
+	uint32_t pending;		/*< Completions still expected */
+	ssize_t io_res;			/*< Bytes done, or -errno */
+	int sync_res;			/*< 0, or -errno of the fsync */
+	struct fsal_module *fsal;
+	struct user_cred creds;		/*< The writer's, groups follow */
+	gid_t groups[];
+};
+
+static struct {
+	bool enabled;
+	uint32_t depth;
+	uint32_t inflight;
+	struct fridgethr *fridge;
+#ifdef USE_IO_URING
+	bool uring;
+	struct io_uring ring;
+	pthread_mutex_t sq_mutex;	/*< Serializes submissions */
+	pthread_t reaper;
+	bool reaping;			/*< Reaper running, under sq_mutex */
+#endif
+} vfs_aio;
+
+/**
+ * @brief Reserve room for a request
+ *
+ * @param[in] slots	Depth needed
+ *
+ * @return true if the request may be issued.
+ */
+static bool vfs_aio_reserve(uint32_t slots)
+{
+	if (atomic_add_uint32_t(&vfs_aio.inflight, slots) > vfs_aio.depth) {
+		(void)atomic_sub_uint32_t(&vfs_aio.inflight, slots);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Deliver the result of a request and free it
+ *
+ * @param[in] req	The completed request
+ */
+static void vfs_aio_complete(struct vfs_aio_req *req)
+{
+	struct fsal_io_arg *io_arg = req->io_arg;
+	struct root_op_context root_op_context;
+	fsal_status_t status = {0, 0};
+
+	if (req->io_res < 0) {
+		status = fsalstat(posix2fsal_error(-req->io_res),
+				  -req->io_res);
+		if (req->write)
+			io_arg->fsal_stable = false;
+	} else {
+		io_arg->io_amount = req->io_res;
+
+		if (!req->write)
+			io_arg->end_of_file = (req->io_res == 0);
+		else if (req->wg != NULL)
+			vfs_wg_mark_dirty(req->wg, io_arg->offset,
+					  req->io_res);
+
+		if (req->sync_res == -ECANCELED) {
+			/* A short write breaks the link to the fsync,
+			 * rare enough to sync from here.
+			 */
+			req->sync_res = fsync(req->fd) == 0 ? 0 : -errno;
+		}
+
+		if (req->sync_res < 0) {
+			status = fsalstat(posix2fsal_error(-req->sync_res),
+					  -req->sync_res);
+			io_arg->fsal_stable = false;
+		}
+	}
+
+	close(req->fd);
+	(void)atomic_sub_uint32_t(&vfs_aio.inflight, req->slots);
+
+	/* Need an op context for the call back */
+	init_root_op_context(&root_op_context, req->ctx_export,
+			     req->fsal_export, 0, 0, UNKNOWN_REQUEST);
+
+	req->done_cb(req->obj_hdl, status, io_arg, req->caller_arg);
+
+	release_root_op_context();
+
+	gsh_free(req);
+}
+
+/**
+ * @brief Do the I/O of a request with plain system calls
+ *
+ * The caller completes the request.
+ *
+ * @param[in] req	The request
+ */
+static void vfs_aio_do_io(struct vfs_aio_req *req)
+{
+	struct fsal_io_arg *io_arg = req->io_arg;
+
+	if (req->write)
+		req->io_res = pwritev(req->fd, io_arg->iov, io_arg->iov_count,
+				      io_arg->offset);
+	else
+		req->io_res = preadv(req->fd, io_arg->iov, io_arg->iov_count,
+				     io_arg->offset);
+
+	if (req->io_res < 0)
+		req->io_res = -errno;
+	else if (req->stable && fsync(req->fd) < 0)
+		req->sync_res = -errno;
+}
+
+/**
+ * @brief Issue a request from the thread pool
+ *
+ * @param[in] ctx	Fridge context, the request is the argument
+ */
+static void vfs_aio_thread_io(struct fridgethr_context *ctx)
+{
+	struct vfs_aio_req *req = ctx->arg;
+
+	if (!req->write) {
+		vfs_aio_do_io(req);
+	} else if (vfs_set_credentials(&req->creds, req->fsal)) {
+		vfs_aio_do_io(req);
+		vfs_restore_ganesha_credentials(req->fsal);
+	} else {
+		req->io_res = -EPERM;
+	}
+
+	vfs_aio_complete(req);
+}
+
+#ifdef USE_IO_URING
+/**
+ * @brief Collect io_uring completions
+ *
+ * A completion without a request asks the reaper to exit.
+ *
+ * @param[in] arg	Unused
+ *
+ * @return NULL
+ */
+static void *vfs_aio_reaper(void *arg)
+{
+	struct io_uring_cqe *cqe;
+	struct vfs_aio_req *req;
+	int rc;
+
+	SetNameFunction("vfs_aio_reap");
+
+	for (;;) {
+		rc = io_uring_wait_cqe(&vfs_aio.ring, &cqe);
+		if (rc == -EINTR)
+			continue;
+		if (rc < 0) {
+			LogCrit(COMPONENT_FSAL,
+				"io_uring_wait_cqe failed: %s, async I/O disabled",
+				strerror(-rc));
+			break;
+		}
+
+		req = io_uring_cqe_get_data(cqe);
+		rc = cqe->res;
+		io_uring_cqe_seen(&vfs_aio.ring, cqe);
+
+		if (req == NULL)
+			break;
+
+		/* A stable write completes its write, then its fsync */
+		if (req->pending-- == 2 || !req->stable)
+			req->io_res = rc;
+		else
+			req->sync_res = rc < 0 ? rc : 0;
+
+		if (req->pending == 0)
+			vfs_aio_complete(req);
+	}
+
+	/* Nobody collects completions anymore, no more submissions */
+	PTHREAD_MUTEX_lock(&vfs_aio.sq_mutex);
+	vfs_aio.reaping = false;
+	vfs_aio.enabled = false;
+	PTHREAD_MUTEX_unlock(&vfs_aio.sq_mutex);
+
+	return NULL;
+}
+
+/**
+ * @brief Issue a request on the ring
+ *
+ * The request runs with the credentials of the calling thread.
+ *
+ * @param[in] req	The request
+ *
+ * @return true if submitted.
+ */
+static bool vfs_aio_uring_submit(struct vfs_aio_req *req)
+{
+	struct fsal_io_arg *io_arg = req->io_arg;
+	struct io_uring_sqe *sqe;
+	int rc;
+
+	PTHREAD_MUTEX_lock(&vfs_aio.sq_mutex);
+
+	if (!vfs_aio.reaping) {
+		PTHREAD_MUTEX_unlock(&vfs_aio.sq_mutex);
+		return false;
+	}
+
+	/* The depth reservation guarantees room in the ring */
+	sqe = io_uring_get_sqe(&vfs_aio.ring);
+	if (req->write)
+		io_uring_prep_writev(sqe, req->fd, io_arg->iov,
+				     io_arg->iov_count, io_arg->offset);
+	else
+		io_uring_prep_readv(sqe, req->fd, io_arg->iov,
+				    io_arg->iov_count, io_arg->offset);
+	io_uring_sqe_set_data(sqe, req);
+
+	if (req->stable) {
+		sqe->flags |= IOSQE_IO_LINK;
+		sqe = io_uring_get_sqe(&vfs_aio.ring);
+		io_uring_prep_fsync(sqe, req->fd, 0);
+		io_uring_sqe_set_data(sqe, req);
+	}
+
+	req->pending = req->slots;
+
+	/* The entries stay in the ring until a submit takes them, so
+	 * transient failures must be retried rather than given up on.
+	 */
+	do {
+		rc = io_uring_submit(&vfs_aio.ring);
+	} while (rc == -EINTR || rc == -EAGAIN || rc == -EBUSY);
+
+	PTHREAD_MUTEX_unlock(&vfs_aio.sq_mutex);
+
+	if (rc < 0) {
+		LogCrit(COMPONENT_FSAL, "io_uring_submit failed: %s",
+			strerror(-rc));
+		return false;
+	}
+
+	return true;
+}
+#endif
+
+/**
+ * @brief Set up a read or write for the engine
+ *
+ * The request gets its own descriptor for the file; if @a closefd is set
+ * the caller's temporary descriptor is taken over instead of duplicated.
+ * The caller then drops its locks and calls vfs_aio_start(), and must not
+ * touch the object afterwards, the request may complete at once.  A write
+ * keeps a copy of op_ctx->creds, and must be started while they are
+ * still set.
+ *
+ * @param[in]     obj_hdl	File being read or written
+ * @param[in]     fd		Descriptor found for the request
+ * @param[in,out] closefd	Whether @a fd is the caller's to close
+ * @param[in]     write		Write rather than read
+ * @param[in]     wg		Write gathering state for unstable writes
+ * @param[in]     done_cb	Callback to call when I/O is done
+ * @param[in]     io_arg	Info about the I/O
+ * @param[in]     caller_arg	Opaque arg from the caller for callback
+ *
+ * @return The request, or NULL if the caller should do the I/O itself.
+ */
+struct vfs_aio_req *vfs_aio_prepare(struct fsal_obj_handle *obj_hdl, int fd,
+				    bool *closefd, bool write,
+				    struct vfs_write_gather *wg,
+				    fsal_async_cb done_cb,
+				    struct fsal_io_arg *io_arg,
+				    void *caller_arg)
+{
+	struct vfs_aio_req *req;
+	bool stable = write && io_arg->fsal_stable;
+	uint32_t slots = stable ? 2 : 1;
+	unsigned int glen = write ? op_ctx->creds->caller_glen : 0;
+	int aio_fd;
+
+	if (!vfs_aio.enabled || !vfs_aio_reserve(slots))
+		return NULL;
+
+	aio_fd = *closefd ? fd : dup(fd);
+	if (aio_fd < 0) {
+		(void)atomic_sub_uint32_t(&vfs_aio.inflight, slots);
+		return NULL;
+	}
+	*closefd = false;
+
+	req = gsh_calloc(1, sizeof(*req) + glen * sizeof(gid_t));
+	req->obj_hdl = obj_hdl;
+	req->fsal = obj_hdl->fsal;
+	req->wg = stable ? NULL : wg;
+	req->done_cb = done_cb;
+	req->io_arg = io_arg;
+	req->caller_arg = caller_arg;
+	req->ctx_export = op_ctx->ctx_export;
+	req->fsal_export = op_ctx->fsal_export;
+	req->fd = aio_fd;
+	req->write = write;
+	req->stable = stable;
+	req->slots = slots;
+
+	if (write) {
+		req->creds = *op_ctx->creds;
+		req->creds.caller_garray = req->groups;
+		if (glen != 0)
+			memcpy(req->groups, op_ctx->creds->caller_garray,
+			       glen * sizeof(gid_t));
+	}
+
+	return req;
+}
+
+/**
+ * @brief Issue a request set up by vfs_aio_prepare()
+ *
+ * If the engine refuses it, the I/O is done right here; either way the
+ * done callback is made exactly once.  A write must be started with the
+ * writer's credentials set, Ganesha's are restored before returning.
+ *
+ * @param[in] req	The request
+ */
+void vfs_aio_start(struct vfs_aio_req *req)
+{
+	struct fsal_module *fsal = req->fsal;
+	bool write = req->write;
+	bool started;
+
+#ifdef USE_IO_URING
+	if (vfs_aio.uring)
+		started = vfs_aio_uring_submit(req);
+	else
+#endif
+		started = fridgethr_submit(vfs_aio.fridge, vfs_aio_thread_io,
+					   req) == 0;
+
+	if (!started)
+		vfs_aio_do_io(req);
+
+	/* Once started the request may already be gone */
+	if (write)
+		vfs_restore_ganesha_credentials(fsal);
+
+	if (!started)
+		vfs_aio_complete(req);
+}
+
+/**
+ * @brief Start the engine
+ *
+ * Called once the module's configuration has been read.
+ *
+ * @param[in] vfs_module	The VFS module and its configuration
+ */
+void vfs_aio_init(struct vfs_fsal_module *vfs_module)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	if (!vfs_module->async_io || vfs_aio.enabled)
+		return;
+
+	vfs_aio.depth = vfs_module->async_io_depth;
+
+#ifdef USE_IO_URING
+	rc = io_uring_queue_init(vfs_aio.depth, &vfs_aio.ring, 0);
+	if (rc == 0) {
+		PTHREAD_MUTEX_init(&vfs_aio.sq_mutex, NULL);
+		vfs_aio.reaping = true;
+		rc = pthread_create(&vfs_aio.reaper, NULL, vfs_aio_reaper,
+				    NULL);
+		if (rc == 0) {
+			vfs_aio.uring = true;
+			vfs_aio.enabled = true;
+			LogEvent(COMPONENT_FSAL,
+				 "FSAL_VFS async I/O using io_uring, depth %"
+				 PRIu32, vfs_aio.depth);
+			return;
+		}
+		vfs_aio.reaping = false;
+		PTHREAD_MUTEX_destroy(&vfs_aio.sq_mutex);
+		io_uring_queue_exit(&vfs_aio.ring);
+	} else {
+		rc = -rc;
+	}
+
+	LogInfo(COMPONENT_FSAL, "io_uring not available (%s)", strerror(rc));
+#endif
+
+	if (vfs_module->async_io_threads == 0) {
+		LogWarn(COMPONENT_FSAL,
+			"FSAL_VFS async I/O disabled, no Async_IO_Threads");
+		return;
+	}
+
+	memset(&frp, 0, sizeof(frp));
+	frp.thr_max = vfs_module->async_io_threads;
+	frp.thr_min = 1;
+	frp.thread_delay = 60;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_queue;
+
+	rc = fridgethr_init(&vfs_aio.fridge, "VFS_AIO", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_FSAL,
+			 "Unable to initialize VFS_AIO fridge, error code %d.",
+			 rc);
+		return;
+	}
+
+	vfs_aio.enabled = true;
+	LogEvent(COMPONENT_FSAL,
+		 "FSAL_VFS async I/O using %" PRIu32 " threads, depth %"
+		 PRIu32, vfs_module->async_io_threads, vfs_aio.depth);
+}
+
+/**
+ * @brief Stop the engine
+ *
+ * Requests still in flight are completed first.
+ */
+void vfs_aio_shutdown(void)
+{
+	int rc;
+
+#ifdef USE_IO_URING
+	/* A reaper that stopped has disabled the engine already */
+	if (vfs_aio.uring) {
+		struct io_uring_sqe *sqe = NULL;
+
+		vfs_aio.enabled = false;
+
+		/* Queued behind everything in flight, so it is reaped last */
+		PTHREAD_MUTEX_lock(&vfs_aio.sq_mutex);
+		if (vfs_aio.reaping) {
+			sqe = io_uring_get_sqe(&vfs_aio.ring);
+			if (sqe != NULL) {
+				io_uring_prep_nop(sqe);
+				sqe->flags |= IOSQE_IO_DRAIN;
+				io_uring_sqe_set_data(sqe, NULL);
+				io_uring_submit(&vfs_aio.ring);
+			} else {
+				pthread_cancel(vfs_aio.reaper);
+			}
+		}
+		PTHREAD_MUTEX_unlock(&vfs_aio.sq_mutex);
+
+		pthread_join(vfs_aio.reaper, NULL);
+
+		io_uring_queue_exit(&vfs_aio.ring);
+		PTHREAD_MUTEX_destroy(&vfs_aio.sq_mutex);
+		vfs_aio.uring = false;
+		return;
+	}
+#endif
+
+	if (!vfs_aio.enabled)
+		return;
+
+	vfs_aio.enabled = false;
+
+	rc = fridgethr_sync_command(vfs_aio.fridge, fridgethr_comm_stop, 120);
+
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_FSAL,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(vfs_aio.fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_FSAL,
+			 "Failed shutting down VFS_AIO threads: %d", rc);
+	}
+
+	fridgethr_destroy(vfs_aio.fridge);
+	vfs_aio.fridge = NULL;
+}
@@ -0,0 +1,515 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* direct_io.c
+ * VFS per-export I/O modes: O_DIRECT and streaming with DONTNEED
+ *
+ * With io_mode = direct, the export's data fds are opened a second time
+ * with O_DIRECT, and I/O goes through that private fd.  The object's
+ * global fd and the fds shared between open states are used by every
+ * export of the filesystem, so they stay buffered and other exports keep
+ * the page cache; a direct export has its own global fd and doesn't share
+ * its open state fds.  Whether an fd is direct is noted when it is opened.
+ *
+ * Requests whose offset, length and buffers are all block aligned go
+ * straight to the file.  Other reads are split: the part of a buffer that
+ * lines up with file blocks is still read directly, the unaligned head
+ * and tail go through an aligned bounce buffer.  Unaligned writes send
+ * their whole blocks through a bounce buffer to the direct fd, and their
+ * partial blocks to the buffered fd kept with it, so they never have to
+ * read-modify-write a block or pad the file, and can't clobber or trim
+ * what concurrent writers put there.
+ *
+ * With io_mode = dontneed, I/O stays buffered but the pages a request
+ * touched are dropped from the page cache once done.  Writes start
+ * writeback at once and drop a window trailing behind them, whose
+ * writeback has had time to finish.
+ *
+ * How many bytes took each path is counted per export and logged when the
+ * export is released.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "vfs_methods.h"
+
+/** Alignment for O_DIRECT, good for any logical block size up to it */
+#define VFS_DIO_ALIGN 4096
+
+/** Most bytes bounced by one system call */
+#define VFS_DIO_BOUNCE (1024 * 1024)
+
+/** How far behind a streaming write its pages are dropped */
+#define VFS_DONTNEED_LAG (8 * 1024 * 1024)
+
+#define VFS_DIO_OFF(x) ((uint64_t)(x) & (VFS_DIO_ALIGN - 1))
+
+struct config_item_list vfs_io_modes[] = {
+	CONFIG_LIST_TOK("buffered", VFS_IO_BUFFERED),
+	CONFIG_LIST_TOK("direct", VFS_IO_DIRECT),
+	CONFIG_LIST_TOK("dontneed", VFS_IO_DONTNEED),
+	CONFIG_LIST_EOL
+};
+
+/* Bytes moved by one request */
+struct vfs_dio_req {
+	char *bounce;
+	size_t bounce_size;
+	uint64_t direct;
+	uint64_t bounced;
+};
+
+static inline struct vfs_fsal_export *vfs_io_export(void)
+{
+	return container_of(op_ctx->fsal_export, struct vfs_fsal_export,
+			    export);
+}
+
+/**
+ * @brief Give a newly opened data fd the export's I/O mode
+ *
+ * On a direct export, the file is opened again with O_DIRECT and that fd
+ * is used for I/O, the buffered one is kept for partial blocks.  The
+ * object's global buffered fd is left alone.  A filesystem that refuses
+ * O_DIRECT is logged and the fd left buffered.
+ *
+ * @param[in]     myself	File the fd is for
+ * @param[in,out] my_fd		Opened fd
+ */
+void vfs_io_setup_fd(struct vfs_fsal_obj_handle *myself,
+		     struct vfs_fd *my_fd)
+{
+	struct vfs_fsal_export *exp = vfs_io_export();
+	fsal_errors_t fsal_error = ERR_FSAL_NO_ERROR;
+	int posix_flags = 0;
+	int fd;
+
+	my_fd->direct = false;
+
+	if (exp->io_mode != VFS_IO_DIRECT || my_fd == &myself->u.file.fd)
+		return;
+
+	fsal2posix_openflags(my_fd->openflags & FSAL_O_RDWR, &posix_flags);
+
+	fd = vfs_fsal_open(myself, posix_flags | O_DIRECT, &fsal_error);
+	if (fd < 0) {
+		LogInfo(COMPONENT_FSAL,
+			"Export %"PRIu16" can not use O_DIRECT on fd %d: %s",
+			exp->export.export_id, my_fd->fd, strerror(-fd));
+		return;
+	}
+
+	my_fd->buf_fd = my_fd->fd;
+	my_fd->fd = fd;
+	my_fd->direct = true;
+}
+
+/**
+ * @brief Get the I/O mode to use on a data fd
+ *
+ * Only fds opened by vfs_io_setup_fd() on a direct export are direct, a
+ * direct export falls back to buffered I/O on any other.
+ *
+ * @param[in] my_fd	fd found for the I/O, NULL for a temporary one
+ *
+ * @return The I/O mode.
+ */
+enum vfs_io_mode vfs_io_mode(const struct vfs_fd *my_fd)
+{
+	enum vfs_io_mode io_mode = vfs_io_export()->io_mode;
+
+	if (my_fd != NULL && my_fd->direct)
+		return VFS_IO_DIRECT;
+
+	return io_mode == VFS_IO_DIRECT ? VFS_IO_BUFFERED : io_mode;
+}
+
+/**
+ * @brief Check whether a request can be issued as is on an O_DIRECT fd
+ *
+ * @param[in] iov	Buffers
+ * @param[in] iovcnt	Number of buffers
+ * @param[in] offset	Offset in the file
+ *
+ * @return true if offset, lengths and buffers are all block aligned.
+ */
+bool vfs_dio_aligned(const struct iovec *iov, int iovcnt, uint64_t offset)
+{
+	int i;
+
+	if (VFS_DIO_OFF(offset) != 0)
+		return false;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (VFS_DIO_OFF(iov[i].iov_base) != 0 ||
+		    VFS_DIO_OFF(iov[i].iov_len) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+static void vfs_dio_account(struct vfs_dio_req *req)
+{
+	struct vfs_io_stats *stats = &vfs_io_export()->io_stats;
+
+	if (req->bounced != 0) {
+		(void)atomic_inc_uint64_t(&stats->bounced_ops);
+		(void)atomic_add_uint64_t(&stats->bounced_bytes,
+					  req->bounced);
+	} else if (req->direct != 0) {
+		(void)atomic_inc_uint64_t(&stats->direct_ops);
+	}
+
+	if (req->direct != 0)
+		(void)atomic_add_uint64_t(&stats->direct_bytes, req->direct);
+
+	gsh_free(req->bounce);
+}
+
+static char *vfs_dio_bounce(struct vfs_dio_req *req)
+{
+	if (req->bounce == NULL)
+		req->bounce = gsh_malloc_aligned(VFS_DIO_ALIGN,
+						 req->bounce_size);
+
+	return req->bounce;
+}
+
+/**
+ * @brief Read part of a block span through the bounce buffer
+ *
+ * @return Bytes copied to @a buf, short at end of file, or -1.
+ */
+static ssize_t vfs_dio_bounce_read(int fd, struct vfs_dio_req *req,
+				   char *buf, size_t len, uint64_t pos)
+{
+	uint64_t start = pos - VFS_DIO_OFF(pos);
+	size_t span = (pos + len - start + VFS_DIO_ALIGN - 1) &
+		      ~(size_t)(VFS_DIO_ALIGN - 1);
+	size_t skip = pos - start;
+	char *bounce = vfs_dio_bounce(req);
+	ssize_t rc;
+
+	rc = pread(fd, bounce, span, start);
+	if (rc < 0)
+		return -1;
+
+	if ((size_t)rc <= skip)
+		return 0;
+
+	if ((size_t)rc - skip < len)
+		len = rc - skip;
+
+	memcpy(buf, bounce + skip, len);
+	req->bounced += len;
+
+	return len;
+}
+
+/**
+ * @brief Read one buffer on an O_DIRECT fd
+ *
+ * When the buffer sits at the same offset within a block as the file
+ * range, only its unaligned head and tail are bounced.
+ */
+static ssize_t vfs_dio_read_buf(int fd, struct vfs_dio_req *req,
+				char *buf, size_t len, uint64_t offset)
+{
+	bool in_step = VFS_DIO_OFF(buf) == VFS_DIO_OFF(offset);
+	size_t done = 0, want;
+	uint64_t pos;
+	ssize_t rc;
+
+	while (done < len) {
+		pos = offset + done;
+		want = len - done;
+
+		if (in_step && VFS_DIO_OFF(pos) == 0 &&
+		    want >= VFS_DIO_ALIGN) {
+			want &= ~(size_t)(VFS_DIO_ALIGN - 1);
+			rc = pread(fd, buf + done, want, pos);
+			if (rc > 0)
+				req->direct += rc;
+		} else {
+			if (in_step) {
+				if (want > VFS_DIO_ALIGN - VFS_DIO_OFF(pos))
+					want = VFS_DIO_ALIGN -
+					       VFS_DIO_OFF(pos);
+			} else if (want > VFS_DIO_BOUNCE - VFS_DIO_OFF(pos)) {
+				want = VFS_DIO_BOUNCE - VFS_DIO_OFF(pos);
+			}
+			rc = vfs_dio_bounce_read(fd, req, buf + done, want,
+						 pos);
+		}
+
+		if (rc < 0)
+			return done != 0 ? (ssize_t)done : -1;
+
+		done += rc;
+
+		if ((size_t)rc < want)
+			break;
+	}
+
+	return done;
+}
+
+/**
+ * @brief Read from an O_DIRECT fd, whatever the alignment
+ *
+ * @param[in] fd	File descriptor in O_DIRECT
+ * @param[in] iov	Buffers
+ * @param[in] iovcnt	Number of buffers
+ * @param[in] offset	Offset in the file
+ *
+ * @return Bytes read, or -1 with errno set.
+ */
+ssize_t vfs_dio_read(int fd, const struct iovec *iov, int iovcnt,
+		     uint64_t offset)
+{
+	struct vfs_dio_req req = { NULL, 0, 0, 0 };
+	ssize_t rc, total = 0;
+	size_t len = 0;
+	int i;
+
+	if (vfs_dio_aligned(iov, iovcnt, offset)) {
+		total = preadv(fd, iov, iovcnt, offset);
+		if (total > 0)
+			req.direct = total;
+		goto out;
+	}
+
+	/* Enough for the largest span bounced at once */
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	req.bounce_size = len + 2 * VFS_DIO_ALIGN;
+	if (req.bounce_size > VFS_DIO_BOUNCE)
+		req.bounce_size = VFS_DIO_BOUNCE;
+
+	for (i = 0; i < iovcnt; i++) {
+		rc = vfs_dio_read_buf(fd, &req, iov[i].iov_base,
+				      iov[i].iov_len, offset + total);
+		if (rc < 0) {
+			if (total == 0)
+				total = -1;
+			break;
+		}
+
+		total += rc;
+
+		if ((size_t)rc < iov[i].iov_len)
+			break;
+	}
+
+ out:
+	vfs_dio_account(&req);
+	return total;
+}
+
+/* Copy len bytes of the buffers, from skip bytes into them, to dst */
+static void vfs_dio_gather(const struct iovec *iov, int iovcnt, size_t skip,
+			   char *dst, size_t len)
+{
+	size_t n;
+	int i;
+
+	for (i = 0; i < iovcnt && len != 0; i++) {
+		if (skip >= iov[i].iov_len) {
+			skip -= iov[i].iov_len;
+			continue;
+		}
+
+		n = iov[i].iov_len - skip;
+		if (n > len)
+			n = len;
+
+		memcpy(dst, (char *)iov[i].iov_base + skip, n);
+		dst += n;
+		len -= n;
+		skip = 0;
+	}
+}
+
+/**
+ * @brief Write to a direct fd, whatever the alignment
+ *
+ * An unaligned write goes out in pieces: whole blocks are copied to an
+ * aligned bounce buffer and written to the O_DIRECT fd, the partial
+ * blocks at either end are written to the buffered fd.  Only the bytes
+ * asked for are written, the file is never padded.
+ *
+ * @param[in] my_fd	Direct fd
+ * @param[in] iov	Buffers
+ * @param[in] iovcnt	Number of buffers
+ * @param[in] offset	Offset in the file
+ *
+ * @return Bytes written, or -1 with errno set.
+ */
+ssize_t vfs_dio_write(struct vfs_fd *my_fd, const struct iovec *iov,
+		      int iovcnt, uint64_t offset)
+{
+	struct vfs_dio_req req = { NULL, 0, 0, 0 };
+	size_t len = 0, done, want;
+	uint64_t pos;
+	ssize_t rc = 0;
+	bool partial;
+	int i;
+
+	if (vfs_dio_aligned(iov, iovcnt, offset)) {
+		rc = pwritev(my_fd->fd, iov, iovcnt, offset);
+		if (rc > 0)
+			req.direct = rc;
+		vfs_dio_account(&req);
+		return rc;
+	}
+
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	req.bounce_size = (len + VFS_DIO_ALIGN - 1) &
+			  ~(size_t)(VFS_DIO_ALIGN - 1);
+	if (req.bounce_size > VFS_DIO_BOUNCE)
+		req.bounce_size = VFS_DIO_BOUNCE;
+
+	for (done = 0; done < len; done += rc) {
+		pos = offset + done;
+		want = len - done;
+		partial = VFS_DIO_OFF(pos) != 0 || want < VFS_DIO_ALIGN;
+
+		if (partial) {
+			if (want > VFS_DIO_ALIGN - VFS_DIO_OFF(pos))
+				want = VFS_DIO_ALIGN - VFS_DIO_OFF(pos);
+		} else {
+			want &= ~(size_t)(VFS_DIO_ALIGN - 1);
+			if (want > VFS_DIO_BOUNCE)
+				want = VFS_DIO_BOUNCE;
+		}
+
+		vfs_dio_gather(iov, iovcnt, done, vfs_dio_bounce(&req), want);
+
+		rc = pwrite(partial ? my_fd->buf_fd : my_fd->fd, req.bounce,
+			    want, pos);
+		if (rc < 0)
+			break;
+
+		if (partial)
+			req.bounced += rc;
+		else
+			req.direct += rc;
+
+		if ((size_t)rc < want) {
+			done += rc;
+			break;
+		}
+	}
+
+	vfs_dio_account(&req);
+
+	if (rc < 0 && done == 0)
+		return -1;
+
+	return done;
+}
+
+/**
+ * @brief Drop the pages of a finished request from the page cache
+ *
+ * Only does anything on dontneed exports.
+ *
+ * @param[in] fd	File descriptor used for the I/O
+ * @param[in] offset	Offset of the request
+ * @param[in] len	Bytes read or written
+ * @param[in] write	Whether it was a write
+ */
+void vfs_io_dontneed(int fd, uint64_t offset, size_t len, bool write)
+{
+	struct vfs_fsal_export *exp = vfs_io_export();
+	uint64_t lag;
+
+	if (exp->io_mode != VFS_IO_DONTNEED || len == 0)
+		return;
+
+	if (write) {
+		/* Dirty pages can't be dropped, start writing these out and
+		 * drop those written a while ago instead.
+		 */
+		(void)sync_file_range(fd, offset, len, SYNC_FILE_RANGE_WRITE);
+
+		lag = offset < VFS_DONTNEED_LAG ? offset : VFS_DONTNEED_LAG;
+		offset -= lag;
+		len += lag;
+	}
+
+	(void)posix_fadvise(fd, offset, len, POSIX_FADV_DONTNEED);
+	(void)atomic_add_uint64_t(&exp->io_stats.dontneed_bytes, len);
+}
+
+/**
+ * @brief Count a direct request handed to the asynchronous engine
+ *
+ * @param[in] iov	Buffers
+ * @param[in] iovcnt	Number of buffers
+ */
+void vfs_dio_count_async(const struct iovec *iov, int iovcnt)
+{
+	struct vfs_io_stats *stats = &vfs_io_export()->io_stats;
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	(void)atomic_inc_uint64_t(&stats->direct_ops);
+	(void)atomic_add_uint64_t(&stats->direct_bytes, len);
+}
+
+/**
+ * @brief Log the I/O mode counters of an export
+ *
+ * @param[in] exp	Export being released
+ */
+void vfs_io_log_stats(struct vfs_fsal_export *exp)
+{
+	struct vfs_io_stats *stats = &exp->io_stats;
+
+	if (exp->io_mode == VFS_IO_BUFFERED)
+		return;
+
+	LogEvent(COMPONENT_FSAL,
+		 "VFS export %"PRIu16" I/O: direct %"PRIu64" ops %"PRIu64
+		 " bytes, bounced %"PRIu64" ops %"PRIu64
+		 " bytes, dropped from cache %"PRIu64" bytes",
+		 exp->export.export_id,
+		 atomic_fetch_uint64_t(&stats->direct_ops),
+		 atomic_fetch_uint64_t(&stats->direct_bytes),
+		 atomic_fetch_uint64_t(&stats->bounced_ops),
+		 atomic_fetch_uint64_t(&stats->bounced_bytes),
+		 atomic_fetch_uint64_t(&stats->dontneed_bytes));
+}
@@ -87,6 +87,9 @@ static void release(struct fsal_export *exp_hdl)
 			 myself->root_fs->path);
 	}
 
+	vfs_io_log_stats(myself);
+	vfs_statx_log_stats(myself);
+
 	vfs_sub_fini(myself);
 
 	vfs_unexport_filesystems(myself);
@@ -601,6 +604,24 @@ fsal_status_t vfs_update_export(struct fsal_module *fsal_hdl,
 		invalid = true;
 	}
 
+	if (orig->io_mode != myself.io_mode) {
+		LogCrit(COMPONENT_FSAL,
+			"Can not change io_mode without restart.");
+		invalid = true;
+	}
+
+	if (orig->statx_dont_sync != myself.statx_dont_sync) {
+		LogCrit(COMPONENT_FSAL,
+			"Can not change statx_dont_sync without restart.");
+		invalid = true;
+	}
+
+	if (orig->share_fds != myself.share_fds) {
+		LogCrit(COMPONENT_FSAL,
+			"Can not change share_fds without restart.");
+		invalid = true;
+	}
+
 	return invalid
 		? posix2fsal_status(EINVAL)
 		: fsalstat(ERR_FSAL_NO_ERROR, 0);
@@ -43,6 +43,86 @@
 #include "os/subr.h"
 #include "sal_data.h"
 
+/*
+ * Open states of a file that want the same access share one kernel fd,
+ * so many clients opening the same files don't each hold a descriptor.
+ * Shares are still checked per state; a shared fd is only closed when
+ * the last state using it is.
+ */
+
+/** Locks protecting the shared fds of files, shared by all files */
+#define VFS_SHARED_FD_LOCKS 64
+
+static pthread_mutex_t vfs_shared_fd_lock[VFS_SHARED_FD_LOCKS];
+static pthread_once_t vfs_shared_fd_once = PTHREAD_ONCE_INIT;
+
+static void vfs_shared_fd_init(void)
+{
+	int i;
+
+	for (i = 0; i < VFS_SHARED_FD_LOCKS; i++)
+		PTHREAD_MUTEX_init(&vfs_shared_fd_lock[i], NULL);
+}
+
+static inline pthread_mutex_t *
+vfs_shared_fd_mutex(struct vfs_fsal_obj_handle *myself)
+{
+	return &vfs_shared_fd_lock[((uintptr_t)myself >> 6) %
+				   VFS_SHARED_FD_LOCKS];
+}
+
+/**
+ * @brief Get a reference on a shared fd allowing an access
+ *
+ * A read/write fd also does for opens that only read or only write.
+ * Must be called with the shared fd lock of the file held.
+ *
+ * @param[in] myself	File
+ * @param[in] access	FSAL_O_READ, FSAL_O_WRITE or FSAL_O_RDWR
+ *
+ * @return The shared fd, or NULL if there is none.
+ */
+static struct vfs_shared_fd *vfs_shared_fd_get(
+				struct vfs_fsal_obj_handle *myself,
+				fsal_openflags_t access)
+{
+	struct vfs_shared_fd *shared = myself->u.file.shared_fd[access - 1];
+
+	if (shared == NULL)
+		shared = myself->u.file.shared_fd[FSAL_O_RDWR - 1];
+
+	if (shared != NULL)
+		shared->refcount++;
+
+	return shared;
+}
+
+/**
+ * @brief Release a reference on a shared fd
+ *
+ * @param[in] shared	Shared fd
+ *
+ * @return true if this was the last reference and the fd must be closed.
+ */
+static bool vfs_shared_fd_put(struct vfs_shared_fd *shared)
+{
+	pthread_mutex_t *lock = vfs_shared_fd_mutex(shared->obj);
+	bool last;
+
+	PTHREAD_MUTEX_lock(lock);
+
+	last = --shared->refcount == 0;
+	if (last)
+		shared->obj->u.file.shared_fd[shared->access - 1] = NULL;
+
+	PTHREAD_MUTEX_unlock(lock);
+
+	if (last)
+		gsh_free(shared);
+
+	return last;
+}
+
 fsal_status_t vfs_open_my_fd(struct vfs_fsal_obj_handle *myself,
 			     fsal_openflags_t openflags,
 			     int posix_flags,
@@ -80,6 +160,7 @@ fsal_status_t vfs_open_my_fd(struct vfs_fsal_obj_handle *myself,
 				fd, openflags);
 		my_fd->fd = fd;
 		my_fd->openflags = FSAL_O_NFS_FLAGS(openflags);
+		vfs_io_setup_fd(myself, my_fd);
 	}
 
 	return fsalstat(fsal_error, retval);
@@ -91,19 +172,115 @@ fsal_status_t vfs_close_my_fd(struct vfs_fd *my_fd)
 	int retval = 0;
 
 	if (my_fd->fd >= 0 && my_fd->openflags != FSAL_O_CLOSED) {
-		LogFullDebug(COMPONENT_FSAL, "Closing Opened fd %d", my_fd->fd);
-		retval = close(my_fd->fd);
-		if (retval < 0) {
-			retval = errno;
-			fsal_error = posix2fsal_error(retval);
+		if (my_fd->shared != NULL &&
+		    !vfs_shared_fd_put(my_fd->shared)) {
+			LogFullDebug(COMPONENT_FSAL,
+				     "Released shared fd %d", my_fd->fd);
+		} else {
+			LogFullDebug(COMPONENT_FSAL,
+				     "Closing Opened fd %d", my_fd->fd);
+			retval = close(my_fd->fd);
+			if (retval < 0) {
+				retval = errno;
+				fsal_error = posix2fsal_error(retval);
+			}
+			if (my_fd->direct)
+				(void) close(my_fd->buf_fd);
 		}
 		my_fd->fd = -1;
 		my_fd->openflags = FSAL_O_CLOSED;
+		my_fd->shared = NULL;
+		my_fd->direct = false;
 	}
 
 	return fsalstat(fsal_error, retval);
 }
 
+/**
+ * @brief Open the file descriptor of a state
+ *
+ * Share states use a kernel fd shared with the other share states of the
+ * file when the export allows it.  Lock and 9P states keep their own fd,
+ * since OFD locks belong to the open file description.  So do the states
+ * of direct exports, whose fds are O_DIRECT.
+ *
+ * @param[in]  myself		File to open
+ * @param[in]  state		State the fd is for
+ * @param[in]  openflags	Mode for open
+ * @param[in]  posix_flags	POSIX open flags
+ * @param[out] my_fd		The state's fd
+ *
+ * @return FSAL status.
+ */
+static fsal_status_t vfs_open_state_fd(struct vfs_fsal_obj_handle *myself,
+				       struct state_t *state,
+				       fsal_openflags_t openflags,
+				       int posix_flags,
+				       struct vfs_fd *my_fd)
+{
+	struct vfs_fsal_export *exp = EXPORT_VFS_FROM_FSAL(op_ctx->fsal_export);
+	fsal_openflags_t access = openflags & FSAL_O_RDWR;
+	struct vfs_shared_fd *shared = NULL;
+	pthread_mutex_t *lock;
+	fsal_status_t status;
+
+	if (!exp->share_fds || exp->io_mode == VFS_IO_DIRECT || access == 0 ||
+	    (state->state_type != STATE_TYPE_SHARE &&
+	     state->state_type != STATE_TYPE_NLM_SHARE))
+		return vfs_open_my_fd(myself, openflags, posix_flags, my_fd);
+
+	(void)pthread_once(&vfs_shared_fd_once, vfs_shared_fd_init);
+
+	lock = vfs_shared_fd_mutex(myself);
+
+	/* A truncating open has to open the file anyway */
+	if ((posix_flags & O_TRUNC) == 0) {
+		PTHREAD_MUTEX_lock(lock);
+		shared = vfs_shared_fd_get(myself, access);
+		PTHREAD_MUTEX_unlock(lock);
+	}
+
+	if (shared == NULL) {
+		status = vfs_open_my_fd(myself, openflags, posix_flags, my_fd);
+		if (FSAL_IS_ERROR(status))
+			return status;
+
+		PTHREAD_MUTEX_lock(lock);
+
+		shared = vfs_shared_fd_get(myself, access);
+		if (shared == NULL) {
+			/* Our fd becomes the shared fd */
+			shared = gsh_malloc(sizeof(*shared));
+			shared->fd = my_fd->fd;
+			shared->access = access;
+			shared->refcount = 1;
+			shared->obj = myself;
+			myself->u.file.shared_fd[access - 1] = shared;
+			my_fd->shared = shared;
+
+			PTHREAD_MUTEX_unlock(lock);
+			return status;
+		}
+
+		PTHREAD_MUTEX_unlock(lock);
+
+		/* Someone shared an fd meanwhile, or we only opened to
+		 * truncate, use the shared fd.
+		 */
+		(void) vfs_close_my_fd(my_fd);
+	}
+
+	LogFullDebug(COMPONENT_FSAL,
+		     "Using shared fd %d refcount %"PRIu32,
+		     shared->fd, shared->refcount);
+
+	my_fd->fd = shared->fd;
+	my_fd->openflags = FSAL_O_NFS_FLAGS(openflags);
+	my_fd->shared = shared;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
 /**
  * @brief Function to open an fsal_obj_handle's global file descriptor.
  *
@@ -173,11 +350,50 @@ fsal_status_t vfs_close(struct fsal_obj_handle *obj_hdl)
 	else
 		status = vfs_close_my_fd(&myself->u.file.fd);
 
+	/* fsal_close() only accounts for the global fd */
+	if (myself->u.file.dio_fd.openflags != FSAL_O_CLOSED &&
+	    !FSAL_IS_ERROR(vfs_close_my_fd(&myself->u.file.dio_fd))) {
+		ssize_t count = atomic_dec_size_t(&open_fd_count);
+
+		if (count < 0) {
+			LogCrit(COMPONENT_FSAL,
+				"open_fd_count is negative: %zd", count);
+		}
+	}
+
 	PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
 
+	/* The fd LRU reclaims the path fd along with the file */
+	vfs_path_fd_release(myself);
+
 	return status;
 }
 
+/* State objects are recycled with their fdlock initialized */
+static pool_t *vfs_state_pool;
+static pthread_once_t vfs_state_pool_once = PTHREAD_ONCE_INIT;
+
+static void vfs_state_ctor(void *object)
+{
+	struct vfs_state_fd *state_fd = object;
+
+	PTHREAD_RWLOCK_init(&state_fd->vfs_fd.fdlock, NULL);
+}
+
+static void vfs_state_dtor(void *object)
+{
+	struct vfs_state_fd *state_fd = object;
+
+	PTHREAD_RWLOCK_destroy(&state_fd->vfs_fd.fdlock);
+}
+
+static void vfs_state_pool_init(void)
+{
+	vfs_state_pool = pool_slab_init("VFS state pool",
+					sizeof(struct vfs_state_fd),
+					vfs_state_ctor, vfs_state_dtor);
+}
+
 /**
  * @brief Allocate a state_t structure
  *
@@ -195,17 +411,22 @@ struct state_t *vfs_alloc_state(struct fsal_export *exp_hdl,
 				enum state_type state_type,
 				struct state_t *related_state)
 {
+	struct vfs_state_fd *state_fd;
 	struct state_t *state;
-	struct vfs_fd *my_fd;
 
-	state = init_state(gsh_calloc(1, sizeof(struct vfs_state_fd)),
-			   exp_hdl, state_type, related_state);
+	(void) pthread_once(&vfs_state_pool_once, vfs_state_pool_init);
+
+	/* Objects come back constructed, not zeroed */
+	state_fd = pool_alloc(vfs_state_pool);
+	memset(&state_fd->state, 0, sizeof(state_fd->state));
 
-	my_fd = &container_of(state, struct vfs_state_fd, state)->vfs_fd;
+	state = init_state(&state_fd->state, exp_hdl, state_type,
+			   related_state);
 
-	my_fd->fd = -1;
-	my_fd->openflags = FSAL_O_CLOSED;
-	PTHREAD_RWLOCK_init(&my_fd->fdlock, NULL);
+	state_fd->vfs_fd.fd = -1;
+	state_fd->vfs_fd.openflags = FSAL_O_CLOSED;
+	state_fd->vfs_fd.shared = NULL;
+	state_fd->vfs_fd.direct = false;
 
 	return state;
 }
@@ -221,11 +442,8 @@ void vfs_free_state(struct fsal_export *exp_hdl, struct state_t *state)
 {
 	struct vfs_state_fd *state_fd = container_of(state, struct vfs_state_fd,
 						     state);
-	struct vfs_fd *my_fd = &state_fd->vfs_fd;
-
-	PTHREAD_RWLOCK_destroy(&my_fd->fdlock);
 
-	gsh_free(state_fd);
+	pool_free(vfs_state_pool, state_fd);
 }
 
 /**
@@ -278,21 +496,37 @@ fsal_status_t vfs_merge(struct fsal_obj_handle *orig_hdl,
 static fsal_status_t fetch_attrs(struct vfs_fsal_obj_handle *myself,
 				 int my_fd, struct attrlist *attrs)
 {
+	struct vfs_fsal_export *exp = EXPORT_VFS_FROM_FSAL(op_ctx->fsal_export);
 	struct stat stat;
+	attrmask_t valid = ATTRS_POSIX;
+	const char *name = NULL;
 	int retval = 0;
 	fsal_status_t status = {0, 0};
-	const char *func = "unknown";
+	const char *func = "statx";
 #ifdef __FreeBSD__
 	struct fhandle *handle;
 #endif
 
+	if (myself->obj_handle.type == SOCKET_FILE ||
+	    myself->obj_handle.type == CHARACTER_FILE ||
+	    myself->obj_handle.type == BLOCK_FILE)
+		name = myself->u.unopenable.name;
+
+	/* Only fetch what was asked for when we can */
+	retval = vfs_statx(exp, my_fd, name, attrs->request_mask, &stat,
+			   &valid);
+
+	if (retval == 0 || errno != ENOSYS)
+		goto stated;
+
+	retval = 0;
+
 	/* Now stat the file as appropriate */
 	switch (myself->obj_handle.type) {
 	case SOCKET_FILE:
 	case CHARACTER_FILE:
 	case BLOCK_FILE:
-		retval = fstatat(my_fd, myself->u.unopenable.name, &stat,
-				 AT_SYMLINK_NOFOLLOW);
+		retval = fstatat(my_fd, name, &stat, AT_SYMLINK_NOFOLLOW);
 		func = "fstatat";
 		break;
 
@@ -320,6 +554,7 @@ static fsal_status_t fetch_attrs(struct vfs_fsal_obj_handle *myself,
 		break;
 	}
 
+ stated:
 	if (retval < 0) {
 		if (errno == ENOENT)
 			retval = ESTALE;
@@ -337,7 +572,8 @@ static fsal_status_t fetch_attrs(struct vfs_fsal_obj_handle *myself,
 		return fsalstat(posix2fsal_error(retval), retval);
 	}
 
-	posix2fsal_attributes_all(&stat, attrs);
+	attrs->valid_mask |= valid;
+	posix2fsal_attributes(&stat, attrs);
 	attrs->fsid = myself->obj_handle.fs->fsid;
 
 	if (myself->sub_ops && myself->sub_ops->getattrs) {
@@ -428,7 +664,12 @@ static fsal_status_t vfs_open2_by_handle(struct fsal_obj_handle *obj_hdl,
 	if (my_fd->openflags != FSAL_O_CLOSED) {
 		vfs_close_my_fd(my_fd);
 	}
-	status = vfs_open_my_fd(myself, openflags, posix_flags, my_fd);
+
+	if (state != NULL)
+		status = vfs_open_state_fd(myself, state, openflags,
+					   posix_flags, my_fd);
+	else
+		status = vfs_open_my_fd(myself, openflags, posix_flags, my_fd);
 
 	if (FSAL_IS_ERROR(status)) {
 		if (state == NULL) {
@@ -885,6 +1126,7 @@ fsal_status_t vfs_open2(struct fsal_obj_handle *obj_hdl,
 
 	my_fd->fd = fd;
 	my_fd->openflags = FSAL_O_NFS_FLAGS(openflags);
+	vfs_io_setup_fd(hdl, my_fd);
 
 	*new_obj = &hdl->obj_handle;
 
@@ -1044,7 +1286,8 @@ fsal_status_t vfs_reopen2(struct fsal_obj_handle *obj_hdl,
 
 	PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
 
-	status = vfs_open_my_fd(myself, openflags, posix_flags, my_fd);
+	status = vfs_open_state_fd(myself, state, openflags, posix_flags,
+				   my_fd);
 
 	if (!FSAL_IS_ERROR(status)) {
 		/* Close the existing file descriptor and copy the new
@@ -1056,6 +1299,9 @@ fsal_status_t vfs_reopen2(struct fsal_obj_handle *obj_hdl,
 		vfs_close_my_fd(my_share_fd);
 		my_share_fd->fd = my_fd->fd;
 		my_share_fd->openflags = my_fd->openflags;
+		my_share_fd->shared = my_fd->shared;
+		my_share_fd->direct = my_fd->direct;
+		my_share_fd->buf_fd = my_fd->buf_fd;
 
 		PTHREAD_RWLOCK_unlock(&my_share_fd->fdlock);
 	} else {
@@ -1074,26 +1320,37 @@ fsal_status_t vfs_reopen2(struct fsal_obj_handle *obj_hdl,
 	return status;
 }
 
-fsal_status_t find_fd(int *fd,
-		      struct fsal_obj_handle *obj_hdl,
-		      bool bypass,
-		      struct state_t *state,
-		      fsal_openflags_t openflags,
-		      bool *has_lock,
-		      bool *closefd,
-		      bool open_for_locks)
+/**
+ * @brief Find the fd to use for an operation on an object
+ *
+ * @param[out] out_fd		fd found, @a temp_fd if *closefd is set
+ * @param[in]  temp_fd		Storage for a temporary fd
+ *
+ * The other parameters are those of find_fd().
+ *
+ * @return FSAL status.
+ */
+static fsal_status_t vfs_find_fd(struct vfs_fd **out_fd,
+				 struct vfs_fd *temp_fd,
+				 struct fsal_obj_handle *obj_hdl,
+				 bool bypass,
+				 struct state_t *state,
+				 fsal_openflags_t openflags,
+				 bool *has_lock,
+				 bool *closefd,
+				 bool open_for_locks)
 {
 	struct vfs_fsal_obj_handle *myself;
 	struct vfs_filesystem *vfs_fs;
-	struct vfs_fd temp_fd = {
-			FSAL_O_CLOSED, PTHREAD_RWLOCK_INITIALIZER, -1 };
-	struct vfs_fd *out_fd = &temp_fd;
+	struct vfs_fsal_export *exp = EXPORT_VFS_FROM_FSAL(op_ctx->fsal_export);
+	struct vfs_fd *global_fd;
 	fsal_status_t status = {ERR_FSAL_NO_ERROR, 0};
 	int rc, posix_flags;
 	bool reusing_open_state_fd = false;
 
 	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
 	vfs_fs = myself->obj_handle.fs->private_data;
+	*out_fd = temp_fd;
 
 	fsal2posix_openflags(openflags, &posix_flags);
 
@@ -1112,7 +1369,7 @@ fsal_status_t find_fd(int *fd,
 				 strerror(-rc), O_PATH | O_NOACCESS);
 			return fsalstat(posix2fsal_error(-rc), -rc);
 		}
-		*fd = rc;
+		temp_fd->fd = rc;
 		*closefd = true;
 		LogFullDebug(COMPONENT_FSAL,
 			     "Opened fd=%d for file %p of type %s",
@@ -1121,18 +1378,24 @@ fsal_status_t find_fd(int *fd,
 		return status;
 
 	case REGULAR_FILE:
-		status = fsal_find_fd((struct fsal_fd **)&out_fd, obj_hdl,
-				      (struct fsal_fd *)&myself->u.file.fd,
+		/* A direct export doesn't turn the global fd of the other
+		 * exports to O_DIRECT, it has its own.
+		 */
+		global_fd = exp->io_mode == VFS_IO_DIRECT
+				? &myself->u.file.dio_fd
+				: &myself->u.file.fd;
+
+		status = fsal_find_fd((struct fsal_fd **)out_fd, obj_hdl,
+				      (struct fsal_fd *)global_fd,
 				      &myself->u.file.share,
 				      bypass, state, openflags,
 				      vfs_open_func, vfs_close_func,
 				      has_lock, closefd, open_for_locks,
 				      &reusing_open_state_fd);
 
-		*fd = out_fd->fd;
 		LogFullDebug(COMPONENT_FSAL,
 			     "Found fd=%d for file %p of type %s",
-			     out_fd->fd, myself,
+			     (*out_fd)->fd, myself,
 			     object_file_type_to_str(obj_hdl->type));
 		return status;
 
@@ -1166,12 +1429,39 @@ fsal_status_t find_fd(int *fd,
 		     "Opened fd=%d for file %p of type %s",
 		     rc, myself, object_file_type_to_str(obj_hdl->type));
 
-	*fd = rc;
+	temp_fd->fd = rc;
 	*closefd = true;
 
 	return status;
 }
 
+fsal_status_t find_fd(int *fd,
+		      struct fsal_obj_handle *obj_hdl,
+		      bool bypass,
+		      struct state_t *state,
+		      fsal_openflags_t openflags,
+		      bool *has_lock,
+		      bool *closefd,
+		      bool open_for_locks)
+{
+	struct vfs_fd temp_fd = {
+			FSAL_O_CLOSED, PTHREAD_RWLOCK_INITIALIZER, -1, NULL };
+	struct vfs_fd *out_fd;
+	fsal_status_t status;
+
+	status = vfs_find_fd(&out_fd, &temp_fd, obj_hdl, bypass, state,
+			     openflags, has_lock, closefd, open_for_locks);
+
+	if (*closefd && temp_fd.direct) {
+		/* The caller only closes one fd, give it the buffered one */
+		(void) close(temp_fd.fd);
+		temp_fd.fd = temp_fd.buf_fd;
+	}
+
+	*fd = out_fd->fd;
+	return status;
+}
+
 /**
  * @brief Read data from a file
  *
@@ -1204,13 +1494,12 @@ void vfs_read2(struct fsal_obj_handle *obj_hdl,
 	bool has_lock = false;
 	bool closefd = false;
 	struct vfs_fd *vfs_fd = NULL;
-
-	if (read_arg->info != NULL) {
-		/* Currently we don't support READ_PLUS */
-		done_cb(obj_hdl, fsalstat(ERR_FSAL_NOTSUPP, 0), read_arg,
-			caller_arg);
-		return;
-	}
+	struct vfs_fd temp_fd = {
+			FSAL_O_CLOSED, PTHREAD_RWLOCK_INITIALIZER, -1, NULL };
+	struct vfs_fd *io_fd;
+	struct vfs_aio_req *aio = NULL;
+	enum vfs_io_mode io_mode;
+	struct io_seg *seg;
 
 	if (obj_hdl->fsal != obj_hdl->fs->fsal) {
 		LogDebug(COMPONENT_FSAL,
@@ -1234,14 +1523,63 @@ void vfs_read2(struct fsal_obj_handle *obj_hdl,
 	/* Get a usable file descriptor */
 	LogFullDebug(COMPONENT_FSAL, "Calling find_fd, state = %p",
 		     read_arg->state);
-	status = find_fd(&my_fd, obj_hdl, bypass, read_arg->state, FSAL_O_READ,
-			 &has_lock, &closefd, false);
+	status = vfs_find_fd(&io_fd, &temp_fd, obj_hdl, bypass,
+			     read_arg->state, FSAL_O_READ, &has_lock,
+			     &closefd, false);
+	my_fd = io_fd->fd;
 
 	if (FSAL_IS_ERROR(status))
 		goto out;
 
-	nb_read = preadv(my_fd, read_arg->iov, read_arg->iov_count,
-			 read_arg->offset);
+	io_mode = vfs_io_mode(io_fd);
+
+	/* Only aligned reads go async on an O_DIRECT export, and none on a
+	 * dontneed one since the pages are dropped here.
+	 */
+	if (read_arg->info == NULL &&
+	    (io_mode == VFS_IO_BUFFERED ||
+	     (io_mode == VFS_IO_DIRECT &&
+	      vfs_dio_aligned(read_arg->iov, read_arg->iov_count,
+			      read_arg->offset)))) {
+		aio = vfs_aio_prepare(obj_hdl, my_fd, &closefd, false, NULL,
+				      done_cb, read_arg, caller_arg);
+		if (aio != NULL) {
+			if (io_mode == VFS_IO_DIRECT)
+				vfs_dio_count_async(read_arg->iov,
+						    read_arg->iov_count);
+			goto out;
+		}
+	}
+
+	if (io_mode == VFS_IO_DIRECT) {
+		/* READ_PLUS returns it all as data, SEEK_DATA and SEEK_HOLE
+		 * don't give block aligned extents.
+		 */
+		nb_read = vfs_dio_read(my_fd, read_arg->iov,
+				       read_arg->iov_count, read_arg->offset);
+		if (read_arg->info != NULL && nb_read >= 0) {
+			read_arg->info->io_nsegs = 0;
+			if (nb_read > 0) {
+				seg = &read_arg->info->io_segs[0];
+				seg->what = NFS4_CONTENT_DATA;
+				seg->offset = read_arg->offset;
+				seg->length = nb_read;
+				read_arg->info->io_nsegs = 1;
+			}
+		}
+		read_arg->end_of_file = (nb_read == 0);
+	} else if (read_arg->info != NULL && read_arg->iov_count == 1) {
+		/* READ_PLUS, only read the data segments */
+		nb_read = fsal_read_plus_fd(my_fd, read_arg->offset,
+					    read_arg->iov[0].iov_len,
+					    read_arg->iov[0].iov_base,
+					    read_arg->info,
+					    &read_arg->end_of_file);
+	} else {
+		nb_read = preadv(my_fd, read_arg->iov, read_arg->iov_count,
+				 read_arg->offset);
+		read_arg->end_of_file = (nb_read == 0);
+	}
 
 	if (read_arg->offset == -1 || nb_read == -1) {
 		retval = errno;
@@ -1251,23 +1589,7 @@ void vfs_read2(struct fsal_obj_handle *obj_hdl,
 
 	read_arg->io_amount = nb_read;
 
-	read_arg->end_of_file = (nb_read == 0);
-
-#if 0
-	/** @todo
-	 *
-	 * Is this all we really need to do to support READ_PLUS? Will anyone
-	 * ever get upset that we don't return holes, even for blocks of all
-	 * zeroes?
-	 *
-	 */
-	if (info != NULL) {
-		info->io_content.what = NFS4_CONTENT_DATA;
-		info->io_content.data.d_offset = offset + nb_read;
-		info->io_content.data.d_data.data_len = nb_read;
-		info->io_content.data.d_data.data_val = buffer;
-	}
-#endif
+	vfs_io_dontneed(my_fd, read_arg->offset, nb_read, false);
 
  out:
 
@@ -1279,9 +1601,19 @@ void vfs_read2(struct fsal_obj_handle *obj_hdl,
 		close(my_fd);
 	}
 
+	/* Even when the async read took over closing the fd */
+	if (temp_fd.direct)
+		close(temp_fd.buf_fd);
+
 	if (has_lock)
 		PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
 
+	if (aio != NULL) {
+		/* The request may complete at once, leave obj_hdl alone */
+		vfs_aio_start(aio);
+		return;
+	}
+
 	done_cb(obj_hdl, status, read_arg, caller_arg);
 }
 
@@ -1320,6 +1652,14 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl,
 	bool closefd = false;
 	fsal_openflags_t openflags = FSAL_O_WRITE;
 	struct vfs_fd *vfs_fd = NULL;
+	struct vfs_fd temp_fd = {
+			FSAL_O_CLOSED, PTHREAD_RWLOCK_INITIALIZER, -1, NULL };
+	struct vfs_fd *io_fd;
+	struct vfs_fsal_obj_handle *myself;
+	struct vfs_aio_req *aio = NULL;
+	enum vfs_io_mode io_mode;
+
+	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
 
 	if (obj_hdl->fsal != obj_hdl->fs->fsal) {
 		LogDebug(COMPONENT_FSAL,
@@ -1343,8 +1683,10 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl,
 	/* Get a usable file descriptor */
 	LogFullDebug(COMPONENT_FSAL, "Calling find_fd, state = %p",
 		     write_arg->state);
-	status = find_fd(&my_fd, obj_hdl, bypass, write_arg->state, openflags,
-			 &has_lock, &closefd, false);
+	status = vfs_find_fd(&io_fd, &temp_fd, obj_hdl, bypass,
+			     write_arg->state, openflags, &has_lock,
+			     &closefd, false);
+	my_fd = io_fd->fd;
 
 	if (FSAL_IS_ERROR(status)) {
 		LogDebug(COMPONENT_FSAL,
@@ -1358,8 +1700,32 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl,
 		goto out;
 	}
 
-	nb_written = pwritev(my_fd, write_arg->iov, write_arg->iov_count,
-			     write_arg->offset);
+	io_mode = vfs_io_mode(io_fd);
+
+	/* Small unstable writes may be gathered with concurrent ones */
+	if (!write_arg->fsal_stable && write_arg->info == NULL &&
+	    io_mode == VFS_IO_BUFFERED &&
+	    container_of(obj_hdl->fsal, struct vfs_fsal_module,
+			 module)->write_gather &&
+	    vfs_wg_write(&myself->u.file.wg, my_fd, write_arg, &status))
+		goto out;
+
+	/* Writes on O_DIRECT and dontneed exports stay synchronous */
+	if (write_arg->info == NULL && io_mode == VFS_IO_BUFFERED) {
+		aio = vfs_aio_prepare(obj_hdl, my_fd, &closefd, true,
+				      &myself->u.file.wg, done_cb, write_arg,
+				      caller_arg);
+		if (aio != NULL)
+			goto out;
+	}
+
+	if (io_mode == VFS_IO_DIRECT)
+		nb_written = vfs_dio_write(io_fd, write_arg->iov,
+					   write_arg->iov_count,
+					   write_arg->offset);
+	else
+		nb_written = pwritev(my_fd, write_arg->iov,
+				     write_arg->iov_count, write_arg->offset);
 
 	if (nb_written == -1) {
 		retval = errno;
@@ -1369,6 +1735,10 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl,
 
 	write_arg->io_amount = nb_written;
 
+	if (!write_arg->fsal_stable)
+		vfs_wg_mark_dirty(&myself->u.file.wg, write_arg->offset,
+				  nb_written);
+
 	if (write_arg->fsal_stable) {
 		retval = fsync(my_fd);
 		if (retval == -1) {
@@ -1378,9 +1748,15 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl,
 		}
 	}
 
+	vfs_io_dontneed(my_fd, write_arg->offset, nb_written, true);
+
  out:
 
-	vfs_restore_ganesha_credentials(obj_hdl->fsal);
+	/* An async write is issued with the caller's credentials, starting
+	 * it restores Ganesha's.
+	 */
+	if (aio == NULL)
+		vfs_restore_ganesha_credentials(obj_hdl->fsal);
 
 	if (vfs_fd)
 		PTHREAD_RWLOCK_unlock(&vfs_fd->fdlock);
@@ -1390,9 +1766,18 @@ void vfs_write2(struct fsal_obj_handle *obj_hdl,
 		close(my_fd);
 	}
 
+	if (temp_fd.direct)
+		close(temp_fd.buf_fd);
+
 	if (has_lock)
 		PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
 
+	if (aio != NULL) {
+		/* The request may complete at once, leave obj_hdl alone */
+		vfs_aio_start(aio);
+		return;
+	}
+
 	done_cb(obj_hdl, status, write_arg, caller_arg);
 }
 
@@ -1413,7 +1798,6 @@ fsal_status_t vfs_seek2(struct fsal_obj_handle *obj_hdl,
 			struct state_t *state,
 			struct io_info *info)
 {
-	struct vfs_fsal_obj_handle *myself;
 	off_t ret = 0, offset = info->io_content.hole.di_offset;
 	int what = 0;
 	bool has_lock = false;
@@ -1421,9 +1805,7 @@ fsal_status_t vfs_seek2(struct fsal_obj_handle *obj_hdl,
 	fsal_openflags_t openflags = FSAL_O_ANY;
 	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
 	int my_fd = -1;
-	struct attrlist attrs;
-
-	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
+	struct stat st;
 
 	/* Get a usable file descriptor */
 	status = find_fd(&my_fd, obj_hdl, false, state, openflags,
@@ -1432,23 +1814,16 @@ fsal_status_t vfs_seek2(struct fsal_obj_handle *obj_hdl,
 	if (FSAL_IS_ERROR(status))
 		goto out;
 
-	fsal_prepare_attrs(&attrs,
-			   (op_ctx->fsal_export->exp_ops.fs_supported_attrs(
-							op_ctx->fsal_export)
-				& ~(ATTR_ACL | ATTR4_FS_LOCATIONS)));
-
-	status = fetch_attrs(myself, my_fd, &attrs);
-
-	fsal_release_attrs(&attrs);
-
-	if (FSAL_IS_ERROR(status)) {
+	/* Only the size is needed, don't bother with a full fetch_attrs */
+	if (fstat(my_fd, &st) < 0) {
+		status = posix2fsal_status(errno);
 		goto out;
 	}
 
 	/* RFC7862 15.11.3,
 	 * If the sa_offset is beyond the end of the file,
 	 * then SEEK MUST return NFS4ERR_NXIO. */
-	if (offset >= attrs.filesize) {
+	if (offset >= st.st_size) {
 		status = posix2fsal_status(ENXIO);
 		goto out;
 	}
@@ -1472,7 +1847,7 @@ fsal_status_t vfs_seek2(struct fsal_obj_handle *obj_hdl,
 		}
 		goto out;
 	} else {
-		info->io_eof = (ret >= attrs.filesize);
+		info->io_eof = (ret >= st.st_size);
 		info->io_content.hole.di_offset = ret;
 	}
 
@@ -1558,6 +1933,275 @@ fsal_status_t vfs_fallocate(struct fsal_obj_handle *obj_hdl,
 }
 #endif
 
+/* Largest chunk handed to the kernel at once, also the bounce buffer size */
+#define VFS_COPY_CHUNK (1024 * 1024)
+
+/**
+ * @brief Copy a range with pread/pwrite
+ *
+ * Used when copy_file_range is not available or refuses the pair of
+ * files (different super blocks on older kernels).
+ *
+ * @return bytes copied, 0 at end of source, -1 with errno set on error.
+ */
+static ssize_t vfs_copy_bounce(int src_fd, off_t *src_offset,
+			       int dst_fd, off_t *dst_offset, size_t len)
+{
+	char *buf;
+	ssize_t nread, nwritten, done = 0;
+
+	if (len > VFS_COPY_CHUNK)
+		len = VFS_COPY_CHUNK;
+
+	buf = gsh_malloc(len);
+
+	nread = pread(src_fd, buf, len, *src_offset);
+	if (nread <= 0) {
+		done = nread;
+		goto out;
+	}
+
+	while (done < nread) {
+		nwritten = pwrite(dst_fd, buf + done, nread - done,
+				  *dst_offset + done);
+		if (nwritten < 0) {
+			if (done == 0)
+				done = -1;
+			break;
+		}
+		done += nwritten;
+	}
+
+	if (done > 0) {
+		*src_offset += done;
+		*dst_offset += done;
+	}
+
+ out:
+	gsh_free(buf);
+	return done;
+}
+
+/**
+ * @brief Server side copy
+ *
+ * Let the kernel move the data with copy_file_range so that it never
+ * crosses into user space, and can be offloaded by the underlying
+ * filesystem (reflink, NFS server side copy, ...).
+ *
+ * @param[in]  src_hdl    File to copy from
+ * @param[in]  src_state  Open stateid for the source
+ * @param[in]  src_offset Offset in the source
+ * @param[in]  dst_hdl    File to copy to
+ * @param[in]  dst_state  Open stateid for the destination
+ * @param[in]  dst_offset Offset in the destination
+ * @param[in]  count      Number of bytes to copy
+ * @param[out] copied     Number of bytes copied
+ *
+ * @return FSAL status.
+ */
+
+fsal_status_t vfs_copy(struct fsal_obj_handle *src_hdl,
+		       struct state_t *src_state, uint64_t src_offset,
+		       struct fsal_obj_handle *dst_hdl,
+		       struct state_t *dst_state, uint64_t dst_offset,
+		       uint64_t count, uint64_t *copied)
+{
+	bool src_lock = false, src_closefd = false;
+	bool dst_lock = false, dst_closefd = false;
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+	int src_fd = -1, dst_fd = -1;
+	off_t src_off = src_offset, dst_off = dst_offset;
+	ssize_t nb;
+	size_t len;
+	int retval;
+
+	*copied = 0;
+
+	/* Get usable file descriptors */
+	status = find_fd(&src_fd, src_hdl, false, src_state, FSAL_O_READ,
+			 &src_lock, &src_closefd, false);
+
+	if (FSAL_IS_ERROR(status))
+		goto out;
+
+	status = find_fd(&dst_fd, dst_hdl, false, dst_state, FSAL_O_WRITE,
+			 &dst_lock, &dst_closefd, false);
+
+	if (FSAL_IS_ERROR(status))
+		goto out;
+
+	if (!vfs_set_credentials(op_ctx->creds, dst_hdl->fsal)) {
+		status = posix2fsal_status(EPERM);
+		goto out;
+	}
+
+	while (*copied < count) {
+		len = count - *copied;
+		if (len > VFS_COPY_CHUNK)
+			len = VFS_COPY_CHUNK;
+
+#ifdef HAVE_COPY_FILE_RANGE
+		nb = copy_file_range(src_fd, &src_off, dst_fd, &dst_off,
+				     len, 0);
+		if (nb < 0 && (errno == EXDEV || errno == ENOSYS ||
+			       errno == EOPNOTSUPP))
+#endif
+			nb = vfs_copy_bounce(src_fd, &src_off, dst_fd,
+					     &dst_off, len);
+
+		if (nb < 0) {
+			retval = errno;
+			LogFullDebug(COMPONENT_FSAL,
+				     "copy returned %s (%d) after %" PRIu64
+				     " bytes", strerror(retval), retval,
+				     *copied);
+			/* Report the partial copy, the error will show up
+			 * again on the next call.
+			 */
+			if (*copied == 0)
+				status = posix2fsal_status(retval);
+			break;
+		}
+
+		if (nb == 0) {
+			/* End of the source file */
+			break;
+		}
+
+		*copied += nb;
+	}
+
+	vfs_restore_ganesha_credentials(dst_hdl->fsal);
+
+	/* The copy is unstable like a write */
+	vfs_wg_mark_dirty(&container_of(dst_hdl, struct vfs_fsal_obj_handle,
+					obj_handle)->u.file.wg,
+			  dst_offset, *copied);
+
+ out:
+
+	if (dst_closefd) {
+		LogFullDebug(COMPONENT_FSAL,
+			     "Closing Opened fd %d", dst_fd);
+		close(dst_fd);
+	}
+
+	if (dst_lock)
+		PTHREAD_RWLOCK_unlock(&dst_hdl->obj_lock);
+
+	if (src_closefd) {
+		LogFullDebug(COMPONENT_FSAL,
+			     "Closing Opened fd %d", src_fd);
+		close(src_fd);
+	}
+
+	if (src_lock)
+		PTHREAD_RWLOCK_unlock(&src_hdl->obj_lock);
+
+	return status;
+}
+
+/**
+ * @brief Share a range of blocks between two files
+ *
+ * @param[in] src_hdl    File to clone from
+ * @param[in] src_state  Open stateid for the source
+ * @param[in] src_offset Offset in the source
+ * @param[in] dst_hdl    File to clone to
+ * @param[in] dst_state  Open stateid for the destination
+ * @param[in] dst_offset Offset in the destination
+ * @param[in] count      Number of bytes to clone, 0 means to EOF
+ *
+ * @return FSAL status.
+ */
+
+#ifdef FICLONERANGE
+fsal_status_t vfs_clone(struct fsal_obj_handle *src_hdl,
+			struct state_t *src_state, uint64_t src_offset,
+			struct fsal_obj_handle *dst_hdl,
+			struct state_t *dst_state, uint64_t dst_offset,
+			uint64_t count)
+{
+	bool src_lock = false, src_closefd = false;
+	bool dst_lock = false, dst_closefd = false;
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+	int src_fd = -1, dst_fd = -1;
+	struct file_clone_range range;
+	int retval;
+
+	/* Get usable file descriptors */
+	status = find_fd(&src_fd, src_hdl, false, src_state, FSAL_O_READ,
+			 &src_lock, &src_closefd, false);
+
+	if (FSAL_IS_ERROR(status))
+		goto out;
+
+	status = find_fd(&dst_fd, dst_hdl, false, dst_state, FSAL_O_WRITE,
+			 &dst_lock, &dst_closefd, false);
+
+	if (FSAL_IS_ERROR(status))
+		goto out;
+
+	if (!vfs_set_credentials(op_ctx->creds, dst_hdl->fsal)) {
+		status = posix2fsal_status(EPERM);
+		goto out;
+	}
+
+	range.src_fd = src_fd;
+	range.src_offset = src_offset;
+	range.src_length = count;
+	range.dest_offset = dst_offset;
+
+	retval = ioctl(dst_fd, FICLONERANGE, &range);
+
+	if (retval < 0) {
+		retval = errno;
+		LogFullDebug(COMPONENT_FSAL,
+			     "FICLONERANGE returned %s (%d)",
+			     strerror(retval), retval);
+		/* Filesystems without reflink support say EOPNOTSUPP,
+		 * files on different filesystems EXDEV.
+		 */
+		if (retval == EOPNOTSUPP || retval == EXDEV)
+			status = fsalstat(ERR_FSAL_NOTSUPP, retval);
+		else
+			status = posix2fsal_status(retval);
+	} else {
+		/* Make sure a later COMMIT syncs the cloned range */
+		vfs_wg_mark_dirty(&container_of(dst_hdl,
+						struct vfs_fsal_obj_handle,
+						obj_handle)->u.file.wg,
+				  dst_offset,
+				  count != 0 ? count : UINT64_MAX - dst_offset);
+	}
+
+	vfs_restore_ganesha_credentials(dst_hdl->fsal);
+
+ out:
+
+	if (dst_closefd) {
+		LogFullDebug(COMPONENT_FSAL,
+			     "Closing Opened fd %d", dst_fd);
+		close(dst_fd);
+	}
+
+	if (dst_lock)
+		PTHREAD_RWLOCK_unlock(&dst_hdl->obj_lock);
+
+	if (src_closefd) {
+		LogFullDebug(COMPONENT_FSAL,
+			     "Closing Opened fd %d", src_fd);
+		close(src_fd);
+	}
+
+	if (src_lock)
+		PTHREAD_RWLOCK_unlock(&src_hdl->obj_lock);
+
+	return status;
+}
+#endif
+
 /**
  * @brief Commit written data
  *
@@ -1567,6 +2211,9 @@ fsal_status_t vfs_fallocate(struct fsal_obj_handle *obj_hdl,
  * FSAL must be able to perform this operation without being passed a specific
  * state.
  *
+ * A range with no unstable writes since the last sync returns at once, and
+ * concurrent commits on the file share a single sync (see write_gather.c).
+ *
  * @param[in] obj_hdl          File on which to operate
  * @param[in] state            state_t to use for this operation
  * @param[in] offset           Start of range to commit
@@ -1583,13 +2230,17 @@ fsal_status_t vfs_commit2(struct fsal_obj_handle *obj_hdl,
 	fsal_status_t status;
 	int retval;
 	struct vfs_fd temp_fd = {
-			FSAL_O_CLOSED, PTHREAD_RWLOCK_INITIALIZER, -1 };
+			FSAL_O_CLOSED, PTHREAD_RWLOCK_INITIALIZER, -1, NULL };
 	struct vfs_fd *out_fd = &temp_fd;
 	bool has_lock = false;
 	bool closefd = false;
 
 	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
 
+	/* Nothing unstable in the range, no need to even open the file */
+	if (vfs_wg_is_clean(&myself->u.file.wg, offset, len))
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
 	/* Make sure file is open in appropriate mode.
 	 * Do not check share reservation.
 	 */
@@ -1608,12 +2259,11 @@ fsal_status_t vfs_commit2(struct fsal_obj_handle *obj_hdl,
 			goto out;
 		}
 
-		retval = fsync(out_fd->fd);
+		retval = vfs_wg_commit(&myself->u.file.wg, out_fd->fd,
+				       offset, len);
 
-		if (retval == -1) {
-			retval = errno;
+		if (retval != 0)
 			status = fsalstat(posix2fsal_error(retval), retval);
-		}
 
 		vfs_restore_ganesha_credentials(obj_hdl->fsal);
 	}
@@ -1622,7 +2272,7 @@ out:
 	if (closefd) {
 		LogFullDebug(COMPONENT_FSAL,
 			     "Closing Opened fd %d", out_fd->fd);
-		close(out_fd->fd);
+		(void) vfs_close_my_fd(out_fd);
 	}
 
 	if (has_lock)
@@ -2074,10 +2724,14 @@ fsal_status_t vfs_setattr2(struct fsal_obj_handle *obj_hdl,
 			 */
 
 			retval = ftruncate(my_fd, attrib_set->filesize);
-			if (retval != 0) {
-				func = "truncate";
-				goto fileerr;
-			}
+			if (retval != 0)
+				retval = errno;
+		}
+
+		if (retval != 0) {
+			errno = retval;
+			func = "truncate";
+			goto fileerr;
 		}
 	}
 
@@ -58,9 +58,7 @@ int vfs_fsal_open(struct vfs_fsal_obj_handle *hdl,
 		  int openflags,
 		  fsal_errors_t *fsal_error)
 {
-	struct vfs_filesystem *vfs_fs = hdl->obj_handle.fs->private_data;
-
-	return vfs_open_by_handle(vfs_fs, hdl->handle, openflags, fsal_error);
+	return vfs_path_fd_open(hdl, openflags, fsal_error);
 }
 
 /**
@@ -101,8 +99,12 @@ void free_vfs_fsal_obj_handle(struct vfs_fsal_obj_handle **hdl_ref)
 	} else if (vfs_unopenable_type(type)) {
 		gsh_free(myself->u.unopenable.name);
 		gsh_free(myself->u.unopenable.dir);
+	} else if (type == DIRECTORY) {
+		vfs_readdir_release(myself);
 	}
 
+	vfs_path_fd_release(myself);
+
 	LogDebug(COMPONENT_FSAL,
 		 "Releasing obj_hdl=%p, myself=%p",
 		 &myself->obj_handle, myself);
@@ -152,6 +154,9 @@ struct vfs_fsal_obj_handle *alloc_handle(int dirfd,
 	if (hdl->obj_handle.type == REGULAR_FILE) {
 		hdl->u.file.fd.fd = -1;	/* no open on this yet */
 		hdl->u.file.fd.openflags = FSAL_O_CLOSED;
+		hdl->u.file.dio_fd.fd = -1;
+		hdl->u.file.dio_fd.openflags = FSAL_O_CLOSED;
+		vfs_wg_init(&hdl->u.file.wg);
 	} else if (hdl->obj_handle.type == SYMBOLIC_LINK) {
 		ssize_t retlink;
 		size_t len = stat->st_size + 1;
@@ -198,6 +203,8 @@ struct vfs_fsal_obj_handle *alloc_handle(int dirfd,
 	return hdl;
 
  spcerr:
+	if (hdl->obj_handle.type == REGULAR_FILE)
+		vfs_wg_fini(&hdl->u.file.wg);
 	free_vfs_fsal_obj_handle(&hdl);
 	return NULL;
 }
@@ -250,7 +257,8 @@ out:
 
 static fsal_status_t check_filesystem(struct vfs_fsal_obj_handle *parent_hdl,
 				      int dirfd, const char *path,
-				      struct stat *stat,
+				      attrmask_t request,
+				      struct stat *stat, attrmask_t *valid,
 				      struct fsal_filesystem **filesystem,
 				      bool *xfsal)
 {
@@ -261,7 +269,7 @@ static fsal_status_t check_filesystem(struct vfs_fsal_obj_handle *parent_hdl,
 	struct vfs_fsal_export *myexp_hdl =
 	    container_of(op_ctx->fsal_export, struct vfs_fsal_export, export);
 
-	retval = fstatat(dirfd, path, stat, AT_SYMLINK_NOFOLLOW);
+	retval = vfs_stat_name(myexp_hdl, dirfd, path, request, stat, valid);
 
 	if (retval < 0) {
 		retval = errno;
@@ -364,14 +372,65 @@ out:
 	return status;
 }
 
-static fsal_status_t lookup_with_fd(struct vfs_fsal_obj_handle *parent_hdl,
-				    int dirfd, const char *path,
-				    struct fsal_obj_handle **handle,
-				    struct attrlist *attrs_out)
+/* Make the handle of a name, once its filesystem and handle are known */
+static fsal_status_t make_handle(struct vfs_fsal_obj_handle *parent_hdl,
+				 int dirfd, const char *path,
+				 struct stat *stat, attrmask_t valid,
+				 struct fsal_filesystem *fs,
+				 vfs_file_handle_t *fh,
+				 struct fsal_obj_handle **handle,
+				 struct attrlist *attrs_out)
 {
 	struct vfs_fsal_obj_handle *hdl;
+	fsal_status_t status;
+
+	/* allocate an obj_handle and fill it up */
+	hdl = alloc_handle(dirfd, fh, fs, stat, parent_hdl->handle, path,
+			   op_ctx->fsal_export);
+
+	if (hdl == NULL) {
+		status = fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+		return status;
+	}
+
+	if (attrs_out != NULL) {
+		attrs_out->valid_mask |= valid;
+		posix2fsal_attributes(stat, attrs_out);
+	}
+
+	hdl->obj_handle.fsid = hdl->obj_handle.fs->fsid;
+
+	/* if it is a directory and the sticky bit is set
+	 * let's look for referral information
+	 */
+
+	if (attrs_out != NULL &&
+	    hdl->obj_handle.obj_ops->is_referral(&hdl->obj_handle, attrs_out,
+		false) &&
+	    hdl->obj_handle.fs->private_data != NULL &&
+	    hdl->sub_ops->getattrs) {
+
+		status = populate_fs_locations(hdl, attrs_out);
+		if (FSAL_IS_ERROR(status)) {
+			LogEvent(COMPONENT_FSAL, "Could not get the referral "
+				 "locations the path: %d, %s", dirfd, path);
+			free_vfs_fsal_obj_handle(&hdl);
+			return status;
+		}
+	}
+
+	*handle = &hdl->obj_handle;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+fsal_status_t lookup_with_fd(struct vfs_fsal_obj_handle *parent_hdl,
+			     int dirfd, const char *path,
+			     struct fsal_obj_handle **handle,
+			     struct attrlist *attrs_out)
+{
 	int retval;
 	struct stat stat;
+	attrmask_t valid;
 	vfs_file_handle_t *fh = NULL;
 	struct fsal_filesystem *fs;
 	bool xfsal = false;
@@ -379,7 +438,10 @@ static fsal_status_t lookup_with_fd(struct vfs_fsal_obj_handle *parent_hdl,
 
 	vfs_alloc_handle(fh);
 
-	status = check_filesystem(parent_hdl, dirfd, path, &stat, &fs, &xfsal);
+	status = check_filesystem(parent_hdl, dirfd, path,
+				  attrs_out != NULL ? attrs_out->request_mask
+						    : 0,
+				  &stat, &valid, &fs, &xfsal);
 
 	if (FSAL_IS_ERROR(status))
 		return status;
@@ -423,42 +485,36 @@ static fsal_status_t lookup_with_fd(struct vfs_fsal_obj_handle *parent_hdl,
 		}
 	}
 
-	/* allocate an obj_handle and fill it up */
-	hdl = alloc_handle(dirfd, fh, fs, &stat, parent_hdl->handle, path,
-			   op_ctx->fsal_export);
-
-	if (hdl == NULL) {
-		status = fsalstat(ERR_FSAL_NOMEM, ENOMEM);
-		return status;
-	}
-
-	if (attrs_out != NULL) {
-		posix2fsal_attributes_all(&stat, attrs_out);
-	}
-
-	hdl->obj_handle.fsid = hdl->obj_handle.fs->fsid;
-
-	/* if it is a directory and the sticky bit is set
-	 * let's look for referral information
-	 */
-
-	if (attrs_out != NULL &&
-	    hdl->obj_handle.obj_ops->is_referral(&hdl->obj_handle, attrs_out,
-		false) &&
-	    hdl->obj_handle.fs->private_data != NULL &&
-	    hdl->sub_ops->getattrs) {
-
-		status = populate_fs_locations(hdl, attrs_out);
-		if (FSAL_IS_ERROR(status)) {
-			LogEvent(COMPONENT_FSAL, "Could not get the referral "
-				 "locations the path: %d, %s", dirfd, path);
-			free_vfs_fsal_obj_handle(&hdl);
-			return status;
-		}
-	}
+	return make_handle(parent_hdl, dirfd, path, &stat, valid, fs, fh,
+			   handle, attrs_out);
+}
 
-	*handle = &hdl->obj_handle;
-	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+/**
+ * @brief Make the handle of a name already stat'ed
+ *
+ * For names on the same filesystem as their directory, whose stat and
+ * handle were fetched ahead of time by readdir.
+ *
+ * @param[in]  parent_hdl	Directory
+ * @param[in]  dirfd		Open fd of the directory
+ * @param[in]  path		Name in the directory
+ * @param[in]  stat		Result of vfs_stat_name on the name
+ * @param[in]  valid		POSIX attributes filled in @a stat
+ * @param[in]  fh		Handle of the name
+ * @param[out] handle		New handle
+ * @param[out] attrs_out	Attributes, may be NULL
+ *
+ * @return FSAL status.
+ */
+fsal_status_t lookup_with_stat(struct vfs_fsal_obj_handle *parent_hdl,
+			       int dirfd, const char *path,
+			       struct stat *stat, attrmask_t valid,
+			       vfs_file_handle_t *fh,
+			       struct fsal_obj_handle **handle,
+			       struct attrlist *attrs_out)
+{
+	return make_handle(parent_hdl, dirfd, path, stat, valid,
+			   parent_hdl->obj_handle.fs, fh, handle, attrs_out);
 }
 
 /* handle methods
@@ -1255,8 +1311,6 @@ static fsal_status_t linkfile(struct fsal_obj_handle *obj_hdl,
  */
 #ifndef HAS_DOFF
 #define BUF_SIZE sizeof(struct dirent)
-#else
-#define BUF_SIZE 1024
 #endif
 /**
  * read_dirents
@@ -1275,24 +1329,24 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 				  bool *eof)
 {
 	struct vfs_fsal_obj_handle *myself;
-	int dirfd;
 	fsal_status_t status = {0, 0};
 	int retval = 0;
+#ifndef HAS_DOFF
+	int dirfd;
 	off_t seekloc = 0;
 	off_t baseloc = 0;
 	unsigned int bpos;
 	int nread;
 	struct vfs_dirent dentry, *dentryp = &dentry;
 	char buf[BUF_SIZE];
-#ifndef HAS_DOFF
 	int nreadent;
 	char entbuf[sizeof(struct dirent)];
 	off_t rewindloc = 0;
 	off_t entloc = 0;
-#endif
 
 	if (whence != NULL)
 		seekloc = (off_t) *whence;
+#endif
 	myself = container_of(dir_hdl, struct vfs_fsal_obj_handle, obj_handle);
 	if (dir_hdl->fsal != dir_hdl->fs->fsal) {
 		LogDebug(COMPONENT_FSAL,
@@ -1305,6 +1359,10 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 		status = posix2fsal_status(retval);
 		goto out;
 	}
+#ifdef HAS_DOFF
+	status = vfs_readdir_bulk(myself, whence, dir_state, cb, attrmask,
+				  eof);
+#else
 	dirfd = vfs_fsal_open(myself, O_RDONLY | O_DIRECTORY, &status.major);
 	if (dirfd < 0) {
 		retval = -dirfd;
@@ -1328,7 +1386,6 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 		}
 		if (nread == 0)
 			break;
-#ifndef HAS_DOFF
 		/*
 		 * Very inefficient workaround to retrieve directory offsets.
 		 * We rewind dirfd's to its previous offset in order read the
@@ -1340,7 +1397,6 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 			status = posix2fsal_status(retval);
 			goto done;
 		}
-#endif
 		for (bpos = 0; bpos < nread;) {
 			struct fsal_obj_handle *hdl;
 			struct attrlist attrs;
@@ -1349,7 +1405,6 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 			if (!to_vfs_dirent(buf, bpos, dentryp, baseloc))
 				goto skip;
 
-#ifndef HAS_DOFF
 			/* Re-read the entry and fetch its offset. */
 			nreadent = vfs_readents(dirfd, entbuf,
 						dentryp->vd_reclen, &entloc);
@@ -1365,7 +1420,6 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 				goto done;
 			}
 			dentryp->vd_offset = entloc;
-#endif
 
 			if (strcmp(dentryp->vd_name, ".") == 0
 			    || strcmp(dentryp->vd_name, "..") == 0)
@@ -1398,6 +1452,7 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 	*eof = true;
  done:
 	close(dirfd);
+#endif
 
  out:
 	return status;
@@ -1413,6 +1468,8 @@ static fsal_status_t renamefile(struct fsal_obj_handle *obj_hdl,
 	int oldfd = -1, newfd = -1;
 	fsal_errors_t fsal_error = ERR_FSAL_NO_ERROR;
 	int retval = 0;
+	vfs_file_handle_t *target_fh = NULL;
+	struct stat st;
 
 	olddir =
 	    container_of(olddir_hdl, struct vfs_fsal_obj_handle, obj_handle);
@@ -1451,6 +1508,17 @@ static fsal_status_t renamefile(struct fsal_obj_handle *obj_hdl,
 		retval = -newfd;
 		goto out;
 	}
+	/* The last link of a file or directory replaced by the rename
+	 * must not stay open in the path fd cache.
+	 */
+	if (fstatat(newfd, new_name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+	    (S_ISDIR(st.st_mode) ||
+	     (S_ISREG(st.st_mode) && st.st_nlink == 1))) {
+		vfs_alloc_handle(target_fh);
+		if (vfs_name_to_handle(newfd, newdir_hdl->fs, new_name,
+				       target_fh) < 0)
+			target_fh = NULL;
+	}
 	/* Become the user because we are creating/removing objects
 	 * in these dirs which messes with quotas and perms.
 	 */
@@ -1481,6 +1549,9 @@ static fsal_status_t renamefile(struct fsal_obj_handle *obj_hdl,
 		}
 
 		vfs_restore_ganesha_credentials(obj_hdl->fsal);
+
+		if (target_fh != NULL)
+			vfs_path_fd_forget(target_fh);
 	}
 
  out:
@@ -1670,6 +1741,11 @@ static fsal_status_t file_unlink(struct fsal_obj_handle *dir_hdl,
 			fsal_error = ERR_FSAL_STALE;
 		else
 			fsal_error = posix2fsal_error(retval);
+	} else {
+		/* Don't keep the unlinked inode around */
+		vfs_path_fd_release(container_of(obj_hdl,
+						 struct vfs_fsal_obj_handle,
+						 obj_handle));
 	}
 	vfs_restore_ganesha_credentials(dir_hdl->fsal);
 
@@ -1747,9 +1823,12 @@ static void release(struct fsal_obj_handle *obj_hdl)
 		PTHREAD_RWLOCK_wrlock(&obj_hdl->obj_lock);
 
 		st = vfs_close_my_fd(&myself->u.file.fd);
+		(void) vfs_close_my_fd(&myself->u.file.dio_fd);
 
 		PTHREAD_RWLOCK_unlock(&obj_hdl->obj_lock);
 
+		vfs_wg_fini(&myself->u.file.wg);
+
 		if (FSAL_IS_ERROR(st)) {
 			LogCrit(COMPONENT_FSAL,
 				"Could not close hdl 0x%p, error %s(%d)",
@@ -1780,6 +1859,10 @@ void vfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->close = vfs_close;
 #ifdef FALLOC_FL_PUNCH_HOLE
 	ops->fallocate = vfs_fallocate;
+#endif
+	ops->copy = vfs_copy;
+#ifdef FICLONERANGE
+	ops->clone = vfs_clone;
 #endif
 	ops->handle_to_wire = handle_to_wire;
 	ops->handle_to_key = handle_to_key;
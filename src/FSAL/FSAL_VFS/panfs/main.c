@@ -78,7 +78,8 @@ static struct vfs_fsal_module PANFS = {
 			.expire_time_parent = -1,
 		}
 	},
-	.only_one_user = false
+	.only_one_user = false,
+	.write_gather = true
 };
 
 static struct config_item panfs_params[] = {
@@ -98,6 +99,8 @@ static struct config_item panfs_params[] = {
 		       module.fs_info.auth_exportpath_xdev),
 	CONF_ITEM_BOOL("only_one_user", false, vfs_fsal_module,
 		       only_one_user),
+	CONF_ITEM_BOOL("write_gather", true, vfs_fsal_module,
+		       write_gather),
 	CONFIG_EOL
 };
 
@@ -55,6 +55,13 @@ struct config_item export_params[] = {
 	CONF_ITEM_TOKEN("fsid_type", FSID_NO_TYPE,
 			fsid_types,
 			panfs_fsal_export, vfs_export.fsid_type),
+	CONF_ITEM_TOKEN("io_mode", VFS_IO_BUFFERED,
+			vfs_io_modes,
+			panfs_fsal_export, vfs_export.io_mode),
+	CONF_ITEM_BOOL("statx_dont_sync", false,
+		       panfs_fsal_export, vfs_export.statx_dont_sync),
+	CONF_ITEM_BOOL("share_fds", true,
+		       panfs_fsal_export, vfs_export.share_fds),
 	CONFIG_EOL
 };
 
@@ -0,0 +1,384 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* path_fd.c
+ * VFS cache of O_PATH fds for recently used handles
+ *
+ * open_by_handle_at has to reconnect the dentry of a handle that is not in
+ * the dcache, walking up to the root of the filesystem.  Directories and
+ * regular files that were opened recently keep an O_PATH fd, and later
+ * opens of the handle are made from it instead: a dup for the O_PATH
+ * opens used as the base of fstatat/openat, a reopen through /proc for
+ * the others.
+ *
+ * The fds are counted in open_fd_count, so they weigh on the mdcache fd
+ * LRU like any other, and are dropped when it closes the file, when the
+ * handle is released, when it is unlinked or when a rename replaces it.
+ * The least recently used one is closed when the cache is full.
+ *
+ * An fd still reaches an object removed by another client of the
+ * filesystem, so a cached fd whose object has no links left is dropped
+ * instead of used, and the open goes through open_by_handle_at, which
+ * then fails with ESTALE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "gsh_list.h"
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "fsal_handle_syscalls.h"
+#include "vfs_methods.h"
+
+static struct {
+	pthread_mutex_t mutex;
+	struct glist_head lru;	/*< Most recently used first */
+	uint32_t max_fds;
+	uint32_t fds;
+	bool no_proc;		/*< /proc can not reopen fds */
+	uint64_t hits;		/*< Opens that avoided open_by_handle_at */
+	uint64_t misses;
+	uint64_t evictions;
+} vfs_pfd;
+
+/**
+ * @brief Set up the path fd cache
+ *
+ * @param[in] vfs_module	Module configuration
+ */
+void vfs_path_fd_init(struct vfs_fsal_module *vfs_module)
+{
+#ifdef LINUX
+	if (vfs_pfd.max_fds != 0)
+		return;
+
+	PTHREAD_MUTEX_init(&vfs_pfd.mutex, NULL);
+	glist_init(&vfs_pfd.lru);
+	vfs_pfd.max_fds = vfs_module->path_fds;
+#endif
+}
+
+/**
+ * @brief Log the path fd cache counters
+ *
+ * All handles, and their fds, are gone by the time the module is
+ * unloaded.
+ */
+void vfs_path_fd_shutdown(void)
+{
+	if (vfs_pfd.max_fds == 0)
+		return;
+
+	LogEvent(COMPONENT_FSAL,
+		 "VFS path fds: %"PRIu64" reconnects avoided, %"PRIu64
+		 " misses, %"PRIu64" evictions",
+		 atomic_fetch_uint64_t(&vfs_pfd.hits),
+		 atomic_fetch_uint64_t(&vfs_pfd.misses),
+		 atomic_fetch_uint64_t(&vfs_pfd.evictions));
+
+	PTHREAD_MUTEX_destroy(&vfs_pfd.mutex);
+	vfs_pfd.max_fds = 0;
+}
+
+static void vfs_path_fd_close(int fd)
+{
+	ssize_t count;
+
+	close(fd);
+
+	count = atomic_dec_size_t(&open_fd_count);
+	if (count < 0) {
+		LogCrit(COMPONENT_FSAL,
+			"open_fd_count is negative: %zd", count);
+	}
+}
+
+/**
+ * @brief Take the cached fd of a handle
+ *
+ * The fd stays open until vfs_path_fd_put, it is never evicted while used.
+ * Must be called with the mutex held.
+ *
+ * @return The fd, or -1 if the handle has none.
+ */
+static int vfs_path_fd_get(struct vfs_fsal_obj_handle *hdl)
+{
+	if (glist_null(&hdl->path_fd_lru))
+		return -1;
+
+	glist_del(&hdl->path_fd_lru);
+	glist_add(&vfs_pfd.lru, &hdl->path_fd_lru);
+	hdl->path_fd_users++;
+
+	return hdl->path_fd;
+}
+
+static void vfs_path_fd_put(struct vfs_fsal_obj_handle *hdl)
+{
+	PTHREAD_MUTEX_lock(&vfs_pfd.mutex);
+	hdl->path_fd_users--;
+	PTHREAD_MUTEX_unlock(&vfs_pfd.mutex);
+}
+
+/**
+ * @brief Cache a new fd on a handle, making room for it
+ *
+ * Must be called with the mutex held.
+ *
+ * @param[in]  hdl	Handle the fd was opened for
+ * @param[in]  fd	O_PATH fd of the handle
+ * @param[out] victim	fd evicted, to be closed once unlocked, or -1
+ *
+ * @return The fd to use, with a user taken, or -1 if there is no room.
+ */
+static int vfs_path_fd_insert(struct vfs_fsal_obj_handle *hdl, int fd,
+			      int *victim)
+{
+	struct vfs_fsal_obj_handle *old;
+	struct glist_head *node;
+
+	*victim = -1;
+
+	/* Somebody else opened it meanwhile */
+	if (!glist_null(&hdl->path_fd_lru))
+		return vfs_path_fd_get(hdl);
+
+	if (vfs_pfd.fds >= vfs_pfd.max_fds) {
+		for (node = vfs_pfd.lru.prev; node != &vfs_pfd.lru;
+		     node = node->prev) {
+			old = glist_entry(node, struct vfs_fsal_obj_handle,
+					  path_fd_lru);
+			if (old->path_fd_users == 0)
+				break;
+		}
+
+		if (node == &vfs_pfd.lru)
+			return -1;
+
+		glist_del(&old->path_fd_lru);
+		*victim = old->path_fd;
+		vfs_pfd.fds--;
+		(void)atomic_inc_uint64_t(&vfs_pfd.evictions);
+	}
+
+	hdl->path_fd = fd;
+	hdl->path_fd_users = 1;
+	glist_add(&vfs_pfd.lru, &hdl->path_fd_lru);
+	vfs_pfd.fds++;
+	(void)atomic_inc_size_t(&open_fd_count);
+
+	return fd;
+}
+
+/* Whether the object of a cached fd was removed since it was opened */
+static bool vfs_path_fd_unlinked(int path_fd)
+{
+	struct stat st;
+
+	return fstat(path_fd, &st) < 0 || st.st_nlink == 0;
+}
+
+/**
+ * @brief Open a new fd from a cached O_PATH fd
+ *
+ * @return The new fd, or -1 with errno set.
+ */
+static int vfs_path_fd_reopen(int path_fd, int openflags)
+{
+	char path[32];
+
+	if (openflags & O_PATH)
+		return dup(path_fd);
+
+	/* Only files and directories are cached, following the /proc link
+	 * is what we want here.
+	 */
+	(void)snprintf(path, sizeof(path), "/proc/self/fd/%d", path_fd);
+	return open(path, openflags & ~O_NOFOLLOW);
+}
+
+/**
+ * @brief Open a VFS object by handle, through the path fd cache
+ *
+ * @param[in]  hdl		Object to open
+ * @param[in]  openflags	open(2) flags
+ * @param[out] fsal_error	Error, if any
+ *
+ * @return The fd, or -errno as vfs_open_by_handle.
+ */
+int vfs_path_fd_open(struct vfs_fsal_obj_handle *hdl, int openflags,
+		     fsal_errors_t *fsal_error)
+{
+	struct vfs_filesystem *vfs_fs = hdl->obj_handle.fs->private_data;
+	object_file_type_t type = hdl->obj_handle.type;
+	int path_fd, victim, fd;
+
+	if (vfs_pfd.max_fds == 0 ||
+	    (type != REGULAR_FILE && type != DIRECTORY) ||
+	    ((openflags & O_PATH) == 0 && vfs_pfd.no_proc))
+		return vfs_open_by_handle(vfs_fs, hdl->handle, openflags,
+					  fsal_error);
+
+	PTHREAD_MUTEX_lock(&vfs_pfd.mutex);
+	path_fd = vfs_path_fd_get(hdl);
+	PTHREAD_MUTEX_unlock(&vfs_pfd.mutex);
+
+	if (path_fd >= 0 && vfs_path_fd_unlinked(path_fd)) {
+		LogFullDebug(COMPONENT_FSAL,
+			     "Object of path fd %d is gone", path_fd);
+		vfs_path_fd_put(hdl);
+		vfs_path_fd_release(hdl);
+		path_fd = -1;
+	}
+
+	if (path_fd >= 0) {
+		(void)atomic_inc_uint64_t(&vfs_pfd.hits);
+	} else {
+		(void)atomic_inc_uint64_t(&vfs_pfd.misses);
+
+		fd = vfs_open_by_handle(vfs_fs, hdl->handle,
+					O_PATH | O_NOACCESS, fsal_error);
+		if (fd < 0)
+			return fd;
+
+		PTHREAD_MUTEX_lock(&vfs_pfd.mutex);
+		path_fd = vfs_path_fd_insert(hdl, fd, &victim);
+		PTHREAD_MUTEX_unlock(&vfs_pfd.mutex);
+
+		if (victim >= 0)
+			vfs_path_fd_close(victim);
+
+		if (path_fd != fd) {
+			/* Lost a race, or every cached fd is in use */
+			close(fd);
+			if (path_fd < 0)
+				return vfs_open_by_handle(vfs_fs, hdl->handle,
+							  openflags,
+							  fsal_error);
+		}
+	}
+
+	fd = vfs_path_fd_reopen(path_fd, openflags);
+	if (fd < 0)
+		fd = -errno;
+
+	vfs_path_fd_put(hdl);
+
+	if (fd == -ENOENT) {
+		/* The fd is open, only a missing /proc gets here */
+		LogInfo(COMPONENT_FSAL,
+			"Can not reopen fds through /proc, VFS path fds only used for O_PATH opens");
+		vfs_pfd.no_proc = true;
+		return vfs_open_by_handle(vfs_fs, hdl->handle, openflags,
+					  fsal_error);
+	}
+
+	if (fd < 0) {
+		*fsal_error = posix2fsal_error(-fd);
+		LogDebug(COMPONENT_FSAL, "Failed with %s openflags 0x%08x",
+			 strerror(-fd), openflags);
+	} else {
+		LogFullDebug(COMPONENT_FSAL, "Opened fd %d from path fd %d",
+			     fd, path_fd);
+	}
+
+	return fd;
+}
+
+/**
+ * @brief Drop the cached fd of a handle
+ *
+ * An fd that is being reopened is left alone, it will go with the handle
+ * or be evicted.
+ *
+ * @param[in] hdl	Handle closed, unlinked or being freed
+ */
+void vfs_path_fd_release(struct vfs_fsal_obj_handle *hdl)
+{
+	int fd = -1;
+
+	if (vfs_pfd.max_fds == 0)
+		return;
+
+	PTHREAD_MUTEX_lock(&vfs_pfd.mutex);
+
+	if (!glist_null(&hdl->path_fd_lru) && hdl->path_fd_users == 0) {
+		glist_del(&hdl->path_fd_lru);
+		fd = hdl->path_fd;
+		vfs_pfd.fds--;
+	}
+
+	PTHREAD_MUTEX_unlock(&vfs_pfd.mutex);
+
+	if (fd >= 0) {
+		LogFullDebug(COMPONENT_FSAL, "Closing path fd %d", fd);
+		vfs_path_fd_close(fd);
+	}
+}
+
+/**
+ * @brief Drop the cached fd of an object known by its file handle
+ *
+ * For an object removed without its handle at hand, such as the target
+ * of a rename.  Walks the cache.
+ *
+ * @param[in] fh	File handle of the object
+ */
+void vfs_path_fd_forget(const vfs_file_handle_t *fh)
+{
+	struct vfs_fsal_obj_handle *hdl;
+	struct glist_head *node;
+	int fd = -1;
+
+	if (vfs_pfd.max_fds == 0)
+		return;
+
+	PTHREAD_MUTEX_lock(&vfs_pfd.mutex);
+
+	glist_for_each(node, &vfs_pfd.lru) {
+		hdl = glist_entry(node, struct vfs_fsal_obj_handle,
+				  path_fd_lru);
+
+		if (hdl->handle->handle_len != fh->handle_len ||
+		    memcmp(hdl->handle->handle_data, fh->handle_data,
+			   fh->handle_len) != 0)
+			continue;
+
+		if (hdl->path_fd_users == 0) {
+			glist_del(&hdl->path_fd_lru);
+			fd = hdl->path_fd;
+			vfs_pfd.fds--;
+		}
+		break;
+	}
+
+	PTHREAD_MUTEX_unlock(&vfs_pfd.mutex);
+
+	if (fd >= 0) {
+		LogFullDebug(COMPONENT_FSAL, "Closing path fd %d", fd);
+		vfs_path_fd_close(fd);
+	}
+}
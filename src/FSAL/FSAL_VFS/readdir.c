@@ -0,0 +1,596 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* readdir.c
+ * VFS bulk readdir
+ *
+ * A directory being read keeps an open fd and a large getdents buffer,
+ * its stream, between calls.  When a call starts at the cookie where the
+ * previous one stopped, as the chunked readdir of MDCACHE does, the
+ * stream carries on from the buffer without reopening or seeking.  Any
+ * other cookie seeks the stream.  A limited number of streams are kept,
+ * each on its directory's handle until the handle is released, their fds
+ * are counted in open_fd_count while they are kept.
+ *
+ * The buffer is only good while the directory is as it was when it was
+ * filled.  The directory's mtime and ctime are noted before each fill,
+ * if either has moved when the stream is picked up again the buffer is
+ * dropped and the stream seeked to its cookie.
+ *
+ * Names are taken from the buffer in batches.  The stat and
+ * name_to_handle_at of a batch are done by a pool of threads, together
+ * with the calling thread, then the handles are made and handed to the
+ * callback in directory order by the caller.  Names on another
+ * filesystem, or that failed, go through the usual lookup.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "fridgethr.h"
+#include "vfs_methods.h"
+#include "os/subr.h"
+
+/** Size of the getdents buffer of a stream */
+#define VFS_RD_BUF_SIZE (64 * 1024)
+
+/** Most names stat'ed in one batch */
+#define VFS_RD_BATCH 128
+
+/** Fewest names worth waking up the pool for */
+#define VFS_RD_MIN_PARALLEL 16
+
+struct vfs_rd_entry {
+	const char *name;	/*< In the stream's buffer */
+	off_t cookie;
+	unsigned int next;	/*< Buffer position after the entry */
+	int error;		/*< 0 if stat and fh are good */
+	struct stat stat;
+	attrmask_t valid;	/*< POSIX attributes filled in stat */
+	vfs_file_handle_t fh;
+};
+
+struct vfs_rd_batch {
+	int dirfd;
+	fsal_dev_t dev;
+	struct fsal_filesystem *fs;
+	struct vfs_fsal_export *exp;
+	attrmask_t request;	/*< Attributes asked for */
+	uint32_t count;
+	uint32_t next;		/*< Next entry to prefetch */
+	uint32_t workers;	/*< Pool threads still on the batch */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct vfs_rd_entry ent[VFS_RD_BATCH];
+};
+
+struct vfs_dir_stream {
+	int fd;
+	off_t cookie;		/*< Cookie of the last name handed out */
+	off_t seekloc;
+	int nread;		/*< Bytes in buf */
+	unsigned int bpos;	/*< Next entry in buf */
+	bool eof;		/*< getdents returned nothing */
+	struct timespec mtime;	/*< Of the directory before buf was read */
+	struct timespec ctime;
+	struct vfs_rd_batch batch;
+	char buf[VFS_RD_BUF_SIZE];
+};
+
+static struct {
+	struct fridgethr *fridge;
+	uint32_t threads;
+	uint32_t max_streams;
+	uint32_t streams;	/*< Streams kept on handles */
+} vfs_rd;
+
+/**
+ * @brief Start the readdir thread pool
+ *
+ * @param[in] vfs_module	Module configuration
+ */
+void vfs_readdir_init(struct vfs_fsal_module *vfs_module)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	vfs_rd.max_streams = vfs_module->readdir_streams;
+	vfs_rd.threads = vfs_module->readdir_threads;
+
+	if (vfs_rd.threads == 0 || vfs_rd.fridge != NULL)
+		return;
+
+	memset(&frp, 0, sizeof(frp));
+	frp.thr_max = vfs_rd.threads;
+	frp.thr_min = 0;
+	frp.thread_delay = 60;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_fail;
+
+	rc = fridgethr_init(&vfs_rd.fridge, "VFS_RD", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_FSAL,
+			 "Unable to initialize VFS_RD fridge, error code %d.",
+			 rc);
+		vfs_rd.fridge = NULL;
+		vfs_rd.threads = 0;
+	}
+}
+
+/**
+ * @brief Stop the readdir thread pool
+ */
+void vfs_readdir_shutdown(void)
+{
+	int rc;
+
+	if (vfs_rd.fridge == NULL)
+		return;
+
+	rc = fridgethr_sync_command(vfs_rd.fridge, fridgethr_comm_stop, 120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_FSAL,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(vfs_rd.fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_FSAL,
+			 "Failed shutting down VFS_RD threads: %d", rc);
+	}
+
+	fridgethr_destroy(vfs_rd.fridge);
+	vfs_rd.fridge = NULL;
+}
+
+static void vfs_rd_stream_free(struct vfs_dir_stream *stream)
+{
+	if (stream->fd >= 0)
+		close(stream->fd);
+
+	PTHREAD_MUTEX_destroy(&stream->batch.mutex);
+	PTHREAD_COND_destroy(&stream->batch.cond);
+	gsh_free(stream);
+}
+
+/* A stream kept on a handle, or taken back, holds an fd for MDCACHE */
+static void vfs_rd_stream_kept(bool kept)
+{
+	ssize_t count;
+
+	if (kept) {
+		(void)atomic_inc_size_t(&open_fd_count);
+		return;
+	}
+
+	count = atomic_dec_size_t(&open_fd_count);
+	if (count < 0) {
+		LogCrit(COMPONENT_FSAL,
+			"open_fd_count is negative: %zd", count);
+	}
+}
+
+/**
+ * @brief Drop the stream kept on a directory
+ *
+ * @param[in] myself	Directory handle being freed
+ */
+void vfs_readdir_release(struct vfs_fsal_obj_handle *myself)
+{
+	struct vfs_dir_stream *stream = myself->u.dir.stream;
+
+	if (stream == NULL)
+		return;
+
+	myself->u.dir.stream = NULL;
+	(void)atomic_dec_uint32_t(&vfs_rd.streams);
+	vfs_rd_stream_kept(false);
+	vfs_rd_stream_free(stream);
+}
+
+/* Take the directory's stream, if nobody else is using it */
+static struct vfs_dir_stream *vfs_rd_stream_get(struct vfs_fsal_obj_handle
+						*myself)
+{
+	struct vfs_dir_stream *stream;
+
+	PTHREAD_RWLOCK_wrlock(&myself->obj_handle.obj_lock);
+	stream = myself->u.dir.stream;
+	myself->u.dir.stream = NULL;
+	PTHREAD_RWLOCK_unlock(&myself->obj_handle.obj_lock);
+
+	if (stream != NULL) {
+		(void)atomic_dec_uint32_t(&vfs_rd.streams);
+		vfs_rd_stream_kept(false);
+	}
+
+	return stream;
+}
+
+/* Keep a stream on its directory for the next call, or free it */
+static void vfs_rd_stream_put(struct vfs_fsal_obj_handle *myself,
+			      struct vfs_dir_stream *stream)
+{
+	if (stream->eof)
+		goto free;
+
+	if (atomic_inc_uint32_t(&vfs_rd.streams) <= vfs_rd.max_streams) {
+		/* Counted before it is visible, whoever takes it uncounts */
+		vfs_rd_stream_kept(true);
+
+		PTHREAD_RWLOCK_wrlock(&myself->obj_handle.obj_lock);
+		if (myself->u.dir.stream == NULL) {
+			myself->u.dir.stream = stream;
+			stream = NULL;
+		}
+		PTHREAD_RWLOCK_unlock(&myself->obj_handle.obj_lock);
+
+		if (stream == NULL)
+			return;
+
+		vfs_rd_stream_kept(false);
+	}
+
+	(void)atomic_dec_uint32_t(&vfs_rd.streams);
+ free:
+	vfs_rd_stream_free(stream);
+}
+
+static struct vfs_dir_stream *vfs_rd_stream_open(struct vfs_fsal_obj_handle
+						 *myself,
+						 fsal_status_t *status)
+{
+	struct vfs_dir_stream *stream;
+	int fd;
+
+	fd = vfs_fsal_open(myself, O_RDONLY | O_DIRECTORY, &status->major);
+	if (fd < 0) {
+		*status = posix2fsal_status(-fd);
+		return NULL;
+	}
+
+	stream = gsh_malloc(sizeof(*stream));
+	stream->fd = fd;
+	stream->cookie = 0;
+	stream->seekloc = 0;
+	stream->nread = 0;
+	stream->bpos = 0;
+	stream->eof = false;
+	memset(&stream->mtime, 0, sizeof(stream->mtime));
+	memset(&stream->ctime, 0, sizeof(stream->ctime));
+	PTHREAD_MUTEX_init(&stream->batch.mutex, NULL);
+	PTHREAD_COND_init(&stream->batch.cond, NULL);
+
+	return stream;
+}
+
+/* Whether the directory changed since the stream's buffer was read */
+static bool vfs_rd_stream_stale(struct vfs_dir_stream *stream)
+{
+	struct stat st;
+
+	if (fstat(stream->fd, &st) < 0)
+		return true;
+
+	return st.st_mtim.tv_sec != stream->mtime.tv_sec ||
+	       st.st_mtim.tv_nsec != stream->mtime.tv_nsec ||
+	       st.st_ctim.tv_sec != stream->ctime.tv_sec ||
+	       st.st_ctim.tv_nsec != stream->ctime.tv_nsec;
+}
+
+/* Position a stream at a cookie, unless it is already there and its
+ * buffer still shows the directory as it is.
+ */
+static int vfs_rd_stream_seek(struct vfs_dir_stream *stream, off_t cookie)
+{
+	if (stream->cookie == cookie &&
+	    ((stream->nread != 0 && !vfs_rd_stream_stale(stream)) ||
+	     (cookie == 0 && stream->nread == 0 && !stream->eof)))
+		return 0;
+
+	stream->seekloc = lseek(stream->fd, cookie, SEEK_SET);
+	if (stream->seekloc < 0)
+		return errno;
+
+	stream->cookie = cookie;
+	stream->nread = 0;
+	stream->bpos = 0;
+	stream->eof = false;
+
+	return 0;
+}
+
+static void vfs_rd_prefetch(struct vfs_rd_batch *batch, uint32_t i)
+{
+	struct vfs_rd_entry *ent = &batch->ent[i];
+	fsal_dev_t dev;
+
+	if (ent->error == -1)
+		return;
+
+	if (vfs_stat_name(batch->exp, batch->dirfd, ent->name, batch->request,
+			  &ent->stat, &ent->valid) < 0) {
+		ent->error = errno;
+		return;
+	}
+
+	dev = posix2fsal_devt(ent->stat.st_dev);
+	if (dev.major != batch->dev.major || dev.minor != batch->dev.minor) {
+		/* Let lookup find or claim the filesystem */
+		ent->error = EXDEV;
+		return;
+	}
+
+	memset(&ent->fh, 0, sizeof(ent->fh));
+	ent->fh.handle_len = VFS_HANDLE_LEN;
+
+	if (vfs_name_to_handle(batch->dirfd, batch->fs, ent->name,
+			       &ent->fh) < 0) {
+		ent->error = errno;
+		return;
+	}
+
+	ent->error = 0;
+}
+
+static void vfs_rd_prefetch_all(struct vfs_rd_batch *batch)
+{
+	uint32_t i;
+
+	while ((i = atomic_postinc_uint32_t(&batch->next)) < batch->count)
+		vfs_rd_prefetch(batch, i);
+}
+
+static void vfs_rd_worker(struct fridgethr_context *ctx)
+{
+	struct vfs_rd_batch *batch = ctx->arg;
+
+	vfs_rd_prefetch_all(batch);
+
+	PTHREAD_MUTEX_lock(&batch->mutex);
+	if (--batch->workers == 0)
+		pthread_cond_signal(&batch->cond);
+	PTHREAD_MUTEX_unlock(&batch->mutex);
+}
+
+/**
+ * @brief Stat the names of a batch and get their handles
+ *
+ * Pool threads that are idle help, none is waited for to start.
+ */
+static void vfs_rd_prefetch_batch(struct vfs_rd_batch *batch)
+{
+	uint32_t helpers = 0, i;
+
+	batch->next = 0;
+	batch->workers = 0;
+
+	if (vfs_rd.fridge != NULL && batch->count >= VFS_RD_MIN_PARALLEL) {
+		helpers = batch->count / VFS_RD_MIN_PARALLEL - 1;
+		if (helpers > vfs_rd.threads)
+			helpers = vfs_rd.threads;
+	}
+
+	for (i = 0; i < helpers; i++) {
+		PTHREAD_MUTEX_lock(&batch->mutex);
+		batch->workers++;
+		PTHREAD_MUTEX_unlock(&batch->mutex);
+
+		if (fridgethr_submit(vfs_rd.fridge, vfs_rd_worker,
+				     batch) != 0) {
+			/* No idle thread, do the rest ourselves */
+			PTHREAD_MUTEX_lock(&batch->mutex);
+			batch->workers--;
+			PTHREAD_MUTEX_unlock(&batch->mutex);
+			break;
+		}
+	}
+
+	vfs_rd_prefetch_all(batch);
+
+	PTHREAD_MUTEX_lock(&batch->mutex);
+	while (batch->workers != 0)
+		pthread_cond_wait(&batch->cond, &batch->mutex);
+	PTHREAD_MUTEX_unlock(&batch->mutex);
+}
+
+/* Fill a batch with the next names of the stream */
+static int vfs_rd_fill_batch(struct vfs_dir_stream *stream)
+{
+	struct vfs_rd_batch *batch = &stream->batch;
+	struct vfs_rd_entry *ent;
+	struct vfs_dirent dentry;
+	unsigned int bpos = stream->bpos;
+
+	batch->count = 0;
+
+	while (batch->count == 0) {
+		if (bpos >= stream->nread) {
+			struct stat st;
+
+			if (stream->eof)
+				break;
+
+			/* Before reading, so a change during the read shows */
+			if (fstat(stream->fd, &st) == 0) {
+				stream->mtime = st.st_mtim;
+				stream->ctime = st.st_ctim;
+			}
+
+			stream->nread = vfs_readents(stream->fd, stream->buf,
+						     VFS_RD_BUF_SIZE,
+						     &stream->seekloc);
+			if (stream->nread < 0) {
+				stream->nread = 0;
+				return errno;
+			}
+			stream->eof = stream->nread == 0;
+			stream->bpos = bpos = 0;
+			continue;
+		}
+
+		while (bpos < stream->nread && batch->count < VFS_RD_BATCH) {
+			if (!to_vfs_dirent(stream->buf, bpos, &dentry,
+					   stream->seekloc)) {
+				bpos += dentry.vd_reclen;
+				stream->bpos = bpos;
+				continue;
+			}
+
+			bpos += dentry.vd_reclen;
+
+			ent = &batch->ent[batch->count];
+			ent->name = dentry.vd_name;
+			ent->cookie = dentry.vd_offset;
+			ent->next = bpos;
+
+			if (strcmp(ent->name, ".") == 0 ||
+			    strcmp(ent->name, "..") == 0)
+				ent->error = -1;	/* must skip them */
+			else
+				ent->error = EAGAIN;	/* not fetched yet */
+
+			batch->count++;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Read a directory through its stream
+ *
+ * Same contract as the readdir method.
+ *
+ * @param[in]  myself		Directory to read
+ * @param[in]  whence		Where to start (next), NULL for the start
+ * @param[in]  dir_state	Pass thru of state to callback
+ * @param[in]  cb		Callback function
+ * @param[in]  attrmask		Attributes wanted
+ * @param[out] eof		Set at end of directory
+ *
+ * @return FSAL status.
+ */
+fsal_status_t vfs_readdir_bulk(struct vfs_fsal_obj_handle *myself,
+			       fsal_cookie_t *whence, void *dir_state,
+			       fsal_readdir_cb cb, attrmask_t attrmask,
+			       bool *eof)
+{
+	struct vfs_dir_stream *stream;
+	struct vfs_rd_batch *batch;
+	struct vfs_rd_entry *ent;
+	struct fsal_obj_handle *hdl;
+	struct attrlist attrs;
+	enum fsal_dir_result cb_rc;
+	fsal_status_t status = {0, 0};
+	off_t cookie = whence != NULL ? (off_t) *whence : 0;
+	uint32_t i;
+	int retval;
+
+	stream = vfs_rd_stream_get(myself);
+	if (stream == NULL) {
+		stream = vfs_rd_stream_open(myself, &status);
+		if (stream == NULL)
+			return status;
+	}
+
+	retval = vfs_rd_stream_seek(stream, cookie);
+	if (retval != 0) {
+		status = posix2fsal_status(retval);
+		goto fail;
+	}
+
+	batch = &stream->batch;
+	batch->dirfd = stream->fd;
+	batch->dev = myself->dev;
+	batch->fs = myself->obj_handle.fs;
+	batch->exp = EXPORT_VFS_FROM_FSAL(op_ctx->fsal_export);
+	batch->request = attrmask;
+
+	for (;;) {
+		retval = vfs_rd_fill_batch(stream);
+		if (retval != 0) {
+			status = posix2fsal_status(retval);
+			goto fail;
+		}
+
+		if (batch->count == 0) {
+			*eof = true;
+			break;
+		}
+
+		vfs_rd_prefetch_batch(batch);
+
+		for (i = 0; i < batch->count; i++) {
+			ent = &batch->ent[i];
+
+			if (ent->error == -1 || ent->error == ENOENT) {
+				/* '.', '..' or a name removed since */
+				goto skip;
+			}
+
+			fsal_prepare_attrs(&attrs, attrmask);
+
+			if (ent->error == 0)
+				status = lookup_with_stat(myself, stream->fd,
+							  ent->name,
+							  &ent->stat,
+							  ent->valid,
+							  &ent->fh, &hdl,
+							  &attrs);
+			else
+				status = lookup_with_fd(myself, stream->fd,
+							ent->name, &hdl,
+							&attrs);
+
+			if (FSAL_IS_ERROR(status)) {
+				fsal_release_attrs(&attrs);
+				goto fail;
+			}
+
+			/* callback to cache inode */
+			cb_rc = cb(ent->name, hdl, &attrs, dir_state,
+				   (fsal_cookie_t) ent->cookie);
+
+			fsal_release_attrs(&attrs);
+
+			stream->bpos = ent->next;
+			stream->cookie = ent->cookie;
+
+			/* Read ahead not supported by this FSAL. */
+			if (cb_rc >= DIR_READAHEAD)
+				goto out;
+			continue;
+ skip:
+			stream->bpos = ent->next;
+		}
+	}
+
+ out:
+	vfs_rd_stream_put(myself, stream);
+	return status;
+
+ fail:
+	/* Don't know where we are any more */
+	vfs_rd_stream_free(stream);
+	return status;
+}
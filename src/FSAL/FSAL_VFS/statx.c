@@ -0,0 +1,236 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* statx.c
+ * VFS attribute fetch limited to the attributes asked for
+ *
+ * getattrs, lookup and readdir only ask statx for the fields behind the
+ * requested attributes, so filesystems that have to go to a server or a
+ * daemon for some of them (FUSE, overlay over network filesystems) can
+ * skip that work.  Exports
+ * with statx_dont_sync also let the filesystem answer from its cached
+ * attributes.
+ *
+ * Calls are counted per statx field mask and logged when the export is
+ * released, showing which attribute sets clients really use.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "fsal.h"
+#include "vfs_methods.h"
+
+#ifdef HAVE_STATX
+
+#include <sys/sysmacros.h>
+
+static const struct {
+	attrmask_t attr;
+	unsigned int fields;
+} vfs_statx_fields[] = {
+	{ ATTR_TYPE, STATX_TYPE },
+	{ ATTR_MODE, STATX_TYPE | STATX_MODE },
+	{ ATTR_SIZE, STATX_SIZE },
+	{ ATTR_FILEID, STATX_INO },
+	{ ATTR_NUMLINKS, STATX_NLINK },
+	{ ATTR_OWNER, STATX_UID },
+	{ ATTR_GROUP, STATX_GID },
+	{ ATTR_ATIME, STATX_ATIME },
+	{ ATTR_MTIME, STATX_MTIME },
+	{ ATTR_CTIME, STATX_CTIME },
+	{ ATTR_CHANGE, STATX_MTIME | STATX_CTIME },
+	{ ATTR_SPACEUSED, STATX_BLOCKS },
+};
+
+/** Set once the kernel turned statx down, fall back to fstat for good */
+static bool vfs_statx_missing;
+
+static void vfs_statx_to_stat(const struct statx *stx, struct stat *st)
+{
+	memset(st, 0, sizeof(*st));
+
+	st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+	st->st_ino = stx->stx_ino;
+	st->st_mode = stx->stx_mode;
+	st->st_nlink = stx->stx_nlink;
+	st->st_uid = stx->stx_uid;
+	st->st_gid = stx->stx_gid;
+	st->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+	st->st_size = stx->stx_size;
+	st->st_blksize = stx->stx_blksize;
+	st->st_blocks = stx->stx_blocks;
+	st->st_atim.tv_sec = stx->stx_atime.tv_sec;
+	st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+	st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+	st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+	st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+	st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+
+/**
+ * @brief Stat an object for the POSIX attributes a caller asked for
+ *
+ * The fsid and rawdev are always filled in.  Other fields of @a st are
+ * only meaningful for the attributes returned in @a valid, which holds
+ * those the filesystem actually returned.
+ *
+ * @param[in]  exp	Export the object belongs to
+ * @param[in]  fd	File descriptor of the object, or of its directory
+ * @param[in]  name	Name of the object in @a fd, NULL to stat @a fd
+ * @param[in]  request	Attributes asked for
+ * @param[out] st	Attributes found
+ * @param[out] valid	POSIX attributes filled in @a st
+ *
+ * @return 0, or -1 with errno set.  errno is ENOSYS if statx can not be
+ *	   used, the caller then stats the object the usual way.
+ */
+int vfs_statx(struct vfs_fsal_export *exp, int fd, const char *name,
+	      attrmask_t request, struct stat *st, attrmask_t *valid)
+{
+	struct statx stx;
+	unsigned int fields = STATX_TYPE;
+	int flags = AT_SYMLINK_NOFOLLOW;
+	int i;
+
+	if (vfs_statx_missing) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	for (i = 0;
+	     i < sizeof(vfs_statx_fields) / sizeof(vfs_statx_fields[0]);
+	     i++) {
+		if (request & vfs_statx_fields[i].attr)
+			fields |= vfs_statx_fields[i].fields;
+	}
+
+	if (name == NULL) {
+		name = "";
+		flags |= AT_EMPTY_PATH;
+	}
+
+	if (exp->statx_dont_sync)
+		flags |= AT_STATX_DONT_SYNC;
+
+	if (statx(fd, name, flags, fields, &stx) < 0) {
+		if (errno == ENOSYS) {
+			LogInfo(COMPONENT_FSAL,
+				"statx not supported, using fstat");
+			vfs_statx_missing = true;
+		}
+		return -1;
+	}
+
+	(void)atomic_inc_uint64_t(
+		&exp->statx_calls[fields & (VFS_STATX_MASKS - 1)]);
+
+	LogFullDebug(COMPONENT_FSAL,
+		     "statx request 0x%"PRIx64" fields 0x%x returned 0x%x",
+		     request, fields, stx.stx_mask);
+
+	vfs_statx_to_stat(&stx, st);
+
+	/* The filesystem may not have returned every field asked for, an
+	 * attribute is only good if all its fields came back.  Mtime and
+	 * ctime asked for the change attribute are returned too.
+	 */
+	*valid = ATTR_FSID | ATTR_RAWDEV;
+
+	for (i = 0;
+	     i < sizeof(vfs_statx_fields) / sizeof(vfs_statx_fields[0]);
+	     i++) {
+		unsigned int need = vfs_statx_fields[i].fields;
+
+		if ((fields & need) == need && (stx.stx_mask & need) == need)
+			*valid |= vfs_statx_fields[i].attr;
+	}
+
+	return 0;
+}
+
+#else /* HAVE_STATX */
+
+int vfs_statx(struct vfs_fsal_export *exp, int fd, const char *name,
+	      attrmask_t request, struct stat *st, attrmask_t *valid)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif /* HAVE_STATX */
+
+/**
+ * @brief Stat a name in a directory for a lookup
+ *
+ * As vfs_statx, falling back to fstatat when statx can't be used or
+ * doesn't return what a new handle needs: the type, and the size of a
+ * symlink to read the link.
+ *
+ * @param[in]  exp	Export the directory belongs to
+ * @param[in]  dirfd	File descriptor of the directory
+ * @param[in]  name	Name to stat
+ * @param[in]  request	Attributes asked for
+ * @param[out] st	Attributes found
+ * @param[out] valid	POSIX attributes filled in @a st
+ *
+ * @return 0, or -1 with errno set.
+ */
+int vfs_stat_name(struct vfs_fsal_export *exp, int dirfd, const char *name,
+		  attrmask_t request, struct stat *st, attrmask_t *valid)
+{
+	if (vfs_statx(exp, dirfd, name, request | ATTR_SIZE, st, valid) == 0) {
+		if ((*valid & ATTR_TYPE) &&
+		    (*valid & ATTR_SIZE || !S_ISLNK(st->st_mode)))
+			return 0;
+	} else if (errno != ENOSYS) {
+		return -1;
+	}
+
+	*valid = ATTRS_POSIX;
+
+	return fstatat(dirfd, name, st, AT_SYMLINK_NOFOLLOW);
+}
+
+/**
+ * @brief Log how often each statx field mask was used by an export
+ *
+ * @param[in] exp	Export being released
+ */
+void vfs_statx_log_stats(struct vfs_fsal_export *exp)
+{
+	uint64_t calls;
+	int i;
+
+	for (i = 0; i < VFS_STATX_MASKS; i++) {
+		calls = atomic_fetch_uint64_t(&exp->statx_calls[i]);
+		if (calls == 0)
+			continue;
+
+		LogEvent(COMPONENT_FSAL,
+			 "VFS export %"PRIu16" statx fields 0x%03x: %"PRIu64
+			 " calls",
+			 exp->export.export_id, i, calls);
+	}
+}
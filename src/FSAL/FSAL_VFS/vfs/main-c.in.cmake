@@ -84,7 +84,14 @@ static struct vfs_fsal_module VFS = {
 			.expire_time_parent = -1,
 		}
 	},
-	.only_one_user = false
+	.only_one_user = false,
+	.write_gather = true,
+	.async_io = false,
+	.async_io_depth = 128,
+	.async_io_threads = 8,
+	.readdir_streams = 256,
+	.readdir_threads = 4,
+	.path_fds = 1024
 };
 
 static struct config_item vfs_params[] = {
@@ -104,6 +111,20 @@ static struct config_item vfs_params[] = {
 		       module.fs_info.auth_exportpath_xdev),
 	CONF_ITEM_BOOL("only_one_user", false, vfs_fsal_module,
 		       only_one_user),
+	CONF_ITEM_BOOL("write_gather", true, vfs_fsal_module,
+		       write_gather),
+	CONF_ITEM_BOOL("async_io", false, vfs_fsal_module,
+		       async_io),
+	CONF_ITEM_UI32("async_io_depth", 1, 4096, 128, vfs_fsal_module,
+		       async_io_depth),
+	CONF_ITEM_UI32("async_io_threads", 0, 256, 8, vfs_fsal_module,
+		       async_io_threads),
+	CONF_ITEM_UI32("readdir_streams", 0, 65536, 256, vfs_fsal_module,
+		       readdir_streams),
+	CONF_ITEM_UI32("readdir_threads", 0, 64, 4, vfs_fsal_module,
+		       readdir_threads),
+	CONF_ITEM_UI32("path_fds", 0, 1048576, 1024, vfs_fsal_module,
+		       path_fds),
 	CONFIG_EOL
 };
 
@@ -191,6 +212,9 @@ static fsal_status_t init_config(struct fsal_module *vfs_fsal_module,
 		return fsalstat(ERR_FSAL_INVAL, 0);
 
 	display_fsinfo(&vfs_module->module);
+	vfs_aio_init(vfs_module);
+	vfs_readdir_init(vfs_module);
+	vfs_path_fd_init(vfs_module);
 	LogFullDebug(COMPONENT_FSAL,
 		     "Supported attributes constant = 0x%" PRIx64,
 		     VFS_SUPPORTED_ATTRIBUTES);
@@ -231,6 +255,10 @@ MODULE_FINI void vfs_unload(void)
 {
 	int retval;
 
+	vfs_aio_shutdown();
+	vfs_readdir_shutdown();
+	vfs_path_fd_shutdown();
+
 	retval = unregister_fsal(&VFS.module);
 	if (retval != 0) {
 		fprintf(stderr, "VFS module failed to unregister");
@@ -34,6 +34,10 @@
 #include "fsal_api.h"
 #include "FSAL/fsal_commonlib.h"
 #include "FSAL/access_check.h"
+#ifdef LINUX
+#include <sys/ioctl.h>
+#include <linux/fs.h>	/* FICLONERANGE */
+#endif
 
 struct vfs_fsal_obj_handle;
 struct vfs_fsal_export;
@@ -46,8 +50,35 @@ struct vfs_fsal_module {
 	struct fsal_module module;
 	struct fsal_obj_ops handle_ops;
 	bool only_one_user;
+	bool write_gather;
+	bool async_io;
+	uint32_t async_io_depth;
+	uint32_t async_io_threads;
+	uint32_t readdir_streams;
+	uint32_t readdir_threads;
+	uint32_t path_fds;
+};
+
+/*
+ * How an export moves file data, see direct_io.c
+ */
+enum vfs_io_mode {
+	VFS_IO_BUFFERED,	/*< Through the page cache */
+	VFS_IO_DIRECT,		/*< O_DIRECT, unaligned I/O bounced */
+	VFS_IO_DONTNEED,	/*< Buffered, dropped from the cache after */
+};
+
+struct vfs_io_stats {
+	uint64_t direct_ops;
+	uint64_t direct_bytes;
+	uint64_t bounced_ops;	/*< Requests that bounced any part */
+	uint64_t bounced_bytes;
+	uint64_t dontneed_bytes;
 };
 
+/* One getattrs counter per combination of the basic statx fields */
+#define VFS_STATX_MASKS 0x800
+
 /*
  * VFS internal export
  */
@@ -57,6 +88,11 @@ struct vfs_fsal_export {
 	struct glist_head filesystems;
 	int fsid_type;
 	bool async_hsm_restore;
+	int io_mode;
+	struct vfs_io_stats io_stats;
+	bool statx_dont_sync;
+	bool share_fds;
+	uint64_t statx_calls[VFS_STATX_MASKS];
 };
 
 #define EXPORT_VFS_FROM_FSAL(fsal) \
@@ -147,6 +183,16 @@ struct vfs_subfsal_obj_ops {
 				  struct attrlist *attrib_set);
 };
 
+/*
+ * Kernel file descriptor shared by the open states of a file
+ */
+struct vfs_shared_fd {
+	int fd;
+	fsal_openflags_t access;	/*< FSAL_O_READ, WRITE or RDWR */
+	uint32_t refcount;		/*< Open states using the fd */
+	struct vfs_fsal_obj_handle *obj;
+};
+
 struct vfs_fd {
 	/** The open and share mode etc. */
 	fsal_openflags_t openflags;
@@ -154,6 +200,12 @@ struct vfs_fd {
 	pthread_rwlock_t fdlock;
 	/** The kernel file descriptor. */
 	int fd;
+	/** The shared fd fd belongs to, NULL if it is our own */
+	struct vfs_shared_fd *shared;
+	/** fd was opened with O_DIRECT, see direct_io.c */
+	bool direct;
+	/** Buffered fd for the partial blocks of a direct fd */
+	int buf_fd;
 };
 
 struct vfs_state_fd {
@@ -161,6 +213,29 @@ struct vfs_state_fd {
 	struct vfs_fd vfs_fd;
 };
 
+/*
+ * Write gathering and COMMIT coalescing for a regular file.
+ *
+ * One thread at a time issues small unstable writes, its own along with
+ * those queued behind it for the same fd and credentials, merging
+ * contiguous ones into a single pwritev.  The range
+ * written since the last sync is tracked so that a COMMIT on a clean
+ * range returns without syncing, and concurrent COMMITs share one sync.
+ */
+struct vfs_write_gather {
+	pthread_mutex_t wg_mutex;
+	pthread_cond_t wg_cond;
+	struct glist_head wg_queue;	/*< Writes waiting to be issued */
+	bool wg_writing;		/*< A thread is issuing writes */
+	bool wg_syncing;		/*< A COMMIT is syncing wg_sync_* */
+	uint64_t wg_dirty_start;	/*< Written since the last sync */
+	uint64_t wg_dirty_end;
+	uint64_t wg_sync_start;		/*< Being synced */
+	uint64_t wg_sync_end;
+	uint64_t wg_sync_gen;		/*< Number of completed syncs */
+	int wg_sync_error;		/*< errno of the last sync */
+};
+
 /*
  * VFS internal object handle
  * handle is a pointer because
@@ -184,10 +259,19 @@ struct vfs_fsal_obj_handle {
 #endif
 	struct vfs_subfsal_obj_ops *sub_ops;	/*< Optional subfsal ops */
 	const struct fsal_up_vector *up_ops;	/*< Upcall operations */
+	/* Cached O_PATH fd, see path_fd.c */
+	struct glist_head path_fd_lru;	/*< Not on a list if no fd */
+	int path_fd;
+	uint32_t path_fd_users;
 	union {
 		struct {
 			struct fsal_share share;
 			struct vfs_fd fd;
+			/** Global fd of direct exports, opened O_DIRECT */
+			struct vfs_fd dio_fd;
+			struct vfs_write_gather wg;
+			/** Shared fds, indexed by access - 1 */
+			struct vfs_shared_fd *shared_fd[FSAL_O_RDWR];
 		} file;
 		struct {
 			unsigned char *link_content;
@@ -197,6 +281,9 @@ struct vfs_fsal_obj_handle {
 			vfs_file_handle_t *dir;
 			char *name;
 		} unopenable;
+		struct {
+			struct vfs_dir_stream *stream;
+		} dir;
 	} u;
 };
 
@@ -339,10 +426,101 @@ fsal_status_t vfs_fallocate(struct fsal_obj_handle *obj_hdl,
 			    uint64_t length, bool allocate);
 #endif
 
+fsal_status_t vfs_copy(struct fsal_obj_handle *src_hdl,
+		       struct state_t *src_state, uint64_t src_offset,
+		       struct fsal_obj_handle *dst_hdl,
+		       struct state_t *dst_state, uint64_t dst_offset,
+		       uint64_t count, uint64_t *copied);
+
+#ifdef FICLONERANGE
+fsal_status_t vfs_clone(struct fsal_obj_handle *src_hdl,
+			struct state_t *src_state, uint64_t src_offset,
+			struct fsal_obj_handle *dst_hdl,
+			struct state_t *dst_state, uint64_t dst_offset,
+			uint64_t count);
+#endif
+
 fsal_status_t vfs_commit2(struct fsal_obj_handle *obj_hdl,
 			  off_t offset,
 			  size_t len);
 
+/* Write gathering, write_gather.c */
+void vfs_wg_init(struct vfs_write_gather *wg);
+void vfs_wg_fini(struct vfs_write_gather *wg);
+void vfs_wg_mark_dirty(struct vfs_write_gather *wg, uint64_t offset,
+		       uint64_t length);
+
+bool vfs_wg_write(struct vfs_write_gather *wg, int fd,
+		  struct fsal_io_arg *write_arg, fsal_status_t *status);
+bool vfs_wg_is_clean(struct vfs_write_gather *wg, uint64_t offset,
+		     uint64_t length);
+int vfs_wg_commit(struct vfs_write_gather *wg, int fd, uint64_t offset,
+		  uint64_t length);
+
+/* Asynchronous I/O, async_io.c */
+struct vfs_aio_req;
+
+void vfs_aio_init(struct vfs_fsal_module *vfs_module);
+void vfs_aio_shutdown(void);
+struct vfs_aio_req *vfs_aio_prepare(struct fsal_obj_handle *obj_hdl, int fd,
+				    bool *closefd, bool write,
+				    struct vfs_write_gather *wg,
+				    fsal_async_cb done_cb,
+				    struct fsal_io_arg *io_arg,
+				    void *caller_arg);
+void vfs_aio_start(struct vfs_aio_req *req);
+
+/* Bulk readdir, readdir.c */
+struct vfs_dir_stream;
+
+void vfs_readdir_init(struct vfs_fsal_module *vfs_module);
+void vfs_readdir_shutdown(void);
+void vfs_readdir_release(struct vfs_fsal_obj_handle *myself);
+fsal_status_t vfs_readdir_bulk(struct vfs_fsal_obj_handle *myself,
+			       fsal_cookie_t *whence, void *dir_state,
+			       fsal_readdir_cb cb, attrmask_t attrmask,
+			       bool *eof);
+fsal_status_t lookup_with_fd(struct vfs_fsal_obj_handle *parent_hdl,
+			     int dirfd, const char *path,
+			     struct fsal_obj_handle **handle,
+			     struct attrlist *attrs_out);
+fsal_status_t lookup_with_stat(struct vfs_fsal_obj_handle *parent_hdl,
+			       int dirfd, const char *path,
+			       struct stat *stat, attrmask_t valid,
+			       vfs_file_handle_t *fh,
+			       struct fsal_obj_handle **handle,
+			       struct attrlist *attrs_out);
+
+/* Cached O_PATH fds, path_fd.c */
+void vfs_path_fd_init(struct vfs_fsal_module *vfs_module);
+void vfs_path_fd_shutdown(void);
+int vfs_path_fd_open(struct vfs_fsal_obj_handle *hdl, int openflags,
+		     fsal_errors_t *fsal_error);
+void vfs_path_fd_release(struct vfs_fsal_obj_handle *hdl);
+void vfs_path_fd_forget(const vfs_file_handle_t *fh);
+
+/* Per-export I/O modes, direct_io.c */
+extern struct config_item_list vfs_io_modes[];
+
+void vfs_io_setup_fd(struct vfs_fsal_obj_handle *myself,
+		     struct vfs_fd *my_fd);
+enum vfs_io_mode vfs_io_mode(const struct vfs_fd *my_fd);
+bool vfs_dio_aligned(const struct iovec *iov, int iovcnt, uint64_t offset);
+ssize_t vfs_dio_read(int fd, const struct iovec *iov, int iovcnt,
+		     uint64_t offset);
+ssize_t vfs_dio_write(struct vfs_fd *my_fd, const struct iovec *iov,
+		      int iovcnt, uint64_t offset);
+void vfs_dio_count_async(const struct iovec *iov, int iovcnt);
+void vfs_io_dontneed(int fd, uint64_t offset, size_t len, bool write);
+void vfs_io_log_stats(struct vfs_fsal_export *exp);
+
+/* Attributes limited to the request, statx.c */
+int vfs_statx(struct vfs_fsal_export *exp, int fd, const char *name,
+	      attrmask_t request, struct stat *st, attrmask_t *valid);
+int vfs_stat_name(struct vfs_fsal_export *exp, int dirfd, const char *name,
+		  attrmask_t request, struct stat *st, attrmask_t *valid);
+void vfs_statx_log_stats(struct vfs_fsal_export *exp);
+
 fsal_status_t vfs_lock_op2(struct fsal_obj_handle *obj_hdl,
 			   struct state_t *state,
 			   void *owner,
@@ -0,0 +1,525 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* write_gather.c
+ * VFS write gathering and COMMIT coalescing
+ *
+ * Unstable writes are issued by whichever thread finds no other write in
+ * progress on the file.  Writes that arrive while it is busy wait in a
+ * queue.  When its pwritev is done, the writer completes its own write
+ * and hands the queue to the first thread waiting in it, which issues its
+ * own write together with the queued writes that go through the same fd
+ * with the same credentials, in runs of contiguous writes with one
+ * pwritev each.  Every thread returns and calls its own done_cb, so no
+ * thread does more than one batch of other threads' writes, and nothing
+ * is written with somebody else's credentials.  No write is ever delayed
+ * waiting for a neighbour, gathering only happens when writes to a file
+ * are already concurrent.
+ *
+ * Every unstable write extends the file's dirty range.  COMMIT returns at
+ * once when the range it covers is clean, otherwise one thread syncs the
+ * whole dirty range while other COMMITs wait for it to finish.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "vfs_methods.h"
+
+/** Largest write that is queued for gathering */
+#define VFS_WG_MAX_WRITE (256 * 1024)
+
+/** Largest run of gathered writes issued with one pwritev */
+#define VFS_WG_MAX_RUN (4 * 1024 * 1024)
+
+/** Most iovecs in one gathered pwritev */
+#define VFS_WG_MAX_IOV 64
+
+/** Most writes issued by one thread at a time */
+#define VFS_WG_MAX_BATCH 32
+
+enum vfs_wg_state {
+	VFS_WG_WAITING,	/*< Queued behind the writer */
+	VFS_WG_ISSUING,	/*< Taken by the writer, or being the writer */
+	VFS_WG_DONE,	/*< Issued, status and io_amount are set */
+	VFS_WG_LEAD,	/*< Handed the queue, issue it */
+};
+
+/** A write, on the stack of the thread that must complete it */
+struct vfs_wg_write {
+	struct glist_head list;
+	struct fsal_io_arg *write_arg;
+	const struct user_cred *creds;
+	int fd;
+	uint64_t offset;
+	uint64_t length;
+	fsal_status_t status;
+	enum vfs_wg_state state;
+};
+
+static inline bool vfs_wg_overlap(uint64_t start1, uint64_t end1,
+				  uint64_t start2, uint64_t end2)
+{
+	return start1 < end2 && start2 < end1;
+}
+
+static inline uint64_t vfs_wg_end(uint64_t offset, uint64_t length)
+{
+	/* A length of 0 means to the end of the file */
+	if (length == 0 || offset + length < offset)
+		return UINT64_MAX;
+	return offset + length;
+}
+
+/**
+ * @brief Initialize the write gathering state of a new file handle
+ *
+ * Nothing is known about what was written through a previous handle for
+ * the same file, so the whole file starts out dirty and the first COMMIT
+ * always syncs.
+ *
+ * @param[in] wg  Write gathering state
+ */
+
+void vfs_wg_init(struct vfs_write_gather *wg)
+{
+	PTHREAD_MUTEX_init(&wg->wg_mutex, NULL);
+	PTHREAD_COND_init(&wg->wg_cond, NULL);
+	glist_init(&wg->wg_queue);
+	wg->wg_writing = false;
+	wg->wg_syncing = false;
+	wg->wg_dirty_start = 0;
+	wg->wg_dirty_end = UINT64_MAX;
+	wg->wg_sync_start = 0;
+	wg->wg_sync_end = 0;
+	wg->wg_sync_gen = 0;
+	wg->wg_sync_error = 0;
+}
+
+/**
+ * @brief Release the write gathering state of a file handle
+ *
+ * @param[in] wg  Write gathering state
+ */
+
+void vfs_wg_fini(struct vfs_write_gather *wg)
+{
+	assert(glist_empty(&wg->wg_queue));
+	PTHREAD_MUTEX_destroy(&wg->wg_mutex);
+	PTHREAD_COND_destroy(&wg->wg_cond);
+}
+
+/* Called with wg_mutex held */
+static void vfs_wg_dirty_locked(struct vfs_write_gather *wg,
+				uint64_t start, uint64_t end)
+{
+	if (wg->wg_dirty_start >= wg->wg_dirty_end) {
+		wg->wg_dirty_start = start;
+		wg->wg_dirty_end = end;
+		return;
+	}
+
+	if (start < wg->wg_dirty_start)
+		wg->wg_dirty_start = start;
+	if (end > wg->wg_dirty_end)
+		wg->wg_dirty_end = end;
+}
+
+/**
+ * @brief Record that a range of the file has unstable data
+ *
+ * @param[in] wg      Write gathering state
+ * @param[in] offset  Start of the range
+ * @param[in] length  Length of the range
+ */
+
+void vfs_wg_mark_dirty(struct vfs_write_gather *wg, uint64_t offset,
+		       uint64_t length)
+{
+	if (length == 0)
+		return;
+
+	PTHREAD_MUTEX_lock(&wg->wg_mutex);
+	vfs_wg_dirty_locked(wg, offset, vfs_wg_end(offset, length));
+	PTHREAD_MUTEX_unlock(&wg->wg_mutex);
+}
+
+/* Same credentials, so the write may go out in another thread's pwritev */
+static bool vfs_wg_same_creds(const struct user_cred *a,
+			      const struct user_cred *b)
+{
+	if (a == b)
+		return true;
+
+	return a->caller_uid == b->caller_uid &&
+	       a->caller_gid == b->caller_gid &&
+	       a->caller_glen == b->caller_glen &&
+	       (a->caller_glen == 0 ||
+		memcmp(a->caller_garray, b->caller_garray,
+		       a->caller_glen * sizeof(gid_t)) == 0);
+}
+
+/* Set the outcome of a write */
+static void vfs_wg_done(struct vfs_wg_write *wr, fsal_status_t status,
+			uint64_t written)
+{
+	wr->write_arg->io_amount = written;
+	wr->status = status;
+}
+
+/**
+ * @brief Issue a list of writes
+ *
+ * Runs of writes that follow each other in the file are issued with a
+ * single pwritev.  Writes are never reordered, overlapping writes land in
+ * the order they arrived.
+ */
+static void vfs_wg_write_batch(struct vfs_write_gather *wg, int fd,
+			       struct glist_head *batch,
+			       struct glist_head *done)
+{
+	struct iovec iov[VFS_WG_MAX_IOV];
+	struct glist_head run;
+	struct vfs_wg_write *wr, *first;
+	uint64_t run_start, run_end, last;
+	ssize_t nb_written;
+	int iovcnt, i;
+
+	while (!glist_empty(batch)) {
+		first = glist_first_entry(batch, struct vfs_wg_write, list);
+		run_start = first->offset;
+		run_end = first->offset;
+		iovcnt = 0;
+		glist_init(&run);
+
+		/* Collect a run of contiguous writes */
+		while ((wr = glist_first_entry(batch, struct vfs_wg_write,
+					       list)) != NULL) {
+			if (wr->offset != run_end ||
+			    iovcnt + wr->write_arg->iov_count > VFS_WG_MAX_IOV ||
+			    (iovcnt != 0 &&
+			     run_end - run_start + wr->length >
+			     VFS_WG_MAX_RUN))
+				break;
+
+			for (i = 0; i < wr->write_arg->iov_count; i++)
+				iov[iovcnt++] = wr->write_arg->iov[i];
+
+			run_end += wr->length;
+			glist_del(&wr->list);
+			glist_add_tail(&run, &wr->list);
+		}
+
+		nb_written = pwritev(fd, iov, iovcnt, run_start);
+
+		if (nb_written < 0) {
+			int retval = errno;
+
+			while ((wr = glist_first_entry(&run,
+						       struct vfs_wg_write,
+						       list)) != NULL) {
+				glist_del(&wr->list);
+				vfs_wg_done(wr, fsalstat(
+						posix2fsal_error(retval),
+						retval), 0);
+				glist_add_tail(done, &wr->list);
+			}
+			continue;
+		}
+
+		LogFullDebug(COMPONENT_FSAL,
+			     "Gathered write of %zd bytes at %" PRIu64,
+			     nb_written, run_start);
+
+		vfs_wg_mark_dirty(wg, run_start, nb_written);
+		last = run_start + nb_written;
+
+		/* Hand out what was written, a short write only shortens the
+		 * writes past its end.
+		 */
+		while ((wr = glist_first_entry(&run, struct vfs_wg_write,
+					       list)) != NULL) {
+			uint64_t written = 0;
+
+			if (last > wr->offset)
+				written = last - wr->offset;
+			if (written > wr->length)
+				written = wr->length;
+
+			glist_del(&wr->list);
+			glist_add_tail(done, &wr->list);
+
+			if (written == 0 && wr->length != 0) {
+				/* Nothing of this one made it, retry it alone
+				 * to get the real error.
+				 */
+				nb_written = pwritev(fd, wr->write_arg->iov,
+						     wr->write_arg->iov_count,
+						     wr->offset);
+				if (nb_written < 0) {
+					int retval = errno;
+
+					vfs_wg_done(wr, fsalstat(
+						posix2fsal_error(retval),
+						retval), 0);
+					continue;
+				}
+				vfs_wg_mark_dirty(wg, wr->offset, nb_written);
+				written = nb_written;
+			}
+
+			vfs_wg_done(wr, fsalstat(ERR_FSAL_NO_ERROR, 0),
+				    written);
+		}
+	}
+}
+
+/**
+ * @brief Issue an unstable write, gathered with concurrent ones
+ *
+ * Large writes bypass gathering and are issued by the caller as usual.
+ * If another thread is writing the file, wait until it has issued this
+ * write along with its own, or handed us the queue.  As the writer, issue
+ * our write along with the queued writes that use the same fd and
+ * credentials, then pass the queue on to the next waiting thread.
+ *
+ * The caller must have its credentials set and hold @a fd until we
+ * return, and calls its own done_cb with the status.
+ *
+ * @param[in]  wg         Write gathering state
+ * @param[in]  fd         File descriptor open for write
+ * @param[in]  write_arg  The write, io_amount is set
+ * @param[out] status     Outcome of the write
+ *
+ * @retval false if the write was not gathered, the caller issues it.
+ * @retval true if the write was issued.
+ */
+
+bool vfs_wg_write(struct vfs_write_gather *wg, int fd,
+		  struct fsal_io_arg *write_arg, fsal_status_t *status)
+{
+	struct vfs_wg_write me, *wr;
+	struct glist_head batch, done;
+	struct glist_head *glist, *glistn;
+	uint64_t length = 0;
+	int i, nb = 1;
+
+	if (write_arg->iov_count > VFS_WG_MAX_IOV)
+		return false;
+
+	for (i = 0; i < write_arg->iov_count; i++)
+		length += write_arg->iov[i].iov_len;
+
+	if (length > VFS_WG_MAX_WRITE)
+		return false;
+
+	me.write_arg = write_arg;
+	me.creds = op_ctx->creds;
+	me.fd = fd;
+	me.offset = write_arg->offset;
+	me.length = length;
+
+	PTHREAD_MUTEX_lock(&wg->wg_mutex);
+
+	if (wg->wg_writing) {
+		me.state = VFS_WG_WAITING;
+		glist_add_tail(&wg->wg_queue, &me.list);
+
+		LogFullDebug(COMPONENT_FSAL,
+			     "Queued write of %" PRIu64 " bytes at %" PRIu64,
+			     length, me.offset);
+
+		while (me.state == VFS_WG_WAITING ||
+		       me.state == VFS_WG_ISSUING)
+			pthread_cond_wait(&wg->wg_cond, &wg->wg_mutex);
+
+		if (me.state == VFS_WG_DONE) {
+			PTHREAD_MUTEX_unlock(&wg->wg_mutex);
+			*status = me.status;
+			return true;
+		}
+
+		/* We were handed the queue and are no longer in it */
+	}
+
+	wg->wg_writing = true;
+	me.state = VFS_WG_ISSUING;
+
+	/* Take what may go out with our write, stopping at the first
+	 * write we can't issue so that none is reordered.
+	 */
+	glist_init(&batch);
+	glist_init(&done);
+	glist_add_tail(&batch, &me.list);
+
+	while (nb < VFS_WG_MAX_BATCH &&
+	       (wr = glist_first_entry(&wg->wg_queue, struct vfs_wg_write,
+				       list)) != NULL &&
+	       wr->fd == fd && vfs_wg_same_creds(wr->creds, me.creds)) {
+		glist_del(&wr->list);
+		wr->state = VFS_WG_ISSUING;
+		glist_add_tail(&batch, &wr->list);
+		nb++;
+	}
+
+	PTHREAD_MUTEX_unlock(&wg->wg_mutex);
+
+	vfs_wg_write_batch(wg, fd, &batch, &done);
+
+	PTHREAD_MUTEX_lock(&wg->wg_mutex);
+
+	glist_for_each_safe(glist, glistn, &done) {
+		wr = glist_entry(glist, struct vfs_wg_write, list);
+		glist_del(&wr->list);
+		wr->state = VFS_WG_DONE;
+	}
+
+	/* Pass the rest on, the next thread issues its own write and what
+	 * it can take with it.
+	 */
+	wr = glist_first_entry(&wg->wg_queue, struct vfs_wg_write, list);
+	if (wr != NULL) {
+		glist_del(&wr->list);
+		wr->state = VFS_WG_LEAD;
+	} else {
+		wg->wg_writing = false;
+	}
+
+	pthread_cond_broadcast(&wg->wg_cond);
+	PTHREAD_MUTEX_unlock(&wg->wg_mutex);
+
+	*status = me.status;
+	return true;
+}
+
+/**
+ * @brief Check if a range has no unstable data
+ *
+ * @param[in] wg      Write gathering state
+ * @param[in] offset  Start of the range
+ * @param[in] length  Length of the range, 0 for to the end of the file
+ *
+ * @retval true if nothing in the range needs to be synced.
+ */
+
+bool vfs_wg_is_clean(struct vfs_write_gather *wg, uint64_t offset,
+		     uint64_t length)
+{
+	uint64_t end = vfs_wg_end(offset, length);
+	bool clean;
+
+	PTHREAD_MUTEX_lock(&wg->wg_mutex);
+
+	clean = !vfs_wg_overlap(offset, end,
+				wg->wg_dirty_start, wg->wg_dirty_end) &&
+		!(wg->wg_syncing &&
+		  vfs_wg_overlap(offset, end,
+				 wg->wg_sync_start, wg->wg_sync_end));
+
+	PTHREAD_MUTEX_unlock(&wg->wg_mutex);
+
+	return clean;
+}
+
+/**
+ * @brief Make a range of the file stable
+ *
+ * If another COMMIT is already syncing, wait for it; if it covered our
+ * range we are done.  Otherwise take the whole dirty range and sync it
+ * for everyone.
+ *
+ * @param[in] wg      Write gathering state
+ * @param[in] fd      File descriptor open on the file
+ * @param[in] offset  Start of the range
+ * @param[in] length  Length of the range, 0 for to the end of the file
+ *
+ * @return 0 or an errno.
+ */
+
+int vfs_wg_commit(struct vfs_write_gather *wg, int fd, uint64_t offset,
+		  uint64_t length)
+{
+	uint64_t end = vfs_wg_end(offset, length);
+	uint64_t start, stop, gen;
+	int retval;
+
+	PTHREAD_MUTEX_lock(&wg->wg_mutex);
+
+	while (wg->wg_syncing) {
+		bool covered = vfs_wg_overlap(offset, end, wg->wg_sync_start,
+					      wg->wg_sync_end);
+
+		gen = wg->wg_sync_gen;
+
+		while (wg->wg_syncing && wg->wg_sync_gen == gen)
+			pthread_cond_wait(&wg->wg_cond, &wg->wg_mutex);
+
+		if (covered && wg->wg_sync_error != 0) {
+			retval = wg->wg_sync_error;
+			PTHREAD_MUTEX_unlock(&wg->wg_mutex);
+			return retval;
+		}
+	}
+
+	if (!vfs_wg_overlap(offset, end, wg->wg_dirty_start,
+			    wg->wg_dirty_end)) {
+		/* Synced by someone else or never written */
+		PTHREAD_MUTEX_unlock(&wg->wg_mutex);
+		return 0;
+	}
+
+	start = wg->wg_dirty_start;
+	stop = wg->wg_dirty_end;
+	wg->wg_sync_start = start;
+	wg->wg_sync_end = stop;
+	wg->wg_dirty_start = 0;
+	wg->wg_dirty_end = 0;
+	wg->wg_syncing = true;
+
+	PTHREAD_MUTEX_unlock(&wg->wg_mutex);
+
+	LogFullDebug(COMPONENT_FSAL,
+		     "Syncing %" PRIu64 " to %" PRIu64, start, stop);
+
+	retval = fdatasync(fd) < 0 ? errno : 0;
+
+	PTHREAD_MUTEX_lock(&wg->wg_mutex);
+
+	if (retval != 0) {
+		/* Still unstable */
+		vfs_wg_dirty_locked(wg, start, stop);
+	}
+
+	wg->wg_syncing = false;
+	wg->wg_sync_gen++;
+	wg->wg_sync_error = retval;
+	pthread_cond_broadcast(&wg->wg_cond);
+
+	PTHREAD_MUTEX_unlock(&wg->wg_mutex);
+
+	return retval;
+}
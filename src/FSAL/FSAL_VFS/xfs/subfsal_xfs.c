@@ -37,6 +37,13 @@
 
 static struct config_item export_params[] = {
 	CONF_ITEM_NOOP("name"),
+	CONF_ITEM_TOKEN("io_mode", VFS_IO_BUFFERED,
+			vfs_io_modes,
+			vfs_fsal_export, io_mode),
+	CONF_ITEM_BOOL("statx_dont_sync", false,
+		       vfs_fsal_export, statx_dont_sync),
+	CONF_ITEM_BOOL("share_fds", true,
+		       vfs_fsal_export, share_fds),
 	CONFIG_EOL
 };
 
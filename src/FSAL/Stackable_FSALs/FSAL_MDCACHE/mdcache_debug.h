@@ -54,6 +54,28 @@ struct fsal_obj_handle *mdcdb_get_sub_handle(struct fsal_obj_handle *obj_hdl)
 	return entry->sub_handle;
 }
 
+/**
+ * @brief Forget what MDCACHE knows about an object
+ *
+ * Stops trusting the cached attributes and, for a directory, drops the cached
+ * dirents, so the next getattrs or lookup goes down to the sub-FSAL.
+ *
+ * @param[in] obj_hdl	MDCACHE handle
+ */
+void mdcdb_invalidate(struct fsal_obj_handle *obj_hdl)
+{
+	mdcache_entry_t *entry =
+		container_of(obj_hdl, mdcache_entry_t, obj_handle);
+
+	mdc_untrust_attrs(entry);
+
+	if (obj_hdl->type == DIRECTORY) {
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+		mdcache_dirent_invalidate_all(entry);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+	}
+}
+
 void lru_cleanup_entries(void);
 
 #endif /* MDCACHE_DEBUG_H */
@@ -112,6 +112,24 @@ struct mdcache_parameter {
 	/** High water mark for dirent mapping entries.  Defaults to 10000,
 	    settable by Dirmap_HWMark. */
 	uint32_t dirmap_hwmark;
+	/** Cache test_access() results per entry and credentials.
+	    Defaults to true, settable with Cache_Access. */
+	bool cache_access;
+	/** Cache protocol encodings of the attributes per entry.
+	    Defaults to true, settable with Cache_Encoded_Attrs. */
+	bool cache_encoded_attrs;
+	/** Number of multi-component paths remembered.  Defaults to 4096,
+	    settable with Path_Cache_Size, 0 disables the path cache. */
+	uint32_t path_cache_size;
+	/** Number of xattr values remembered.  Defaults to 4096, settable
+	    with Xattr_Cache_Size, 0 disables the xattr cache. */
+	uint32_t xattr_cache_size;
+	/** Seconds an xattr value is remembered.  Defaults to 60,
+	    settable with Xattr_Cache_Expiration. */
+	uint32_t xattr_cache_expiration;
+	/** Seconds a missing xattr is remembered.  Defaults to 10,
+	    settable with Xattr_Cache_Negative_Expiration. */
+	uint32_t xattr_cache_negative_expiration;
 };
 
 extern struct mdcache_parameter mdcache_param;
@@ -33,6 +33,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include "FSAL/fsal_commonlib.h"
+#include "sal_functions.h"
 #include "mdcache_int.h"
 #include "mdcache_lru.h"
 #include "mdcache.h"
@@ -193,8 +194,7 @@ static fsal_status_t mdc_open2_by_name(mdcache_entry_t *mdc_parent,
 
 	if (openflags & FSAL_O_TRUNC) {
 		/* Invalidate the attributes since we just truncated. */
-		atomic_clear_uint32_t_bits(&entry->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(entry);
 	}
 
 	if (attrs_out) {
@@ -318,7 +318,9 @@ fsal_status_t mdcache_open2(struct fsal_obj_handle *obj_hdl,
 	struct attrlist attrs;
 	const char *dispname = name != NULL ? name : "<by-handle>";
 	struct mdcache_fsal_export *export = mdc_cur_export();
+	struct fsal_obj_handle *existing = NULL;
 	bool invalidate;
+	bool created;
 
 	LogAttrlist(COMPONENT_CACHE_INODE, NIV_FULL_DEBUG,
 		    "attrs_in ", attrs_in, false);
@@ -360,6 +362,29 @@ fsal_status_t mdcache_open2(struct fsal_obj_handle *obj_hdl,
 	 * We can survive if we don't actually succeed in fetching the
 	 * attributes.
 	 */
+	/* An UNCHECKED or EXCLUSIVE create may just open a file that is not
+	 * cached.  Directory delegation holders must only hear about files
+	 * that were really created, so find out first if it exists.
+	 */
+	created = createmode != FSAL_NO_CREATE;
+
+	if (name != NULL &&
+	    (createmode == FSAL_UNCHECKED || createmode == FSAL_EXCLUSIVE ||
+	     createmode == FSAL_EXCLUSIVE_41) &&
+	    state_dir_deleg_held(obj_hdl)) {
+		subcall(
+			status = mdc_parent->sub_handle->obj_ops->lookup(
+				mdc_parent->sub_handle, name, &existing, NULL)
+		       );
+
+		if (FSAL_IS_SUCCESS(status)) {
+			created = false;
+			subcall(
+				existing->obj_ops->release(existing)
+			       );
+		}
+	}
+
 	fsal_prepare_attrs(&attrs,
 			   (op_ctx->fsal_export->exp_ops.fs_supported_attrs(
 							op_ctx->fsal_export)
@@ -394,8 +419,7 @@ fsal_status_t mdcache_open2(struct fsal_obj_handle *obj_hdl,
 			/* Mark the attributes as not-trusted, so we will
 			 * refresh the attributes.
 			 */
-			atomic_clear_uint32_t_bits(&mdc_parent->mde_flags,
-						   MDCACHE_TRUST_ATTRS);
+			mdc_untrust_attrs(mdc_parent);
 		}
 
 		LogFullDebug(COMPONENT_CACHE_INODE,
@@ -410,6 +434,10 @@ fsal_status_t mdcache_open2(struct fsal_obj_handle *obj_hdl,
 
 	invalidate = createmode != FSAL_NO_CREATE;
 
+	/* Let directory delegation holders know */
+	if (created)
+		state_dir_deleg_notify(obj_hdl, NOTIFY4_ADD_ENTRY, name, NULL);
+
 	PTHREAD_RWLOCK_wrlock(&mdc_parent->content_lock);
 
 	/* We will invalidate parent attrs if we did any form of create. */
@@ -511,8 +539,7 @@ fsal_status_t mdcache_reopen2(struct fsal_obj_handle *obj_hdl,
 		mdcache_kill_entry(entry);
 
 	if (truncated && !FSAL_IS_ERROR(status)) {
-		atomic_clear_uint32_t_bits(&entry->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(entry);
 	}
 
 	return status;
@@ -618,8 +645,7 @@ static void mdc_write_cb(struct fsal_obj_handle *obj, fsal_status_t ret,
 		mdcache_kill_entry(entry);
 	}
 	else
-		atomic_clear_uint32_t_bits(&entry->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(entry);
 
 	supercall(
 		  arg->cb(arg->obj_hdl, ret, obj_data, arg->cb_arg);
@@ -746,8 +772,7 @@ fsal_status_t mdcache_commit2(struct fsal_obj_handle *obj_hdl, off_t offset,
 	if (status.major == ERR_FSAL_STALE)
 		mdcache_kill_entry(entry);
 	else
-		atomic_clear_uint32_t_bits(&entry->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(entry);
 
 	return status;
 }
@@ -859,8 +884,99 @@ fsal_status_t mdcache_fallocate(struct fsal_obj_handle *obj_hdl,
 	if (status.major == ERR_FSAL_STALE)
 		mdcache_kill_entry(entry);
 	else
-		atomic_clear_uint32_t_bits(&entry->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(entry);
+
+	return status;
+}
+
+/**
+ * @brief Server side copy
+ *
+ * Pass through to the sub-FSAL.  Any bytes landing in the destination
+ * change its size and change attribute, so its cached attributes are no
+ * longer trusted even if the copy fails part way.
+ *
+ * @param[in]  src_hdl    File to copy from
+ * @param[in]  src_state  Open stateid for the source
+ * @param[in]  src_offset Offset in the source
+ * @param[in]  dst_hdl    File to copy to
+ * @param[in]  dst_state  Open stateid for the destination
+ * @param[in]  dst_offset Offset in the destination
+ * @param[in]  count      Number of bytes to copy
+ * @param[out] copied     Number of bytes copied
+ *
+ * @return FSAL status
+ */
+fsal_status_t mdcache_copy(struct fsal_obj_handle *src_hdl,
+			  struct state_t *src_state, uint64_t src_offset,
+			  struct fsal_obj_handle *dst_hdl,
+			  struct state_t *dst_state, uint64_t dst_offset,
+			  uint64_t count, uint64_t *copied)
+{
+	mdcache_entry_t *src =
+		container_of(src_hdl, mdcache_entry_t, obj_handle);
+	mdcache_entry_t *dst =
+		container_of(dst_hdl, mdcache_entry_t, obj_handle);
+	fsal_status_t status;
+
+	subcall(
+		status = src->sub_handle->obj_ops->copy(
+						src->sub_handle, src_state,
+						src_offset, dst->sub_handle,
+						dst_state, dst_offset, count,
+						copied);
+	       );
+
+	if (status.major == ERR_FSAL_STALE) {
+		mdcache_kill_entry(src);
+		mdcache_kill_entry(dst);
+		return status;
+	}
+
+	if (*copied != 0 || FSAL_IS_ERROR(status))
+		mdc_untrust_attrs(dst);
+
+	return status;
+}
+
+/**
+ * @brief Clone a range of one file into another
+ *
+ * @param[in] src_hdl    File to clone from
+ * @param[in] src_state  Open stateid for the source
+ * @param[in] src_offset Offset in the source
+ * @param[in] dst_hdl    File to clone to
+ * @param[in] dst_state  Open stateid for the destination
+ * @param[in] dst_offset Offset in the destination
+ * @param[in] count      Number of bytes to clone
+ *
+ * @return FSAL status
+ */
+fsal_status_t mdcache_clone(struct fsal_obj_handle *src_hdl,
+			   struct state_t *src_state, uint64_t src_offset,
+			   struct fsal_obj_handle *dst_hdl,
+			   struct state_t *dst_state, uint64_t dst_offset,
+			   uint64_t count)
+{
+	mdcache_entry_t *src =
+		container_of(src_hdl, mdcache_entry_t, obj_handle);
+	mdcache_entry_t *dst =
+		container_of(dst_hdl, mdcache_entry_t, obj_handle);
+	fsal_status_t status;
+
+	subcall(
+		status = src->sub_handle->obj_ops->clone(
+						src->sub_handle, src_state,
+						src_offset, dst->sub_handle,
+						dst_state, dst_offset, count);
+	       );
+
+	if (status.major == ERR_FSAL_STALE) {
+		mdcache_kill_entry(src);
+		mdcache_kill_entry(dst);
+	} else {
+		mdc_untrust_attrs(dst);
+	}
 
 	return status;
 }
@@ -38,6 +38,7 @@
 #include "nfs4_acls.h"
 #include "nfs_exports.h"
 #include "sal_functions.h"
+#include "murmur3.h"
 #include <os/subr.h>
 
 #include "mdcache_lru.h"
@@ -115,8 +116,7 @@ fsal_status_t mdcache_alloc_and_check_handle(
 		/* This function is called after a create, so go ahead
 		 * and invalidate the parent directory attributes.
 		 */
-		atomic_clear_uint32_t_bits(&parent->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(parent);
 	}
 
 	if (mdcache_param.dir.avl_chunk != 0) {
@@ -185,6 +185,194 @@ static fsal_status_t mdcache_lookup(struct fsal_obj_handle *parent,
 	return status;
 }
 
+/**
+ * @brief Callback arg for MDCACHE async metadata calls
+ */
+struct mdc_md_async_arg {
+	mdcache_entry_t *entry;			/**< MDCACHE's entry */
+	struct mdcache_fsal_export *export;	/**< MDCACHE's export */
+	const char *name;			/**< Name being looked up */
+	struct attrlist attrs;			/**< Attributes from sub-FSAL */
+	struct attrlist *attrs_out;		/**< Caller's attributes */
+	fsal_async_cb cb;			/**< Wrapped callback */
+	void *cb_arg;				/**< Wrapped callback data */
+	uint64_t attr_gen;			/**< Entry's attr gen at call */
+	uint64_t dir_gen;			/**< Entry's dir gen at call */
+};
+
+/**
+ * @brief Callback for MDCACHE async lookup
+ *
+ * Cache the entry the sub-FSAL found, add the dirent, and call up.  If the
+ * directory changed while the lookup was out, the name may already be gone,
+ * so the result is dropped and the lookup is redone synchronously.
+ *
+ * @param[in] obj		Sub-FSAL directory
+ * @param[in] ret		Return status of call
+ * @param[in] obj_data		Sub-FSAL handle found
+ * @param[in] caller_data	Data for caller
+ */
+static void mdc_lookup_async_cb(struct fsal_obj_handle *obj,
+				fsal_status_t ret, void *obj_data,
+				void *caller_data)
+{
+	struct mdc_md_async_arg *arg = caller_data;
+	mdcache_entry_t *mdc_parent = arg->entry;
+	struct fsal_obj_handle *sub_handle = obj_data;
+	struct fsal_obj_handle *new_obj = NULL;
+	mdcache_entry_t *entry = NULL;
+	struct fsal_export *save_exp = op_ctx->fsal_export;
+	bool invalidate = false;
+
+	op_ctx->fsal_export = &arg->export->mfe_exp;
+
+	if (FSAL_IS_ERROR(ret)) {
+		LogDebugAlt(COMPONENT_NFS_READDIR, COMPONENT_CACHE_INODE,
+			    "lookup %s failed with %s",
+			    arg->name, fsal_err_txt(ret));
+		goto out;
+	}
+
+	if (mdcache_param.dir.avl_chunk == 0) {
+		PTHREAD_RWLOCK_rdlock(&mdc_parent->content_lock);
+	} else {
+		PTHREAD_RWLOCK_wrlock(&mdc_parent->content_lock);
+
+		/* Someone else may have cached the name while we were out */
+		ret = mdc_try_get_cached(mdc_parent, arg->name, &entry);
+		if (!FSAL_IS_ERROR(ret)) {
+			PTHREAD_RWLOCK_unlock(&mdc_parent->content_lock);
+			sub_handle->obj_ops->release(sub_handle);
+			new_obj = &entry->obj_handle;
+			ret = get_optional_attrs(new_obj, arg->attrs_out);
+			if (FSAL_IS_ERROR(ret)) {
+				mdcache_put(entry);
+				new_obj = NULL;
+			}
+			goto out;
+		}
+	}
+
+	/* Removes bump the dir gen under the content_lock, so either we see
+	 * it here or the remove drops the dirent we add.
+	 */
+	if (atomic_fetch_uint64_t(&mdc_parent->attr_gen) != arg->attr_gen ||
+	    atomic_fetch_uint64_t(&mdc_dir_gen[mdc_dir_gen_slot(mdc_parent)])
+	    != arg->dir_gen) {
+		PTHREAD_RWLOCK_unlock(&mdc_parent->content_lock);
+		LogDebugAlt(COMPONENT_NFS_READDIR, COMPONENT_CACHE_INODE,
+			    "%s changed during lookup, retrying", arg->name);
+		sub_handle->obj_ops->release(sub_handle);
+		ret = mdc_lookup(mdc_parent, arg->name, true, &entry,
+				 arg->attrs_out);
+		if (!FSAL_IS_ERROR(ret))
+			new_obj = &entry->obj_handle;
+		goto out;
+	}
+
+	if (mdcache_param.dir.avl_chunk != 0 &&
+	    !test_mde_flags(mdc_parent, MDCACHE_TRUST_CONTENT))
+		mdcache_dirent_invalidate_all(mdc_parent);
+
+	ret = mdcache_alloc_and_check_handle(arg->export, sub_handle, &new_obj,
+					     false, &arg->attrs,
+					     arg->attrs_out, "lookup ",
+					     mdc_parent, arg->name,
+					     &invalidate, NULL);
+
+	PTHREAD_RWLOCK_unlock(&mdc_parent->content_lock);
+
+out:
+	fsal_release_attrs(&arg->attrs);
+
+	if (ret.major == ERR_FSAL_STALE)
+		ret.major = ERR_FSAL_NOENT;
+
+	arg->cb(&mdc_parent->obj_handle, ret, new_obj, arg->cb_arg);
+
+	op_ctx->fsal_export = save_exp;
+	gsh_free(arg);
+}
+
+/**
+ * @brief Look up a name asynchronously
+ *
+ * Hits in the dirent cache are answered inline; misses go to the sub-FSAL's
+ * lookup_async without holding the content_lock, and the result is cached
+ * when it comes back.
+ *
+ * @param[in]     parent     Handle of parent
+ * @param[in]     name       Name to look up
+ * @param[in,out] attrs_out  Optional attributes for the object found
+ * @param[in]     done_cb    Callback to call when the lookup is done
+ * @param[in]     caller_arg Opaque arg from the caller for callback
+ */
+static void mdcache_lookup_async(struct fsal_obj_handle *parent,
+				 const char *name,
+				 struct attrlist *attrs_out,
+				 fsal_async_cb done_cb,
+				 void *caller_arg)
+{
+	mdcache_entry_t *mdc_parent =
+		container_of(parent, mdcache_entry_t, obj_handle);
+	mdcache_entry_t *entry = NULL;
+	struct mdc_md_async_arg *arg;
+	fsal_status_t status;
+
+	if (!strcmp(name, "..")) {
+		/* ".." doesn't end up in the cache */
+		status = mdc_lookup(mdc_parent, name, true, &entry, attrs_out);
+		goto inline_cb;
+	}
+
+	PTHREAD_RWLOCK_rdlock(&mdc_parent->content_lock);
+	status = mdc_try_get_cached(mdc_parent, name, &entry);
+	PTHREAD_RWLOCK_unlock(&mdc_parent->content_lock);
+
+	if (!FSAL_IS_ERROR(status)) {
+		status = get_optional_attrs(&entry->obj_handle, attrs_out);
+		if (FSAL_IS_ERROR(status)) {
+			mdcache_put(entry);
+			entry = NULL;
+		}
+		goto inline_cb;
+	} else if (status.major != ERR_FSAL_STALE) {
+		/* Negative cache hit */
+		goto inline_cb;
+	}
+
+	LogDebugAlt(COMPONENT_NFS_READDIR, COMPONENT_CACHE_INODE,
+		    "Cache Miss detected for %s, going async", name);
+
+	arg = gsh_calloc(1, sizeof(*arg));
+	arg->entry = mdc_parent;
+	arg->export = mdc_cur_export();
+	arg->name = name;
+	arg->attrs_out = attrs_out;
+	arg->cb = done_cb;
+	arg->cb_arg = caller_arg;
+	arg->attr_gen = atomic_fetch_uint64_t(&mdc_parent->attr_gen);
+	arg->dir_gen = atomic_fetch_uint64_t(
+			&mdc_dir_gen[mdc_dir_gen_slot(mdc_parent)]);
+
+	/* Ask for all supported attributes except ACL (we defer fetching ACL
+	 * until asked for it (including a permission check).
+	 */
+	fsal_prepare_attrs(&arg->attrs,
+			   op_ctx->fsal_export->exp_ops.fs_supported_attrs(
+					op_ctx->fsal_export) & ~ATTR_ACL);
+
+	subcall(
+		mdc_parent->sub_handle->obj_ops->lookup_async(
+			mdc_parent->sub_handle, name, &arg->attrs,
+			mdc_lookup_async_cb, arg)
+	       );
+	return;
+
+inline_cb:
+	done_cb(parent, status, entry ? &entry->obj_handle : NULL, caller_arg);
+}
+
 /**
  * @brief Make a directory
  *
@@ -241,6 +429,9 @@ static fsal_status_t mdcache_mkdir(struct fsal_obj_handle *dir_hdl,
 		return status;
 	}
 
+	/* Let directory delegation holders know */
+	state_dir_deleg_notify(dir_hdl, NOTIFY4_ADD_ENTRY, name, NULL);
+
 	PTHREAD_RWLOCK_wrlock(&parent->content_lock);
 
 	status = mdcache_alloc_and_check_handle(export, sub_handle, handle,
@@ -321,6 +512,9 @@ static fsal_status_t mdcache_mknode(struct fsal_obj_handle *dir_hdl,
 		return status;
 	}
 
+	/* Let directory delegation holders know */
+	state_dir_deleg_notify(dir_hdl, NOTIFY4_ADD_ENTRY, name, NULL);
+
 	PTHREAD_RWLOCK_wrlock(&parent->content_lock);
 
 	status = mdcache_alloc_and_check_handle(export, sub_handle, handle,
@@ -401,6 +595,9 @@ static fsal_status_t mdcache_symlink(struct fsal_obj_handle *dir_hdl,
 		return status;
 	}
 
+	/* Let directory delegation holders know */
+	state_dir_deleg_notify(dir_hdl, NOTIFY4_ADD_ENTRY, name, NULL);
+
 	PTHREAD_RWLOCK_wrlock(&parent->content_lock);
 
 	status = mdcache_alloc_and_check_handle(export, sub_handle, handle,
@@ -495,6 +692,8 @@ static fsal_status_t mdcache_link(struct fsal_obj_handle *obj_hdl,
 		return status;
 	}
 
+	state_dir_deleg_notify(destdir_hdl, NOTIFY4_ADD_ENTRY, name, NULL);
+
 	if (mdcache_param.dir.avl_chunk != 0) {
 		PTHREAD_RWLOCK_wrlock(&dest->content_lock);
 
@@ -506,7 +705,7 @@ static fsal_status_t mdcache_link(struct fsal_obj_handle *obj_hdl,
 	}
 
 	/* Invalidate attributes, so refresh will be forced */
-	atomic_clear_uint32_t_bits(&entry->mde_flags, MDCACHE_TRUST_ATTRS);
+	mdc_untrust_attrs(entry);
 
 	if (FSAL_IS_SUCCESS(status) && !invalidate) {
 		/* Refresh destination directory attributes without
@@ -585,6 +784,31 @@ static fsal_status_t mdcache_readdir(struct fsal_obj_handle *dir_hdl,
  *
  * @return FSAL status.
  */
+static inline uint64_t mdc_groups_hash(const struct user_cred *creds)
+{
+	uint64_t hash[2];
+
+	if (creds->caller_glen == 0)
+		return 0;
+
+	MurmurHash3_x64_128(creds->caller_garray,
+			    creds->caller_glen * sizeof(gid_t), 0, hash);
+	return hash[0];
+}
+
+static inline bool mdc_access_match(const struct mdc_access_result *res,
+				    const struct user_cred *creds,
+				    uint64_t groups_hash,
+				    fsal_accessflags_t access_type)
+{
+	return res->access_type == access_type &&
+	       res->uid == creds->caller_uid &&
+	       res->gid == creds->caller_gid &&
+	       res->glen == creds->caller_glen &&
+	       res->groups_hash == groups_hash &&
+	       res->fsal_export == op_ctx->fsal_export;
+}
+
 static fsal_status_t mdcache_test_access(struct fsal_obj_handle *obj_hdl,
 					 fsal_accessflags_t access_type,
 					 fsal_accessflags_t *allowed,
@@ -593,12 +817,97 @@ static fsal_status_t mdcache_test_access(struct fsal_obj_handle *obj_hdl,
 {
 	mdcache_entry_t *entry =
 		container_of(obj_hdl, mdcache_entry_t, obj_handle);
+	const struct user_cred *creds = op_ctx->creds;
+	struct mdc_access_result *res;
+	fsal_accessflags_t res_allowed = 0, res_denied = 0;
+	fsal_status_t status;
+	uint64_t groups_hash;
+	attrmask_t mask;
+	uint32_t gen, i;
 
-	if (owner_skip && entry->attrs.owner == op_ctx->creds->caller_uid)
+	if (owner_skip && entry->attrs.owner == creds->caller_uid)
 		return fsalstat(ERR_FSAL_NO_ERROR, 0);
 
-	return fsal_test_access(obj_hdl, access_type, allowed, denied,
-				owner_skip);
+	/* An owner_skip result says nothing about the mode bits, so it
+	 * can't be reused for other checks.
+	 */
+	if (!mdcache_param.cache_access || owner_skip)
+		return fsal_test_access(obj_hdl, access_type, allowed, denied,
+					owner_skip);
+
+	/* Same attributes fsal_test_access() will look at */
+	mask = op_ctx->fsal_export->exp_ops.fs_supported_attrs(
+					op_ctx->fsal_export)
+	       & (ATTRS_CREDS | ATTR_MODE | ATTR_ACL);
+	groups_hash = mdc_groups_hash(creds);
+
+	PTHREAD_RWLOCK_rdlock(&entry->attr_lock);
+
+	if (mdcache_is_attrs_valid(entry, mask)) {
+		for (i = 0; i < entry->access_count; i++) {
+			res = &entry->access_cache[i];
+
+			if (!mdc_access_match(res, creds, groups_hash,
+					      access_type))
+				continue;
+
+			if (allowed != NULL)
+				*allowed = res->allowed;
+			if (denied != NULL)
+				*denied = res->denied;
+			status = fsalstat(res->status, 0);
+
+			PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+			(void)atomic_inc_uint64_t(&cache_stp->access_hit);
+			return status;
+		}
+	}
+
+	gen = atomic_fetch_uint32_t(&entry->access_gen);
+
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	(void)atomic_inc_uint64_t(&cache_stp->access_miss);
+
+	status = fsal_test_access(obj_hdl, access_type, &res_allowed,
+				  &res_denied, owner_skip);
+
+	if (allowed != NULL)
+		*allowed = res_allowed;
+	if (denied != NULL)
+		*denied = res_denied;
+
+	/* Only cache definite answers */
+	if (status.major != ERR_FSAL_NO_ERROR &&
+	    status.major != ERR_FSAL_ACCESS)
+		return status;
+
+	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
+
+	/* If the attributes changed under us, this result may be stale */
+	if (entry->access_gen == gen) {
+		if (entry->access_count < MDC_ACCESS_CACHE_SIZE) {
+			res = &entry->access_cache[entry->access_count++];
+		} else {
+			res = &entry->access_cache[entry->access_next];
+			entry->access_next = (entry->access_next + 1) %
+					     MDC_ACCESS_CACHE_SIZE;
+		}
+
+		res->fsal_export = op_ctx->fsal_export;
+		res->groups_hash = groups_hash;
+		res->uid = creds->caller_uid;
+		res->gid = creds->caller_gid;
+		res->glen = creds->caller_glen;
+		res->access_type = access_type;
+		res->allowed = res_allowed;
+		res->denied = res_denied;
+		res->status = status.major;
+	}
+
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	return status;
 }
 
 /**
@@ -665,23 +974,30 @@ static fsal_status_t mdcache_rename(struct fsal_obj_handle *obj_hdl,
 	if (FSAL_IS_ERROR(status))
 		goto unlock;
 
+	/* Let directory delegation holders know */
+	if (olddir_hdl == newdir_hdl) {
+		state_dir_deleg_notify(olddir_hdl, NOTIFY4_RENAME_ENTRY,
+				       old_name, new_name);
+	} else {
+		state_dir_deleg_notify(olddir_hdl, NOTIFY4_REMOVE_ENTRY,
+				       old_name, NULL);
+		state_dir_deleg_notify(newdir_hdl, NOTIFY4_ADD_ENTRY,
+				       new_name, NULL);
+	}
+
 	if (mdc_lookup_dst != NULL) {
 		/* Mark target file attributes as invalid */
-		atomic_clear_uint32_t_bits(&mdc_lookup_dst->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(mdc_lookup_dst);
 	}
 
 	/* Mark renamed file attributes as invalid */
-	atomic_clear_uint32_t_bits(&mdc_obj->mde_flags,
-				   MDCACHE_TRUST_ATTRS);
+	mdc_untrust_attrs(mdc_obj);
 
 	/* Mark directory attributes as invalid */
-	atomic_clear_uint32_t_bits(&mdc_olddir->mde_flags,
-				   MDCACHE_TRUST_ATTRS);
+	mdc_untrust_attrs(mdc_olddir);
 
 	if (olddir_hdl != newdir_hdl) {
-		atomic_clear_uint32_t_bits(&mdc_newdir->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(mdc_newdir);
 	}
 
 	/* NOTE: Below we mostly don't check if the directory is not
@@ -790,6 +1106,79 @@ out:
 	return status;
 }
 
+static inline bool mdc_has_file_deleg(mdcache_entry_t *entry)
+{
+	return entry->obj_handle.state_hdl &&
+	  entry->obj_handle.state_hdl->file.fdeleg_stats.fds_curr_delegations;
+}
+
+/**
+ * @brief Prepare an attribute list to refresh an mdcache entry
+ *
+ * @param[out] attrs		Attribute list to prepare
+ * @param[in] need_acl		Indicates if the ACL needs updating.
+ * @param[in] need_fslocations	Indicates if the fslocations are needed.
+ */
+
+static void mdc_prepare_refresh_attrs(struct attrlist *attrs, bool need_acl,
+				      bool need_fslocations)
+{
+	/* We always ask for all regular attributes, even if the caller was
+	 * only interested in the ACL unless the file is delegated.
+	 */
+	fsal_prepare_attrs(attrs,
+			   op_ctx->fsal_export->exp_ops.fs_supported_attrs(
+					op_ctx->fsal_export) | ATTR_RDATTR_ERR);
+
+	if (!need_acl) {
+		/* Don't request the ACL if not necessary. */
+		attrs->request_mask &= ~ATTR_ACL;
+	}
+
+	if (!need_fslocations) {
+		/* Don't request FS LOCATIONS if not required */
+		attrs->request_mask &= ~ATTR4_FS_LOCATIONS;
+	}
+}
+
+/**
+ * @brief Finish refreshing the attributes for an mdcache entry
+ *
+ * @note The caller must hold the attribute lock for WRITE
+ *
+ * @param[in] entry		The mdcache entry that was refreshed.
+ * @param[in] file_deleg	The file is delegated.
+ * @param[in] oldmtime		mtime before the refresh.
+ * @param[in] invalidate	Invalidate the dirent cache if the entry is a
+ *				directory.
+ */
+
+static void mdc_refresh_attrs_done(mdcache_entry_t *entry, bool file_deleg,
+				   struct timespec *oldmtime, bool invalidate)
+{
+	cbgetattr_t *cbgetattr;
+
+	/* Always save copy of latest change and filesize
+	 * to compare with values returned in cbgetattr response
+	 */
+	if (file_deleg) {
+		cbgetattr = &entry->obj_handle.state_hdl->file.cbgetattr;
+		cbgetattr->change = entry->attrs.change;
+		cbgetattr->filesize = entry->attrs.filesize;
+	}
+
+	LogAttrlist(COMPONENT_CACHE_INODE, NIV_FULL_DEBUG,
+		    "attrs ", &entry->attrs, true);
+
+	if (invalidate && entry->obj_handle.type == DIRECTORY &&
+	    gsh_time_cmp(oldmtime, &entry->attrs.mtime) < 0) {
+
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+		mdcache_dirent_invalidate_all(entry);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+	}
+}
+
 /**
  * @brief Refresh the attributes for an mdcache entry.
  *
@@ -812,30 +1201,13 @@ fsal_status_t mdcache_refresh_attrs(mdcache_entry_t *entry, bool need_acl,
 	fsal_status_t status = {0, 0};
 	struct timespec oldmtime;
 	bool file_deleg = false;
-	cbgetattr_t *cbgetattr;
 
 	/* Use this to detect if we should invalidate a directory. */
 	oldmtime = entry->attrs.mtime;
 
-	file_deleg = (entry->obj_handle.state_hdl &&
-	  entry->obj_handle.state_hdl->file.fdeleg_stats.fds_curr_delegations);
+	file_deleg = mdc_has_file_deleg(entry);
 
-	/* We always ask for all regular attributes, even if the caller was
-	 * only interested in the ACL unless the file is delegated.
-	 */
-	fsal_prepare_attrs(&attrs,
-			   op_ctx->fsal_export->exp_ops.fs_supported_attrs(
-					op_ctx->fsal_export) | ATTR_RDATTR_ERR);
-
-	if (!need_acl) {
-		/* Don't request the ACL if not necessary. */
-		attrs.request_mask &= ~ATTR_ACL;
-	}
-
-	if (!need_fslocations) {
-		/* Don't request FS LOCATIONS if not required */
-		attrs.request_mask &= ~ATTR4_FS_LOCATIONS;
-	}
+	mdc_prepare_refresh_attrs(&attrs, need_acl, need_fslocations);
 
 	if (file_deleg && entry->attrs.expire_time_attr) {
 		/* If the file is delegated, then we can trust
@@ -881,25 +1253,7 @@ out:
 	 */
 	fsal_release_attrs(&attrs);
 
-	/* Always save copy of latest change and filesize
-	 * to compare with values returned in cbgetattr response
-	 */
-	if (file_deleg) {
-		cbgetattr = &entry->obj_handle.state_hdl->file.cbgetattr;
-		cbgetattr->change = entry->attrs.change;
-		cbgetattr->filesize = entry->attrs.filesize;
-	}
-
-	LogAttrlist(COMPONENT_CACHE_INODE, NIV_FULL_DEBUG,
-		    "attrs ", &entry->attrs, true);
-
-	if (invalidate && entry->obj_handle.type == DIRECTORY &&
-	    gsh_time_cmp(&oldmtime, &entry->attrs.mtime) < 0) {
-
-		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
-		mdcache_dirent_invalidate_all(entry);
-		PTHREAD_RWLOCK_unlock(&entry->content_lock);
-	}
+	mdc_refresh_attrs_done(entry, file_deleg, &oldmtime, invalidate);
 
 	return status;
 }
@@ -970,6 +1324,153 @@ unlock_no_attrs:
 	return status;
 }
 
+/**
+ * @brief Callback for MDCACHE async getattrs
+ *
+ * Update the attribute cache, copy out, and call up.  If the attributes
+ * changed while the call was out, what came back may be older than the
+ * cache, so it is dropped and the attributes are fetched synchronously.
+ *
+ * @param[in] obj		Sub-FSAL object
+ * @param[in] ret		Return status of call
+ * @param[in] obj_data		Sub-FSAL attributes
+ * @param[in] caller_data	Data for caller
+ */
+static void mdc_getattrs_async_cb(struct fsal_obj_handle *obj,
+				  fsal_status_t ret, void *obj_data,
+				  void *caller_data)
+{
+	struct mdc_md_async_arg *arg = caller_data;
+	mdcache_entry_t *entry = arg->entry;
+	struct attrlist *attrs_out = arg->attrs_out;
+	struct fsal_export *save_exp = op_ctx->fsal_export;
+	struct timespec oldmtime;
+	uint64_t gen;
+
+	op_ctx->fsal_export = &arg->export->mfe_exp;
+
+	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
+
+	if (!FSAL_IS_ERROR(ret) && entry->attr_gen != arg->attr_gen) {
+		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+		LogDebug(COMPONENT_CACHE_INODE,
+			 "attributes of %p changed during getattrs, retrying",
+			 entry);
+		fsal_release_attrs(&arg->attrs);
+		ret = mdcache_getattrs(&entry->obj_handle, attrs_out);
+		goto out;
+	}
+
+	if (FSAL_IS_ERROR(ret)) {
+		/* We do not change the validity of the current entry
+		 * attributes.
+		 */
+		if (attrs_out->request_mask & ATTR_RDATTR_ERR)
+			attrs_out->valid_mask = ATTR_RDATTR_ERR;
+	} else {
+		oldmtime = entry->attrs.mtime;
+
+		/* We will want all the requested attributes in the entry */
+		entry->attrs.request_mask = arg->attrs.request_mask;
+		if (entry->attrs.acl != NULL) {
+			/* request_mask & ATTR_ACL must match attrs.acl */
+			entry->attrs.request_mask |= ATTR_ACL;
+		}
+
+		mdc_update_attr_cache(entry, &arg->attrs);
+		gen = entry->attr_gen;
+		mdc_refresh_attrs_done(entry, false, &oldmtime, true);
+
+		/* mdc_untrust_attrs() does not take the attr_lock.  It bumps
+		 * the generation before clearing the flag, so if it raced with
+		 * us, either we see the bump or it clears the flag after us.
+		 */
+		if (atomic_fetch_uint64_t(&entry->attr_gen) != gen)
+			atomic_clear_uint32_t_bits(&entry->mde_flags,
+						   MDCACHE_TRUST_ATTRS);
+
+		/* Struct copy */
+		fsal_copy_attrs(attrs_out, &entry->attrs, false);
+	}
+
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	fsal_release_attrs(&arg->attrs);
+
+	if (ret.major == ERR_FSAL_STALE)
+		mdcache_kill_entry(entry);
+
+out:
+	arg->cb(&entry->obj_handle, ret, attrs_out, arg->cb_arg);
+
+	op_ctx->fsal_export = save_exp;
+	gsh_free(arg);
+}
+
+/**
+ * @brief Get the attributes for an object asynchronously
+ *
+ * Valid cached attributes are returned inline.  Otherwise the sub-FSAL is
+ * asked without holding the attr_lock, and the cache is updated from the
+ * callback.  Delegated files need a partial refresh under the attr_lock, so
+ * they are done synchronously.
+ *
+ * @param[in]     obj_hdl    Object to get attributes from
+ * @param[in,out] attrs_out  Attributes fetched
+ * @param[in]     done_cb    Callback to call when attributes are available
+ * @param[in]     caller_arg Opaque arg from the caller for callback
+ */
+static void mdcache_getattrs_async(struct fsal_obj_handle *obj_hdl,
+				   struct attrlist *attrs_out,
+				   fsal_async_cb done_cb,
+				   void *caller_arg)
+{
+	mdcache_entry_t *entry =
+		container_of(obj_hdl, mdcache_entry_t, obj_handle);
+	struct mdc_md_async_arg *arg;
+	fsal_status_t status = {0, 0};
+	bool file_deleg;
+
+	PTHREAD_RWLOCK_rdlock(&entry->attr_lock);
+
+	if (mdcache_is_attrs_valid(entry, attrs_out->request_mask)) {
+		/* Up-to-date, struct copy */
+		fsal_copy_attrs(attrs_out, &entry->attrs, false);
+		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+		done_cb(obj_hdl, status, attrs_out, caller_arg);
+		return;
+	}
+
+	file_deleg = mdc_has_file_deleg(entry);
+
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	if (file_deleg) {
+		status = mdcache_getattrs(obj_hdl, attrs_out);
+		done_cb(obj_hdl, status, attrs_out, caller_arg);
+		return;
+	}
+
+	arg = gsh_calloc(1, sizeof(*arg));
+	arg->entry = entry;
+	arg->export = mdc_cur_export();
+	arg->attrs_out = attrs_out;
+	arg->cb = done_cb;
+	arg->cb_arg = caller_arg;
+	arg->attr_gen = atomic_fetch_uint64_t(&entry->attr_gen);
+
+	mdc_prepare_refresh_attrs(&arg->attrs,
+				  (attrs_out->request_mask & ATTR_ACL) != 0,
+				  (attrs_out->request_mask &
+				   ATTR4_FS_LOCATIONS) != 0);
+
+	subcall(
+		entry->sub_handle->obj_ops->getattrs_async(
+			entry->sub_handle, &arg->attrs,
+			mdc_getattrs_async_cb, arg)
+	       );
+}
+
 /**
  * @brief Set attributes on an object (new style)
  *
@@ -1003,6 +1504,9 @@ static fsal_status_t mdcache_setattr2(struct fsal_obj_handle *obj_hdl,
 		goto out;
 	}
 
+	/* Mode and ownership changes can change ACL xattrs */
+	mdc_xattr_invalidate(entry);
+
 	/* In case of ACL enabled, any of the below attribute changes
 	 * result in change of ACL set as well.
 	 */
@@ -1017,8 +1521,9 @@ static fsal_status_t mdcache_setattr2(struct fsal_obj_handle *obj_hdl,
 					false /*need_fslocations*/, false);
 	if (FSAL_IS_ERROR(status2)) {
 		/* Assume that the cache is bogus now */
+		mdc_untrust_attrs(entry);
 		atomic_clear_uint32_t_bits(&entry->mde_flags,
-				MDCACHE_TRUST_ATTRS | MDCACHE_TRUST_ACL |
+				MDCACHE_TRUST_ACL |
 				MDCACHE_TRUST_FS_LOCATIONS |
 				MDCACHE_TRUST_SEC_LABEL);
 		if (status2.major == ERR_FSAL_STALE)
@@ -1029,6 +1534,7 @@ static fsal_status_t mdcache_setattr2(struct fsal_obj_handle *obj_hdl,
 			 (long long int) change,
 			 (long long int) entry->attrs.change);
 		entry->attrs.change = change + 1;
+		mdc_flush_encoded_attrs(entry);
 	}
 	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
 out:
@@ -1088,15 +1594,16 @@ static fsal_status_t mdcache_unlink(struct fsal_obj_handle *dir_hdl,
 			return status;
 		}
 	} else {
+		state_dir_deleg_notify(dir_hdl, NOTIFY4_REMOVE_ENTRY, name,
+				       NULL);
+
 		PTHREAD_RWLOCK_wrlock(&parent->content_lock);
 		mdcache_dirent_remove(parent, name);
 		PTHREAD_RWLOCK_unlock(&parent->content_lock);
 
 		/* Invalidate attributes of parent and entry */
-		atomic_clear_uint32_t_bits(&parent->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
-		atomic_clear_uint32_t_bits(&entry->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(parent);
+		mdc_untrust_attrs(entry);
 
 		if (entry->obj_handle.type == DIRECTORY) {
 			PTHREAD_RWLOCK_wrlock(&entry->content_lock);
@@ -1288,8 +1795,7 @@ static nfsstat4 mdcache_layoutcommit(struct fsal_obj_handle *obj_hdl,
 	       );
 
 	if (status == NFS4_OK)
-		atomic_clear_uint32_t_bits(&entry->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(entry);
 
 	return status;
 }
@@ -1448,6 +1954,143 @@ out:
 	return result;
 }
 
+/**
+ * @brief Find a cached attribute encoding
+ *
+ * @note The caller must hold the attribute lock
+ *
+ * @param[in] entry	Entry to search
+ * @param[in] key	Key of the encoding
+ *
+ * @return The encoding, or NULL if there is none.
+ */
+static struct mdc_encoded_attrs *
+mdc_find_encoded_attrs(mdcache_entry_t *entry, const struct gsh_buffdesc *key)
+{
+	uint32_t i;
+
+	for (i = 0; i < entry->encoded_count; i++) {
+		struct mdc_encoded_attrs *enc = &entry->encoded_attrs[i];
+
+		if (enc->key_len == key->len &&
+		    memcmp(enc->key, key->addr, key->len) == 0)
+			return enc;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Fetch a cached attribute encoding
+ *
+ * A hit needs the cached attributes in @a mask to still be valid, so an
+ * encoding never outlives the attributes it was made from.
+ *
+ * @param[in]  obj_hdl  Object whose attributes are wanted
+ * @param[in]  key      Protocol key for the encoding
+ * @param[in]  mask     Attributes the encoding depends on
+ * @param[out] blob     Copy of the cached encoding
+ * @param[out] gen      Attribute generation on a miss
+ *
+ * @return true if @a blob was filled in.
+ */
+static bool mdcache_get_encoded_attrs(struct fsal_obj_handle *obj_hdl,
+				      const struct gsh_buffdesc *key,
+				      attrmask_t mask,
+				      struct gsh_buffdesc *blob,
+				      uint64_t *gen)
+{
+	mdcache_entry_t *entry =
+		container_of(obj_hdl, mdcache_entry_t, obj_handle);
+	struct mdc_encoded_attrs *enc;
+
+	if (!mdcache_param.cache_encoded_attrs ||
+	    key->len > MDC_ENCODED_KEY_MAX) {
+		*gen = 0;
+		return false;
+	}
+
+	PTHREAD_RWLOCK_rdlock(&entry->attr_lock);
+
+	if (mdcache_is_attrs_valid(entry, mask)) {
+		enc = mdc_find_encoded_attrs(entry, key);
+
+		if (enc != NULL) {
+			blob->addr = gsh_malloc(enc->len);
+			memcpy(blob->addr, enc->blob, enc->len);
+			blob->len = enc->len;
+
+			PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+			(void)atomic_inc_uint64_t(&cache_stp->encoded_hit);
+			return true;
+		}
+	}
+
+	*gen = atomic_fetch_uint64_t(&entry->attr_gen);
+
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	(void)atomic_inc_uint64_t(&cache_stp->encoded_miss);
+	return false;
+}
+
+/**
+ * @brief Remember an attribute encoding
+ *
+ * @param[in] obj_hdl  Object the attributes were fetched from
+ * @param[in] key      Protocol key for the encoding
+ * @param[in] gen      Generation returned by mdcache_get_encoded_attrs()
+ * @param[in] blob     The encoding
+ */
+static void mdcache_put_encoded_attrs(struct fsal_obj_handle *obj_hdl,
+				      const struct gsh_buffdesc *key,
+				      uint64_t gen,
+				      const struct gsh_buffdesc *blob)
+{
+	mdcache_entry_t *entry =
+		container_of(obj_hdl, mdcache_entry_t, obj_handle);
+	struct mdc_encoded_attrs *enc;
+	void *copy;
+
+	if (!mdcache_param.cache_encoded_attrs ||
+	    key->len > MDC_ENCODED_KEY_MAX ||
+	    blob->len == 0 || blob->len > MDC_ENCODED_ATTRS_MAX)
+		return;
+
+	/* Copy outside the lock, we may throw it away */
+	copy = gsh_malloc(blob->len);
+	memcpy(copy, blob->addr, blob->len);
+
+	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
+
+	/* If the attributes changed under us, this encoding may be stale */
+	if (entry->attr_gen != gen) {
+		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+		gsh_free(copy);
+		return;
+	}
+
+	enc = mdc_find_encoded_attrs(entry, key);
+
+	if (enc == NULL) {
+		if (entry->encoded_count < MDC_ENCODED_ATTRS_SIZE) {
+			enc = &entry->encoded_attrs[entry->encoded_count++];
+		} else {
+			enc = &entry->encoded_attrs[entry->encoded_next];
+			entry->encoded_next = (entry->encoded_next + 1) %
+					      MDC_ENCODED_ATTRS_SIZE;
+		}
+		enc->key_len = key->len;
+		memcpy(enc->key, key->addr, key->len);
+	}
+
+	gsh_free(enc->blob);
+	enc->blob = copy;
+	enc->len = blob->len;
+
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+}
+
 void mdcache_handle_ops_init(struct fsal_obj_ops *ops)
 {
 	fsal_default_obj_ops_init(ops);
@@ -1493,6 +2136,14 @@ void mdcache_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->setattr2 = mdcache_setattr2;
 	ops->close2 = mdcache_close2;
 	ops->fallocate = mdcache_fallocate;
+	ops->copy = mdcache_copy;
+	ops->clone = mdcache_clone;
+	ops->getattrs_async = mdcache_getattrs_async;
+	ops->lookup_async = mdcache_lookup_async;
+	ops->get_encoded_attrs = mdcache_get_encoded_attrs;
+	ops->put_encoded_attrs = mdcache_put_encoded_attrs;
+	ops->lookup_cached_path = mdcache_lookup_cached_path;
+	ops->cache_path = mdcache_cache_path;
 
 	/* xattr related functions */
 	ops->list_ext_attrs = mdcache_list_ext_attrs;
@@ -209,6 +209,9 @@ static mdcache_entry_t *_mdcache_alloc_handle(
 
 	/* Initialize common fields */
 	result->mde_flags = 0;
+	result->access_count = 0;
+	result->encoded_count = 0;
+	mdc_xattr_invalidate(result);
 	glist_init(&result->export_list);
 	atomic_store_int32_t(&result->first_export_id, -1);
 
@@ -605,6 +608,8 @@ void mdcache_dirent_invalidate_all(mdcache_entry_t *entry)
 	/* Clean the active and deleted trees */
 	mdcache_avl_clean_trees(entry);
 
+	mdc_dir_gen_bump(entry);
+
 	atomic_clear_uint32_t_bits(&entry->mde_flags, MDCACHE_DIR_POPULATED);
 
 	atomic_set_uint32_t_bits(&entry->mde_flags, MDCACHE_TRUST_CONTENT |
@@ -1521,6 +1526,8 @@ mdcache_dirent_add(mdcache_entry_t *parent, const char *name,
 
 	LogFullDebug(COMPONENT_CACHE_INODE, "Add dir entry %s", name);
 
+	mdc_dir_gen_bump(parent);
+
 	if (name[0] == '\0') {
 		/* An empty dirent name is invalid */
 		LogInfo(COMPONENT_CACHE_INODE,
@@ -1584,6 +1591,8 @@ void mdcache_dirent_remove(mdcache_entry_t *parent, const char *name)
 #ifdef DEBUG_MDCACHE
 	assert(parent->content_lock.__data.__cur_writer);
 #endif
+	mdc_dir_gen_bump(parent);
+
 	/* Don't remove if we aren't doing dirent caching or the cache is empty
 	 */
 	if (mdcache_param.dir.avl_chunk != 0 &&
@@ -3468,6 +3477,36 @@ _mdcache_kill_entry(mdcache_entry_t *entry,
  */
 void mdc_update_attr_cache(mdcache_entry_t *entry, struct attrlist *attrs)
 {
+	/* Permission checks depend on owner, group, mode and ACL only.
+	 * ACLs are shared between entries with the same ACEs, so a pointer
+	 * compare is enough, and a NULL ACL with ATTR_ACL set means the ACL
+	 * was removed.
+	 */
+	bool perms_changed =
+		((attrs->valid_mask & ATTR_MODE) &&
+		 attrs->mode != entry->attrs.mode) ||
+		((attrs->valid_mask & ATTR_OWNER) &&
+		 attrs->owner != entry->attrs.owner) ||
+		((attrs->valid_mask & ATTR_GROUP) &&
+		 attrs->group != entry->attrs.group) ||
+		((attrs->valid_mask & ATTR_ACL) &&
+		 attrs->acl != entry->attrs.acl);
+
+	/* Flush even when nothing is cached, the generation bump is what
+	 * stops a check computed against the old attributes from being
+	 * stored once we are done.
+	 */
+	if (perms_changed)
+		mdc_flush_access_cache(entry);
+
+	/* Cached paths crossing a directory are only valid while anybody
+	 * may search it.
+	 */
+	if (perms_changed && entry->obj_handle.type == DIRECTORY)
+		mdc_dir_gen_bump(entry);
+
+	mdc_flush_encoded_attrs(entry);
+
 	if (entry->attrs.acl != NULL) {
 		/* We used to have an ACL... */
 		if (attrs->acl != NULL) {
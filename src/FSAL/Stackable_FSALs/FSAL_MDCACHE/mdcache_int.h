@@ -188,6 +188,49 @@ struct mdcache_stats {
 	uint64_t inode_conf;
 	uint64_t inode_added;
 	uint64_t inode_mapping;
+	uint64_t access_hit;
+	uint64_t access_miss;
+	uint64_t encoded_hit;
+	uint64_t encoded_miss;
+	uint64_t path_hit;
+	uint64_t path_miss;
+	uint64_t xattr_hit;
+	uint64_t xattr_miss;
+};
+
+/** Number of access results cached per entry */
+#define MDC_ACCESS_CACHE_SIZE 4
+
+/**
+ * @brief A cached test_access() result for one set of credentials
+ */
+struct mdc_access_result {
+	const struct fsal_export *fsal_export;	/*< superuser is per export */
+	uint64_t groups_hash;		/*< hash of the alternate groups */
+	uid_t uid;
+	gid_t gid;
+	int glen;
+	fsal_accessflags_t access_type;	/*< access that was asked for */
+	fsal_accessflags_t allowed;
+	fsal_accessflags_t denied;
+	fsal_errors_t status;		/*< ERR_FSAL_NO_ERROR or ACCESS */
+};
+
+/** Number of attribute encodings cached per entry */
+#define MDC_ENCODED_ATTRS_SIZE 2
+/** Largest key for an attribute encoding */
+#define MDC_ENCODED_KEY_MAX 32
+/** Largest attribute encoding worth caching */
+#define MDC_ENCODED_ATTRS_MAX 512
+
+/**
+ * @brief A protocol encoding of the cached attributes
+ */
+struct mdc_encoded_attrs {
+	size_t key_len;
+	char key[MDC_ENCODED_KEY_MAX];	/*< opaque to MDCACHE */
+	size_t len;
+	void *blob;			/*< gsh_malloc'd encoding */
 };
 
 extern struct mdcache_stats *cache_stp;
@@ -295,6 +338,24 @@ struct mdcache_fsal_obj_handle {
 	time_t acl_time;
 	/** Time at which we last refreshed fs locations */
 	time_t fs_locations_time;
+	/** Cached access results (protected by attr_lock) */
+	struct mdc_access_result access_cache[MDC_ACCESS_CACHE_SIZE];
+	/** Number of valid access_cache slots (protected by attr_lock) */
+	uint32_t access_count;
+	/** Next access_cache slot to reuse (protected by attr_lock) */
+	uint32_t access_next;
+	/** Bumped whenever access_cache is flushed */
+	uint32_t access_gen;
+	/** Cached attribute encodings (protected by attr_lock) */
+	struct mdc_encoded_attrs encoded_attrs[MDC_ENCODED_ATTRS_SIZE];
+	/** Number of valid encoded_attrs slots (protected by attr_lock) */
+	uint32_t encoded_count;
+	/** Next encoded_attrs slot to reuse (protected by attr_lock) */
+	uint32_t encoded_next;
+	/** Bumped whenever the cached attributes change */
+	uint64_t attr_gen;
+	/** Generation of the cached xattrs, see mdc_xattr_invalidate() */
+	uint64_t xattr_gen;
 	/** New style LRU link */
 	mdcache_lru_t lru;
 	/** Exports per entry (protected by attr_lock) */
@@ -538,6 +599,114 @@ fsal_status_t mdc_get_parent(struct mdcache_fsal_export *exp,
 
 void mdc_update_attr_cache(mdcache_entry_t *entry, struct attrlist *attrs);
 
+/**
+ * @brief Forget the cached access results of an entry
+ *
+ * @note The caller must hold the attribute lock for WRITE
+ *
+ * @param[in] entry	Entry to flush
+ */
+static inline void mdc_flush_access_cache(mdcache_entry_t *entry)
+{
+	entry->access_count = 0;
+	entry->access_next = 0;
+	atomic_inc_uint32_t(&entry->access_gen);
+}
+
+/**
+ * @brief Forget the cached attribute encodings of an entry
+ *
+ * Must be called whenever entry->attrs changes.
+ *
+ * @note The caller must hold the attribute lock for WRITE
+ *
+ * @param[in] entry	Entry to flush
+ */
+static inline void mdc_flush_encoded_attrs(mdcache_entry_t *entry)
+{
+	uint32_t i;
+
+	for (i = 0; i < entry->encoded_count; i++) {
+		gsh_free(entry->encoded_attrs[i].blob);
+		entry->encoded_attrs[i].blob = NULL;
+	}
+	entry->encoded_count = 0;
+	entry->encoded_next = 0;
+	atomic_inc_uint64_t(&entry->attr_gen);
+}
+
+/**
+ * @brief Stop trusting the cached attributes of an entry
+ *
+ * Bumps the attribute generation, so an asynchronous getattr that was in
+ * flight does not make its older result trusted again.
+ *
+ * @param[in] entry	Entry whose attributes changed
+ */
+static inline void mdc_untrust_attrs(mdcache_entry_t *entry)
+{
+	/* Bump first, see mdc_getattrs_async_cb() */
+	atomic_inc_uint64_t(&entry->attr_gen);
+	atomic_clear_uint32_t_bits(&entry->mde_flags, MDCACHE_TRUST_ATTRS);
+}
+
+/** Number of directory generations shared by the path cache */
+#define MDC_DIR_GEN_SLOTS 4096
+
+extern uint64_t mdc_dir_gen[MDC_DIR_GEN_SLOTS];
+
+/**
+ * @brief Generation slot of a directory
+ *
+ * Directories share generations by hash, a collision only costs a path
+ * cache miss.
+ *
+ * @param[in] entry	Directory
+ */
+static inline uint32_t mdc_dir_gen_slot(mdcache_entry_t *entry)
+{
+	return entry->fh_hk.key.hk % MDC_DIR_GEN_SLOTS;
+}
+
+/**
+ * @brief Note that the names or the search permission of a directory changed
+ *
+ * Paths cached through the directory are no longer trusted.
+ *
+ * @param[in] entry	Directory that changed
+ */
+static inline void mdc_dir_gen_bump(mdcache_entry_t *entry)
+{
+	atomic_inc_uint64_t(&mdc_dir_gen[mdc_dir_gen_slot(entry)]);
+}
+
+void mdc_path_cache_pkginit(void);
+void mdc_path_cache_pkgshutdown(void);
+bool mdcache_lookup_cached_path(struct fsal_obj_handle *parent,
+				const char *path, uint64_t epoch,
+				struct fsal_obj_handle **handle);
+void mdcache_cache_path(struct fsal_obj_handle *parent, const char *path,
+			uint64_t epoch);
+
+extern uint64_t mdc_xattr_gen;
+
+/**
+ * @brief Forget the xattrs cached for an entry
+ *
+ * The entry moves to a generation no entry had before, so neither its
+ * old values nor those of a previous use of the entry can be found.
+ *
+ * @param[in] entry	Entry whose xattrs changed
+ */
+static inline void mdc_xattr_invalidate(mdcache_entry_t *entry)
+{
+	atomic_store_uint64_t(&entry->xattr_gen,
+			      atomic_inc_uint64_t(&mdc_xattr_gen));
+}
+
+void mdc_xattr_cache_pkginit(void);
+void mdc_xattr_cache_pkgshutdown(void);
+
 static inline void mdcache_free_fh(struct gsh_buffdesc *fh_desc);
 
 /**
@@ -950,6 +1119,8 @@ mdc_has_state(mdcache_entry_t *entry)
 			return true;
 		if (entry->fsobj.fsdir.dhdl.dir.exp_root_refcount)
 			return true;
+		if (!glist_empty(&entry->fsobj.fsdir.dhdl.dir.list_of_states))
+			return true;
 		return false;
 	default:
 		/* No state for these types */
@@ -1087,6 +1258,16 @@ fsal_status_t mdcache_close2(struct fsal_obj_handle *obj_hdl,
 fsal_status_t mdcache_fallocate(struct fsal_obj_handle *obj_hdl,
 				struct state_t *state, uint64_t offset,
 				uint64_t length, bool allocate);
+fsal_status_t mdcache_copy(struct fsal_obj_handle *src_hdl,
+			  struct state_t *src_state, uint64_t src_offset,
+			  struct fsal_obj_handle *dst_hdl,
+			  struct state_t *dst_state, uint64_t dst_offset,
+			  uint64_t count, uint64_t *copied);
+fsal_status_t mdcache_clone(struct fsal_obj_handle *src_hdl,
+			   struct state_t *src_state, uint64_t src_offset,
+			   struct fsal_obj_handle *dst_hdl,
+			   struct state_t *dst_state, uint64_t dst_offset,
+			   uint64_t count);
 
 /* extended attributes management */
 fsal_status_t mdcache_list_ext_attrs(struct fsal_obj_handle *obj_hdl,
@@ -587,6 +587,7 @@ mdcache_lru_clean(mdcache_entry_t *entry)
 
 	/* Done with the attrs */
 	fsal_release_attrs(&entry->attrs);
+	mdc_flush_encoded_attrs(entry);
 
 	/* Clean out the export mapping before deconstruction */
 	mdc_clean_entry(entry);
@@ -321,6 +321,9 @@ mdcache_fsal_unload(struct fsal_module *fsal_hdl)
 	fsal_status_t status;
 	int retval;
 
+	mdc_path_cache_pkgshutdown();
+	mdc_xattr_cache_pkgshutdown();
+
 	/* Destroy the cache inode AVL tree */
 	cih_pkgdestroy();
 
@@ -386,6 +389,8 @@ fsal_status_t mdcache_pkginit(void)
 	}
 
 	cih_pkginit();
+	mdc_path_cache_pkginit();
+	mdc_xattr_cache_pkginit();
 
 	return status;
 }
@@ -426,6 +431,38 @@ void mdcache_dbus_show(DBusMessageIter *iter)
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
 					&cache_st.inode_mapping);
+	type = "access_hit";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.access_hit);
+	type = "access_miss";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.access_miss);
+	type = "encoded_hit";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.encoded_hit);
+	type = "encoded_miss";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.encoded_miss);
+	type = "path_hit";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.path_hit);
+	type = "path_miss";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.path_miss);
+	type = "xattr_hit";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.xattr_hit);
+	type = "xattr_miss";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.xattr_miss);
 
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
@@ -0,0 +1,338 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/**
+ * @addtogroup FSAL_MDCACHE
+ * @{
+ */
+
+/**
+ * @file  mdcache_path.c
+ * @brief Multi-component path cache
+ *
+ * Remembers which entry a slash separated path leads to from a directory,
+ * so a run of LOOKUPs can be answered with a single hash lookup.
+ *
+ * A cached path records the generation of every directory it goes
+ * through, and is only used while none of them changed.  It also expires
+ * when the attributes of the directories it crosses would have been
+ * refreshed by a plain lookup.  Only paths whose intermediate directories
+ * can be searched by everybody are cached, so no access check is skipped;
+ * the caller still checks the starting directory.
+ */
+
+#include "config.h"
+
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "fsal.h"
+#include "city.h"
+#include "mdcache_int.h"
+#include "mdcache_hash.h"
+
+/** Most components in a cached path */
+#define MDC_PATH_MAX_DEPTH 16
+
+/** Number of locks shared by the path cache slots */
+#define MDC_PATH_LOCKS 64
+
+struct mdc_path_entry {
+	uint64_t hash;		/*< Hash of start, export and path */
+	char *path;		/*< The path, NULL for an empty slot */
+	uint64_t epoch;		/*< Caller's namespace generation */
+	uint16_t export_id;	/*< Export the path was resolved in */
+	mdcache_key_t start;	/*< Directory the path starts from */
+	mdcache_key_t found;	/*< Entry the path leads to */
+	time_t expire;		/*< When the crossed attributes expire */
+	uint32_t ndirs;		/*< Directories looked in, start included */
+	uint32_t dir_slot[MDC_PATH_MAX_DEPTH];
+	uint64_t dir_gen[MDC_PATH_MAX_DEPTH];
+};
+
+uint64_t mdc_dir_gen[MDC_DIR_GEN_SLOTS];
+
+static struct mdc_path_entry *mdc_path_table;
+static uint32_t mdc_path_size;
+static pthread_mutex_t mdc_path_lock[MDC_PATH_LOCKS];
+
+static void mdc_path_entry_free(struct mdc_path_entry *pe)
+{
+	gsh_free(pe->path);
+	pe->path = NULL;
+	mdcache_key_delete(&pe->start);
+	mdcache_key_delete(&pe->found);
+}
+
+static uint64_t mdc_path_hash(mdcache_entry_t *start, uint16_t export_id,
+			      const char *path)
+{
+	return CityHash64WithSeed(path, strlen(path),
+				  start->fh_hk.key.hk ^ export_id);
+}
+
+/**
+ * @brief Check that anybody may search an intermediate directory
+ *
+ * Also lowers @a expire to when the directory's attributes expire.
+ *
+ * @param[in]     dir		Directory crossed by the path
+ * @param[in,out] expire	Expiry of the path
+ *
+ * @return true if the directory may be skipped by a cached path.
+ */
+static bool mdc_path_searchable(mdcache_entry_t *dir, time_t *expire)
+{
+	const uint32_t search_all = S_IXUSR | S_IXGRP | S_IXOTH;
+	bool acl_supported =
+		op_ctx->fsal_export->exp_ops.fs_supported_attrs(
+			op_ctx->fsal_export) & ATTR_ACL;
+	bool ok;
+
+	PTHREAD_RWLOCK_rdlock(&dir->attr_lock);
+
+	ok = mdcache_is_attrs_valid(dir, ATTR_MODE) &&
+	     (dir->attrs.mode & search_all) == search_all &&
+	     dir->attrs.acl == NULL &&
+	     (!acl_supported || (dir->attrs.valid_mask & ATTR_ACL));
+
+	if (ok && dir->attrs.expire_time_attr > 0 &&
+	    dir->attr_time + dir->attrs.expire_time_attr < *expire)
+		*expire = dir->attr_time + dir->attrs.expire_time_attr;
+
+	PTHREAD_RWLOCK_unlock(&dir->attr_lock);
+
+	return ok;
+}
+
+/**
+ * @brief Look up a path in the path cache
+ *
+ * @param[in]  parent	Directory the path starts from
+ * @param[in]  path	Slash separated path
+ * @param[in]  epoch	Caller's namespace generation
+ * @param[out] handle	Entry found, ref'd
+ *
+ * @return true on a hit.
+ */
+bool mdcache_lookup_cached_path(struct fsal_obj_handle *parent,
+				const char *path, uint64_t epoch,
+				struct fsal_obj_handle **handle)
+{
+	mdcache_entry_t *start =
+		container_of(parent, mdcache_entry_t, obj_handle);
+	mdcache_entry_t *entry = NULL;
+	struct mdc_path_entry *pe;
+	pthread_mutex_t *lock;
+	uint16_t export_id;
+	uint64_t hash;
+	uint32_t slot, i;
+	fsal_status_t status;
+
+	*handle = NULL;
+
+	if (mdc_path_size == 0 || mdcache_param.dir.avl_chunk == 0)
+		return false;
+
+	export_id = op_ctx->ctx_export->export_id;
+	hash = mdc_path_hash(start, export_id, path);
+	slot = hash % mdc_path_size;
+	pe = &mdc_path_table[slot];
+	lock = &mdc_path_lock[slot % MDC_PATH_LOCKS];
+
+	PTHREAD_MUTEX_lock(lock);
+
+	if (pe->path == NULL || pe->hash != hash || pe->epoch != epoch ||
+	    pe->export_id != export_id || strcmp(pe->path, path) != 0 ||
+	    mdcache_key_cmp(&pe->start, &start->fh_hk.key) != 0 ||
+	    time(NULL) > pe->expire)
+		goto miss;
+
+	for (i = 0; i < pe->ndirs; i++) {
+		if (atomic_fetch_uint64_t(&mdc_dir_gen[pe->dir_slot[i]]) !=
+		    pe->dir_gen[i])
+			goto miss;
+	}
+
+	status = mdcache_find_keyed(&pe->found, &entry);
+	if (FSAL_IS_ERROR(status))
+		goto miss;
+
+	PTHREAD_MUTEX_unlock(lock);
+
+	LogFullDebug(COMPONENT_CACHE_INODE,
+		     "Path cache hit %s from %p: %p", path, start, entry);
+
+	(void)atomic_inc_uint64_t(&cache_stp->path_hit);
+	*handle = &entry->obj_handle;
+	return true;
+
+miss:
+	PTHREAD_MUTEX_unlock(lock);
+
+	(void)atomic_inc_uint64_t(&cache_stp->path_miss);
+	return false;
+}
+
+/**
+ * @brief Remember where a path leads
+ *
+ * The path is walked again through the dirent cache, recording the
+ * directory generations before each name is looked up.  Nothing is cached
+ * if any part of the walk is not in the cache, or if an intermediate
+ * directory is not searchable by everybody.
+ *
+ * @param[in] parent	Directory the path starts from
+ * @param[in] path	Slash separated path of at least two names
+ * @param[in] epoch	Caller's namespace generation
+ */
+void mdcache_cache_path(struct fsal_obj_handle *parent, const char *path,
+			uint64_t epoch)
+{
+	mdcache_entry_t *start =
+		container_of(parent, mdcache_entry_t, obj_handle);
+	mdcache_entry_t *dir = start;
+	mdcache_entry_t *next = NULL;
+	struct mdc_path_entry new = { .expire = LONG_MAX };
+	struct mdc_path_entry old;
+	struct mdc_path_entry *pe;
+	char name[NAME_MAX + 1];
+	const char *comp, *slash;
+	fsal_status_t status;
+	size_t len;
+	uint32_t slot;
+
+	if (mdc_path_size == 0 || mdcache_param.dir.avl_chunk == 0)
+		return;
+
+	for (comp = path; ; comp = slash + 1) {
+		slash = strchr(comp, '/');
+		len = slash != NULL ? slash - comp : strlen(comp);
+
+		if (len == 0 || len > NAME_MAX ||
+		    new.ndirs == MDC_PATH_MAX_DEPTH)
+			goto out;
+
+		if (dir != start && !mdc_path_searchable(dir, &new.expire))
+			goto out;
+
+		memcpy(name, comp, len);
+		name[len] = '\0';
+
+		/* Take the generation before looking, a change racing with
+		 * us makes the path stale rather than wrong.
+		 */
+		new.dir_slot[new.ndirs] = mdc_dir_gen_slot(dir);
+		new.dir_gen[new.ndirs] =
+			atomic_fetch_uint64_t(&mdc_dir_gen[mdc_dir_gen_slot(dir)]);
+		new.ndirs++;
+
+		PTHREAD_RWLOCK_rdlock(&dir->content_lock);
+		status = mdc_try_get_cached(dir, name, &next);
+		PTHREAD_RWLOCK_unlock(&dir->content_lock);
+
+		if (dir != start)
+			mdcache_put(dir);
+
+		if (FSAL_IS_ERROR(status))
+			return;
+
+		dir = next;
+
+		if (slash == NULL)
+			break;
+
+		if (dir->obj_handle.type != DIRECTORY)
+			goto out;
+	}
+
+	if (new.ndirs < 2 || dir == start)
+		goto out;
+
+	new.export_id = op_ctx->ctx_export->export_id;
+	new.hash = mdc_path_hash(start, new.export_id, path);
+	new.epoch = epoch;
+	new.path = gsh_strdup(path);
+	mdcache_key_dup(&new.start, &start->fh_hk.key);
+	mdcache_key_dup(&new.found, &dir->fh_hk.key);
+
+	slot = new.hash % mdc_path_size;
+	pe = &mdc_path_table[slot];
+
+	PTHREAD_MUTEX_lock(&mdc_path_lock[slot % MDC_PATH_LOCKS]);
+	old = *pe;
+	*pe = new;
+	PTHREAD_MUTEX_unlock(&mdc_path_lock[slot % MDC_PATH_LOCKS]);
+
+	if (old.path != NULL)
+		mdc_path_entry_free(&old);
+
+	LogFullDebug(COMPONENT_CACHE_INODE,
+		     "Path cache add %s from %p: %p", path, start, dir);
+
+out:
+	if (dir != start)
+		mdcache_put(dir);
+}
+
+/**
+ * @brief Allocate the path cache
+ *
+ * Called once at startup, after parsing config.
+ */
+void mdc_path_cache_pkginit(void)
+{
+	int i;
+
+	mdc_path_size = mdcache_param.path_cache_size;
+	if (mdc_path_size == 0)
+		return;
+
+	mdc_path_table = gsh_calloc(mdc_path_size, sizeof(*mdc_path_table));
+
+	for (i = 0; i < MDC_PATH_LOCKS; i++)
+		PTHREAD_MUTEX_init(&mdc_path_lock[i], NULL);
+}
+
+/**
+ * @brief Free the path cache
+ */
+void mdc_path_cache_pkgshutdown(void)
+{
+	uint32_t i;
+
+	if (mdc_path_table == NULL)
+		return;
+
+	for (i = 0; i < mdc_path_size; i++) {
+		if (mdc_path_table[i].path != NULL)
+			mdc_path_entry_free(&mdc_path_table[i]);
+	}
+
+	for (i = 0; i < MDC_PATH_LOCKS; i++)
+		PTHREAD_MUTEX_destroy(&mdc_path_lock[i]);
+
+	gsh_free(mdc_path_table);
+	mdc_path_table = NULL;
+	mdc_path_size = 0;
+}
+
+/** @} */
@@ -87,6 +87,18 @@ static struct config_item mdcache_params[] = {
 		       mdcache_parameter, futility_count),
 	CONF_ITEM_UI32("Dirmap_HWMark", 1, UINT32_MAX, 10000,
 		       mdcache_parameter, dirmap_hwmark),
+	CONF_ITEM_BOOL("Cache_Access", true,
+		       mdcache_parameter, cache_access),
+	CONF_ITEM_BOOL("Cache_Encoded_Attrs", true,
+		       mdcache_parameter, cache_encoded_attrs),
+	CONF_ITEM_UI32("Path_Cache_Size", 0, 1 << 20, 4096,
+		       mdcache_parameter, path_cache_size),
+	CONF_ITEM_UI32("Xattr_Cache_Size", 0, 1 << 20, 4096,
+		       mdcache_parameter, xattr_cache_size),
+	CONF_ITEM_UI32("Xattr_Cache_Expiration", 0, 3600, 60,
+		       mdcache_parameter, xattr_cache_expiration),
+	CONF_ITEM_UI32("Xattr_Cache_Negative_Expiration", 0, 3600, 10,
+		       mdcache_parameter, xattr_cache_negative_expiration),
 	CONFIG_EOL
 };
 
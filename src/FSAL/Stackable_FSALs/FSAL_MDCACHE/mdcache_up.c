@@ -71,6 +71,16 @@ mdc_up_invalidate(const struct fsal_up_vector *vec, struct gsh_buffdesc *handle,
 	atomic_clear_uint32_t_bits(&entry->mde_flags,
 				   flags & FSAL_UP_INVALIDATE_CACHE);
 
+	if (flags & FSAL_UP_INVALIDATE_ATTRS)
+		mdc_untrust_attrs(entry);
+
+	if ((flags & FSAL_UP_INVALIDATE_CACHE) &&
+	    entry->obj_handle.type == DIRECTORY)
+		mdc_dir_gen_bump(entry);
+
+	if (flags & FSAL_UP_INVALIDATE_CACHE)
+		mdc_xattr_invalidate(entry);
+
 	if (flags & FSAL_UP_INVALIDATE_CLOSE)
 		status = fsal_close(&entry->obj_handle);
 
@@ -156,10 +166,11 @@ mdc_up_update(const struct fsal_up_vector *vec, struct gsh_buffdesc *handle,
 		LogFullDebug(COMPONENT_CACHE_INODE,
 			     "Entry %p Clearing MDCACHE_TRUST_ATTRS, MDCACHE_TRUST_CONTENT, MDCACHE_DIR_POPULATED",
 			     entry);
+		mdc_untrust_attrs(entry);
 		atomic_clear_uint32_t_bits(&entry->mde_flags,
-					   MDCACHE_TRUST_ATTRS |
 					   MDCACHE_TRUST_CONTENT |
 					   MDCACHE_DIR_POPULATED);
+		mdc_dir_gen_bump(entry);
 
 		status = fsal_close(&entry->obj_handle);
 
@@ -313,6 +324,9 @@ mdc_up_update(const struct fsal_up_vector *vec, struct gsh_buffdesc *handle,
 	if (mutatis_mutandis) {
 		mdc_fixup_md(entry, attr);
 		entry->attrs.valid_mask |= mask_set;
+		if (mask_set & (ATTR_MODE | ATTR_OWNER | ATTR_GROUP | ATTR_ACL))
+			mdc_flush_access_cache(entry);
+		mdc_flush_encoded_attrs(entry);
 		/* If directory can not trust content anymore. */
 		if (entry->obj_handle.type == DIRECTORY) {
 			LogFullDebug(COMPONENT_CACHE_INODE,
@@ -321,11 +335,11 @@ mdc_up_update(const struct fsal_up_vector *vec, struct gsh_buffdesc *handle,
 			atomic_clear_uint32_t_bits(&entry->mde_flags,
 						   MDCACHE_TRUST_CONTENT |
 						   MDCACHE_DIR_POPULATED);
+			mdc_dir_gen_bump(entry);
 		}
 		status = fsalstat(ERR_FSAL_NO_ERROR, 0);
 	} else {
-		atomic_clear_uint32_t_bits(&entry->mde_flags,
-					   MDCACHE_TRUST_ATTRS);
+		mdc_untrust_attrs(entry);
 		status = fsalstat(ERR_FSAL_INVAL, 0);
 	}
 
@@ -38,8 +38,257 @@
 #include "gsh_list.h"
 #include "fsal_convert.h"
 #include "FSAL/fsal_commonlib.h"
+#include "city.h"
 #include "mdcache_int.h"
 
+/*
+ * Values read by name are kept in a bounded table, so clients reading the
+ * same xattrs of a file over and over (macOS and SMB gateways do on every
+ * open) don't go down to the sub-FSAL each time.  Lookups that found no
+ * such xattr are remembered too, for a shorter time.
+ *
+ * A cached value belongs to an entry generation; setting or removing any
+ * xattr of the entry, a setattr or an upcall invalidation moves the entry
+ * to a new generation, which drops everything cached for it.  A hit still
+ * needs read access to the file.  trusted. and security. names, which
+ * need privileges to read, are never cached.
+ */
+
+/** Most bytes of a cached xattr value */
+#define MDC_XATTR_MAX_VALUE 4096
+
+/** Number of locks shared by the xattr cache slots */
+#define MDC_XATTR_LOCKS 64
+
+struct mdc_xattr_entry {
+	uint64_t hash;		/*< Hash of entry, API and name */
+	char *name;		/*< The name, NULL for an empty slot */
+	uint32_t name_len;
+	bool v4;		/*< Cached by the NFSv4.2 xattr operations */
+	mdcache_entry_t *entry;	/*< Entry, only compared */
+	uint64_t gen;		/*< Generation of the entry when cached */
+	time_t expire;
+	fsal_status_t status;	/*< Error of a negative entry */
+	uint32_t len;
+	char *value;
+};
+
+uint64_t mdc_xattr_gen;
+
+static struct mdc_xattr_entry *mdc_xattr_table;
+static uint32_t mdc_xattr_size;
+static pthread_mutex_t mdc_xattr_lock[MDC_XATTR_LOCKS];
+
+static void mdc_xattr_entry_free(struct mdc_xattr_entry *xe)
+{
+	gsh_free(xe->name);
+	gsh_free(xe->value);
+	xe->name = NULL;
+	xe->value = NULL;
+}
+
+/**
+ * @brief Check whether a name may be cached, and hash it
+ *
+ * @param[in]  entry	Entry the xattr is on
+ * @param[in]  v4	NFSv4.2 xattr operation
+ * @param[in]  name	Name of the xattr
+ * @param[in]  len	Length of @a name
+ * @param[out] hash	Hash of the name
+ *
+ * @return true if the xattr may be cached.
+ */
+static bool mdc_xattr_cacheable(mdcache_entry_t *entry, bool v4,
+				const char *name, size_t len, uint64_t *hash)
+{
+	if (mdc_xattr_size == 0 || name == NULL || len == 0 ||
+	    (len >= 8 && memcmp(name, "trusted.", 8) == 0) ||
+	    (len >= 9 && memcmp(name, "security.", 9) == 0))
+		return false;
+
+	*hash = CityHash64WithSeed(name, len, (uintptr_t)entry ^ v4);
+	return true;
+}
+
+/**
+ * @brief Look up an xattr value in the cache
+ *
+ * @param[in]  entry	Entry the xattr is on
+ * @param[in]  v4	NFSv4.2 xattr operation
+ * @param[in]  name	Name of the xattr
+ * @param[in]  name_len	Length of @a name
+ * @param[out] buf	Buffer for the value
+ * @param[in]  size	Size of @a buf
+ * @param[out] len	Length of the value
+ * @param[out] status	Status to return
+ *
+ * @return true on a hit.
+ */
+static bool mdc_xattr_lookup(mdcache_entry_t *entry, bool v4,
+			     const char *name, size_t name_len,
+			     void *buf, size_t size, size_t *len,
+			     fsal_status_t *status)
+{
+	const fsal_accessflags_t access =
+		FSAL_MODE_MASK_SET(FSAL_R_OK) |
+		FSAL_ACE4_MASK_SET(FSAL_ACE_PERM_READ_DATA);
+	struct mdc_xattr_entry *xe;
+	pthread_mutex_t *lock;
+	uint64_t hash;
+	uint32_t slot;
+	fsal_status_t access_status;
+
+	if (!mdc_xattr_cacheable(entry, v4, name, name_len, &hash))
+		return false;
+
+	slot = hash % mdc_xattr_size;
+	xe = &mdc_xattr_table[slot];
+	lock = &mdc_xattr_lock[slot % MDC_XATTR_LOCKS];
+
+	PTHREAD_MUTEX_lock(lock);
+
+	if (xe->name == NULL || xe->hash != hash || xe->entry != entry ||
+	    xe->v4 != v4 || xe->name_len != name_len ||
+	    memcmp(xe->name, name, name_len) != 0 ||
+	    xe->gen != atomic_fetch_uint64_t(&entry->xattr_gen) ||
+	    time(NULL) > xe->expire ||
+	    (!FSAL_IS_ERROR(xe->status) && xe->len > size))
+		goto miss;
+
+	if (!FSAL_IS_ERROR(xe->status)) {
+		memcpy(buf, xe->value, xe->len);
+		*len = xe->len;
+	}
+	*status = xe->status;
+
+	PTHREAD_MUTEX_unlock(lock);
+
+	/* The sub-FSAL checked the credentials that filled the cache, check
+	 * ours.  A denial goes down to get the sub-FSAL's own error.
+	 */
+	access_status = entry->obj_handle.obj_ops->test_access(
+				&entry->obj_handle, access, NULL, NULL, false);
+	if (FSAL_IS_ERROR(access_status)) {
+		(void)atomic_inc_uint64_t(&cache_stp->xattr_miss);
+		return false;
+	}
+
+	LogFullDebug(COMPONENT_CACHE_INODE,
+		     "Xattr cache hit %.*s on %p", (int)name_len, name, entry);
+
+	(void)atomic_inc_uint64_t(&cache_stp->xattr_hit);
+	return true;
+
+miss:
+	PTHREAD_MUTEX_unlock(lock);
+
+	(void)atomic_inc_uint64_t(&cache_stp->xattr_miss);
+	return false;
+}
+
+/**
+ * @brief Remember the result of reading an xattr
+ *
+ * Only values and "no such xattr" errors are cached.
+ *
+ * @param[in] entry	Entry the xattr is on
+ * @param[in] v4	NFSv4.2 xattr operation
+ * @param[in] name	Name of the xattr
+ * @param[in] name_len	Length of @a name
+ * @param[in] gen	Generation of the entry before reading
+ * @param[in] status	Status of the read
+ * @param[in] value	Value read
+ * @param[in] len	Length of @a value
+ */
+static void mdc_xattr_insert(mdcache_entry_t *entry, bool v4,
+			     const char *name, size_t name_len, uint64_t gen,
+			     fsal_status_t status, const void *value,
+			     size_t len)
+{
+	struct mdc_xattr_entry new = { .entry = entry, .v4 = v4, .gen = gen };
+	struct mdc_xattr_entry old;
+	uint32_t ttl, slot;
+
+	if (FSAL_IS_ERROR(status)) {
+		if (status.major != ERR_FSAL_NOENT &&
+		    status.major != ERR_FSAL_NO_DATA)
+			return;
+		ttl = mdcache_param.xattr_cache_negative_expiration;
+	} else {
+		if (len > MDC_XATTR_MAX_VALUE || (len > 0 && value == NULL))
+			return;
+		ttl = mdcache_param.xattr_cache_expiration;
+	}
+
+	if (ttl == 0 ||
+	    !mdc_xattr_cacheable(entry, v4, name, name_len, &new.hash))
+		return;
+
+	new.name = gsh_malloc(name_len);
+	memcpy(new.name, name, name_len);
+	new.name_len = name_len;
+	new.expire = time(NULL) + ttl;
+	new.status = status;
+
+	if (!FSAL_IS_ERROR(status) && len > 0) {
+		new.value = gsh_malloc(len);
+		memcpy(new.value, value, len);
+		new.len = len;
+	}
+
+	slot = new.hash % mdc_xattr_size;
+
+	PTHREAD_MUTEX_lock(&mdc_xattr_lock[slot % MDC_XATTR_LOCKS]);
+	old = mdc_xattr_table[slot];
+	mdc_xattr_table[slot] = new;
+	PTHREAD_MUTEX_unlock(&mdc_xattr_lock[slot % MDC_XATTR_LOCKS]);
+
+	if (old.name != NULL)
+		mdc_xattr_entry_free(&old);
+}
+
+/**
+ * @brief Allocate the xattr cache
+ *
+ * Called once at startup, after parsing config.
+ */
+void mdc_xattr_cache_pkginit(void)
+{
+	int i;
+
+	mdc_xattr_size = mdcache_param.xattr_cache_size;
+	if (mdc_xattr_size == 0)
+		return;
+
+	mdc_xattr_table = gsh_calloc(mdc_xattr_size, sizeof(*mdc_xattr_table));
+
+	for (i = 0; i < MDC_XATTR_LOCKS; i++)
+		PTHREAD_MUTEX_init(&mdc_xattr_lock[i], NULL);
+}
+
+/**
+ * @brief Free the xattr cache
+ */
+void mdc_xattr_cache_pkgshutdown(void)
+{
+	uint32_t i;
+
+	if (mdc_xattr_table == NULL)
+		return;
+
+	for (i = 0; i < mdc_xattr_size; i++) {
+		if (mdc_xattr_table[i].name != NULL)
+			mdc_xattr_entry_free(&mdc_xattr_table[i]);
+	}
+
+	for (i = 0; i < MDC_XATTR_LOCKS; i++)
+		PTHREAD_MUTEX_destroy(&mdc_xattr_lock[i]);
+
+	gsh_free(mdc_xattr_table);
+	mdc_xattr_table = NULL;
+	mdc_xattr_size = 0;
+}
+
 /**
  * @brief List extended attributes on a file
  *
@@ -136,7 +385,7 @@ fsal_status_t mdcache_getextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
 /**
  * @brief Get contents of xattr by name
  *
- * Pass through to sub-FSAL
+ * Answered from the xattr cache when possible
  *
  * @param[in] obj_hdl	File to search
  * @param[in] name	Name of xattr to look up
@@ -155,6 +404,14 @@ fsal_status_t mdcache_getextattr_value_by_name(struct fsal_obj_handle *obj_hdl,
 		container_of(obj_hdl, struct mdcache_fsal_obj_handle,
 			     obj_handle);
 	fsal_status_t status;
+	uint64_t gen;
+
+	if (name != NULL && buf != NULL && p_output_size != NULL &&
+	    mdc_xattr_lookup(handle, false, name, strlen(name), buf, buf_size,
+			     p_output_size, &status))
+		return status;
+
+	gen = atomic_fetch_uint64_t(&handle->xattr_gen);
 
 	subcall(
 		status = handle->sub_handle->obj_ops->getextattr_value_by_name(
@@ -162,6 +419,10 @@ fsal_status_t mdcache_getextattr_value_by_name(struct fsal_obj_handle *obj_hdl,
 				buf_size, p_output_size)
 	       );
 
+	if (name != NULL && buf != NULL && p_output_size != NULL)
+		mdc_xattr_insert(handle, false, name, strlen(name), gen,
+				 status, buf, *p_output_size);
+
 	return status;
 }
 
@@ -194,6 +455,8 @@ fsal_status_t mdcache_setextattr_value(struct fsal_obj_handle *obj_hdl,
 			buf_size, create)
 	       );
 
+	mdc_xattr_invalidate(handle);
+
 	return status;
 }
 
@@ -224,6 +487,8 @@ fsal_status_t mdcache_setextattr_value_by_id(struct fsal_obj_handle *obj_hdl,
 				buf_size)
 	       );
 
+	mdc_xattr_invalidate(handle);
+
 	return status;
 }
 
@@ -249,6 +514,8 @@ fsal_status_t mdcache_remove_extattr_by_id(struct fsal_obj_handle *obj_hdl,
 			handle->sub_handle, id)
 	       );
 
+	mdc_xattr_invalidate(handle);
+
 	return status;
 }
 
@@ -274,13 +541,15 @@ fsal_status_t mdcache_remove_extattr_by_name(struct fsal_obj_handle *obj_hdl,
 			handle->sub_handle, name)
 	       );
 
+	mdc_xattr_invalidate(handle);
+
 	return status;
 }
 
 /**
  * @brief Get an Extended Attribute
  *
- * Pass through to sub-FSAL
+ * Answered from the xattr cache when possible
  *
  * @param[in] obj_hdl	File to search
  * @param[in] name	Name of attribute
@@ -294,12 +563,32 @@ fsal_status_t mdcache_getxattrs(struct fsal_obj_handle *obj_hdl,
 		container_of(obj_hdl, struct mdcache_fsal_obj_handle,
 			     obj_handle);
 	fsal_status_t status;
+	size_t len;
+	uint64_t gen;
+
+	if (value->utf8string_val != NULL &&
+	    mdc_xattr_lookup(handle, true, name->utf8string_val,
+			     name->utf8string_len, value->utf8string_val,
+			     value->utf8string_len, &len, &status)) {
+		if (!FSAL_IS_ERROR(status))
+			value->utf8string_len = len;
+		return status;
+	}
+
+	gen = atomic_fetch_uint64_t(&handle->xattr_gen);
 
 	subcall(
 		status = handle->sub_handle->obj_ops->getxattrs(
 			handle->sub_handle, name, value)
 	       );
 
+	/* Calls without a buffer only ask for the size */
+	if (value->utf8string_val != NULL)
+		mdc_xattr_insert(handle, true, name->utf8string_val,
+				 name->utf8string_len, gen, status,
+				 value->utf8string_val,
+				 value->utf8string_len);
+
 	return status;
 }
 
@@ -328,6 +617,8 @@ fsal_status_t mdcache_setxattrs(struct fsal_obj_handle *obj_hdl,
 			handle->sub_handle, type, name, value)
 	       );
 
+	mdc_xattr_invalidate(handle);
+
 	return status;
 }
 
@@ -353,6 +644,8 @@ fsal_status_t mdcache_removexattrs(struct fsal_obj_handle *obj_hdl,
 			handle->sub_handle, name)
 	       );
 
+	mdc_xattr_invalidate(handle);
+
 	return status;
 }
 
@@ -257,6 +257,92 @@ void nullfs_write2(struct fsal_obj_handle *obj_hdl,
 	op_ctx->fsal_export = &export->export;
 }
 
+void nullfs_getattrs_async(struct fsal_obj_handle *obj_hdl,
+			   struct attrlist *attrs,
+			   fsal_async_cb done_cb,
+			   void *caller_arg)
+{
+	struct nullfs_fsal_obj_handle *handle =
+		container_of(obj_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+	struct nullfs_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct nullfs_fsal_export,
+			     export);
+	struct null_async_arg *arg;
+
+	/* Set up async callback */
+	arg = gsh_calloc(1, sizeof(*arg));
+	arg->obj_hdl = obj_hdl;
+	arg->cb = done_cb;
+	arg->cb_arg = caller_arg;
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->export.sub_export;
+	handle->sub_handle->obj_ops->getattrs_async(handle->sub_handle, attrs,
+						   null_async_cb, arg);
+	op_ctx->fsal_export = &export->export;
+}
+
+/**
+ * @brief Callback for NULL async lookup
+ *
+ * Wrap the sub-FSAL's new handle before calling up.
+ *
+ * @param[in] obj		Sub-FSAL directory
+ * @param[in] ret		Return status of call
+ * @param[in] obj_data		Sub-FSAL handle found
+ * @param[in] caller_data	Data for caller
+ */
+static void null_lookup_async_cb(struct fsal_obj_handle *obj,
+				 fsal_status_t ret, void *obj_data,
+				 void *caller_data)
+{
+	struct fsal_export *save_exp = op_ctx->fsal_export;
+	struct null_async_arg *arg = caller_data;
+	struct nullfs_fsal_export *export =
+		container_of(save_exp->super_export, struct nullfs_fsal_export,
+			     export);
+	struct fsal_obj_handle *handle = NULL;
+
+	/* wraping the subfsal handle in a nullfs handle. */
+	ret = nullfs_alloc_and_check_handle(export, obj_data,
+					    arg->obj_hdl->fs, &handle, ret);
+
+	op_ctx->fsal_export = save_exp->super_export;
+	arg->cb(arg->obj_hdl, ret, handle, arg->cb_arg);
+	op_ctx->fsal_export = save_exp;
+
+	gsh_free(arg);
+}
+
+void nullfs_lookup_async(struct fsal_obj_handle *dir_hdl,
+			 const char *path,
+			 struct attrlist *attrs_out,
+			 fsal_async_cb done_cb,
+			 void *caller_arg)
+{
+	struct nullfs_fsal_obj_handle *handle =
+		container_of(dir_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+	struct nullfs_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct nullfs_fsal_export,
+			     export);
+	struct null_async_arg *arg;
+
+	/* Set up async callback */
+	arg = gsh_calloc(1, sizeof(*arg));
+	arg->obj_hdl = dir_hdl;
+	arg->cb = done_cb;
+	arg->cb_arg = caller_arg;
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->export.sub_export;
+	handle->sub_handle->obj_ops->lookup_async(handle->sub_handle, path,
+						 attrs_out,
+						 null_lookup_async_cb, arg);
+	op_ctx->fsal_export = &export->export;
+}
+
 fsal_status_t nullfs_seek2(struct fsal_obj_handle *obj_hdl,
 			   struct state_t *state,
 			   struct io_info *info)
@@ -389,3 +475,58 @@ fsal_status_t nullfs_fallocate(struct fsal_obj_handle *obj_hdl,
 	op_ctx->fsal_export = &export->export;
 	return status;
 }
+
+fsal_status_t nullfs_copy(struct fsal_obj_handle *src_hdl,
+			  struct state_t *src_state, uint64_t src_offset,
+			  struct fsal_obj_handle *dst_hdl,
+			  struct state_t *dst_state, uint64_t dst_offset,
+			  uint64_t count, uint64_t *copied)
+{
+	struct nullfs_fsal_obj_handle *src =
+		container_of(src_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+	struct nullfs_fsal_obj_handle *dst =
+		container_of(dst_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+
+	struct nullfs_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct nullfs_fsal_export,
+			     export);
+	fsal_status_t status;
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->export.sub_export;
+	status = src->sub_handle->obj_ops->copy(src->sub_handle, src_state,
+						src_offset, dst->sub_handle,
+						dst_state, dst_offset, count,
+						copied);
+	op_ctx->fsal_export = &export->export;
+	return status;
+}
+
+fsal_status_t nullfs_clone(struct fsal_obj_handle *src_hdl,
+			   struct state_t *src_state, uint64_t src_offset,
+			   struct fsal_obj_handle *dst_hdl,
+			   struct state_t *dst_state, uint64_t dst_offset,
+			   uint64_t count)
+{
+	struct nullfs_fsal_obj_handle *src =
+		container_of(src_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+	struct nullfs_fsal_obj_handle *dst =
+		container_of(dst_hdl, struct nullfs_fsal_obj_handle,
+			     obj_handle);
+
+	struct nullfs_fsal_export *export =
+		container_of(op_ctx->fsal_export, struct nullfs_fsal_export,
+			     export);
+	fsal_status_t status;
+
+	/* calling subfsal method */
+	op_ctx->fsal_export = export->export.sub_export;
+	status = src->sub_handle->obj_ops->clone(src->sub_handle, src_state,
+						 src_offset, dst->sub_handle,
+						 dst_state, dst_offset, count);
+	op_ctx->fsal_export = &export->export;
+	return status;
+}
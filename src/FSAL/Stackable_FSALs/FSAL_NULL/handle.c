@@ -691,6 +691,10 @@ void nullfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->setattr2 = nullfs_setattr2;
 	ops->close2 = nullfs_close2;
 	ops->fallocate = nullfs_fallocate;
+	ops->copy = nullfs_copy;
+	ops->clone = nullfs_clone;
+	ops->getattrs_async = nullfs_getattrs_async;
+	ops->lookup_async = nullfs_lookup_async;
 
 	/* xattr related functions */
 	ops->list_ext_attrs = nullfs_list_ext_attrs;
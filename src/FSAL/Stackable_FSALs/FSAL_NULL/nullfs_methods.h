@@ -144,6 +144,15 @@ void nullfs_write2(struct fsal_obj_handle *obj_hdl,
 		   fsal_async_cb done_cb,
 		   struct fsal_io_arg *write_arg,
 		   void *caller_arg);
+void nullfs_getattrs_async(struct fsal_obj_handle *obj_hdl,
+			   struct attrlist *attrs,
+			   fsal_async_cb done_cb,
+			   void *caller_arg);
+void nullfs_lookup_async(struct fsal_obj_handle *dir_hdl,
+			 const char *path,
+			 struct attrlist *attrs_out,
+			 fsal_async_cb done_cb,
+			 void *caller_arg);
 fsal_status_t nullfs_seek2(struct fsal_obj_handle *obj_hdl,
 			   struct state_t *state,
 			   struct io_info *info);
@@ -163,6 +172,16 @@ fsal_status_t nullfs_close2(struct fsal_obj_handle *obj_hdl,
 fsal_status_t nullfs_fallocate(struct fsal_obj_handle *obj_hdl,
 			       struct state_t *state, uint64_t offset,
 			       uint64_t length, bool allocate);
+fsal_status_t nullfs_copy(struct fsal_obj_handle *src_hdl,
+			  struct state_t *src_state, uint64_t src_offset,
+			  struct fsal_obj_handle *dst_hdl,
+			  struct state_t *dst_state, uint64_t dst_offset,
+			  uint64_t count, uint64_t *copied);
+fsal_status_t nullfs_clone(struct fsal_obj_handle *src_hdl,
+			   struct state_t *src_state, uint64_t src_offset,
+			   struct fsal_obj_handle *dst_hdl,
+			   struct state_t *dst_state, uint64_t dst_offset,
+			   uint64_t count);
 
 /* extended attributes management */
 fsal_status_t nullfs_list_ext_attrs(struct fsal_obj_handle *obj_hdl,
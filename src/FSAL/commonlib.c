@@ -3083,6 +3083,109 @@ bool check_verifier_attrlist(struct attrlist *attrs, fsal_verifier_t verifier)
 	       attrs->mtime.tv_sec == verf_lo;
 }
 
+/**
+ * @brief Read a range of a file as a list of data and hole segments
+ *
+ * Walk the range with SEEK_DATA/SEEK_HOLE, reading only the data extents.
+ * The data is packed in order at the start of buffer and the segment map
+ * is returned in info->io_segs.  If the filesystem can't report holes the
+ * whole range is returned as data.  The walk stops early if the segment
+ * map fills up; the caller sees a short read.
+ *
+ * @param[in]  fd      File descriptor open for read
+ * @param[in]  offset  Offset to start reading at
+ * @param[in]  len     Maximum number of bytes to cover
+ * @param[out] buffer  Buffer of at least len bytes for the data segments
+ * @param[out] info    Segment map
+ * @param[out] eof     Set if the range reached the end of the file
+ *
+ * @return Number of data bytes read, or -1 with errno set.
+ */
+
+ssize_t fsal_read_plus_fd(int fd, uint64_t offset, size_t len, char *buffer,
+			  struct io_info *info, bool *eof)
+{
+	struct stat st;
+	uint64_t pos = offset, end = offset + len;
+	ssize_t nb_read, total = 0;
+	off_t data, hole;
+	struct io_seg *seg = NULL;
+
+	info->io_nsegs = 0;
+
+	if (fstat(fd, &st) < 0)
+		return -1;
+
+	if (end > (uint64_t) st.st_size)
+		end = st.st_size;
+
+	while (pos < end) {
+		data = lseek(fd, pos, SEEK_DATA);
+
+		if (data < 0 && errno == ENXIO) {
+			/* No more data, the rest of the file is a hole */
+			data = end;
+		} else if (data < 0) {
+			/* Holes not supported, everything is data */
+			data = pos;
+			hole = end;
+			goto read_data;
+		} else if ((uint64_t) data > end) {
+			data = end;
+		}
+
+		if ((uint64_t) data > pos) {
+			if (seg == NULL || seg->what != NFS4_CONTENT_HOLE) {
+				if (info->io_nsegs == IO_INFO_MAX_SEGS)
+					break;
+				seg = &info->io_segs[info->io_nsegs++];
+				seg->what = NFS4_CONTENT_HOLE;
+				seg->offset = pos;
+				seg->length = 0;
+			}
+			seg->length += data - pos;
+			pos = data;
+			continue;
+		}
+
+		hole = lseek(fd, pos, SEEK_HOLE);
+
+		if (hole <= (off_t) pos || (uint64_t) hole > end)
+			hole = end;
+
+ read_data:
+		if (seg == NULL || seg->what != NFS4_CONTENT_DATA) {
+			if (info->io_nsegs == IO_INFO_MAX_SEGS)
+				break;
+			seg = &info->io_segs[info->io_nsegs++];
+			seg->what = NFS4_CONTENT_DATA;
+			seg->offset = pos;
+			seg->length = 0;
+		}
+
+		nb_read = pread(fd, buffer + total, hole - pos, pos);
+
+		if (nb_read < 0)
+			return -1;
+
+		seg->length += nb_read;
+		total += nb_read;
+		pos += nb_read;
+
+		if (nb_read == 0) {
+			/* File was truncated under us */
+			if (seg->length == 0)
+				info->io_nsegs--;
+			end = pos;
+			break;
+		}
+	}
+
+	*eof = pos >= (uint64_t) st.st_size;
+
+	return total;
+}
+
 /**
  * @brief Common is_referral routine for FSALs that use the special mode
  *
@@ -1496,6 +1496,118 @@ static bool is_referral(struct fsal_obj_handle *obj_hdl,
 	return false;
 }
 
+/* file_copy
+ * default case not supported, the protocol layer reports NOTSUPP
+ */
+
+static fsal_status_t file_copy(struct fsal_obj_handle *src_hdl,
+			       struct state_t *src_state,
+			       uint64_t src_offset,
+			       struct fsal_obj_handle *dst_hdl,
+			       struct state_t *dst_state,
+			       uint64_t dst_offset,
+			       uint64_t count,
+			       uint64_t *copied)
+{
+	*copied = 0;
+	return fsalstat(ERR_FSAL_NOTSUPP, ENOTSUP);
+}
+
+/* file_clone
+ * default case not supported, the protocol layer reports NOTSUPP
+ */
+
+static fsal_status_t file_clone(struct fsal_obj_handle *src_hdl,
+				struct state_t *src_state,
+				uint64_t src_offset,
+				struct fsal_obj_handle *dst_hdl,
+				struct state_t *dst_state,
+				uint64_t dst_offset,
+				uint64_t count)
+{
+	return fsalstat(ERR_FSAL_NOTSUPP, ENOTSUP);
+}
+
+/* file_getattrs_async
+ * default case is synchronous, call back inline
+ */
+
+static void file_getattrs_async(struct fsal_obj_handle *obj_hdl,
+				struct attrlist *attrs,
+				fsal_async_cb done_cb,
+				void *caller_arg)
+{
+	fsal_status_t status = obj_hdl->obj_ops->getattrs(obj_hdl, attrs);
+
+	done_cb(obj_hdl, status, attrs, caller_arg);
+}
+
+/* file_lookup_async
+ * default case is synchronous, call back inline
+ */
+
+static void file_lookup_async(struct fsal_obj_handle *dir_hdl,
+			      const char *path,
+			      struct attrlist *attrs_out,
+			      fsal_async_cb done_cb,
+			      void *caller_arg)
+{
+	struct fsal_obj_handle *obj = NULL;
+	fsal_status_t status;
+
+	status = dir_hdl->obj_ops->lookup(dir_hdl, path, &obj, attrs_out);
+
+	done_cb(dir_hdl, status, obj, caller_arg);
+}
+
+/* get_encoded_attrs
+ * default case caches nothing
+ */
+
+static bool get_encoded_attrs(struct fsal_obj_handle *obj_hdl,
+			      const struct gsh_buffdesc *key,
+			      attrmask_t mask,
+			      struct gsh_buffdesc *blob,
+			      uint64_t *gen)
+{
+	*gen = 0;
+	return false;
+}
+
+/* put_encoded_attrs
+ * default case caches nothing
+ */
+
+static void put_encoded_attrs(struct fsal_obj_handle *obj_hdl,
+			      const struct gsh_buffdesc *key,
+			      uint64_t gen,
+			      const struct gsh_buffdesc *blob)
+{
+}
+
+/* lookup_cached_path
+ * default case caches nothing
+ */
+
+static bool lookup_cached_path(struct fsal_obj_handle *parent,
+			       const char *path,
+			       uint64_t epoch,
+			       struct fsal_obj_handle **handle)
+{
+	*handle = NULL;
+	return false;
+}
+
+/* cache_path
+ * default case caches nothing
+ */
+
+static void cache_path(struct fsal_obj_handle *parent,
+		       const char *path,
+		       uint64_t epoch)
+{
+}
+
 /* Default fsal handle object method vector.
  * copied to allocated vector at register time
  */
@@ -1554,6 +1666,14 @@ struct fsal_obj_ops def_handle_ops = {
 	.setattr2 = setattr2,
 	.close2 = close2,
 	.is_referral = is_referral,
+	.copy = file_copy,
+	.clone = file_clone,
+	.getattrs_async = file_getattrs_async,
+	.lookup_async = file_lookup_async,
+	.get_encoded_attrs = get_encoded_attrs,
+	.put_encoded_attrs = put_encoded_attrs,
+	.lookup_cached_path = lookup_cached_path,
+	.cache_path = cache_path,
 };
 
 /* fsal_pnfs_ds common methods */
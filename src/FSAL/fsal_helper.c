@@ -697,6 +697,57 @@ fsal_status_t fsal_lookup(struct fsal_obj_handle *parent,
 	return parent->obj_ops->lookup(parent, name, obj, attrs_out);
 }
 
+/**
+ * @brief Look up a name in a directory asynchronously
+ *
+ * Does the same checks as fsal_lookup, then lets the FSAL complete the lookup
+ * through @a done_cb, which is passed the found object as obj_data.  Errors
+ * from the checks, "." and ".." are reported through @a done_cb inline.
+ *
+ * @param[in] parent     Handle for the parent directory to be managed.
+ * @param[in] name       Name of the file that we are looking up, must stay
+ *                       valid until @a done_cb is called.
+ * @param[in] attrs_out  Optional attributes for the found file
+ * @param[in] done_cb    Callback to call when the lookup is done
+ * @param[in] caller_arg Opaque arg from the caller for callback
+ *
+ * @note On success, the object passed to @a done_cb has been ref'd
+ */
+
+void fsal_lookup_async(struct fsal_obj_handle *parent,
+		       const char *name,
+		       struct attrlist *attrs_out,
+		       fsal_async_cb done_cb,
+		       void *caller_arg)
+{
+	struct fsal_obj_handle *obj = NULL;
+	fsal_status_t fsal_status;
+	fsal_accessflags_t access_mask =
+	    (FSAL_MODE_MASK_SET(FSAL_X_OK) |
+	     FSAL_ACE4_MASK_SET(FSAL_ACE_PERM_EXECUTE));
+
+	if (parent->type != DIRECTORY) {
+		fsal_status = fsalstat(ERR_FSAL_NOTDIR, 0);
+		goto inline_cb;
+	}
+
+	fsal_status = fsal_access(parent, access_mask);
+	if (FSAL_IS_ERROR(fsal_status))
+		goto inline_cb;
+
+	if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+		fsal_status = fsal_lookup(parent, name, &obj, attrs_out);
+		goto inline_cb;
+	}
+
+	parent->obj_ops->lookup_async(parent, name, attrs_out, done_cb,
+				      caller_arg);
+	return;
+
+inline_cb:
+	done_cb(parent, fsal_status, obj, caller_arg);
+}
+
 /**
  * @brief Look up a directory's parent
  *
@@ -497,6 +497,112 @@ int async_delegrecall(struct fridgethr *fr, struct fsal_obj_handle *obj)
 	return rc;
 }
 
+struct delegrecall_one_args {
+	struct fsal_obj_handle *obj;
+	struct state_t *state;
+};
+
+static void queue_delegrecall_one(struct fridgethr_context *ctx)
+{
+	struct delegrecall_one_args *args = ctx->arg;
+
+	(void)delegrecall_one_impl(args->obj, args->state);
+	dec_state_t_ref(args->state);
+	args->obj->obj_ops->put_ref(args->obj);
+	gsh_free(args);
+}
+
+int async_delegrecall_one(struct fridgethr *fr, struct fsal_obj_handle *obj,
+			  struct state_t *state)
+{
+	struct delegrecall_one_args *args;
+	int rc;
+
+	args = gsh_malloc(sizeof(*args));
+	args->obj = obj;
+	args->state = state;
+
+	obj->obj_ops->get_ref(obj);
+	inc_state_t_ref(state);
+
+	rc = fridgethr_submit(fr, queue_delegrecall_one, args);
+	if (rc != 0) {
+		dec_state_t_ref(state);
+		obj->obj_ops->put_ref(obj);
+		gsh_free(args);
+	}
+	return rc;
+}
+
+/* Directory delegation CB_NOTIFY or recall */
+
+struct dir_notify_args {
+	struct fsal_obj_handle *dir;
+	struct gsh_export *ctx_export;
+	clientid4 changer;
+	notify_type4 type;
+	char *name;
+	char *new_name;
+	char names[];
+};
+
+static void queue_dir_notify(struct fridgethr_context *ctx)
+{
+	struct dir_notify_args *args = ctx->arg;
+	struct root_op_context root_op_context;
+
+	init_root_op_context(&root_op_context, args->ctx_export,
+			     args->ctx_export->fsal_export, 0, 0,
+			     UNKNOWN_REQUEST);
+
+	(void)dir_notify_impl(args->dir, args->type, args->name,
+			      args->new_name, args->changer);
+
+	release_root_op_context();
+
+	args->dir->obj_ops->put_ref(args->dir);
+	put_gsh_export(args->ctx_export);
+
+	gsh_free(args);
+}
+
+int async_dir_notify(struct fridgethr *fr, struct fsal_obj_handle *dir,
+		     notify_type4 type, const char *name, const char *new_name)
+{
+	int rc;
+	struct dir_notify_args *args;
+	size_t name_len = strlen(name) + 1;
+	size_t new_len = new_name != NULL ? strlen(new_name) + 1 : 0;
+
+	args = gsh_malloc(sizeof(struct dir_notify_args) + name_len + new_len);
+
+	/* get a ref to prevent races when the notify is sent too late */
+	dir->obj_ops->get_ref(dir);
+
+	args->dir = dir;
+	args->ctx_export = op_ctx->ctx_export;
+	get_gsh_export_ref(args->ctx_export);
+	/* The client making the change does not conflict with itself */
+	args->changer = op_ctx->clientid != NULL ? *op_ctx->clientid : 0;
+	args->type = type;
+	args->name = args->names;
+	memcpy(args->name, name, name_len);
+	if (new_name != NULL) {
+		args->new_name = args->names + name_len;
+		memcpy(args->new_name, new_name, new_len);
+	} else {
+		args->new_name = NULL;
+	}
+
+	rc = fridgethr_submit(fr, queue_dir_notify, args);
+	if (rc != 0) {
+		dir->obj_ops->put_ref(dir);
+		put_gsh_export(args->ctx_export);
+		gsh_free(args);
+	}
+	return rc;
+}
+
 static void up_queue_delegrecall(struct fridgethr_context *ctx)
 {
 
@@ -1498,94 +1498,411 @@ static int schedule_delegrevoke_check(struct delegrecall_context *ctx,
 	return rc;
 }
 
-state_status_t delegrecall_impl(struct fsal_obj_handle *obj)
+/**
+ * @brief Start the recall of one delegation
+ *
+ * @note The state_lock MUST be held for write
+ *
+ * @param[in] obj     The file or directory being delegated
+ * @param[in] state   The delegation
+ * @param[in] req_ctx Context to use for state_del_locked and others
+ */
+
+static void delegrecall_state(struct fsal_obj_handle *obj,
+			      struct state_t *state,
+			      struct req_op_context *req_ctx)
 {
-	struct glist_head *glist, *glist_n;
-	state_status_t rc = 0;
 	uint32_t *deleg_state = NULL;
-	struct state_t *state;
 	state_owner_t *owner;
 	struct delegrecall_context *drc_ctx;
+
+	if (isDebug(COMPONENT_NFS_CB)) {
+		char str[LOG_BUFF_LEN] = "\0";
+		struct display_buffer dspbuf = {sizeof(str), str, str};
+
+		display_stateid(&dspbuf, state);
+		LogDebug(COMPONENT_NFS_CB, "Delegation for %s", str);
+	}
+
+	deleg_state = &state->state_data.deleg.sd_state;
+	if (*deleg_state != DELEG_GRANTED) {
+		LogDebug(COMPONENT_FSAL_UP,
+			 "Delegation already being recalled, NOOP");
+		return;
+	}
+	*deleg_state = DELEG_RECALL_WIP;
+
+	drc_ctx = gsh_malloc(sizeof(struct delegrecall_context));
+
+	/* Get references on the owner and the the export. The
+	 * export reference we will hold while we perform the recall.
+	 * The owner reference will be used to get access to the
+	 * clientid and reserve the lease.
+	 */
+	if (!get_state_obj_export_owner_refs(state, NULL,
+					     &drc_ctx->drc_exp,
+					     &owner)) {
+		LogDebug(COMPONENT_FSAL_UP,
+			 "Something is going stale, no need to recall delegation");
+		gsh_free(drc_ctx);
+		return;
+	}
+
+	/* op_ctx may be used by state_del_locked and others */
+	op_ctx = req_ctx;
+	op_ctx->ctx_export = drc_ctx->drc_exp;
+	op_ctx->fsal_export = drc_ctx->drc_exp->fsal_export;
+
+	drc_ctx->drc_clid = owner->so_owner.so_nfs4_owner.so_clientrec;
+	COPY_STATEID(&drc_ctx->drc_stateid, state);
+	inc_client_id_ref(drc_ctx->drc_clid);
+	dec_state_owner_ref(owner);
+
+	if (obj->type == DIRECTORY)
+		obj->state_hdl->dir.ddeleg_stats.dds_last_recall = time(NULL);
+	else
+		obj->state_hdl->file.fdeleg_stats.fds_last_recall = time(NULL);
+
+	/* Prevent client's lease expiring until we complete
+	 * this recall/revoke operation. If the client's lease
+	 * has already expired, let the reaper thread handling
+	 * expired clients revoke this delegation, and we just
+	 * skip it here.
+	 */
+	PTHREAD_MUTEX_lock(&drc_ctx->drc_clid->cid_mutex);
+	if (!reserve_lease(drc_ctx->drc_clid)) {
+		PTHREAD_MUTEX_unlock(&drc_ctx->drc_clid->cid_mutex);
+		put_gsh_export(drc_ctx->drc_exp);
+		dec_client_id_ref(drc_ctx->drc_clid);
+		gsh_free(drc_ctx);
+		return;
+	}
+	PTHREAD_MUTEX_unlock(&drc_ctx->drc_clid->cid_mutex);
+
+	delegrecall_one(obj, state, drc_ctx);
+}
+
+state_status_t delegrecall_impl(struct fsal_obj_handle *obj)
+{
+	struct glist_head *glist, *glist_n, *list;
+	state_status_t rc = 0;
+	struct state_t *state;
 	struct req_op_context *save_ctx = op_ctx, req_ctx = {0};
 
 	LogDebug(COMPONENT_FSAL_UP,
 		 "FSAL_UP_DELEG: obj %p type %u",
 		 obj, obj->type);
 
+	if (obj->type == DIRECTORY)
+		list = &obj->state_hdl->dir.list_of_states;
+	else
+		list = &obj->state_hdl->file.list_of_states;
+
 	PTHREAD_RWLOCK_wrlock(&obj->state_hdl->state_lock);
-	glist_for_each_safe(glist, glist_n,
-			    &obj->state_hdl->file.list_of_states) {
+	glist_for_each_safe(glist, glist_n, list) {
 		state = glist_entry(glist, struct state_t, state_list);
 
 		if (state->state_type != STATE_TYPE_DELEG)
 			continue;
 
-		if (isDebug(COMPONENT_NFS_CB)) {
-			char str[LOG_BUFF_LEN] = "\0";
-			struct display_buffer dspbuf = {sizeof(str), str, str};
+		delegrecall_state(obj, state, &req_ctx);
+	}
+	PTHREAD_RWLOCK_unlock(&obj->state_hdl->state_lock);
 
-			display_stateid(&dspbuf, state);
-			LogDebug(COMPONENT_NFS_CB, "Delegation for %s", str);
-		}
+	op_ctx = save_ctx;
+	return rc;
+}
 
-		deleg_state = &state->state_data.deleg.sd_state;
-		if (*deleg_state != DELEG_GRANTED) {
-			LogDebug(COMPONENT_FSAL_UP,
-				 "Delegation already being recalled, NOOP");
-			continue;
-		}
-		*deleg_state = DELEG_RECALL_WIP;
+/**
+ * @brief Recall a single delegation
+ *
+ * Other delegations on the object are left alone.  Nothing is done if
+ * the delegation is already being recalled or gone.
+ *
+ * @param[in] obj   The file or directory being delegated
+ * @param[in] state The delegation, the caller holds a reference
+ *
+ * @return STATE_SUCCESS.
+ */
+state_status_t delegrecall_one_impl(struct fsal_obj_handle *obj,
+				    struct state_t *state)
+{
+	struct req_op_context *save_ctx = op_ctx, req_ctx = {0};
+
+	PTHREAD_RWLOCK_wrlock(&obj->state_hdl->state_lock);
+	delegrecall_state(obj, state, &req_ctx);
+	PTHREAD_RWLOCK_unlock(&obj->state_hdl->state_lock);
 
-		drc_ctx = gsh_malloc(sizeof(struct delegrecall_context));
+	op_ctx = save_ctx;
+	return STATE_SUCCESS;
+}
 
-		/* Get references on the owner and the the export. The
-		 * export reference we will hold while we perform the recall.
-		 * The owner reference will be used to get access to the
-		 * clientid and reserve the lease.
-		 */
-		if (!get_state_obj_export_owner_refs(state, NULL,
-						     &drc_ctx->drc_exp,
-						     &owner)) {
-			LogDebug(COMPONENT_FSAL_UP,
-				 "Something is going stale, no need to recall delegation");
-			gsh_free(drc_ctx);
-			continue;
+/**
+ * @brief Data for a directory CB_NOTIFY
+ *
+ * The single change is XDR encoded into @c vals, which is what the
+ * notify4 opaque carries on the wire.
+ */
+
+struct cb_dir_notify {
+	nfs_cb_argop4 arg;	/*< Arguments (so we can free them) */
+	struct notify4 notify;	/*< The one change we send */
+	char vals[];		/*< Encoded notify_add4/remove4/rename4 */
+};
+
+/**
+ * @brief Handle CB_NOTIFY response
+ *
+ * A client that fails the notification can no longer trust its cached
+ * directory, so take its delegation back.  Other holders got their own
+ * notification and keep theirs.
+ *
+ * @param[in] call  The RPC call being completed
+ */
+
+static void dir_notify_completion(rpc_call_t *call)
+{
+	struct cb_dir_notify *arg = call->call_arg;
+	CB_NOTIFY4args *cb_notify = &arg->arg.nfs_cb_argop4_u.opcbnotify;
+	struct state_t *state;
+	struct fsal_obj_handle *obj = NULL;
+	struct gsh_export *export = NULL;
+	bool failed = (call->states & NFS_CB_CALL_ABORTED) ||
+		      call->call_req.cc_error.re_status != RPC_SUCCESS ||
+		      call->cbt.v_u.v4.res.status != NFS4_OK;
+
+	LogFullDebug(COMPONENT_NFS_CB, "status %d arg %p",
+		     call->cbt.v_u.v4.res.status, call->call_arg);
+
+	if (failed) {
+		state = nfs4_State_Get_Pointer(cb_notify->cna_stateid.other);
+
+		if (state != NULL &&
+		    get_state_obj_export_owner_refs(state, &obj, &export,
+						    NULL) &&
+		    obj != NULL) {
+			LogDebug(COMPONENT_NFS_CB,
+				 "CB_NOTIFY failed, recalling directory delegation");
+			if (async_delegrecall_one(general_fridge, obj,
+						  state) != 0)
+				LogCrit(COMPONENT_NFS_CB,
+					"Failed to start thread to recall directory delegation");
 		}
 
-		/* op_ctx may be used by state_del_locked and others */
-		op_ctx = &req_ctx;
-		op_ctx->ctx_export = drc_ctx->drc_exp;
-		op_ctx->fsal_export = drc_ctx->drc_exp->fsal_export;
+		if (obj != NULL)
+			obj->obj_ops->put_ref(obj);
+		if (export != NULL)
+			put_gsh_export(export);
+		if (state != NULL)
+			dec_state_t_ref(state);
+	}
 
-		drc_ctx->drc_clid = owner->so_owner.so_nfs4_owner.so_clientrec;
-		COPY_STATEID(&drc_ctx->drc_stateid, state);
-		inc_client_id_ref(drc_ctx->drc_clid);
-		dec_state_owner_ref(owner);
+	nfs4_freeFH(&cb_notify->cna_fh);
+	nfs41_release_single(call);
+	gsh_free(arg);
+}
 
-		obj->state_hdl->file.fdeleg_stats.fds_last_recall = time(NULL);
+/**
+ * @brief Fill in a notify_entry4 with just a name
+ */
 
-		/* Prevent client's lease expiring until we complete
-		 * this recall/revoke operation. If the client's lease
-		 * has already expired, let the reaper thread handling
-		 * expired clients revoke this delegation, and we just
-		 * skip it here.
-		 */
-		PTHREAD_MUTEX_lock(&drc_ctx->drc_clid->cid_mutex);
-		if (!reserve_lease(drc_ctx->drc_clid)) {
-			PTHREAD_MUTEX_unlock(&drc_ctx->drc_clid->cid_mutex);
-			put_gsh_export(drc_ctx->drc_exp);
-			dec_client_id_ref(drc_ctx->drc_clid);
-			gsh_free(drc_ctx);
+static inline void dir_notify_entry(notify_entry4 *entry, const char *name)
+{
+	entry->ne_file.utf8string_val = (char *)name;
+	entry->ne_file.utf8string_len = strlen(name);
+	entry->ne_attrs.attrmask.bitmap4_len = 0;
+	entry->ne_attrs.attr_vals.attrlist4_len = 0;
+	entry->ne_attrs.attr_vals.attrlist4_val = NULL;
+}
+
+/**
+ * @brief Send one CB_NOTIFY for one directory delegation
+ *
+ * @note The state_lock MUST be held
+ *
+ * @param[in] dir      The delegated directory
+ * @param[in] state    The directory delegation
+ * @param[in] clid     Client holding the delegation
+ * @param[in] export   Export the delegation was granted through
+ * @param[in] type     What changed
+ * @param[in] name     Entry added or removed, old name for a rename
+ * @param[in] new_name New name for a rename
+ *
+ * @return true if the notify was sent, false if the delegation has to
+ *         be recalled instead.
+ */
+
+static bool dir_notify_one(struct fsal_obj_handle *dir, struct state_t *state,
+			   nfs_client_id_t *clid, struct gsh_export *export,
+			   notify_type4 type, const char *name,
+			   const char *new_name)
+{
+	struct cb_dir_notify *arg;
+	CB_NOTIFY4args *cb_notify;
+	notify_remove4 remove;
+	notify_add4 add;
+	notify_rename4 rename;
+	nfs_cookie4 cookie = 0;
+	const char *cookie_name = new_name != NULL ? new_name : name;
+	size_t maxlen;
+	XDR xdrs;
+	bool ok;
+
+	/* Cookies only mean something if the FSAL can compute them
+	 * without reading the directory.
+	 */
+	if (type != NOTIFY4_REMOVE_ENTRY)
+		cookie = dir->obj_ops->compute_readdir_cookie(dir,
+							      cookie_name);
+
+	memset(&add, 0, sizeof(add));
+	memset(&remove, 0, sizeof(remove));
+
+	switch (type) {
+	case NOTIFY4_REMOVE_ENTRY:
+		dir_notify_entry(&remove.nrm_old_entry, name);
+		break;
+	case NOTIFY4_ADD_ENTRY:
+		dir_notify_entry(&add.nad_new_entry, name);
+		break;
+	case NOTIFY4_RENAME_ENTRY:
+		dir_notify_entry(&remove.nrm_old_entry, name);
+		dir_notify_entry(&add.nad_new_entry, new_name);
+		break;
+	default:
+		return false;
+	}
+
+	if (cookie != 0) {
+		add.nad_new_entry_cookie.nad_new_entry_cookie_len = 1;
+		add.nad_new_entry_cookie.nad_new_entry_cookie_val = &cookie;
+	}
+
+	maxlen = 2 * (strlen(name) + (new_name ? strlen(new_name) : 0)) + 128;
+
+	/* free in dir_notify_completion */
+	arg = gsh_calloc(1, sizeof(struct cb_dir_notify) + maxlen);
+
+	xdrmem_create(&xdrs, arg->vals, maxlen, XDR_ENCODE);
+	switch (type) {
+	case NOTIFY4_REMOVE_ENTRY:
+		ok = xdr_notify_remove4(&xdrs, &remove);
+		break;
+	case NOTIFY4_ADD_ENTRY:
+		ok = xdr_notify_add4(&xdrs, &add);
+		break;
+	default:
+		rename.nrn_old_entry = remove;
+		rename.nrn_new_entry = add;
+		ok = xdr_notify_rename4(&xdrs, &rename);
+		break;
+	}
+
+	if (!ok) {
+		LogCrit(COMPONENT_NFS_CB, "Could not encode CB_NOTIFY %d",
+			type);
+		xdr_destroy(&xdrs);
+		gsh_free(arg);
+		return false;
+	}
+
+	arg->arg.argop = NFS4_OP_CB_NOTIFY;
+	arg->notify.notify_mask.bitmap4_len = 1;
+	arg->notify.notify_mask.map[0] = 1 << type;
+	arg->notify.notify_vals.notifylist4_len = xdr_getpos(&xdrs);
+	arg->notify.notify_vals.notifylist4_val = arg->vals;
+	xdr_destroy(&xdrs);
+
+	cb_notify = &arg->arg.nfs_cb_argop4_u.opcbnotify;
+	COPY_STATEID(&cb_notify->cna_stateid, state);
+	cb_notify->cna_changes.cna_changes_len = 1;
+	cb_notify->cna_changes.cna_changes_val = &arg->notify;
+
+	if (!nfs4_FSALToFhandle(true, &cb_notify->cna_fh, dir, export)) {
+		LogCrit(COMPONENT_NFS_CB,
+			"nfs4_FSALToFhandle failed, can not send CB_NOTIFY");
+		gsh_free(arg);
+		return false;
+	}
+
+	if (nfs_rpc_cb_single(clid, &arg->arg, &state->state_refer,
+			      dir_notify_completion, arg) != 0) {
+		nfs4_freeFH(&cb_notify->cna_fh);
+		gsh_free(arg);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Notify or recall the delegations on a changed directory
+ *
+ * Holders that asked for this kind of change get a CB_NOTIFY, the
+ * others have their delegation recalled. The client that made the
+ * change is left alone.
+ *
+ * @param[in] dir      The directory that changed
+ * @param[in] type     What changed
+ * @param[in] name     Entry added or removed, old name for a rename
+ * @param[in] new_name New name for a rename, NULL otherwise
+ * @param[in] changer  Clientid making the change, 0 if none
+ *
+ * @return STATE_SUCCESS.
+ */
+
+state_status_t dir_notify_impl(struct fsal_obj_handle *dir,
+			       notify_type4 type, const char *name,
+			       const char *new_name, clientid4 changer)
+{
+	struct glist_head *glist, *glist_n;
+	struct state_t *state;
+	struct req_op_context *save_ctx = op_ctx, req_ctx = {0};
+	struct gsh_export *export;
+	state_owner_t *owner;
+	nfs_client_id_t *clid;
+	bool notified;
+
+	LogDebug(COMPONENT_FSAL_UP,
+		 "Directory %p change %d name %s new name %s",
+		 dir, type, name, new_name ? new_name : "(none)");
+
+	PTHREAD_RWLOCK_wrlock(&dir->state_hdl->state_lock);
+	glist_for_each_safe(glist, glist_n,
+			    &dir->state_hdl->dir.list_of_states) {
+		state = glist_entry(glist, struct state_t, state_list);
+
+		if (state->state_type != STATE_TYPE_DELEG ||
+		    state->state_data.deleg.sd_state != DELEG_GRANTED)
+			continue;
+
+		if (!get_state_obj_export_owner_refs(state, NULL, &export,
+						     &owner))
+			continue;
+
+		clid = owner->so_owner.so_nfs4_owner.so_clientrec;
+
+		if (clid->cid_clientid == changer) {
+			dec_state_owner_ref(owner);
+			put_gsh_export(export);
 			continue;
 		}
-		PTHREAD_MUTEX_unlock(&drc_ctx->drc_clid->cid_mutex);
 
-		delegrecall_one(obj, state, drc_ctx);
+		notified = false;
+		if (state->state_data.deleg.sd_notify_types & (1 << type))
+			notified = dir_notify_one(dir, state, clid, export,
+						  type, name, new_name);
+
+		dec_state_owner_ref(owner);
+		put_gsh_export(export);
+
+		if (!notified)
+			delegrecall_state(dir, state, &req_ctx);
 	}
-	PTHREAD_RWLOCK_unlock(&obj->state_hdl->state_lock);
+	PTHREAD_RWLOCK_unlock(&dir->state_hdl->state_lock);
 
 	op_ctx = save_ctx;
-	return rc;
+	return STATE_SUCCESS;
 }
 
 /**
@@ -645,7 +645,8 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	exports_pkginit();
 
 	nfs41_session_pool =
-	    pool_basic_init("NFSv4.1 session pool", sizeof(nfs41_session_t));
+	    pool_slab_init("NFSv4.1 session pool", sizeof(nfs41_session_t),
+			   NULL, NULL);
 
 	/* If rpcsec_gss is used, set the path to the keytab */
 #ifdef _HAVE_GSSAPI
@@ -176,7 +176,7 @@ static const struct nfs4_op_desc optabv4[] = {
 	[NFS4_OP_GETATTR] = {
 		.name = "OP_GETATTR",
 		.funct = nfs4_op_getattr,
-		.resume = nfs4_default_resume,
+		.resume = nfs4_op_getattr_resume,
 		.free_res = nfs4_op_getattr_Free,
 		.resp_size = VARIABLE_RESP_SIZE,
 		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
@@ -218,7 +218,7 @@ static const struct nfs4_op_desc optabv4[] = {
 	[NFS4_OP_LOOKUP] = {
 		.name = "OP_LOOKUP",
 		.funct = nfs4_op_lookup,
-		.resume = nfs4_default_resume,
+		.resume = nfs4_op_lookup_resume,
 		.free_res = nfs4_op_lookup_Free,
 		.resp_size = sizeof(LOOKUP4res),
 		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
@@ -434,11 +434,11 @@ static const struct nfs4_op_desc optabv4[] = {
 		.exp_perm_flags = 0},
 	[NFS4_OP_GET_DIR_DELEGATION] = {
 		.name = "OP_GET_DIR_DELEGATION",
-		.funct = nfs4_op_illegal,
+		.funct = nfs4_op_get_dir_delegation,
 		.resume = nfs4_default_resume,
-		.free_res = nfs4_op_illegal_Free,
+		.free_res = nfs4_op_get_dir_delegation_Free,
 		.resp_size = sizeof(GET_DIR_DELEGATION4res),
-		.exp_perm_flags = 0	/* tbd */},
+		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
 	[NFS4_OP_GETDEVICEINFO] = {
 		.name = "OP_GETDEVICEINFO",
 		.funct = nfs4_op_getdeviceinfo,
@@ -534,9 +534,9 @@ static const struct nfs4_op_desc optabv4[] = {
 		.exp_perm_flags = 0},
 	[NFS4_OP_COPY] = {
 		.name = "OP_COPY",
-		.funct = nfs4_op_notsupp,
+		.funct = nfs4_op_copy,
 		.resume = nfs4_default_resume,
-		.free_res = nfs4_op_notsupp_Free,
+		.free_res = nfs4_op_copy_Free,
 		.resp_size = sizeof(COPY4res),
 		.exp_perm_flags = 0},
 	[NFS4_OP_COPY_NOTIFY] = {
@@ -576,16 +576,16 @@ static const struct nfs4_op_desc optabv4[] = {
 		.exp_perm_flags = 0},
 	[NFS4_OP_OFFLOAD_CANCEL] = {
 		.name = "OP_OFFLOAD_CANCEL",
-		.funct = nfs4_op_notsupp,
+		.funct = nfs4_op_offload_cancel,
 		.resume = nfs4_default_resume,
-		.free_res = nfs4_op_notsupp_Free,
-		.resp_size = sizeof(OFFLOAD_ABORT4res),
+		.free_res = nfs4_op_offload_cancel_Free,
+		.resp_size = sizeof(OFFLOAD_CANCEL4res),
 		.exp_perm_flags = 0},
 	[NFS4_OP_OFFLOAD_STATUS] = {
 		.name = "OP_OFFLOAD_STATUS",
-		.funct = nfs4_op_notsupp,
+		.funct = nfs4_op_offload_status,
 		.resume = nfs4_default_resume,
-		.free_res = nfs4_op_notsupp_Free,
+		.free_res = nfs4_op_offload_status_Free,
 		.resp_size = sizeof(OFFLOAD_STATUS4res),
 		.exp_perm_flags = 0},
 	[NFS4_OP_READ_PLUS] = {
@@ -611,10 +611,10 @@ static const struct nfs4_op_desc optabv4[] = {
 		.exp_perm_flags = 0},
 	[NFS4_OP_CLONE] = {
 		.name = "OP_CLONE",
-		.funct = nfs4_op_notsupp,
+		.funct = nfs4_op_clone,
 		.resume = nfs4_default_resume,
-		.free_res = nfs4_op_notsupp_Free,
-		.resp_size = sizeof(ILLEGAL4res),
+		.free_res = nfs4_op_clone_Free,
+		.resp_size = sizeof(CLONE4res),
 		.exp_perm_flags = 0},
 
 	/* NFSv4.3 */
@@ -1445,12 +1445,15 @@ void compound_data_Free(compound_data_t *data)
 
 	gsh_free(data->tagname);
 
+	nfs4_lookup_run_release(data);
+
 	if (data->session) {
 		if (data->slotid != UINT32_MAX) {
 			nfs41_session_slot_t *slot;
 
 			/* Release the slot if in use */
-			slot = &data->session->fc_slots[data->slotid];
+			slot = nfs41_session_slot(data->session,
+						  data->slotid);
 			PTHREAD_MUTEX_unlock(&slot->lock);
 		}
 
@@ -0,0 +1,871 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file nfs4_op_copy.c
+ * @brief Routines used for managing the NFS4 COMPOUND functions.
+ *
+ * Routines used for managing the NFS4 COMPOUND functions COPY,
+ * OFFLOAD_STATUS, OFFLOAD_CANCEL and CLONE (RFC 7862).  Only intra-server
+ * copies are supported: the source is the saved filehandle, the
+ * destination the current filehandle, both within the same export.
+ *
+ * Small copies are done synchronously.  Larger ones, when the client
+ * allows it and has a back channel, are handed to a pool of copy
+ * threads and completion is reported with CB_OFFLOAD.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "fsal.h"
+#include "nfs_core.h"
+#include "sal_functions.h"
+#include "nfs_proto_functions.h"
+#include "nfs_proto_tools.h"
+#include "nfs_convert.h"
+#include "nfs_rpc_callback.h"
+#include "export_mgr.h"
+#include "fridgethr.h"
+
+/** Amount handed to the FSAL at a time, cancel is checked in between */
+#define NFS4_COPY_CHUNK (4 * 1024 * 1024)
+
+/** Copies up to this size are always done synchronously, and a
+ *  synchronous copy moves no more than this per COPY, leaving the client
+ *  to send another for the rest.
+ */
+#define NFS4_COPY_SYNC_MAX (16 * 1024 * 1024)
+
+/**
+ * @brief A copy in progress
+ *
+ * Synchronous copies use one on the stack of the request, asynchronous
+ * ones are on copy_list until CB_OFFLOAD has been answered.
+ */
+struct nfs4_copy {
+	struct glist_head copy_list;	/*< On copy_list */
+	stateid4 stateid;		/*< Handed back in wr_callback_id */
+	nfs_client_id_t *clientid;	/*< Client that asked for it */
+	struct gsh_export *export;
+	struct fsal_obj_handle *src_obj;
+	struct fsal_obj_handle *dst_obj;
+	state_t *src_state;
+	state_t *dst_state;
+	uint64_t src_offset;
+	uint64_t dst_offset;
+	uint64_t count;
+	uint64_t copied;		/*< Progress, read by OFFLOAD_STATUS */
+	uint32_t cancelled;		/*< Set by OFFLOAD_CANCEL */
+	uint32_t complete;		/*< Copy thread is done */
+	nfsstat4 status;		/*< Final status */
+	nfs_fh4 dst_fh;			/*< For CB_OFFLOAD */
+	nfs_cb_argop4 cb_arg;
+	struct user_cred creds;		/*< The requester's, for the copy */
+	struct export_perms export_perms;
+};
+
+static struct glist_head copy_list = GLIST_HEAD_INIT(copy_list);
+static pthread_mutex_t copy_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t copy_counter;
+
+static struct fridgethr *copy_fridge;
+static pthread_once_t copy_fridge_once = PTHREAD_ONCE_INIT;
+
+static void copy_fridge_init(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 8;
+	frp.thr_min = 0;
+	frp.thread_delay = 60;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_queue;
+
+	rc = fridgethr_init(&copy_fridge, "Copy_Fridge", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_NFS_V4,
+			 "Unable to initialize copy fridge, error code %d.",
+			 rc);
+		copy_fridge = NULL;
+	}
+}
+
+/**
+ * @brief Validate one of the stateids of a COPY or CLONE
+ *
+ * Same rules as READ (source) or WRITE (destination): lock stateids are
+ * turned into their open stateid, delegations must allow the access,
+ * and anonymous stateids must not conflict with a delegation.
+ *
+ * @param[in]  data     Compound request's data
+ * @param[in]  stateid  Stateid from the arguments
+ * @param[in]  obj      File the stateid applies to
+ * @param[in]  write    Whether write access is needed
+ * @param[out] pstate   Referenced state, or NULL for anonymous stateids
+ * @param[in]  tag      For logging
+ *
+ * @return NFS4_OK or an error.
+ */
+static nfsstat4 copy_check_state(compound_data_t *data, stateid4 *stateid,
+				 struct fsal_obj_handle *obj, bool write,
+				 state_t **pstate, const char *tag)
+{
+	state_t *state = NULL;
+	state_t *state_open;
+	uint32_t access = write ? OPEN4_SHARE_ACCESS_WRITE
+				: OPEN4_SHARE_ACCESS_READ;
+	nfsstat4 status;
+
+	*pstate = NULL;
+
+	status = nfs4_Check_Stateid(stateid, obj, &state, data,
+				    STATEID_SPECIAL_ANY, 0, false, tag);
+
+	if (status != NFS4_OK)
+		return status;
+
+	if (state == NULL) {
+		/* Anonymous stateid, don't step on a delegation */
+		if (state_deleg_conflict(obj, write))
+			return NFS4ERR_DELAY;
+		return NFS4_OK;
+	}
+
+	switch (state->state_type) {
+	case STATE_TYPE_SHARE:
+		break;
+	case STATE_TYPE_LOCK:
+		state_open = state->state_data.lock.openstate;
+		inc_state_t_ref(state_open);
+		dec_state_t_ref(state);
+		state = state_open;
+		break;
+	case STATE_TYPE_DELEG:
+		if (write &&
+		    !(state->state_data.deleg.sd_type & OPEN_DELEGATE_WRITE)) {
+			status = NFS4ERR_BAD_STATEID;
+			goto err;
+		}
+		/* As with READ and WRITE, use the global fd */
+		dec_state_t_ref(state);
+		return NFS4_OK;
+	default:
+		LogDebug(COMPONENT_NFS_V4_LOCK,
+			 "%s with invalid stateid of type %d",
+			 tag, (int)state->state_type);
+		status = NFS4ERR_BAD_STATEID;
+		goto err;
+	}
+
+	if ((state->state_data.share.share_access & access) == 0) {
+		LogDebug(COMPONENT_NFS_V4_LOCK,
+			 "%s stateid doesn't have OPEN4_SHARE_ACCESS_%s",
+			 tag, write ? "WRITE" : "READ");
+		status = NFS4ERR_OPENMODE;
+		goto err;
+	}
+
+	*pstate = state;
+	return NFS4_OK;
+
+ err:
+	dec_state_t_ref(state);
+	return status;
+}
+
+/**
+ * @brief Common checks for COPY and CLONE
+ *
+ * Checks the filehandles, stateids, access and ranges.  On success the
+ * caller owns the references on the returned states.
+ *
+ * @param[in]     data       Compound request's data
+ * @param[in]     src_sid    Source stateid
+ * @param[in]     dst_sid    Destination stateid
+ * @param[in]     src_offset Source offset
+ * @param[in]     dst_offset Destination offset
+ * @param[in,out] count      Count, 0 is replaced by the bytes to EOF
+ * @param[out]    src_state  Source state
+ * @param[out]    dst_state  Destination state
+ * @param[in]     tag        For logging
+ *
+ * @return NFS4_OK or an error.
+ */
+static nfsstat4 copy_prepare(compound_data_t *data,
+			     stateid4 *src_sid, stateid4 *dst_sid,
+			     uint64_t src_offset, uint64_t dst_offset,
+			     uint64_t *count, state_t **src_state,
+			     state_t **dst_state, const char *tag)
+{
+	struct fsal_obj_handle *src = data->saved_obj;
+	struct fsal_obj_handle *dst = data->current_obj;
+	uint64_t MaxOffsetWrite =
+		atomic_fetch_uint64_t(&op_ctx->ctx_export->MaxOffsetWrite);
+	struct attrlist attrs;
+	fsal_status_t fsal_status;
+	nfsstat4 status;
+
+	*src_state = NULL;
+	*dst_state = NULL;
+
+	status = nfs4_sanity_check_FH(data, REGULAR_FILE, false);
+	if (status != NFS4_OK)
+		return status;
+
+	status = nfs4_sanity_check_saved_FH(data, REGULAR_FILE, false);
+	if (status != NFS4_OK)
+		return status;
+
+	/* Intra-server only, and the FSAL needs both files at hand */
+	if (op_ctx->ctx_export != NULL && data->saved_export != NULL &&
+	    op_ctx->ctx_export->export_id != data->saved_export->export_id)
+		return NFS4ERR_XDEV;
+
+	status = copy_check_state(data, src_sid, src, false, src_state, tag);
+	if (status != NFS4_OK)
+		return status;
+
+	status = copy_check_state(data, dst_sid, dst, true, dst_state, tag);
+	if (status != NFS4_OK)
+		goto err;
+
+	fsal_status = src->obj_ops->test_access(src, FSAL_READ_ACCESS,
+						NULL, NULL, true);
+	if (!FSAL_IS_ERROR(fsal_status))
+		fsal_status = dst->obj_ops->test_access(dst, FSAL_WRITE_ACCESS,
+							NULL, NULL, true);
+	if (FSAL_IS_ERROR(fsal_status)) {
+		status = nfs4_Errno_status(fsal_status);
+		goto err;
+	}
+
+	fsal_prepare_attrs(&attrs, ATTR_SIZE);
+	fsal_status = src->obj_ops->getattrs(src, &attrs);
+	fsal_release_attrs(&attrs);
+
+	if (FSAL_IS_ERROR(fsal_status)) {
+		status = nfs4_Errno_status(fsal_status);
+		goto err;
+	}
+
+	if (src_offset > attrs.filesize) {
+		status = NFS4ERR_INVAL;
+		goto err;
+	}
+
+	if (*count == 0)
+		*count = attrs.filesize - src_offset;
+	else if (*count > attrs.filesize - src_offset) {
+		status = NFS4ERR_INVAL;
+		goto err;
+	}
+
+	/* Copying a file onto itself is fine as long as the ranges
+	 * don't overlap.
+	 */
+	if (src == dst && src_offset < dst_offset + *count &&
+	    dst_offset < src_offset + *count) {
+		status = NFS4ERR_INVAL;
+		goto err;
+	}
+
+	if (dst_offset + *count < dst_offset ||
+	    (MaxOffsetWrite < UINT64_MAX &&
+	     dst_offset + *count > MaxOffsetWrite)) {
+		LogEvent(COMPONENT_NFS_V4,
+			 "A client tried to violate max file size %"
+			 PRIu64 " for exportid #%hu",
+			 MaxOffsetWrite, op_ctx->ctx_export->export_id);
+		status = NFS4ERR_FBIG;
+		goto err;
+	}
+
+	return NFS4_OK;
+
+ err:
+	if (*src_state != NULL) {
+		dec_state_t_ref(*src_state);
+		*src_state = NULL;
+	}
+	if (*dst_state != NULL) {
+		dec_state_t_ref(*dst_state);
+		*dst_state = NULL;
+	}
+	return status;
+}
+
+/**
+ * @brief Move the data, a chunk at a time
+ *
+ * @param[in,out] copy  Copy description, copied is updated as we go
+ *
+ * @return NFS4_OK, or an error if nothing could be copied at all.
+ */
+static nfsstat4 copy_range(struct nfs4_copy *copy)
+{
+	fsal_status_t fsal_status;
+	uint64_t done, len, copied;
+
+	while ((copied = atomic_fetch_uint64_t(&copy->copied)) < copy->count) {
+		if (atomic_fetch_uint32_t(&copy->cancelled))
+			return NFS4ERR_OFFLOAD_DENIED;
+
+		len = copy->count - copied;
+		if (len > NFS4_COPY_CHUNK)
+			len = NFS4_COPY_CHUNK;
+
+		done = 0;
+		fsal_status = copy->src_obj->obj_ops->copy(
+					copy->src_obj, copy->src_state,
+					copy->src_offset + copied,
+					copy->dst_obj, copy->dst_state,
+					copy->dst_offset + copied,
+					len, &done);
+
+		if (FSAL_IS_ERROR(fsal_status)) {
+			LogDebug(COMPONENT_NFS_V4,
+				 "copy failed with %s after %" PRIu64
+				 " bytes", msg_fsal_err(fsal_status.major),
+				 copied);
+			return nfs4_Errno_status(fsal_status);
+		}
+
+		if (done == 0) {
+			/* Source shrank under us */
+			break;
+		}
+
+		atomic_add_uint64_t(&copy->copied, done);
+	}
+
+	return NFS4_OK;
+}
+
+static void copy_free(struct nfs4_copy *copy)
+{
+	if (copy->src_state != NULL)
+		dec_state_t_ref(copy->src_state);
+	if (copy->dst_state != NULL)
+		dec_state_t_ref(copy->dst_state);
+	if (copy->src_obj != NULL)
+		copy->src_obj->obj_ops->put_ref(copy->src_obj);
+	if (copy->dst_obj != NULL)
+		copy->dst_obj->obj_ops->put_ref(copy->dst_obj);
+	if (copy->export != NULL)
+		put_gsh_export(copy->export);
+	if (copy->clientid != NULL)
+		dec_client_id_ref(copy->clientid);
+	gsh_free(copy->dst_fh.nfs_fh4_val);
+	gsh_free(copy->creds.caller_garray);
+	gsh_free(copy);
+}
+
+static void copy_unhash(struct nfs4_copy *copy)
+{
+	PTHREAD_MUTEX_lock(&copy_mutex);
+	glist_del(&copy->copy_list);
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+}
+
+static void copy_cb_completion(rpc_call_t *call)
+{
+	struct nfs4_copy *copy = call->call_arg;
+
+	LogFullDebug(COMPONENT_NFS_CB, "CB_OFFLOAD status %d",
+		     call->cbt.v_u.v4.res.status);
+
+	copy_unhash(copy);
+	copy_free(copy);
+}
+
+/**
+ * @brief Tell the client an asynchronous copy is done
+ *
+ * The copy record stays visible to OFFLOAD_STATUS until the client has
+ * answered the callback.
+ */
+static void copy_send_offload(struct nfs4_copy *copy)
+{
+	CB_OFFLOAD4args *cbo = &copy->cb_arg.nfs_cb_argop4_u.opcboffload;
+	struct gsh_buffdesc verf_desc;
+	int rc;
+
+	copy->cb_arg.argop = NFS4_OP_CB_OFFLOAD;
+	cbo->coa_fh = copy->dst_fh;
+	cbo->coa_stateid = copy->stateid;
+	cbo->coa_offload_info.coa_status = copy->status;
+
+	if (copy->status == NFS4_OK) {
+		write_response4 *wr = &cbo->coa_offload_info.coa_resok4;
+
+		wr->wr_ids = 0;
+		wr->wr_count = atomic_fetch_uint64_t(&copy->copied);
+		wr->wr_committed = UNSTABLE4;
+		verf_desc.addr = wr->wr_writeverf;
+		verf_desc.len = sizeof(verifier4);
+		op_ctx->fsal_export->exp_ops.get_write_verifier(
+					op_ctx->fsal_export, &verf_desc);
+	} else {
+		cbo->coa_offload_info.coa_bytes_copied =
+					atomic_fetch_uint64_t(&copy->copied);
+	}
+
+	rc = nfs_rpc_cb_single(copy->clientid, &copy->cb_arg, NULL,
+			       copy_cb_completion, copy);
+	if (rc != 0) {
+		LogDebug(COMPONENT_NFS_CB,
+			 "CB_OFFLOAD could not be sent: %d", rc);
+		copy_unhash(copy);
+		copy_free(copy);
+	}
+}
+
+static void copy_task(struct fridgethr_context *ctx)
+{
+	struct nfs4_copy *copy = ctx->arg;
+	struct root_op_context root_op_context;
+
+	init_root_op_context(&root_op_context, copy->export,
+			     copy->export->fsal_export, NFS_V4, 2,
+			     NFS_REQUEST);
+
+	/* Copy as the client that asked, squashed as it was then */
+	root_op_context.creds = copy->creds;
+	root_op_context.export_perms = copy->export_perms;
+
+	copy->status = copy_range(copy);
+	atomic_store_uint32_t(&copy->complete, true);
+
+	LogDebug(COMPONENT_NFS_V4,
+		 "async copy of %" PRIu64 " bytes done, status %s",
+		 atomic_fetch_uint64_t(&copy->copied),
+		 nfsstat4_to_str(copy->status));
+
+	if (atomic_fetch_uint32_t(&copy->cancelled)) {
+		/* The client has forgotten about it, no CB_OFFLOAD */
+		copy_unhash(copy);
+		copy_free(copy);
+	} else {
+		copy_send_offload(copy);
+	}
+
+	release_root_op_context();
+}
+
+/**
+ * @brief Look up an asynchronous copy by its stateid
+ *
+ * @return The copy with copy_mutex held, or NULL.
+ */
+static struct nfs4_copy *copy_lookup(stateid4 *stateid,
+				     nfs_client_id_t *clientid)
+{
+	struct glist_head *glist;
+	struct nfs4_copy *copy;
+
+	PTHREAD_MUTEX_lock(&copy_mutex);
+
+	glist_for_each(glist, &copy_list) {
+		copy = glist_entry(glist, struct nfs4_copy, copy_list);
+		if (copy->clientid == clientid &&
+		    memcmp(copy->stateid.other, stateid->other,
+			   sizeof(stateid->other)) == 0)
+			return copy;
+	}
+
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+	return NULL;
+}
+
+/**
+ * @brief Queue an asynchronous copy
+ *
+ * On success the copy thread owns the record and frees it, on failure
+ * the caller keeps it, with its state references, and copies
+ * synchronously.
+ *
+ * @param[in]  data     Compound request's data
+ * @param[in]  copy     The copy
+ * @param[out] stateid  Stateid identifying the copy to the client
+ *
+ * @return true if queued, false to fall back to a synchronous copy.
+ */
+static bool copy_start_async(compound_data_t *data, struct nfs4_copy *copy,
+			     stateid4 *stateid)
+{
+	uint64_t id;
+
+	pthread_once(&copy_fridge_once, copy_fridge_init);
+	if (copy_fridge == NULL)
+		return false;
+
+	/* A stateid nobody else hands out, only looked up in copy_list */
+	id = atomic_inc_uint64_t(&copy_counter);
+	copy->stateid.seqid = 1;
+	memcpy(copy->stateid.other, "COPY", 4);
+	memcpy(copy->stateid.other + 4, &id, sizeof(id));
+	*stateid = copy->stateid;
+
+	copy->clientid = data->session->clientid_record;
+	inc_client_id_ref(copy->clientid);
+	copy->export = op_ctx->ctx_export;
+	get_gsh_export_ref(copy->export);
+	copy->src_obj->obj_ops->get_ref(copy->src_obj);
+	copy->dst_obj->obj_ops->get_ref(copy->dst_obj);
+
+	copy->dst_fh.nfs_fh4_len = data->currentFH.nfs_fh4_len;
+	copy->dst_fh.nfs_fh4_val = gsh_malloc(data->currentFH.nfs_fh4_len);
+	memcpy(copy->dst_fh.nfs_fh4_val, data->currentFH.nfs_fh4_val,
+	       data->currentFH.nfs_fh4_len);
+
+	copy->creds = *op_ctx->creds;
+	copy->creds.caller_garray = NULL;
+	if (copy->creds.caller_glen != 0) {
+		copy->creds.caller_garray =
+			gsh_malloc(copy->creds.caller_glen * sizeof(gid_t));
+		memcpy(copy->creds.caller_garray,
+		       op_ctx->creds->caller_garray,
+		       copy->creds.caller_glen * sizeof(gid_t));
+	}
+	copy->export_perms = *op_ctx->export_perms;
+
+	PTHREAD_MUTEX_lock(&copy_mutex);
+	glist_add_tail(&copy_list, &copy->copy_list);
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+
+	if (fridgethr_submit(copy_fridge, copy_task, copy) == 0)
+		return true;
+
+	copy_unhash(copy);
+	copy->src_obj->obj_ops->put_ref(copy->src_obj);
+	copy->dst_obj->obj_ops->put_ref(copy->dst_obj);
+	put_gsh_export(copy->export);
+	copy->export = NULL;
+	dec_client_id_ref(copy->clientid);
+	copy->clientid = NULL;
+	gsh_free(copy->dst_fh.nfs_fh4_val);
+	copy->dst_fh.nfs_fh4_val = NULL;
+	gsh_free(copy->creds.caller_garray);
+	copy->creds.caller_garray = NULL;
+	return false;
+}
+
+/**
+ * @brief The NFS4_OP_COPY operation
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC 7862
+ */
+enum nfs_req_result nfs4_op_copy(struct nfs_argop4 *op,
+				 compound_data_t *data,
+				 struct nfs_resop4 *resp)
+{
+	COPY4args * const arg_COPY = &op->nfs_argop4_u.opcopy;
+	COPY4res * const res_COPY = &resp->nfs_resop4_u.opcopy;
+	write_response4 *wr = &res_COPY->COPY4res_u.cr_resok4.cr_response;
+	copy_requirements4 *req =
+			&res_COPY->COPY4res_u.cr_resok4.cr_requirements;
+	struct gsh_buffdesc verf_desc;
+	struct nfs4_copy *copy;
+	uint64_t count = arg_COPY->ca_count;
+	state_t *src_state, *dst_state;
+
+	resp->resop = NFS4_OP_COPY;
+
+	if (data->minorversion < 2) {
+		res_COPY->cr_status = NFS4ERR_NOTSUPP;
+		return NFS_REQ_ERROR;
+	}
+
+	/* Inter-server copy is not supported */
+	if (arg_COPY->ca_source_server.ca_source_server_len != 0) {
+		res_COPY->cr_status = NFS4ERR_NOTSUPP;
+		return NFS_REQ_ERROR;
+	}
+
+	res_COPY->cr_status = copy_prepare(data, &arg_COPY->ca_src_stateid,
+					   &arg_COPY->ca_dst_stateid,
+					   arg_COPY->ca_src_offset,
+					   arg_COPY->ca_dst_offset,
+					   &count, &src_state, &dst_state,
+					   "COPY");
+	if (res_COPY->cr_status != NFS4_OK)
+		return NFS_REQ_ERROR;
+
+	LogFullDebug(COMPONENT_NFS_V4,
+		     "src_offset = %" PRIu64 " dst_offset = %" PRIu64
+		     " count = %" PRIu64 " synchronous = %d",
+		     arg_COPY->ca_src_offset, arg_COPY->ca_dst_offset,
+		     count, arg_COPY->ca_synchronous);
+
+	copy = gsh_calloc(1, sizeof(*copy));
+	copy->src_obj = data->saved_obj;
+	copy->dst_obj = data->current_obj;
+	copy->src_state = src_state;
+	copy->dst_state = dst_state;
+	copy->src_offset = arg_COPY->ca_src_offset;
+	copy->dst_offset = arg_COPY->ca_dst_offset;
+	copy->count = count;
+
+	memset(wr, 0, sizeof(*wr));
+	req->cr_consecutive = true;
+
+	if (!arg_COPY->ca_synchronous && count > NFS4_COPY_SYNC_MAX &&
+	    data->session != NULL &&
+	    (data->session->flags & session_bc_up) &&
+	    copy_start_async(data, copy, &wr->wr_callback_id)) {
+		/* The copy thread owns the record from now on */
+		wr->wr_ids = 1;
+		req->cr_synchronous = false;
+	} else {
+		/* Don't tie up the worker, RFC 7862 lets us return a short
+		 * wr_count.
+		 */
+		if (copy->count > NFS4_COPY_SYNC_MAX)
+			copy->count = NFS4_COPY_SYNC_MAX;
+
+		res_COPY->cr_status = copy_range(copy);
+		wr->wr_count = copy->copied;
+		req->cr_synchronous = true;
+
+		/* Bytes already moved are reported rather than the error */
+		if (copy->copied != 0)
+			res_COPY->cr_status = NFS4_OK;
+
+		/* No object references were taken for a synchronous copy */
+		copy->src_obj = NULL;
+		copy->dst_obj = NULL;
+		copy_free(copy);
+	}
+
+	if (res_COPY->cr_status != NFS4_OK)
+		return NFS_REQ_ERROR;
+
+	/* copy_file_range leaves the data in the page cache */
+	wr->wr_committed = UNSTABLE4;
+	verf_desc.addr = wr->wr_writeverf;
+	verf_desc.len = sizeof(verifier4);
+	op_ctx->fsal_export->exp_ops.get_write_verifier(op_ctx->fsal_export,
+							&verf_desc);
+
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free memory allocated for COPY result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+void nfs4_op_copy_Free(nfs_resop4 *resp)
+{
+	/* Nothing to be done */
+}
+
+/**
+ * @brief The NFS4_OP_OFFLOAD_STATUS operation
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC 7862
+ */
+enum nfs_req_result nfs4_op_offload_status(struct nfs_argop4 *op,
+					   compound_data_t *data,
+					   struct nfs_resop4 *resp)
+{
+	OFFLOAD_STATUS4args * const arg_STATUS =
+					&op->nfs_argop4_u.opoffload_status;
+	OFFLOAD_STATUS4res * const res_STATUS =
+					&resp->nfs_resop4_u.opoffload_status;
+	OFFLOAD_STATUS4resok *resok = &res_STATUS->OFFLOAD_STATUS4res_u
+								.osr_resok4;
+	struct nfs4_copy *copy;
+
+	resp->resop = NFS4_OP_OFFLOAD_STATUS;
+
+	if (data->minorversion < 2 || data->session == NULL) {
+		res_STATUS->osr_status = NFS4ERR_NOTSUPP;
+		return NFS_REQ_ERROR;
+	}
+
+	copy = copy_lookup(&arg_STATUS->osa_stateid,
+			   data->session->clientid_record);
+	if (copy == NULL) {
+		res_STATUS->osr_status = NFS4ERR_BAD_STATEID;
+		return NFS_REQ_ERROR;
+	}
+
+	resok->osr_count = atomic_fetch_uint64_t(&copy->copied);
+	if (atomic_fetch_uint32_t(&copy->complete)) {
+		resok->osr_complete.osr_complete_len = 1;
+		resok->osr_complete.osr_complete_val = copy->status;
+	} else {
+		resok->osr_complete.osr_complete_len = 0;
+	}
+
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+
+	res_STATUS->osr_status = NFS4_OK;
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free memory allocated for OFFLOAD_STATUS result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+void nfs4_op_offload_status_Free(nfs_resop4 *resp)
+{
+	/* Nothing to be done */
+}
+
+/**
+ * @brief The NFS4_OP_OFFLOAD_CANCEL operation
+ *
+ * The copy thread notices between two chunks.  Whatever was copied so
+ * far stays in the destination.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC 7862
+ */
+enum nfs_req_result nfs4_op_offload_cancel(struct nfs_argop4 *op,
+					   compound_data_t *data,
+					   struct nfs_resop4 *resp)
+{
+	OFFLOAD_CANCEL4args * const arg_CANCEL =
+					&op->nfs_argop4_u.opoffload_cancel;
+	OFFLOAD_CANCEL4res * const res_CANCEL =
+					&resp->nfs_resop4_u.opoffload_cancel;
+	struct nfs4_copy *copy;
+
+	resp->resop = NFS4_OP_OFFLOAD_CANCEL;
+
+	if (data->minorversion < 2 || data->session == NULL) {
+		res_CANCEL->ocr_status = NFS4ERR_NOTSUPP;
+		return NFS_REQ_ERROR;
+	}
+
+	copy = copy_lookup(&arg_CANCEL->oca_stateid,
+			   data->session->clientid_record);
+	if (copy == NULL) {
+		res_CANCEL->ocr_status = NFS4ERR_BAD_STATEID;
+		return NFS_REQ_ERROR;
+	}
+
+	atomic_store_uint32_t(&copy->cancelled, true);
+	PTHREAD_MUTEX_unlock(&copy_mutex);
+
+	res_CANCEL->ocr_status = NFS4_OK;
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free memory allocated for OFFLOAD_CANCEL result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+void nfs4_op_offload_cancel_Free(nfs_resop4 *resp)
+{
+	/* Nothing to be done */
+}
+
+/**
+ * @brief The NFS4_OP_CLONE operation
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC 7862
+ */
+enum nfs_req_result nfs4_op_clone(struct nfs_argop4 *op,
+				  compound_data_t *data,
+				  struct nfs_resop4 *resp)
+{
+	CLONE4args * const arg_CLONE = &op->nfs_argop4_u.opclone;
+	CLONE4res * const res_CLONE = &resp->nfs_resop4_u.opclone;
+	struct fsal_obj_handle *src = data->saved_obj;
+	struct fsal_obj_handle *dst = data->current_obj;
+	state_t *src_state, *dst_state;
+	uint64_t count = arg_CLONE->cl_count;
+	fsal_status_t fsal_status;
+
+	resp->resop = NFS4_OP_CLONE;
+
+	if (data->minorversion < 2) {
+		res_CLONE->cl_status = NFS4ERR_NOTSUPP;
+		return NFS_REQ_ERROR;
+	}
+
+	res_CLONE->cl_status = copy_prepare(data, &arg_CLONE->cl_src_stateid,
+					    &arg_CLONE->cl_dst_stateid,
+					    arg_CLONE->cl_src_offset,
+					    arg_CLONE->cl_dst_offset,
+					    &count, &src_state, &dst_state,
+					    "CLONE");
+	if (res_CLONE->cl_status != NFS4_OK)
+		return NFS_REQ_ERROR;
+
+	LogFullDebug(COMPONENT_NFS_V4,
+		     "src_offset = %" PRIu64 " dst_offset = %" PRIu64
+		     " count = %" PRIu64,
+		     arg_CLONE->cl_src_offset, arg_CLONE->cl_dst_offset,
+		     count);
+
+	/* A zero cl_count clones to EOF, which copy_prepare turned into
+	 * an explicit count; an empty source range is a no-op.
+	 */
+	if (count != 0) {
+		fsal_status = src->obj_ops->clone(src, src_state,
+						  arg_CLONE->cl_src_offset,
+						  dst, dst_state,
+						  arg_CLONE->cl_dst_offset,
+						  count);
+		if (FSAL_IS_ERROR(fsal_status))
+			res_CLONE->cl_status = nfs4_Errno_status(fsal_status);
+	}
+
+	if (src_state != NULL)
+		dec_state_t_ref(src_state);
+	if (dst_state != NULL)
+		dec_state_t_ref(dst_state);
+
+	return res_CLONE->cl_status == NFS4_OK ? NFS_REQ_OK : NFS_REQ_ERROR;
+}
+
+/**
+ * @brief Free memory allocated for CLONE result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+void nfs4_op_clone_Free(nfs_resop4 *resp)
+{
+	/* Nothing to be done */
+}
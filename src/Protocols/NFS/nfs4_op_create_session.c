@@ -106,7 +106,9 @@ enum nfs_req_result nfs4_op_create_session(struct nfs_argop4 *op,
 	struct display_buffer dspbuf_clientid4 = {
 		sizeof(str_clientid4), str_clientid4, str_clientid4};
 	/* Return code from clientid calls */
-	int i, rc = 0;
+	int rc = 0;
+	/* Forechannel slots the session starts with */
+	uint32_t initial_slots;
 	/* Component for logging */
 	log_components_t component = COMPONENT_CLIENTID;
 	/* Abbreviated alias for arguments */
@@ -351,14 +353,18 @@ enum nfs_req_result nfs4_op_create_session(struct nfs_argop4 *op,
 	PTHREAD_MUTEX_init(&nfs41_session->cb_mutex, NULL);
 	PTHREAD_COND_init(&nfs41_session->cb_cond, NULL);
 	PTHREAD_RWLOCK_init(&nfs41_session->conn_lock, NULL);
-	nfs41_session->nb_slots = MIN(nfs_param.nfsv4_param.nb_slots,
-			nfs41_session->fore_channel_attrs.ca_maxrequests);
-	nfs41_session->fc_slots = gsh_calloc(nfs41_session->nb_slots,
-					     sizeof(nfs41_session_slot_t));
-	nfs41_session->bc_slots = gsh_calloc(nfs41_session->nb_slots,
-					     sizeof(nfs41_cb_session_slot_t));
-	for (i = 0; i < nfs41_session->nb_slots; i++)
-		PTHREAD_MUTEX_init(&nfs41_session->fc_slots[i].lock, NULL);
+	initial_slots = MIN(nfs_param.nfsv4_param.nb_slots,
+			    nfs41_session->fore_channel_attrs.ca_maxrequests);
+	/* The session may grow up to this if it gets busy, the forechannel
+	 * slots themselves are only allocated as they are offered.
+	 */
+	nfs41_session->nb_slots = MAX(initial_slots,
+				      nfs_param.nfsv4_param.max_slots);
+	nfs41_session->bc_slots = gsh_calloc(
+		MIN(nfs41_session->back_channel_attrs.ca_maxrequests,
+		    nfs41_session->nb_slots),
+		sizeof(nfs41_cb_session_slot_t));
+	nfs41_session_slots_init(nfs41_session, initial_slots);
 
 	/* Take reference to clientid record on behalf the session. */
 	inc_client_id_ref(found);
@@ -370,8 +376,7 @@ enum nfs_req_result nfs4_op_create_session(struct nfs_argop4 *op,
 	PTHREAD_MUTEX_unlock(&found->cid_mutex);
 
 	/* Set ca_maxrequests */
-	nfs41_session->fore_channel_attrs.ca_maxrequests =
-		nfs41_session->nb_slots;
+	nfs41_session->fore_channel_attrs.ca_maxrequests = initial_slots;
 	nfs41_Build_sessionid(&clientid, nfs41_session->session_id);
 
 	res_CREATE_SESSION4ok->csr_sequence = arg_CREATE_SESSION4->csa_sequence;
@@ -78,16 +78,19 @@ enum nfs_req_result nfs4_op_delegreturn(struct nfs_argop4 *op,
 	/* Initialize to sane default */
 	resp->resop = NFS4_OP_DELEGRETURN;
 
-	/* If the filehandle is invalid. Delegations are only supported on
-	 * regular files at the moment.
+	/* If the filehandle is invalid. Delegations are supported on
+	 * regular files and (NFSv4.1) directories.
 	 */
 	res_DELEGRETURN4->status = nfs4_sanity_check_FH(data,
-							REGULAR_FILE,
+							NO_FILE_TYPE,
 							false);
 
-	if (res_DELEGRETURN4->status != NFS4_OK) {
-		if (res_DELEGRETURN4->status == NFS4ERR_ISDIR)
-			res_DELEGRETURN4->status = NFS4ERR_INVAL;
+	if (res_DELEGRETURN4->status != NFS4_OK)
+		return NFS_REQ_ERROR;
+
+	if (data->current_filetype != REGULAR_FILE &&
+	    data->current_filetype != DIRECTORY) {
+		res_DELEGRETURN4->status = NFS4ERR_INVAL;
 		return NFS_REQ_ERROR;
 	}
 
@@ -0,0 +1,181 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file    nfs4_op_get_dir_delegation.c
+ * @brief   Routines used for managing the NFS4 COMPOUND functions.
+ *
+ * Routines used for managing the NFS4 COMPOUND functions.
+ */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "log.h"
+#include "gsh_rpc.h"
+#include "nfs4.h"
+#include "nfs_core.h"
+#include "nfs_exports.h"
+#include "sal_functions.h"
+#include "nfs_proto_functions.h"
+#include "nfs_proto_tools.h"
+#include "nfs_file_handle.h"
+
+/* Entry changes we can send as CB_NOTIFY, anything else is a recall */
+#define DIR_DELEG_NOTIFY_TYPES ((1 << NOTIFY4_REMOVE_ENTRY) | \
+				(1 << NOTIFY4_ADD_ENTRY) | \
+				(1 << NOTIFY4_RENAME_ENTRY))
+
+/**
+ * @brief The NFS4_OP_GET_DIR_DELEGATION operation.
+ *
+ * Grants a read-only directory delegation on a directory that has not
+ * been changing. Entry additions, removals and renames requested by the
+ * client are sent as CB_NOTIFY, any other change recalls the
+ * delegation. Attribute notifications are never granted.
+ *
+ * @param[in]     op    Arguments for nfs4_op
+ * @param[in,out] data  Compound request's data
+ * @param[out]    resp  Results for nfs4_op
+ *
+ * @return per RFC5661 p. 377
+ */
+enum nfs_req_result nfs4_op_get_dir_delegation(struct nfs_argop4 *op,
+					       compound_data_t *data,
+					       struct nfs_resop4 *resp)
+{
+	GET_DIR_DELEGATION4args * const arg_GDD4 =
+	    &op->nfs_argop4_u.opget_dir_delegation;
+	GET_DIR_DELEGATION4res * const res_GDD4 =
+	    &resp->nfs_resop4_u.opget_dir_delegation;
+	GET_DIR_DELEGATION4res_non_fatal *res_nf =
+	    &res_GDD4->GET_DIR_DELEGATION4res_u.gddr_res_non_fatal4;
+	GET_DIR_DELEGATION4resok *resok =
+	    &res_nf->GET_DIR_DELEGATION4res_non_fatal_u.gddrnf_resok4;
+	struct fsal_obj_handle *obj = data->current_obj;
+	nfs_client_id_t *client;
+	state_owner_t *clientowner;
+	union state_data state_data;
+	state_t *new_state = NULL;
+	struct state_refer refer;
+	struct glist_head *glist;
+	state_status_t state_status;
+	uint32_t notify_types = 0;
+
+	resp->resop = NFS4_OP_GET_DIR_DELEGATION;
+	res_GDD4->gddr_status = NFS4_OK;
+
+	if (data->minorversion == 0) {
+		res_GDD4->gddr_status = NFS4ERR_NOTSUPP;
+		return NFS_REQ_ERROR;
+	}
+
+	res_GDD4->gddr_status = nfs4_sanity_check_FH(data, DIRECTORY, false);
+	if (res_GDD4->gddr_status != NFS4_OK)
+		return NFS_REQ_ERROR;
+
+	/* We never send CB_RECALLABLE_OBJ_AVAIL */
+	res_nf->gddrnf_status = GDD4_UNAVAIL;
+	res_nf->GET_DIR_DELEGATION4res_non_fatal_u.gddrnf_signal = false;
+
+	client = data->session->clientid_record;
+	clientowner = &client->cid_owner;
+
+	if (!dir_deleg_supported(obj, op_ctx->export_perms) ||
+	    !(atomic_fetch_uint32_t(&data->session->flags) & session_bc_up))
+		return NFS_REQ_OK;
+
+	if (arg_GDD4->gdda_notification_types.bitmap4_len > 0)
+		notify_types = arg_GDD4->gdda_notification_types.map[0] &
+			       DIR_DELEG_NOTIFY_TYPES;
+
+	memcpy(refer.session, data->session->session_id, sizeof(sessionid4));
+	refer.sequence = data->sequence;
+	refer.slot = data->slotid;
+
+	PTHREAD_RWLOCK_wrlock(&obj->state_hdl->state_lock);
+
+	/* A client asking again just gets its delegation back */
+	glist_for_each(glist, &obj->state_hdl->dir.list_of_states) {
+		state_t *state = glist_entry(glist, state_t, state_list);
+
+		if (state->state_type == STATE_TYPE_DELEG &&
+		    state->state_owner == clientowner &&
+		    state->state_data.deleg.sd_state == DELEG_GRANTED) {
+			state->state_data.deleg.sd_notify_types = notify_types;
+			COPY_STATEID(&resok->gddr_stateid, state);
+			goto granted;
+		}
+	}
+
+	if (!should_we_grant_dir_deleg(obj->state_hdl, client)) {
+		PTHREAD_RWLOCK_unlock(&obj->state_hdl->state_lock);
+		LogDebug(COMPONENT_NFS_V4_LOCK,
+			 "Not granting directory delegation");
+		return NFS_REQ_OK;
+	}
+
+	init_new_deleg_state(&state_data, OPEN_DELEGATE_READ, client);
+	state_data.deleg.sd_notify_types = notify_types;
+	state_data.deleg.share_access = OPEN4_SHARE_ACCESS_READ;
+	state_data.deleg.share_deny = OPEN4_SHARE_DENY_NONE;
+
+	state_status = state_add_impl(obj, STATE_TYPE_DELEG, &state_data,
+				      clientowner, &new_state, &refer);
+	if (state_status != STATE_SUCCESS) {
+		PTHREAD_RWLOCK_unlock(&obj->state_hdl->state_lock);
+		LogDebug(COMPONENT_NFS_V4_LOCK,
+			 "Could not add directory delegation state: %s",
+			 state_err_str(state_status));
+		return NFS_REQ_OK;
+	}
+	new_state->state_seqid++;
+
+	update_dir_delegation_stats(obj->state_hdl, clientowner);
+	COPY_STATEID(&resok->gddr_stateid, new_state);
+	dec_state_t_ref(new_state);
+
+ granted:
+	PTHREAD_RWLOCK_unlock(&obj->state_hdl->state_lock);
+
+	res_nf->gddrnf_status = GDD4_OK;
+	memset(resok->gddr_cookieverf, 0, NFS4_VERIFIER_SIZE);
+	resok->gddr_notification.bitmap4_len = 1;
+	resok->gddr_notification.map[0] = notify_types;
+	resok->gddr_child_attributes.bitmap4_len = 0;
+	resok->gddr_dir_attributes.bitmap4_len = 0;
+
+	LogDebug(COMPONENT_NFS_V4_LOCK,
+		 "Granted directory delegation, notifications 0x%x",
+		 notify_types);
+
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief Free memory allocated for GET_DIR_DELEGATION result
+ *
+ * @param[in,out] resp nfs4_op results
+ */
+void nfs4_op_get_dir_delegation_Free(nfs_resop4 *resp)
+{
+	/* Nothing to be done */
+}
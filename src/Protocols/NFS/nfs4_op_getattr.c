@@ -45,11 +45,170 @@
 #include "nfs_convert.h"
 #include "sal_functions.h"
 
+/**
+ * @brief State for an NFS4_OP_GETATTR waiting on the FSAL
+ */
+struct nfs4_getattr_data {
+	/** The compound */
+	compound_data_t *data;
+	/** Attributes requested */
+	struct bitmap4 *attr_request;
+	/** Attribute mask requested */
+	attrmask_t mask;
+	/** Attributes fetched */
+	struct attrlist attrs;
+	/** Generation for the encoded attribute cache */
+	uint64_t attr_gen;
+	/** Status from the FSAL */
+	fsal_status_t status;
+	/** Synchronization flags between the op and the callback */
+	uint32_t flags;
+};
+
+/**
+ * @brief Callback for NFS4 getattr done
+ *
+ * @param[in] obj		Object being acted on
+ * @param[in] ret		Return status of call
+ * @param[in] attrs		Attributes fetched
+ * @param[in] caller_data	Data for caller
+ */
+static void nfs4_getattr_cb(struct fsal_obj_handle *obj, fsal_status_t ret,
+			    void *attrs, void *caller_data)
+{
+	struct nfs4_getattr_data *getattr_data = caller_data;
+	uint32_t flags;
+
+	getattr_data->status = ret;
+
+	flags = atomic_postset_uint32_t_bits(&getattr_data->flags,
+					     ASYNC_PROC_DONE);
+
+	if ((flags & ASYNC_PROC_EXIT) == ASYNC_PROC_EXIT) {
+		/* nfs4_op_getattr has already exited, we will need to
+		 * reschedule the request for completion.
+		 */
+		svc_resume(getattr_data->data->req);
+	}
+}
+
+/**
+ * @brief Encode the GETATTR reply once the FSAL has returned attributes
+ *
+ * @param[in,out] data Compound request's data
+ * @param[out]    resp Results for nfs4_op
+ *
+ * @return per RFC5661, p. 365
+ */
+static enum nfs_req_result nfs4_complete_getattr(compound_data_t *data,
+						 struct nfs_resop4 *resp)
+{
+	struct nfs4_getattr_data *getattr_data = data->op_data;
+	GETATTR4res * const res_GETATTR4 = &resp->nfs_resop4_u.opgetattr;
+	struct bitmap4 *attr_request = getattr_data->attr_request;
+	struct attrlist *attrs = &getattr_data->attrs;
+	struct fsal_obj_handle *obj = data->current_obj;
+	fattr4 *obj_attributes =
+		&res_GETATTR4->GETATTR4res_u.resok4.obj_attributes;
+	bool current_obj_is_referral = false;
+
+	if (FSAL_IS_ERROR(getattr_data->status))
+		res_GETATTR4->status = nfs4_Errno_status(getattr_data->status);
+	else
+		res_GETATTR4->status = file_attrs_To_Fattr(
+				data, getattr_data->mask, attrs,
+				obj_attributes, attr_request);
+
+	current_obj_is_referral = obj->obj_ops->is_referral(
+					obj, attrs, false);
+
+	if (res_GETATTR4->status == NFS4_OK && !current_obj_is_referral)
+		nfs4_Fattr_cache_put(data, obj, attr_request,
+				     getattr_data->attr_gen, obj_attributes);
+
+	/*
+	 * If it is a referral point, return the FATTR4_RDATTR_ERROR if
+	 * requested along with the requested restricted attrs.
+	 */
+	if (res_GETATTR4->status == NFS4_OK &&
+	    current_obj_is_referral) {
+		bool fill_rdattr_error = true;
+		bool fslocations_requested = attribute_is_set(
+						attr_request,
+						FATTR4_FS_LOCATIONS);
+
+		if (!fslocations_requested) {
+			if (!attribute_is_set(attr_request,
+						FATTR4_RDATTR_ERROR)) {
+				fill_rdattr_error = false;
+			}
+		}
+
+		if (fill_rdattr_error) {
+			struct xdr_attrs_args args;
+
+			memset(&args, 0, sizeof(args));
+			args.attrs = attrs;
+			args.fsid = data->current_obj->fsid;
+			get_mounted_on_fileid(data, &args.mounted_on_fileid);
+
+			if (nfs4_Fattr_Fill_Error(data, obj_attributes,
+						  NFS4ERR_MOVED,
+						  attr_request,
+						  &args)
+			    != 0) {
+				/* Report an error. */
+				res_GETATTR4->status = NFS4ERR_SERVERFAULT;
+			}
+		} else {
+			/* Report the referral. */
+			res_GETATTR4->status = NFS4ERR_MOVED;
+		}
+	}
+
+	/* Done with the attrs */
+	fsal_release_attrs(attrs);
+
+	if (res_GETATTR4->status == NFS4_OK) {
+		/* Fill in and check response size and make sure it fits. */
+		data->op_resp_size = sizeof(nfsstat4) +
+			res_GETATTR4->GETATTR4res_u.resok4.obj_attributes
+			.attr_vals.attrlist4_len;
+
+		res_GETATTR4->status =
+			check_resp_room(data, data->op_resp_size);
+	}
+
+	if (res_GETATTR4->status != NFS4_OK) {
+		/* The attributes that may have been allocated will not be
+		 * consumed. Since the response array was allocated with
+		 * gsh_calloc, the buffer pointer is always NULL or valid.
+		 */
+		nfs4_Fattr_Free(obj_attributes);
+
+		/* Indicate the failed response size. */
+		data->op_resp_size = sizeof(nfsstat4);
+	}
+
+	gsh_free(getattr_data);
+	data->op_data = NULL;
+
+	return nfsstat4_to_nfs_req_result(res_GETATTR4->status);
+}
+
+enum nfs_req_result nfs4_op_getattr_resume(struct nfs_argop4 *op,
+					   compound_data_t *data,
+					   struct nfs_resop4 *resp)
+{
+	return nfs4_complete_getattr(data, resp);
+}
+
 /**
  * @brief Gets attributes for an entry in the FSAL.
  *
  * Impelments the NFS4_OP_GETATTR operation, which gets attributes for
- * an entry in the FSAL.
+ * an entry in the FSAL.  If the FSAL completes the getattrs asynchronously,
+ * the compound is suspended and nfs4_op_getattr_resume() finishes the op.
  *
  * @param[in]     op   Arguments for nfs4_op
  * @param[in,out] data Compound request's data
@@ -65,13 +224,14 @@ enum nfs_req_result nfs4_op_getattr(struct nfs_argop4 *op,
 	GETATTR4args * const arg_GETATTR4 = &op->nfs_argop4_u.opgetattr;
 	GETATTR4res * const res_GETATTR4 = &resp->nfs_resop4_u.opgetattr;
 	attrmask_t mask;
-	struct attrlist attrs;
-	bool current_obj_is_referral = false;
-	fattr4 *obj_attributes =
-		&res_GETATTR4->GETATTR4res_u.resok4.obj_attributes;
+	struct nfs4_getattr_data *getattr_data;
 	nfs_client_id_t *deleg_client = NULL;
 	struct fsal_obj_handle *obj = data->current_obj;
 	cbgetattr_t *cbgetattr = NULL;
+	fattr4 *obj_attributes =
+		&res_GETATTR4->GETATTR4res_u.resok4.obj_attributes;
+	uint64_t attr_gen;
+	uint32_t flags;
 
 	/* This is a NFS4_OP_GETTAR */
 	resp->resop = NFS4_OP_GETATTR;
@@ -102,11 +262,6 @@ enum nfs_req_result nfs4_op_getattr(struct nfs_argop4 *op,
 	if (res_GETATTR4->status != NFS4_OK)
 		goto out;
 
-	/* Add mode to what we actually ask for so we can do fslocations
-	 * test.
-	 */
-	fsal_prepare_attrs(&attrs, mask | ATTR_MODE);
-
 	nfs4_bitmap4_Remove_Unsupported(&arg_GETATTR4->attr_request);
 
 	/* As per rfc 7530, section:10.4.3
@@ -140,82 +295,70 @@ enum nfs_req_result nfs4_op_getattr(struct nfs_argop4 *op,
 	/* release state_lock */
 	PTHREAD_RWLOCK_unlock(&obj->state_hdl->state_lock);
 
-	res_GETATTR4->status = file_To_Fattr(
-			data, mask, &attrs,
-			obj_attributes,
-			&arg_GETATTR4->attr_request);
+	if (deleg_client) {
+		dec_client_id_ref(deleg_client);
+		deleg_client = NULL;
+	}
 
-	current_obj_is_referral = obj->obj_ops->is_referral(
-					obj, &attrs, false);
+	res_GETATTR4->status = file_To_Fattr_access(
+					data, &arg_GETATTR4->attr_request);
 
-	/*
-	 * If it is a referral point, return the FATTR4_RDATTR_ERROR if
-	 * requested along with the requested restricted attrs.
-	 */
-	if (res_GETATTR4->status == NFS4_OK &&
-	    current_obj_is_referral) {
-		bool fill_rdattr_error = true;
-		bool fslocations_requested = attribute_is_set(
-						&arg_GETATTR4->attr_request,
-						FATTR4_FS_LOCATIONS);
+	if (res_GETATTR4->status != NFS4_OK)
+		goto out;
 
-		if (!fslocations_requested) {
-			if (!attribute_is_set(&arg_GETATTR4->attr_request,
-						FATTR4_RDATTR_ERROR)) {
-				fill_rdattr_error = false;
-			}
-		}
+	if (nfs4_Fattr_cache_get(data, obj, &arg_GETATTR4->attr_request,
+				 mask, obj_attributes, &attr_gen)) {
+		/* Same encoding as last time, nothing to fetch */
+		data->op_resp_size = sizeof(nfsstat4) +
+			obj_attributes->attr_vals.attrlist4_len;
 
-		if (fill_rdattr_error) {
-			struct xdr_attrs_args args;
+		res_GETATTR4->status =
+			check_resp_room(data, data->op_resp_size);
 
-			memset(&args, 0, sizeof(args));
-			args.attrs = &attrs;
-			args.fsid = data->current_obj->fsid;
-			get_mounted_on_fileid(data, &args.mounted_on_fileid);
+		if (res_GETATTR4->status != NFS4_OK)
+			nfs4_Fattr_Free(obj_attributes);
 
-			if (nfs4_Fattr_Fill_Error(data, obj_attributes,
-						  NFS4ERR_MOVED,
-						  &arg_GETATTR4->attr_request,
-						  &args)
-			    != 0) {
-				/* Report an error. */
-				res_GETATTR4->status = NFS4ERR_SERVERFAULT;
-			}
-		} else {
-			/* Report the referral. */
-			res_GETATTR4->status = NFS4ERR_MOVED;
-		}
+		goto out;
 	}
 
-	/* Done with the attrs */
-	fsal_release_attrs(&attrs);
+	getattr_data = gsh_calloc(1, sizeof(*getattr_data));
 
-	if (res_GETATTR4->status == NFS4_OK) {
-		/* Fill in and check response size and make sure it fits. */
-		data->op_resp_size = sizeof(nfsstat4) +
-			res_GETATTR4->GETATTR4res_u.resok4.obj_attributes
-			.attr_vals.attrlist4_len;
+	getattr_data->data = data;
+	getattr_data->attr_request = &arg_GETATTR4->attr_request;
+	getattr_data->mask = mask;
+	getattr_data->attr_gen = attr_gen;
 
-		res_GETATTR4->status =
-			check_resp_room(data, data->op_resp_size);
+	/* Add mode to what we actually ask for so we can do fslocations
+	 * test.
+	 */
+	fsal_prepare_attrs(&getattr_data->attrs, mask | ATTR_MODE);
+
+	data->op_data = getattr_data;
+
+	obj->obj_ops->getattrs_async(obj, &getattr_data->attrs,
+				     nfs4_getattr_cb, getattr_data);
+
+	flags = atomic_postset_uint32_t_bits(&getattr_data->flags,
+					     ASYNC_PROC_EXIT);
+
+	if ((flags & ASYNC_PROC_DONE) != ASYNC_PROC_DONE) {
+		/* The getattrs was not finished before we got here. When it
+		 * completes, nfs4_getattr_cb() will reschedule the request
+		 * and nfs4_op_getattr_resume() will finish the op.
+		 */
+		return NFS_REQ_ASYNC_WAIT;
 	}
 
+	return nfs4_complete_getattr(data, resp);
+
 out:
 
 	if (deleg_client)
 		dec_client_id_ref(deleg_client);
 
-	if (res_GETATTR4->status != NFS4_OK) {
-		/* The attributes that may have been allocated will not be
-		 * consumed. Since the response array was allocated with
-		 * gsh_calloc, the buffer pointer is always NULL or valid.
-		 */
-		nfs4_Fattr_Free(obj_attributes);
-
-		/* Indicate the failed response size. */
+	/* Indicate the failed response size. */
+	if (res_GETATTR4->status != NFS4_OK)
 		data->op_resp_size = sizeof(nfsstat4);
-	}
 
 	return nfsstat4_to_nfs_req_result(res_GETATTR4->status);
 }				/* nfs4_op_getattr */
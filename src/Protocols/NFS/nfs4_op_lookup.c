@@ -43,69 +43,233 @@
 #include "export_mgr.h"
 #include "nfs_proto_functions.h"
 
+/** Longest run of LOOKUPs resolved through the path cache */
+#define NFS4_LOOKUP_RUN_MAX 16
+
 /**
- * @brief NFS4_OP_LOOKUP
+ * @brief State for an NFS4_OP_LOOKUP waiting on the FSAL
+ */
+struct nfs4_lookup_data {
+	/** The compound */
+	compound_data_t *data;
+	/** The name to look up */
+	char *name;
+	/** The object found */
+	struct fsal_obj_handle *file_obj;
+	/** Status from the FSAL */
+	fsal_status_t status;
+	/** Synchronization flags between the op and the callback */
+	uint32_t flags;
+};
+
+/**
+ * @brief Callback for NFS4 lookup done
  *
- * This function implments the NFS4_OP_LOOKUP operation, which looks
- * a filename up in the FSAL.
+ * @param[in] dir_obj		Directory looked in
+ * @param[in] ret		Return status of call
+ * @param[in] file_obj		Object found
+ * @param[in] caller_data	Data for caller
+ */
+static void nfs4_lookup_cb(struct fsal_obj_handle *dir_obj, fsal_status_t ret,
+			   void *file_obj, void *caller_data)
+{
+	struct nfs4_lookup_data *lookup_data = caller_data;
+	uint32_t flags;
+
+	lookup_data->status = ret;
+	lookup_data->file_obj = file_obj;
+
+	flags = atomic_postset_uint32_t_bits(&lookup_data->flags,
+					     ASYNC_PROC_DONE);
+
+	if ((flags & ASYNC_PROC_EXIT) == ASYNC_PROC_EXIT) {
+		/* nfs4_op_lookup has already exited, we will need to
+		 * reschedule the request for completion.
+		 */
+		svc_resume(lookup_data->data->req);
+	}
+}
+
+/**
+ * @brief Forget the run of LOOKUPs being resolved name by name
  *
- * @param[in]     op   Arguments for nfs4_op
  * @param[in,out] data Compound request's data
- * @param[out]    resp Results for nfs4_op
+ */
+void nfs4_lookup_run_release(compound_data_t *data)
+{
+	if (data->lookup_start != NULL) {
+		data->lookup_start->obj_ops->put_ref(data->lookup_start);
+		data->lookup_start = NULL;
+	}
+
+	gsh_free(data->lookup_path);
+	data->lookup_path = NULL;
+	data->lookup_left = 0;
+}
+
+/**
+ * @brief Account for one LOOKUP of a run resolved name by name
  *
- * @return per RFC5661, pp. 368-9
+ * Once the whole run succeeded without leaving the export, the FSAL is
+ * asked to remember where the path leads.
  *
+ * @param[in,out] data Compound request's data
+ * @param[in]     ok   Whether this LOOKUP succeeded
  */
+static void nfs4_lookup_run_step(compound_data_t *data, bool ok)
+{
+	struct fsal_obj_handle *start = data->lookup_start;
 
-enum nfs_req_result nfs4_op_lookup(struct nfs_argop4 *op,
-				   compound_data_t *data,
-				   struct nfs_resop4 *resp)
+	if (ok && --data->lookup_left != 0)
+		return;
+
+	if (ok && op_ctx->ctx_export->export_id == data->lookup_export_id &&
+	    atomic_fetch_uint64_t(&pseudofs_junction_gen) ==
+	    data->lookup_epoch)
+		start->obj_ops->cache_path(start, data->lookup_path,
+					   data->lookup_epoch);
+
+	nfs4_lookup_run_release(data);
+}
+
+/**
+ * @brief Build the path looked up by a run of LOOKUPs
+ *
+ * The run starts at the current op and covers the LOOKUPs that directly
+ * follow it.  Every name is checked as the LOOKUP itself would.
+ *
+ * @param[in]  data Compound request's data
+ * @param[out] path The names separated by '/', to be freed by the caller
+ *
+ * @return Number of LOOKUPs in the run, 0 if there is no usable run.
+ */
+static uint32_t nfs4_lookup_run_path(compound_data_t *data, char **path)
 {
-	/* Convenient alias for the arguments */
-	LOOKUP4args * const arg_LOOKUP4 = &op->nfs_argop4_u.oplookup;
-	/* Convenient alias for the response  */
-	LOOKUP4res * const res_LOOKUP4 = &resp->nfs_resop4_u.oplookup;
-	/* The name to look up */
-	char *name = NULL;
-	/* The directory in which to look up the name */
-	struct fsal_obj_handle *dir_obj = NULL;
-	/* The name found */
-	struct fsal_obj_handle *file_obj = NULL;
-	/* Status code from fsal */
-	fsal_status_t status = {0, 0};
+	uint32_t count = 0, i;
+	size_t len = 0;
+	utf8string *name;
+	char *p;
+
+	*path = NULL;
+
+	for (i = data->oppos; i < data->argarray_len &&
+	     data->argarray[i].argop == NFS4_OP_LOOKUP; i++) {
+		name = &data->argarray[i].nfs_argop4_u.oplookup.objname;
+
+		if (count == NFS4_LOOKUP_RUN_MAX ||
+		    name->utf8string_len == 0 ||
+		    name->utf8string_len > MAXNAMLEN ||
+		    nfs4_path_filter(name->utf8string_val,
+				     name->utf8string_len,
+				     UTF8_SCAN_ALL) != NFS4_OK)
+			break;
+
+		len += name->utf8string_len + 1;
+		count++;
+	}
 
-	resp->resop = NFS4_OP_LOOKUP;
-	res_LOOKUP4->status = NFS4_OK;
+	if (count < 2)
+		return 0;
 
-	/* Do basic checks on a filehandle */
-	res_LOOKUP4->status = nfs4_sanity_check_FH(data, DIRECTORY, false);
-	if (res_LOOKUP4->status != NFS4_OK) {
-		/* for some reason lookup is picky.  Just not being
-		 * dir is not enough.  We want to know it is a symlink
-		 */
-		if (res_LOOKUP4->status == NFS4ERR_NOTDIR
-		    && data->current_filetype == SYMBOLIC_LINK)
-			res_LOOKUP4->status = NFS4ERR_SYMLINK;
-		goto out;
+	p = *path = gsh_malloc(len);
+
+	for (i = data->oppos; i < data->oppos + count; i++) {
+		name = &data->argarray[i].nfs_argop4_u.oplookup.objname;
+		memcpy(p, name->utf8string_val, name->utf8string_len);
+		p += name->utf8string_len;
+		*p++ = '/';
 	}
+	p[-1] = '\0';
 
-	/* Validate and convert the UFT8 objname to a regular string */
-	res_LOOKUP4->status = nfs4_utf8string2dynamic(&arg_LOOKUP4->objname,
-						      UTF8_SCAN_ALL,
-						      &name);
+	return count;
+}
 
-	if (res_LOOKUP4->status != NFS4_OK)
-		goto out;
+/**
+ * @brief Try to resolve a run of LOOKUPs in one step
+ *
+ * On a hit the whole path has been resolved, @a data->op_data is set up
+ * for nfs4_complete_lookup() and the following LOOKUPs of the run will
+ * just succeed.  On a miss the run is recorded so the path can be cached
+ * once its last LOOKUP completes.
+ *
+ * @param[in,out] data    Compound request's data
+ * @param[in]     dir_obj Directory the run starts from
+ *
+ * @return true on a hit.
+ */
+static bool nfs4_lookup_run_start(compound_data_t *data,
+				  struct fsal_obj_handle *dir_obj)
+{
+	struct nfs4_lookup_data *lookup_data;
+	struct fsal_obj_handle *obj = NULL;
+	fsal_status_t status;
+	uint64_t epoch;
+	uint32_t count;
+	char *path;
+
+	count = nfs4_lookup_run_path(data, &path);
+	if (count == 0)
+		return false;
+
+	/* The FSAL only vouches for the directories past the first one */
+	status = fsal_access(dir_obj,
+			     FSAL_MODE_MASK_SET(FSAL_X_OK) |
+			     FSAL_ACE4_MASK_SET(FSAL_ACE_PERM_EXECUTE));
+	if (FSAL_IS_ERROR(status)) {
+		/* Let the plain LOOKUP fail the same way */
+		gsh_free(path);
+		return false;
+	}
 
-	LogDebug(COMPONENT_NFS_V4, "name=%s", name);
+	epoch = atomic_fetch_uint64_t(&pseudofs_junction_gen);
 
-	/* Do the lookup in the FSAL */
-	file_obj = NULL;
-	dir_obj = data->current_obj;
+	if (dir_obj->obj_ops->lookup_cached_path(dir_obj, path, epoch,
+						 &obj)) {
+		LogDebug(COMPONENT_NFS_V4, "path=%s resolved by %" PRIu32
+			 " LOOKUPs", path, count);
+
+		lookup_data = gsh_calloc(1, sizeof(*lookup_data));
+		lookup_data->data = data;
+		lookup_data->name = path;
+		lookup_data->file_obj = obj;
+		data->op_data = lookup_data;
+		data->lookup_skip = count - 1;
+		return true;
+	}
+
+	dir_obj->obj_ops->get_ref(dir_obj);
+	data->lookup_start = dir_obj;
+	data->lookup_path = path;
+	data->lookup_left = count;
+	data->lookup_export_id = op_ctx->ctx_export->export_id;
+	data->lookup_epoch = epoch;
 
-	/* Sanity check: dir_obj should be ACTUALLY a directory */
+	return false;
+}
+
+/**
+ * @brief Finish NFS4_OP_LOOKUP once the FSAL has found the name
+ *
+ * Crosses a junction if needed and sets the current filehandle.
+ *
+ * @param[in,out] data Compound request's data
+ * @param[out]    resp Results for nfs4_op
+ *
+ * @return per RFC5661, pp. 368-9
+ */
+static enum nfs_req_result nfs4_complete_lookup(compound_data_t *data,
+						struct nfs_resop4 *resp)
+{
+	struct nfs4_lookup_data *lookup_data = data->op_data;
+	/* Convenient alias for the response  */
+	LOOKUP4res * const res_LOOKUP4 = &resp->nfs_resop4_u.oplookup;
+	/* The name to look up */
+	char *name = lookup_data->name;
+	/* The name found */
+	struct fsal_obj_handle *file_obj = lookup_data->file_obj;
+	/* Status code from fsal */
+	fsal_status_t status = lookup_data->status;
 
-	status = fsal_lookup(dir_obj, name, &file_obj, NULL);
 	if (FSAL_IS_ERROR(status)) {
 		res_LOOKUP4->status = nfs4_Errno_status(status);
 		goto out;
@@ -233,6 +397,122 @@ enum nfs_req_result nfs4_op_lookup(struct nfs_argop4 *op,
 	if (file_obj)
 		file_obj->obj_ops->put_ref(file_obj);
 
+	if (res_LOOKUP4->status != NFS4_OK)
+		data->lookup_skip = 0;
+
+	if (data->lookup_left != 0)
+		nfs4_lookup_run_step(data, res_LOOKUP4->status == NFS4_OK);
+
+	gsh_free(name);
+	gsh_free(lookup_data);
+	data->op_data = NULL;
+
+	return nfsstat4_to_nfs_req_result(res_LOOKUP4->status);
+}
+
+enum nfs_req_result nfs4_op_lookup_resume(struct nfs_argop4 *op,
+					  compound_data_t *data,
+					  struct nfs_resop4 *resp)
+{
+	return nfs4_complete_lookup(data, resp);
+}
+
+/**
+ * @brief NFS4_OP_LOOKUP
+ *
+ * This function implments the NFS4_OP_LOOKUP operation, which looks
+ * a filename up in the FSAL.  If the FSAL completes the lookup
+ * asynchronously, the compound is suspended and nfs4_op_lookup_resume()
+ * finishes the op.
+ *
+ * The first of several LOOKUPs in a row is offered to the FSAL's path
+ * cache as a whole; on a hit the others succeed without doing anything.
+ *
+ * @param[in]     op   Arguments for nfs4_op
+ * @param[in,out] data Compound request's data
+ * @param[out]    resp Results for nfs4_op
+ *
+ * @return per RFC5661, pp. 368-9
+ *
+ */
+
+enum nfs_req_result nfs4_op_lookup(struct nfs_argop4 *op,
+				   compound_data_t *data,
+				   struct nfs_resop4 *resp)
+{
+	/* Convenient alias for the arguments */
+	LOOKUP4args * const arg_LOOKUP4 = &op->nfs_argop4_u.oplookup;
+	/* Convenient alias for the response  */
+	LOOKUP4res * const res_LOOKUP4 = &resp->nfs_resop4_u.oplookup;
+	/* The name to look up */
+	char *name = NULL;
+	/* The directory in which to look up the name */
+	struct fsal_obj_handle *dir_obj = NULL;
+	struct nfs4_lookup_data *lookup_data;
+	uint32_t flags;
+
+	resp->resop = NFS4_OP_LOOKUP;
+	res_LOOKUP4->status = NFS4_OK;
+
+	if (data->lookup_skip != 0) {
+		/* Already resolved with the rest of its run */
+		data->lookup_skip--;
+		return NFS_REQ_OK;
+	}
+
+	/* Do basic checks on a filehandle */
+	res_LOOKUP4->status = nfs4_sanity_check_FH(data, DIRECTORY, false);
+	if (res_LOOKUP4->status != NFS4_OK) {
+		/* for some reason lookup is picky.  Just not being
+		 * dir is not enough.  We want to know it is a symlink
+		 */
+		if (res_LOOKUP4->status == NFS4ERR_NOTDIR
+		    && data->current_filetype == SYMBOLIC_LINK)
+			res_LOOKUP4->status = NFS4ERR_SYMLINK;
+		goto out;
+	}
+
+	/* Validate and convert the UFT8 objname to a regular string */
+	res_LOOKUP4->status = nfs4_utf8string2dynamic(&arg_LOOKUP4->objname,
+						      UTF8_SCAN_ALL,
+						      &name);
+
+	if (res_LOOKUP4->status != NFS4_OK)
+		goto out;
+
+	LogDebug(COMPONENT_NFS_V4, "name=%s", name);
+
+	/* Do the lookup in the FSAL */
+	dir_obj = data->current_obj;
+
+	if (data->lookup_left == 0 && nfs4_lookup_run_start(data, dir_obj)) {
+		gsh_free(name);
+		return nfs4_complete_lookup(data, resp);
+	}
+
+	lookup_data = gsh_calloc(1, sizeof(*lookup_data));
+
+	lookup_data->data = data;
+	lookup_data->name = name;
+
+	data->op_data = lookup_data;
+
+	fsal_lookup_async(dir_obj, name, NULL, nfs4_lookup_cb, lookup_data);
+
+	flags = atomic_postset_uint32_t_bits(&lookup_data->flags,
+					     ASYNC_PROC_EXIT);
+
+	if ((flags & ASYNC_PROC_DONE) != ASYNC_PROC_DONE) {
+		/* The lookup was not finished before we got here. When it
+		 * completes, nfs4_lookup_cb() will reschedule the request
+		 * and nfs4_op_lookup_resume() will finish the op.
+		 */
+		return NFS_REQ_ASYNC_WAIT;
+	}
+
+	return nfs4_complete_lookup(data, resp);
+
+ out:
 	gsh_free(name);
 
 	return nfsstat4_to_nfs_req_result(res_LOOKUP4->status);
@@ -144,32 +144,92 @@ static enum nfs_req_result nfs4_complete_read(struct nfs4_read_data *data)
 	return nfsstat4_to_nfs_req_result(data->res_READ4->status);
 }
 
+/**
+ * @brief Build the READ_PLUS segment list from a completed read
+ *
+ * READ_PLUS4res overlays READ4res, so the status and eof are already in
+ * place and rpr_contents_count/rpr_contents replace the data length and
+ * buffer.  The data segments point into the read buffer, which the FSAL
+ * packed in segment order, so the first data segment owns the buffer.
+ *
+ * @param[in,out] resp       Results for the op
+ * @param[in]     read_data  Read that was done, NULL for a 0 length read
+ */
+
 static void nfs4_complete_read_plus(struct nfs_resop4 *resp,
-				    struct io_info *info)
+				    struct nfs4_read_data *read_data)
 {
-	READ4res * const res_READ4 = &resp->nfs_resop4_u.opread;
 	READ_PLUS4res * const res_RPLUS = &resp->nfs_resop4_u.opread_plus;
-	contents *contentp = &res_RPLUS->rpr_resok4.rpr_contents;
+	struct fsal_io_arg *read_arg;
+	struct io_info *info;
+	contents *contentp = NULL;
+	char *buffer, *datap;
+	bool have_data = false;
+	uint32_t i;
 
-	/* Fixup the eof status from the res_READ4 that res_RPLUS overlays. */
-	res_RPLUS->rpr_resok4.rpr_eof = res_READ4->READ4res_u.resok4.eof;
+	res_RPLUS->rpr_resok4.rpr_contents_count = 0;
+	res_RPLUS->rpr_resok4.rpr_contents = NULL;
 
-	/* Now fill in the rest of res_RPLUS */
-	contentp->what = info->io_content.what;
-	res_RPLUS->rpr_resok4.rpr_contents_count = 1;
+	if (read_data == NULL)
+		return;
 
-	if (info->io_content.what == NFS4_CONTENT_HOLE) {
-		contentp->hole.di_offset = info->io_content.hole.di_offset;
-		contentp->hole.di_length = info->io_content.hole.di_length;
+	read_arg = &read_data->read_arg;
+	info = &read_data->info;
+	buffer = read_arg->iov[0].iov_base;
+
+	if (info->io_nsegs == 0) {
+		/* The FSAL didn't build a segment map, it returned either a
+		 * single hole in io_content or plain data.
+		 */
+		if (info->io_content.what == NFS4_CONTENT_HOLE) {
+			info->io_segs[0].what = NFS4_CONTENT_HOLE;
+			info->io_segs[0].offset =
+					info->io_content.hole.di_offset;
+			info->io_segs[0].length =
+					info->io_content.hole.di_length;
+			info->io_nsegs = 1;
+		} else if (read_arg->io_amount != 0) {
+			info->io_segs[0].what = NFS4_CONTENT_DATA;
+			info->io_segs[0].offset = read_arg->offset;
+			info->io_segs[0].length = read_arg->io_amount;
+			info->io_nsegs = 1;
+		}
 	}
 
-	if (info->io_content.what == NFS4_CONTENT_DATA) {
-		contentp->data.d_offset = info->io_content.data.d_offset;
-		contentp->data.d_data.data_len =
-					info->io_content.data.d_data.data_len;
-		contentp->data.d_data.data_val =
-					info->io_content.data.d_data.data_val;
+	if (info->io_nsegs != 0)
+		contentp = gsh_calloc(info->io_nsegs, sizeof(*contentp));
+
+	datap = buffer;
+
+	for (i = 0; i < info->io_nsegs; i++) {
+		struct io_seg *seg = &info->io_segs[i];
+
+		contentp[i].what = seg->what;
+
+		if (seg->what == NFS4_CONTENT_DATA) {
+			contentp[i].data.d_offset = seg->offset;
+			contentp[i].data.d_data.data_len = seg->length;
+			contentp[i].data.d_data.data_val = datap;
+			datap += seg->length;
+			have_data = true;
+		} else {
+			contentp[i].hole.di_offset = seg->offset;
+			contentp[i].hole.di_length = seg->length;
+		}
 	}
+
+	/* Nothing references the buffer if it was all holes */
+	if (!have_data)
+		gsh_free(buffer);
+
+	res_RPLUS->rpr_resok4.rpr_contents_count = info->io_nsegs;
+	res_RPLUS->rpr_resok4.rpr_contents = contentp;
+
+	LogFullDebug(COMPONENT_NFS_V4,
+		     "NFS4_OP_READ_PLUS: offset = %" PRIu64
+		     " data = %zu segments = %" PRIu32 " eof=%u",
+		     read_arg->offset, read_arg->io_amount, info->io_nsegs,
+		     res_RPLUS->rpr_resok4.rpr_eof);
 }
 
 enum nfs_req_result nfs4_op_read_resume(struct nfs_argop4 *op,
@@ -200,7 +260,7 @@ enum nfs_req_result nfs4_op_read_plus_resume(struct nfs_argop4 *op,
 	enum nfs_req_result rc = nfs4_complete_read(read_data);
 
 	if (rc == NFS_REQ_OK) {
-		nfs4_complete_read_plus(resp, &read_data->info);
+		nfs4_complete_read_plus(resp, read_data);
 	}
 
 	if (rc != NFS_REQ_ASYNC_WAIT) {
@@ -337,7 +397,7 @@ static enum nfs_req_result op_dsread_plus(struct nfs_argop4 *op,
 {
 	READ4args * const arg_READ4 = &op->nfs_argop4_u.opread;
 	READ_PLUS4res * const res_RPLUS = &resp->nfs_resop4_u.opread_plus;
-	contents *contentp = &res_RPLUS->rpr_resok4.rpr_contents;
+	contents *contentp;
 	/* NFSv4 return code */
 	nfsstat4 nfs_status = 0;
 	/* Buffer into which data is to be read */
@@ -348,12 +408,9 @@ static enum nfs_req_result op_dsread_plus(struct nfs_argop4 *op,
 	/* Don't bother calling the FSAL if the read length is 0. */
 
 	if (arg_READ4->count == 0) {
-		res_RPLUS->rpr_resok4.rpr_contents_count = 1;
+		res_RPLUS->rpr_resok4.rpr_contents_count = 0;
+		res_RPLUS->rpr_resok4.rpr_contents = NULL;
 		res_RPLUS->rpr_resok4.rpr_eof = FALSE;
-		contentp->what = NFS4_CONTENT_DATA;
-		contentp->data.d_offset = arg_READ4->offset;
-		contentp->data.d_data.data_len =  0;
-		contentp->data.d_data.data_val = NULL;
 		res_RPLUS->rpr_status = NFS4_OK;
 		return NFS_REQ_OK;
 	}
@@ -378,13 +435,16 @@ static enum nfs_req_result op_dsread_plus(struct nfs_argop4 *op,
 		return NFS_REQ_ERROR;
 	}
 
+	contentp = gsh_calloc(1, sizeof(*contentp));
 	contentp->what = info->io_content.what;
 	res_RPLUS->rpr_resok4.rpr_contents_count = 1;
+	res_RPLUS->rpr_resok4.rpr_contents = contentp;
 	res_RPLUS->rpr_resok4.rpr_eof = eof;
 
 	if (info->io_content.what == NFS4_CONTENT_HOLE) {
 		contentp->hole.di_offset = info->io_content.hole.di_offset;
 		contentp->hole.di_length = info->io_content.hole.di_length;
+		gsh_free(buffer);
 	}
 	if (info->io_content.what == NFS4_CONTENT_DATA) {
 		contentp->data.d_offset = info->io_content.data.d_offset;
@@ -637,6 +697,13 @@ static enum nfs_req_result nfs4_read(struct nfs_argop4 *op,
 	 */
 	resp_size = RNDUP(size) + sizeof(nfsstat4) + 2 * sizeof(uint32_t);
 
+	/* READ_PLUS may split the reply into segments, each one costs its
+	 * type and offset plus a length or data length and padding.
+	 */
+	if (info != NULL)
+		resp_size += IO_INFO_MAX_SEGS *
+			     (sizeof(data_content4) + 2 * sizeof(uint64_t));
+
 	res_READ4->status = check_resp_room(data, resp_size);
 
 	if (res_READ4->status != NFS4_OK)
@@ -689,6 +756,7 @@ static enum nfs_req_result nfs4_read(struct nfs_argop4 *op,
 	if (info != NULL) {
 		/* We will be using the io_info that is part of read_data */
 		read_data->info.io_advise = info->io_advise;
+		read_arg->info = &read_data->info;
 	}
 
 	/* Do the actual read */
@@ -700,6 +768,27 @@ static enum nfs_req_result nfs4_read(struct nfs_argop4 *op,
 	flags =
 	    atomic_postset_uint32_t_bits(&read_data->flags, ASYNC_PROC_EXIT);
 
+	if ((flags & ASYNC_PROC_DONE) == ASYNC_PROC_DONE &&
+	    read_arg->info != NULL &&
+	    res_READ4->status == NFS4ERR_NOTSUPP) {
+		/* The FSAL can't build a segment map for READ_PLUS, do a
+		 * plain read instead and nfs4_complete_read_plus will return
+		 * it as a single DATA segment.
+		 */
+		LogFullDebug(COMPONENT_NFS_V4,
+			     "READ_PLUS not supported by FSAL, doing plain read");
+		read_arg->info = NULL;
+		read_arg->io_amount = 0;
+		read_arg->end_of_file = false;
+		read_data->flags = 0;
+
+		obj->obj_ops->read2(obj, bypass, nfs4_read_cb, read_arg,
+				    read_data);
+
+		flags = atomic_postset_uint32_t_bits(&read_data->flags,
+						     ASYNC_PROC_EXIT);
+	}
+
  out:
 
 	if (state_open != NULL)
@@ -832,9 +921,7 @@ enum nfs_req_result nfs4_op_read_plus(struct nfs_argop4 *op,
 	if (req_result == NFS_REQ_OK) {
 		struct nfs4_read_data *read_data = data->op_data;
 
-		nfs4_complete_read_plus(resp, read_data != NULL
-					      ? &read_data->info
-					      : &info);
+		nfs4_complete_read_plus(resp, read_data);
 	}
 
 	if (req_result != NFS_REQ_ASYNC_WAIT && data->op_data != NULL) {
@@ -854,11 +941,21 @@ enum nfs_req_result nfs4_op_read_plus(struct nfs_argop4 *op,
 void nfs4_op_read_plus_Free(nfs_resop4 *res)
 {
 	READ_PLUS4res *resp = &res->nfs_resop4_u.opread_plus;
-	contents *conp = &resp->rpr_resok4.rpr_contents;
+	contents *conp = resp->rpr_resok4.rpr_contents;
+	uint32_t i;
+
+	if (resp->rpr_status != NFS4_OK || conp == NULL)
+		return;
+
+	/* The first data segment owns the read buffer */
+	for (i = 0; i < resp->rpr_resok4.rpr_contents_count; i++) {
+		if (conp[i].what == NFS4_CONTENT_DATA) {
+			gsh_free(conp[i].data.d_data.data_val);
+			break;
+		}
+	}
 
-	if (resp->rpr_status == NFS4_OK && conp->what == NFS4_CONTENT_DATA)
-		if (conp->data.d_data.data_val != NULL)
-			gsh_free(conp->data.d_data.data_val);
+	gsh_free(conp);
 }
 
 /**
@@ -123,6 +123,8 @@ fsal_errors_t nfs4_readdir_callback(void *opaque,
 	fsal_status_t fsal_status;
 	fsal_accessflags_t access_mask_attr = 0;
 	size_t initial_mem_left = tracker->mem_left;
+	uint64_t attr_gen;
+	bool use_cache;
 
 	/* Cleanup after problem with junction processing. */
 	if (cb_state == CB_PROBLEM) {
@@ -370,6 +372,18 @@ not_junction:
 		goto skip;
 	}
 
+	/* Entries across a junction report the junction's fileid as
+	 * mounted_on_fileid, keep them out of the encoded attribute cache.
+	 */
+	use_cache = cb_state == CB_ORIGINAL && mounted_on_fileid == obj->fileid;
+
+	/* Referrals are never cached, so a hit needs no referral check */
+	if (use_cache &&
+	    nfs4_Fattr_cache_get(data, obj, tracker->req_attr,
+				 attr->request_mask, &tracker_entry->attrs,
+				 &attr_gen))
+		goto skip;
+
 	if (nfs4_FSALattr_To_Fattr(&args,
 				   tracker->req_attr,
 				   &tracker_entry->attrs) != 0) {
@@ -387,6 +401,9 @@ not_junction:
 			 nfsstat4_to_str(rdattr_error));
 		/* Discard the attributes we had retrieved. */
 		nfs4_Fattr_Free(&tracker_entry->attrs);
+	} else if (use_cache) {
+		nfs4_Fattr_cache_put(data, obj, tracker->req_attr, attr_gen,
+				     &tracker_entry->attrs);
 	}
 
  skip:
@@ -101,8 +101,10 @@ enum nfs_req_result nfs4_op_sequence(struct nfs_argop4 *op,
 
 	slotid = arg_SEQUENCE4->sa_slotid;
 
-	/* Check is slot is compliant with ca_maxrequests */
-	if (slotid >= session->fore_channel_attrs.ca_maxrequests) {
+	/* Check is slot is within what we currently accept, this may differ
+	 * from ca_maxrequests as the slot table is resized.
+	 */
+	if (slotid > atomic_fetch_uint32_t(&session->highest_slotid)) {
 		dec_session_ref(session);
 		res_SEQUENCE4->sr_status = NFS4ERR_BADSLOT;
 		LogDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
@@ -111,7 +113,10 @@ enum nfs_req_result nfs4_op_sequence(struct nfs_argop4 *op,
 		return NFS_REQ_ERROR;
 	}
 
-	slot = &session->fc_slots[slotid];
+	/* Feed slot table sizing */
+	nfs41_session_slot_used(session, slotid);
+
+	slot = nfs41_session_slot(session, slotid);
 
 	/* Serialize use of this slot. */
 	PTHREAD_MUTEX_lock(&slot->lock);
@@ -192,9 +197,9 @@ enum nfs_req_result nfs4_op_sequence(struct nfs_argop4 *op,
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_sequenceid = slot->sequence;
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_slotid = slotid;
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_highest_slotid =
-	    session->nb_slots - 1;
+	    atomic_fetch_uint32_t(&session->highest_slotid);
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_target_highest_slotid =
-	    session->fore_channel_attrs.ca_maxrequests - 1;
+	    atomic_fetch_uint32_t(&session->target_highest_slotid);
 
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_status_flags = 0;
 
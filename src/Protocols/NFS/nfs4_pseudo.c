@@ -39,6 +39,14 @@
 #include "fsal.h"
 #include "export_mgr.h"
 
+/**
+ * @brief Generation of the junctions, bumped whenever one comes or goes
+ *
+ * Paths cached by LOOKUP are tagged with it, so a path that now crosses
+ * a junction is never used.
+ */
+uint64_t pseudofs_junction_gen;
+
 /**
  * @brief Find the node for this path component
  *
@@ -416,6 +424,7 @@ bool pseudo_mount_export(struct gsh_export *export)
 	PTHREAD_RWLOCK_wrlock(&state.obj->state_hdl->state_lock);
 	state.obj->state_hdl->dir.junction_export = export;
 	PTHREAD_RWLOCK_unlock(&state.obj->state_hdl->state_lock);
+	(void)atomic_inc_uint64_t(&pseudofs_junction_gen);
 
 	/* And fill in the mounted on information for the export. */
 	PTHREAD_RWLOCK_wrlock(&export->lock);
@@ -538,6 +547,7 @@ void pseudo_unmount_export(struct gsh_export *export)
 		PTHREAD_RWLOCK_wrlock(&junction_inode->state_hdl->state_lock);
 		junction_inode->state_hdl->dir.junction_export = NULL;
 		PTHREAD_RWLOCK_unlock(&junction_inode->state_hdl->state_lock);
+		(void)atomic_inc_uint64_t(&pseudofs_junction_gen);
 
 		/* Detach the export from the inode */
 		PTHREAD_RWLOCK_wrlock(&export->lock);
@@ -3297,100 +3297,6 @@ const struct fattr4_dent fattr4tab[FATTR4_XATTR_SUPPORT + 1] = {
 		.access = FATTR4_ATTR_READ}
 };
 
-/* goes in a more global header?
- */
-
-/** path_filter
- * scan the path we are given for bad filenames.
- *
- * scan control:
- *    UTF8_SCAN_NOSLASH - detect and reject '/' in names
- *    UTF8_NODOT - detect and reject "." and ".." as the name
- *    UTF8_SCAN_CKUTF8 - detect invalid utf8 sequences
- *
- * NULL termination is required.  It also speeds up the scan
- * UTF-8 scanner courtesy Markus Kuhn <http://www.cl.cam.ac.uk/~mgk25/>
- * GPL licensed per licensing referenced in source.
- *
- */
-
-static nfsstat4 path_filter(const char *name, utf8_scantype_t scan)
-{
-	const unsigned char *np = (const unsigned char *)name;
-	nfsstat4 status = NFS4_OK;
-	unsigned int c, first;
-
-	first = 1;
-	c = *np++;
-	while (c) {
-		if (likely(c < 0x80)) {
-			/* ascii */
-			if (unlikely(c == '/' && (scan & UTF8_SCAN_NOSLASH))) {
-				status = NFS4ERR_BADCHAR;
-				goto error;
-			}
-			if (unlikely
-			    (first && c == '.' && (scan & UTF8_SCAN_NODOT))) {
-				if (np[0] == '\0'
-				    || (np[0] == '.' && np[1] == '\0')) {
-					status = NFS4ERR_BADNAME;
-					goto error;
-				}
-			}
-		} else if (likely(scan & UTF8_SCAN_CKUTF8)) {
-			/* UTF-8 range */
-			if ((c & 0xe0) == 0xc0) {
-				/* 2 octet UTF-8 */
-				if ((*np & 0xc0) != 0x80 ||
-				    (c & 0xfe) == 0xc0) {
-					/* overlong */
-					goto badutf8;
-				} else {
-					np++;
-				}
-			} else if ((c & 0xf0) == 0xe0) {
-				/* 3 octet UTF-8 */
-				if (/* overlong */
-				    (*np & 0xc0) != 0x80 ||
-				    (np[1] & 0xc0) != 0x80 ||
-				    (c == 0xe0 && (*np & 0xe0) == 0x80) ||
-				    /* surrogate */
-				    (c == 0xed && (*np & 0xe0) == 0xa0) ||
-				    (c == 0xef && *np == 0xbf &&
-				    (np[1] & 0xfe) == 0xbe)) {
-					/* U+fffe - u+ffff */
-					goto badutf8;
-				} else {
-					np += 2;
-				}
-			} else if ((c & 0xf8) == 0xf0) {
-				/* 4 octet UTF-8 */
-				if (/* overlong */
-				    (*np & 0xc0) != 0x80 ||
-				    (np[1] & 0xc0) != 0x80 ||
-				    (np[2] & 0xc0) != 0x80 ||
-				    (c == 0xf0 && (*np & 0xf0) == 0x80) ||
-				    (c == 0xf4 && *np > 0x8f) || c > 0xf4) {
-					/* > u+10ffff */
-					goto badutf8;
-				} else {
-					np += 3;
-				}
-			} else {
-				goto badutf8;
-			}
-		}
-		c = *np++;
-		first = 0;
-	}
-	return NFS4_OK;
-
- badutf8:
-	status = NFS4ERR_INVAL;
- error:
-	return status;
-}
-
 void nfs4_Fattr_Free(fattr4 *fattr)
 {
 	if (fattr->attr_vals.attrlist4_val != NULL) {
@@ -3420,42 +3326,22 @@ void get_mounted_on_fileid(compound_data_t *data, uint64_t *mounted_on_fileid)
 }
 
 /**
- * @brief Fill NFSv4 Fattr from a file
+ * @brief Check the caller may read the attributes of the current object
  *
- * This function fills an NFSv4 Fattr from a file represented by
- * data->currentFH and data->current-obj.
- *
- * Memory for bitmap_val and attr_val is dynamically allocated, the caller is
- * responsible for freeing it.
- *
- * @param[in]     data          NFSv4 compoud request's data
- * @param[in]     request_mask  The original request attribute mask
- * @param[in/out] attr          attrlist to fill in and mask to request
- * @param[out]    Fattr         NFSv4 Fattr buffer
- * @param[in]     Bitmap        Bitmap of attributes being requested
+ * @param[in] data    NFSv4 compoud request's data
+ * @param[in] Bitmap  Bitmap of attributes being requested
  *
  * @retval NFSv4 status
  */
 
-nfsstat4 file_To_Fattr(compound_data_t *data,
-		       attrmask_t request_mask,
-		       struct attrlist *attr,
-		       fattr4 *Fattr,
-		       struct bitmap4 *Bitmap)
+nfsstat4 file_To_Fattr_access(compound_data_t *data, struct bitmap4 *Bitmap)
 {
 	fsal_status_t status;
-	struct xdr_attrs_args args = {
-		.attrs = attr,
-		.data = data,
-		.hdl4 = &data->currentFH,
-	};
 
 	/* Permission check only if ACL is asked for.
 	 * NOTE: We intentionally do NOT check ACE4_READ_ATTR.
 	 */
 	if (attribute_is_set(Bitmap, FATTR4_ACL)) {
-		fsal_status_t status;
-
 		LogDebug(COMPONENT_NFS_V4_ACL,
 			 "Permission check for ACL for obj %p",
 			 data->current_obj);
@@ -3493,6 +3379,37 @@ nfsstat4 file_To_Fattr(compound_data_t *data,
 #endif /* ENABLE_RFC_ACL */
 	}
 
+	return NFS4_OK;
+}
+
+/**
+ * @brief Encode NFSv4 Fattr from attributes already fetched
+ *
+ * The attributes were fetched from data->current_obj by the caller.  On
+ * success, memory for bitmap_val and attr_val is dynamically allocated, the
+ * caller is responsible for freeing it.
+ *
+ * @param[in]     data          NFSv4 compoud request's data
+ * @param[in]     request_mask  The original request attribute mask
+ * @param[in/out] attr          attrlist fetched
+ * @param[out]    Fattr         NFSv4 Fattr buffer
+ * @param[in]     Bitmap        Bitmap of attributes being requested
+ *
+ * @retval NFSv4 status
+ */
+
+nfsstat4 file_attrs_To_Fattr(compound_data_t *data,
+			     attrmask_t request_mask,
+			     struct attrlist *attr,
+			     fattr4 *Fattr,
+			     struct bitmap4 *Bitmap)
+{
+	struct xdr_attrs_args args = {
+		.attrs = attr,
+		.data = data,
+		.hdl4 = &data->currentFH,
+	};
+
 	if (attribute_is_set(Bitmap, FATTR4_MOUNTED_ON_FILEID)) {
 		get_mounted_on_fileid(data, &args.mounted_on_fileid);
 	}
@@ -3501,10 +3418,6 @@ nfsstat4 file_To_Fattr(compound_data_t *data,
 	args.fileid = data->current_obj->fileid;
 	args.fsid = data->current_obj->fsid;
 
-	status = data->current_obj->obj_ops->getattrs(data->current_obj, attr);
-	if (FSAL_IS_ERROR(status))
-		return nfs4_Errno_status(status);
-
 	/* Restore originally requested mask */
 	attr->request_mask = request_mask;
 
@@ -3519,6 +3432,219 @@ nfsstat4 file_To_Fattr(compound_data_t *data,
 	return NFS4_OK;
 }
 
+/* Attributes whose encoding does not only depend on the object's
+ * attributes, they are never taken from the encoded attribute cache.
+ */
+static const int fattr4_uncacheable[] = {
+	FATTR4_FILES_AVAIL,
+	FATTR4_FILES_FREE,
+	FATTR4_FILES_TOTAL,
+	FATTR4_FS_LOCATIONS,
+	FATTR4_QUOTA_AVAIL_HARD,
+	FATTR4_QUOTA_AVAIL_SOFT,
+	FATTR4_QUOTA_USED,
+	FATTR4_SPACE_AVAIL,
+	FATTR4_SPACE_FREE,
+	FATTR4_SPACE_TOTAL,
+	FATTR4_FS_LOCATIONS_INFO,
+};
+
+/**
+ * @brief Key of an encoded attribute cache entry
+ *
+ * SUPPORTED_ATTRS, FSID, FILEHANDLE and friends depend on the export and
+ * minor version, so they are part of the key.
+ */
+struct fattr4_cache_key {
+	uint16_t export_id;
+	uint16_t minorversion;
+	uint32_t bitmap4_len;
+	uint32_t map[BITMAP4_MAPLEN];
+};
+
+/**
+ * @brief Build the encoded attribute cache key for a request
+ *
+ * @param[in]  data    NFSv4 compound request's data
+ * @param[in]  obj     Object the attributes are for
+ * @param[in]  Bitmap  Bitmap of attributes being requested
+ * @param[out] key     The key
+ *
+ * @return false if this request can't use the cache.
+ */
+static bool nfs4_Fattr_cache_key(compound_data_t *data,
+				 struct fsal_obj_handle *obj,
+				 struct bitmap4 *Bitmap,
+				 struct fattr4_cache_key *key)
+{
+	bool root;
+	size_t i;
+
+	if (Bitmap->bitmap4_len == 0 || Bitmap->bitmap4_len > BITMAP4_MAPLEN)
+		return false;
+
+	for (i = 0;
+	     i < sizeof(fattr4_uncacheable) / sizeof(fattr4_uncacheable[0]);
+	     i++)
+		if (attribute_is_set(Bitmap, fattr4_uncacheable[i]))
+			return false;
+
+	/* The root of the export reports the mounted on fileid of the
+	 * junction, anything else reports its own fileid.
+	 */
+	if (attribute_is_set(Bitmap, FATTR4_MOUNTED_ON_FILEID)) {
+		PTHREAD_RWLOCK_rdlock(&op_ctx->ctx_export->lock);
+		root = obj == op_ctx->ctx_export->exp_root_obj;
+		PTHREAD_RWLOCK_unlock(&op_ctx->ctx_export->lock);
+
+		if (root)
+			return false;
+	}
+
+	memset(key, 0, sizeof(*key));
+	key->export_id = op_ctx->ctx_export->export_id;
+	key->minorversion = data->minorversion;
+	key->bitmap4_len = Bitmap->bitmap4_len;
+	memcpy(key->map, Bitmap->map,
+	       Bitmap->bitmap4_len * sizeof(uint32_t));
+
+	return true;
+}
+
+/**
+ * @brief Look for a cached encoding of an object's attributes
+ *
+ * The FSAL keeps the encoding next to the attributes it was made from.
+ * The cached bytes are the attribute values followed by the bitmap of
+ * attributes actually encoded and its length.
+ *
+ * @param[in]  data    NFSv4 compound request's data
+ * @param[in]  obj     Object whose attributes are wanted
+ * @param[in]  Bitmap  Bitmap of attributes being requested
+ * @param[in]  mask    Attribute mask matching Bitmap
+ * @param[out] Fattr   NFSv4 Fattr buffer, filled in on a hit
+ * @param[out] gen     Token for nfs4_Fattr_cache_put() on a miss
+ *
+ * @return true if Fattr was filled in from the cache.
+ */
+
+bool nfs4_Fattr_cache_get(compound_data_t *data,
+			  struct fsal_obj_handle *obj,
+			  struct bitmap4 *Bitmap,
+			  attrmask_t mask,
+			  fattr4 *Fattr,
+			  uint64_t *gen)
+{
+	struct fattr4_cache_key key;
+	struct gsh_buffdesc key_desc = {
+		.addr = &key,
+		.len = sizeof(key),
+	};
+	struct gsh_buffdesc blob;
+	uint32_t *trailer, maplen;
+
+	*gen = 0;
+
+	if (!nfs4_Fattr_cache_key(data, obj, Bitmap, &key))
+		return false;
+
+	if (!obj->obj_ops->get_encoded_attrs(obj, &key_desc, mask, &blob, gen))
+		return false;
+
+	/* Unpack the trailer */
+	trailer = (uint32_t *) ((char *) blob.addr + blob.len) - 1;
+	maplen = *trailer;
+	trailer -= maplen;
+
+	memset(Fattr, 0, sizeof(*Fattr));
+	Fattr->attrmask.bitmap4_len = maplen;
+	memcpy(Fattr->attrmask.map, trailer, maplen * sizeof(uint32_t));
+	Fattr->attr_vals.attrlist4_len = (char *) trailer - (char *) blob.addr;
+	Fattr->attr_vals.attrlist4_val = blob.addr;
+
+	return true;
+}
+
+/**
+ * @brief Offer an encoding of an object's attributes to the cache
+ *
+ * @param[in] data    NFSv4 compound request's data
+ * @param[in] obj     Object the attributes were fetched from
+ * @param[in] Bitmap  Bitmap of attributes requested
+ * @param[in] gen     Token from nfs4_Fattr_cache_get()
+ * @param[in] Fattr   The encoding
+ */
+
+void nfs4_Fattr_cache_put(compound_data_t *data,
+			  struct fsal_obj_handle *obj,
+			  struct bitmap4 *Bitmap,
+			  uint64_t gen,
+			  fattr4 *Fattr)
+{
+	struct fattr4_cache_key key;
+	struct gsh_buffdesc key_desc = {
+		.addr = &key,
+		.len = sizeof(key),
+	};
+	struct gsh_buffdesc blob;
+	uint32_t maplen = Fattr->attrmask.bitmap4_len;
+	char buf[NFS4_ATTRVALS_BUFFLEN];
+	size_t vals_len = Fattr->attr_vals.attrlist4_len;
+
+	blob.len = vals_len + (maplen + 1) * sizeof(uint32_t);
+
+	if (blob.len > sizeof(buf) ||
+	    !nfs4_Fattr_cache_key(data, obj, Bitmap, &key))
+		return;
+
+	memcpy(buf, Fattr->attr_vals.attrlist4_val, vals_len);
+	memcpy(buf + vals_len, Fattr->attrmask.map,
+	       maplen * sizeof(uint32_t));
+	memcpy(buf + vals_len + maplen * sizeof(uint32_t), &maplen,
+	       sizeof(maplen));
+	blob.addr = buf;
+
+	obj->obj_ops->put_encoded_attrs(obj, &key_desc, gen, &blob);
+}
+
+/**
+ * @brief Fill NFSv4 Fattr from a file
+ *
+ * This function fills an NFSv4 Fattr from a file represented by
+ * data->currentFH and data->current-obj.
+ *
+ * Memory for bitmap_val and attr_val is dynamically allocated, the caller is
+ * responsible for freeing it.
+ *
+ * @param[in]     data          NFSv4 compoud request's data
+ * @param[in]     request_mask  The original request attribute mask
+ * @param[in/out] attr          attrlist to fill in and mask to request
+ * @param[out]    Fattr         NFSv4 Fattr buffer
+ * @param[in]     Bitmap        Bitmap of attributes being requested
+ *
+ * @retval NFSv4 status
+ */
+
+nfsstat4 file_To_Fattr(compound_data_t *data,
+		       attrmask_t request_mask,
+		       struct attrlist *attr,
+		       fattr4 *Fattr,
+		       struct bitmap4 *Bitmap)
+{
+	fsal_status_t status;
+	nfsstat4 rc;
+
+	rc = file_To_Fattr_access(data, Bitmap);
+	if (rc != NFS4_OK)
+		return rc;
+
+	status = data->current_obj->obj_ops->getattrs(data->current_obj, attr);
+	if (FSAL_IS_ERROR(status))
+		return nfs4_Errno_status(status);
+
+	return file_attrs_To_Fattr(data, request_mask, attr, Fattr, Bitmap);
+}
+
 
 /*
  * @brief Sets the FATTR4_RDATTR_ERROR in fattrs along with the other restricted
@@ -4497,16 +4623,18 @@ nfsstat4 nfs4_utf8string2dynamic(const utf8string *input,
 	    (!(scan & UTF8_SCAN_PATH) && input->utf8string_len > MAXNAMLEN))
 		return NFS4ERR_NAMETOOLONG;
 
+	/* Scan straight out of the XDR buffer, before we copy */
+	if (scan != UTF8_SCAN_NONE)
+		status = nfs4_path_filter(input->utf8string_val,
+					  input->utf8string_len, scan);
+	if (status != NFS4_OK)
+		return status;
+
 	char *name = gsh_malloc(input->utf8string_len + 1);
 
 	memcpy(name, input->utf8string_val, input->utf8string_len);
 	name[input->utf8string_len] = '\0';
-	if (scan != UTF8_SCAN_NONE)
-		status = path_filter(name, scan);
-	if (status == NFS4_OK)
-		*obj_name = name;
-	else
-		gsh_free(name);
+	*obj_name = name;
 	return status;
 }
 
@@ -317,9 +317,11 @@ void dupreq2_pkginit(void)
 	int code __attribute__ ((unused)) = 0;
 
 	dupreq_pool =
-	    pool_basic_init("Duplicate Request Pool", sizeof(dupreq_entry_t));
+	    pool_slab_init("Duplicate Request Pool", sizeof(dupreq_entry_t),
+			   NULL, NULL);
 
-	nfs_res_pool = pool_basic_init("nfs_res_t pool", sizeof(nfs_res_t));
+	nfs_res_pool = pool_slab_init("nfs_res_t pool", sizeof(nfs_res_t),
+				      NULL, NULL);
 
 	tcp_drc_pool = pool_basic_init("TCP DRC Pool", sizeof(drc_t));
 
@@ -59,6 +59,14 @@ hash_table_t *ht_session_id;
 
 uint64_t global_sequence;
 
+/**
+ * @param Forechannel slots offered across all sessions
+ *
+ * Each session accounts for target_highest_slotid + 1 slots.
+ */
+
+static uint32_t nfs41_slots_offered;
+
 /**
  * @brief Display a session ID
  *
@@ -262,25 +270,33 @@ int32_t _dec_session_ref(nfs41_session_t *session, const char *func, int line)
 
 		/* Decrement our reference to the clientid record */
 		dec_client_id_ref(session->clientid_record);
+		/* Give back our share of the slot budget */
+		(void)atomic_sub_uint32_t(&nfs41_slots_offered,
+					  session->target_highest_slotid + 1);
+
 		/* Destroy this session's mutexes and condition variable */
 
-		for (i = 0; i < session->nb_slots; i++) {
+		for (i = 0; i < session->nb_slot_chunks * NFS41_SLOT_CHUNK;
+		     i++) {
 			nfs41_session_slot_t *slot;
 
-			slot = &session->fc_slots[i];
+			slot = nfs41_session_slot(session, i);
 			PTHREAD_MUTEX_destroy(&slot->lock);
 			release_slot(slot);
 		}
 
 		PTHREAD_COND_destroy(&session->cb_cond);
 		PTHREAD_MUTEX_destroy(&session->cb_mutex);
+		PTHREAD_MUTEX_destroy(&session->slot_resize_mutex);
 
 		/* Destroy the session's back channel (if any) */
 		if (session->flags & session_bc_up)
 			nfs_rpc_destroy_chan(&session->cb_chan);
 
 		/* Free the slot tables */
-		gsh_free(session->fc_slots);
+		for (i = 0; i < session->nb_slot_chunks; i++)
+			gsh_free(session->fc_slot_chunks[i]);
+		gsh_free(session->fc_slot_chunks);
 		gsh_free(session->bc_slots);
 
 		/* Free the memory for the session */
@@ -290,6 +306,184 @@ int32_t _dec_session_ref(nfs41_session_t *session, const char *func, int line)
 	return refcnt;
 }
 
+/**
+ * @brief Allocate forechannel slots up to a slot id
+ *
+ * Chunks are published before the caller raises highest_slotid, and
+ * are only freed with the session, so SEQUENCE may look slots up
+ * without locking.  Called with slot_resize_mutex held, or before the
+ * session is visible.
+ *
+ * @param[in,out] session The session
+ * @param[in]     highest Highest slot id that must be usable
+ */
+
+static void nfs41_session_slots_grow(nfs41_session_t *session,
+				     uint32_t highest)
+{
+	uint32_t c, i;
+
+	for (c = session->nb_slot_chunks; c * NFS41_SLOT_CHUNK <= highest;
+	     c++) {
+		nfs41_session_slot_t *chunk;
+
+		chunk = gsh_calloc(NFS41_SLOT_CHUNK, sizeof(*chunk));
+		for (i = 0; i < NFS41_SLOT_CHUNK; i++)
+			PTHREAD_MUTEX_init(&chunk[i].lock, NULL);
+
+		atomic_store_voidptr((void **)&session->fc_slot_chunks[c],
+				     chunk);
+	}
+
+	atomic_store_uint32_t(&session->nb_slot_chunks, c);
+}
+
+/**
+ * @brief Set up a session's forechannel slot table
+ *
+ * Only the slots offered at creation are allocated, more are added
+ * as the session grows towards nb_slots.
+ *
+ * @param[in,out] session The new session
+ * @param[in]     initial Number of slots offered at creation
+ */
+
+void nfs41_session_slots_init(nfs41_session_t *session, uint32_t initial)
+{
+	PTHREAD_MUTEX_init(&session->slot_resize_mutex, NULL);
+	session->fc_slot_chunks =
+		gsh_calloc((session->nb_slots + NFS41_SLOT_CHUNK - 1) /
+							NFS41_SLOT_CHUNK,
+			   sizeof(*session->fc_slot_chunks));
+	session->nb_slot_chunks = 0;
+	nfs41_session_slots_grow(session, initial - 1);
+	session->highest_slotid = initial - 1;
+	session->target_highest_slotid = initial - 1;
+	session->slot_max_used = 0;
+	session->slot_requests = 0;
+	session->slot_period_end = time(NULL) + NFS41_SLOT_RESIZE_PERIOD;
+
+	/* New sessions are always admitted, even over budget */
+	(void)atomic_add_uint32_t(&nfs41_slots_offered, initial);
+}
+
+/**
+ * @brief Account for a SEQUENCE on a session slot
+ *
+ * Once per NFS41_SLOT_RESIZE_PERIOD, the slot usage seen during the
+ * period is used to resize the slot table.  A session that used every
+ * slot it was offered gets its target doubled, within
+ * max_slot_table_size and the global slot_table_budget.  A session
+ * that used less than half has its target lowered to twice what it
+ * used, but no lower than min_slot_table_size.  The client learns the
+ * new target through sr_target_highest_slotid.  Slots above the
+ * target are only retired (and their cached replies freed) after a
+ * whole period during which the client did not use them.
+ *
+ * The period statistics are updated without locking, they are only a
+ * heuristic.
+ *
+ * @param[in,out] session The session
+ * @param[in]     slotid  Slot used by this SEQUENCE
+ */
+
+void nfs41_session_slot_used(nfs41_session_t *session, uint32_t slotid)
+{
+	uint32_t used, requests, old_target, target, highest, min_target;
+	uint32_t budget = nfs_param.nfsv4_param.slots_budget;
+	uint32_t offered, excess, i;
+	time_t now = time(NULL);
+
+	(void)atomic_inc_uint32_t(&session->slot_requests);
+
+	if (slotid > atomic_fetch_uint32_t(&session->slot_max_used))
+		atomic_store_uint32_t(&session->slot_max_used, slotid);
+
+	if (now < atomic_fetch_time_t(&session->slot_period_end))
+		return;
+
+	PTHREAD_MUTEX_lock(&session->slot_resize_mutex);
+
+	if (now < session->slot_period_end) {
+		/* Someone else got here first */
+		PTHREAD_MUTEX_unlock(&session->slot_resize_mutex);
+		return;
+	}
+
+	used = atomic_fetch_uint32_t(&session->slot_max_used);
+	requests = atomic_fetch_uint32_t(&session->slot_requests);
+	atomic_store_uint32_t(&session->slot_max_used, 0);
+	atomic_store_uint32_t(&session->slot_requests, 0);
+	atomic_store_time_t(&session->slot_period_end,
+			    now + NFS41_SLOT_RESIZE_PERIOD);
+
+	old_target = session->target_highest_slotid;
+	target = old_target;
+	highest = session->highest_slotid;
+	min_target = MIN(nfs_param.nfsv4_param.min_slots,
+			 session->nb_slots) - 1;
+
+	/* The client was told about old_target for the whole period, if it
+	 * kept away from the slots above it, retire them.
+	 */
+	if (highest > old_target && used <= old_target) {
+		for (i = old_target + 1; i <= highest; i++) {
+			nfs41_session_slot_t *slot =
+				nfs41_session_slot(session, i);
+
+			PTHREAD_MUTEX_lock(&slot->lock);
+			release_slot(slot);
+			/* The client starts over when the slot comes back */
+			slot->sequence = 0;
+			PTHREAD_MUTEX_unlock(&slot->lock);
+		}
+
+		highest = old_target;
+	}
+
+	if (requests != 0 && used >= old_target &&
+	    old_target + 1 < session->nb_slots) {
+		/* Busy, the client used every slot it was offered */
+		target = MIN(2 * old_target + 1, session->nb_slots - 1);
+		offered = atomic_add_uint32_t(&nfs41_slots_offered,
+					      target - old_target);
+
+		if (offered > budget) {
+			excess = MIN(offered - budget, target - old_target);
+			(void)atomic_sub_uint32_t(&nfs41_slots_offered,
+						  excess);
+			target -= excess;
+		}
+	} else if (used < old_target / 2) {
+		/* Mostly idle, keep twice what was used */
+		target = MAX(2 * used + 1, min_target);
+
+		if (target < old_target)
+			(void)atomic_sub_uint32_t(&nfs41_slots_offered,
+						  old_target - target);
+		else
+			target = old_target;
+	}
+
+	if (target > highest) {
+		nfs41_session_slots_grow(session, target);
+		highest = target;
+	}
+
+	if (target != old_target) {
+		LogDebug(COMPONENT_SESSIONS,
+			 "Session %p slot target %"PRIu32" -> %"PRIu32
+			 " highest %"PRIu32" (used %"PRIu32" in %"PRIu32
+			 " requests)",
+			 session, old_target, target, highest, used, requests);
+	}
+
+	atomic_store_uint32_t(&session->target_highest_slotid, target);
+	atomic_store_uint32_t(&session->highest_slotid, highest);
+
+	PTHREAD_MUTEX_unlock(&session->slot_resize_mutex);
+}
+
 /**
  * @brief Set a session into the session hashtable.
  *
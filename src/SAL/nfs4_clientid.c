@@ -550,6 +550,7 @@ nfs_client_id_t *create_client_id(clientid4 clientid,
 	client_rec->cid_confirmed = UNCONFIRMED_CLIENT_ID;
 	client_rec->cid_clientid = clientid;
 	client_rec->cid_last_renew = time(NULL);
+	tw_node_init(&client_rec->cid_lease_timer);
 	client_rec->cid_client_record = client_record;
 	client_rec->cid_credential = *credential;
 
@@ -636,6 +637,11 @@ clientid_status_t nfs_client_id_insert(nfs_client_id_t *clientid)
 	/* Take a reference to the unconfirmed clientid for the hash table. */
 	(void)inc_client_id_ref(clientid);
 
+	/* Start the lease clock */
+	PTHREAD_MUTEX_lock(&clientid->cid_mutex);
+	lease_timer_arm(clientid);
+	PTHREAD_MUTEX_unlock(&clientid->cid_mutex);
+
 	if (isFullDebug(COMPONENT_CLIENTID) &&
 	    isFullDebug(COMPONENT_HASHTABLE)) {
 		LogFullDebug(COMPONENT_CLIENTID,
@@ -683,6 +689,8 @@ int remove_confirmed_client_id(nfs_client_id_t *clientid)
 	/* Set this up so this client id record will be freed. */
 	clientid->cid_confirmed = EXPIRED_CLIENT_ID;
 
+	lease_timer_cancel(clientid);
+
 	/* Release hash table reference to the unconfirmed record */
 	(void)dec_client_id_ref(clientid);
 
@@ -727,6 +735,8 @@ int remove_unconfirmed_client_id(nfs_client_id_t *clientid)
 	/* Set this up so this client id record will be freed. */
 	clientid->cid_confirmed = EXPIRED_CLIENT_ID;
 
+	lease_timer_cancel(clientid);
+
 	/* Release hash table reference to the unconfirmed record */
 	(void)dec_client_id_ref(clientid);
 
@@ -802,6 +812,8 @@ clientid_status_t nfs_client_id_confirm(nfs_client_id_t *clientid,
 		   freed. */
 		clientid->cid_confirmed = EXPIRED_CLIENT_ID;
 
+		lease_timer_cancel(clientid);
+
 		/* Release hash table reference to the unconfirmed
 		   record */
 		(void)dec_client_id_ref(clientid);
@@ -938,6 +950,8 @@ bool nfs_client_id_expire(nfs_client_id_t *clientid, bool make_stale)
 
 		PTHREAD_MUTEX_unlock(&clientid->cid_mutex);
 
+		lease_timer_cancel(clientid);
+
 		buffkey.addr = &clientid->cid_clientid;
 		buffkey.len = sizeof(clientid->cid_clientid);
 
@@ -1335,7 +1349,10 @@ int nfs_Init_client_id(void)
 	}
 
 	client_id_pool =
-	    pool_basic_init("NFS4 Client ID Pool", sizeof(nfs_client_id_t));
+	    pool_slab_init("NFS4 Client ID Pool", sizeof(nfs_client_id_t),
+			   NULL, NULL);
+
+	lease_timer_init();
 
 	return CLIENT_ID_SUCCESS;
 }
@@ -39,6 +39,20 @@
 #include "nfs_core.h"
 #include "nfs4.h"
 #include "sal_functions.h"
+#include "timer_wheel.h"
+
+/**
+ * @brief Wheel of client lease expiry timers
+ *
+ * Every hashed clientid has its cid_lease_timer armed for the time its
+ * lease runs out.  An armed timer holds a reference on the clientid.
+ * The reaper only looks at the timers that come due, and renewals are
+ * a constant time reschedule.
+ *
+ * Lock order is cid_mutex then lease_wheel_mutex.
+ */
+static struct timer_wheel lease_wheel;
+static pthread_mutex_t lease_wheel_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /**
  * @brief Return the lifetime of a valid lease
@@ -145,8 +159,10 @@ void update_lease(nfs_client_id_t *clientid)
 	clientid->cid_lease_reservations--;
 
 	/* Renew lease when last reservation is released */
-	if (clientid->cid_lease_reservations == 0)
+	if (clientid->cid_lease_reservations == 0) {
 		clientid->cid_last_renew = time(NULL);
+		lease_timer_arm(clientid);
+	}
 
 	if (isFullDebug(COMPONENT_CLIENTID)) {
 		char str[LOG_BUFF_LEN] = "\0";
@@ -157,4 +173,122 @@ void update_lease(nfs_client_id_t *clientid)
 	}
 }
 
+/**
+ * @brief Initialize the lease timer wheel
+ */
+void lease_timer_init(void)
+{
+	tw_init(&lease_wheel, time(NULL));
+}
+
+/**
+ * @brief Arm or reschedule the lease timer of a clientid
+ *
+ * The timer is set to fire when the lease would run out, or a full
+ * lease period from now if the lease is reserved.  The wheel takes a
+ * reference on the clientid when the timer goes from unarmed to armed.
+ * A timer that has fired and is still being looked at by the reaper is
+ * left alone; the reaper re-arms it if the lease is still valid.
+ *
+ * The caller must hold cid_mutex.
+ *
+ * @param[in] clientid The clientid
+ */
+void lease_timer_arm(nfs_client_id_t *clientid)
+{
+	struct tw_node *node = &clientid->cid_lease_timer;
+	time_t expire;
+
+	if (clientid->cid_confirmed == EXPIRED_CLIENT_ID)
+		return;
+
+	if (clientid->cid_lease_reservations != 0)
+		expire = time(NULL);
+	else
+		expire = clientid->cid_last_renew;
+
+	expire += nfs_param.nfsv4_param.lease_lifetime;
+
+	/* Several renewals per second are common, don't bother the wheel
+	 * when nothing would change.
+	 */
+	if (atomic_fetch_time_t(&node->tn_expire) == expire)
+		return;
+
+	PTHREAD_MUTEX_lock(&lease_wheel_mutex);
+
+	if (tw_armed(node)) {
+		tw_schedule(&lease_wheel, node, expire);
+	} else if (glist_null(&node->tn_list)) {
+		inc_client_id_ref(clientid);
+		tw_schedule(&lease_wheel, node, expire);
+	}
+
+	PTHREAD_MUTEX_unlock(&lease_wheel_mutex);
+}
+
+/**
+ * @brief Take the lease timer of a clientid off the wheel
+ *
+ * Called when the clientid is unhashed.  Drops the wheel's reference if
+ * the timer was armed.
+ *
+ * @param[in] clientid The clientid
+ */
+void lease_timer_cancel(nfs_client_id_t *clientid)
+{
+	bool armed;
+
+	PTHREAD_MUTEX_lock(&lease_wheel_mutex);
+	armed = tw_cancel(&lease_wheel, &clientid->cid_lease_timer);
+	PTHREAD_MUTEX_unlock(&lease_wheel_mutex);
+
+	if (armed)
+		(void)dec_client_id_ref(clientid);
+}
+
+/**
+ * @brief Collect the lease timers that are due
+ *
+ * @param[out] expired List to receive the expired timers
+ *
+ * @return Number of timers collected.
+ */
+int lease_timer_collect(struct glist_head *expired)
+{
+	int count;
+
+	PTHREAD_MUTEX_lock(&lease_wheel_mutex);
+	count = tw_advance(&lease_wheel, time(NULL), expired);
+	PTHREAD_MUTEX_unlock(&lease_wheel_mutex);
+
+	return count;
+}
+
+/**
+ * @brief Pop the next clientid off a list of collected timers
+ *
+ * The caller inherits the reference the wheel held on the clientid.
+ *
+ * @param[in,out] expired List filled by lease_timer_collect
+ *
+ * @return The clientid, or NULL if the list is empty.
+ */
+nfs_client_id_t *lease_timer_next(struct glist_head *expired)
+{
+	nfs_client_id_t *clientid;
+
+	PTHREAD_MUTEX_lock(&lease_wheel_mutex);
+
+	clientid = glist_first_entry(expired, nfs_client_id_t,
+				     cid_lease_timer.tn_list);
+
+	if (clientid != NULL)
+		glist_del(&clientid->cid_lease_timer.tn_list);
+
+	PTHREAD_MUTEX_unlock(&lease_wheel_mutex);
+
+	return clientid;
+}
+
 /** @} */
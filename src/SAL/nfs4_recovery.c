@@ -652,6 +652,8 @@ static int load_backend(const char *name)
 #endif
 	else if (!strcmp(name, "fs_ng"))
 		fs_ng_backend_init(&recovery_backend);
+	else if (!strcmp(name, "journal"))
+		journal_backend_init(&recovery_backend);
 	else
 		return -1;
 	return 0;
@@ -200,9 +200,14 @@ state_status_t _state_add_impl(struct fsal_obj_handle *obj,
 	PTHREAD_MUTEX_unlock(&pnew_state->state_mutex);
 	PTHREAD_RWLOCK_unlock(&op_ctx->ctx_export->lock);
 
-	/* Add state to list for file */
+	/* Add state to list for file, directories only have delegations */
 	PTHREAD_MUTEX_lock(&pnew_state->state_mutex);
-	glist_add_tail(&ostate->file.list_of_states, &pnew_state->state_list);
+	if (obj->type == DIRECTORY)
+		glist_add_tail(&ostate->dir.list_of_states,
+			       &pnew_state->state_list);
+	else
+		glist_add_tail(&ostate->file.list_of_states,
+			       &pnew_state->state_list);
 	/* Get ref for this state entry */
 	obj->obj_ops->get_ref(obj);
 	PTHREAD_MUTEX_unlock(&pnew_state->state_mutex);
@@ -436,6 +436,293 @@ static hash_parameter_t state_obj_param = {
 	.ht_name = "State Obj Table"
 };
 
+/**
+ * @brief Slot-indexed stateid table
+ *
+ * Stateids handed out by this server normally encode an index into a
+ * table of state_t pointers in the counter word of stateid4.other,
+ * along with a generation number that is bumped every time a slot is
+ * released.  Resolving such a stateid is a bounds check, a generation
+ * compare and a memcmp under a short per-stripe spinlock, with no
+ * hashing.  Stateids that could not get a slot (table full) are built
+ * the old way and live in ht_state_id only.
+ *
+ * Counter word layout (host order, as built by nfs4_BuildStateId_Other):
+ *
+ *  bit 31      STATE_SLOT_FLAG, set for slot-indexed stateids
+ *  bits 18-30  generation of the slot
+ *  bits 0-17   slot index
+ *
+ * A stateid must never repeat within a server epoch, or a stale one a
+ * client still holds could resolve to an unrelated new state.  So a slot
+ * whose generation is used up is retired instead of going back on the
+ * free list, and free slots are reused in FIFO order so that the
+ * generations are consumed evenly across the stripe.
+ */
+#define STATE_SLOT_FLAG		0x80000000U
+#define STATE_SLOT_IDX_BITS	18
+#define STATE_SLOT_IDX_MASK	((1U << STATE_SLOT_IDX_BITS) - 1)
+#define STATE_SLOT_GEN_MASK	(~STATE_SLOT_FLAG >> STATE_SLOT_IDX_BITS)
+#define STATE_SLOT_MAX		(1U << STATE_SLOT_IDX_BITS)
+#define STATE_SLOT_CHUNK_BITS	12
+#define STATE_SLOT_CHUNK	(1U << STATE_SLOT_CHUNK_BITS)
+#define STATE_SLOT_NCHUNKS	(STATE_SLOT_MAX / STATE_SLOT_CHUNK)
+#define STATE_SLOT_STRIPES	64
+#define STATE_SLOT_NONE		UINT32_MAX
+
+struct state_slot {
+	state_t *ss_state;	/**< State occupying the slot, or NULL */
+	uint32_t ss_gen;	/**< Generation, bumped on release */
+	uint32_t ss_next_free;	/**< Next free index in the stripe */
+};
+
+/**
+ * @brief One stripe of the slot table
+ *
+ * Slot index i belongs to stripe (i % STATE_SLOT_STRIPES).  The
+ * spinlock protects all slots of the stripe and its free list.
+ */
+struct state_slot_stripe {
+	pthread_spinlock_t sst_lock;
+	uint32_t sst_free;	/**< Head of free list */
+	uint32_t sst_free_tail;	/**< Tail of free list */
+	uint32_t sst_next;	/**< Next never used index within stripe */
+	uint32_t sst_retired;	/**< Slots whose generation is used up */
+} __attribute__ ((aligned(64)));
+
+static struct state_slot *state_slot_chunks[STATE_SLOT_NCHUNKS];
+static struct state_slot_stripe state_slot_stripes[STATE_SLOT_STRIPES];
+static pthread_mutex_t state_slot_chunk_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t state_slot_rotor;
+
+static inline struct state_slot *state_slot_find(uint32_t idx)
+{
+	struct state_slot *chunk;
+
+	chunk = atomic_fetch_voidptr((void **)
+			&state_slot_chunks[idx >> STATE_SLOT_CHUNK_BITS]);
+
+	if (chunk == NULL)
+		return NULL;
+
+	return &chunk[idx & (STATE_SLOT_CHUNK - 1)];
+}
+
+/**
+ * @brief Make sure the chunk holding a slot index is allocated
+ *
+ * Chunks are never freed, so readers may access them without locks
+ * once the pointer is published.
+ *
+ * @param[in] idx Slot index
+ *
+ * @return The slot.
+ */
+static struct state_slot *state_slot_materialize(uint32_t idx)
+{
+	uint32_t c = idx >> STATE_SLOT_CHUNK_BITS;
+	struct state_slot *chunk = state_slot_find(idx);
+
+	if (chunk != NULL)
+		return chunk;
+
+	PTHREAD_MUTEX_lock(&state_slot_chunk_mutex);
+
+	chunk = state_slot_chunks[c];
+
+	if (chunk == NULL) {
+		chunk = gsh_calloc(STATE_SLOT_CHUNK, sizeof(*chunk));
+		atomic_store_voidptr((void **)&state_slot_chunks[c], chunk);
+	}
+
+	PTHREAD_MUTEX_unlock(&state_slot_chunk_mutex);
+
+	return &chunk[idx & (STATE_SLOT_CHUNK - 1)];
+}
+
+static void state_slot_init(void)
+{
+	int i;
+
+	for (i = 0; i < STATE_SLOT_STRIPES; i++) {
+		pthread_spin_init(&state_slot_stripes[i].sst_lock,
+				  PTHREAD_PROCESS_PRIVATE);
+		state_slot_stripes[i].sst_free = STATE_SLOT_NONE;
+		state_slot_stripes[i].sst_free_tail = STATE_SLOT_NONE;
+		state_slot_stripes[i].sst_next = i;
+		state_slot_stripes[i].sst_retired = 0;
+	}
+}
+
+/**
+ * @brief Put a state into a free slot and encode it in the stateid
+ *
+ * On success the counter word of state->stateid_other is rewritten to
+ * the slot-indexed form.
+ *
+ * @param[in,out] state The state to index
+ *
+ * @retval true if the state got a slot.
+ * @retval false if the table is full.
+ */
+static bool state_slot_insert(state_t *state)
+{
+	uint32_t start = atomic_inc_uint32_t(&state_slot_rotor);
+	uint32_t counter;
+	int i;
+
+	for (i = 0; i < STATE_SLOT_STRIPES; i++) {
+		struct state_slot_stripe *stripe =
+			&state_slot_stripes[(start + i) % STATE_SLOT_STRIPES];
+		struct state_slot *slot;
+		uint32_t idx;
+
+		pthread_spin_lock(&stripe->sst_lock);
+
+		if (stripe->sst_free != STATE_SLOT_NONE) {
+			idx = stripe->sst_free;
+			slot = state_slot_find(idx);
+			stripe->sst_free = slot->ss_next_free;
+			if (stripe->sst_free == STATE_SLOT_NONE)
+				stripe->sst_free_tail = STATE_SLOT_NONE;
+		} else if (stripe->sst_next < STATE_SLOT_MAX) {
+			idx = stripe->sst_next;
+			stripe->sst_next += STATE_SLOT_STRIPES;
+			/* Chunk allocation may block; the index is reserved
+			 * so it's fine to drop the spinlock meanwhile.
+			 */
+			pthread_spin_unlock(&stripe->sst_lock);
+			slot = state_slot_materialize(idx);
+			pthread_spin_lock(&stripe->sst_lock);
+		} else {
+			pthread_spin_unlock(&stripe->sst_lock);
+			continue;
+		}
+
+		slot->ss_state = state;
+		slot->ss_next_free = STATE_SLOT_NONE;
+		counter = STATE_SLOT_FLAG |
+			  (slot->ss_gen << STATE_SLOT_IDX_BITS) |
+			  idx;
+		memcpy(state->stateid_other + sizeof(clientid4), &counter,
+		       sizeof(counter));
+
+		pthread_spin_unlock(&stripe->sst_lock);
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Decode the slot index and generation from a stateid other
+ *
+ * @param[in]  other stateid4.other
+ * @param[out] idx   Slot index
+ * @param[out] gen   Slot generation
+ *
+ * @retval true if other is slot-indexed.
+ * @retval false if it is a legacy (hashed) stateid.
+ */
+static inline bool state_slot_decode(const char *other, uint32_t *idx,
+				     uint32_t *gen)
+{
+	uint32_t counter;
+
+	memcpy(&counter, other + sizeof(clientid4), sizeof(counter));
+
+	if ((counter & STATE_SLOT_FLAG) == 0)
+		return false;
+
+	*idx = counter & STATE_SLOT_IDX_MASK;
+	*gen = (counter & ~STATE_SLOT_FLAG) >> STATE_SLOT_IDX_BITS;
+	return true;
+}
+
+/**
+ * @brief Look up a slot-indexed stateid and take a reference
+ *
+ * @param[in] idx   Slot index
+ * @param[in] gen   Expected generation
+ * @param[in] other Full stateid4.other to compare
+ *
+ * @returns The found state_t or NULL if not found.
+ */
+static state_t *state_slot_get(uint32_t idx, uint32_t gen, const char *other)
+{
+	struct state_slot_stripe *stripe =
+				&state_slot_stripes[idx % STATE_SLOT_STRIPES];
+	struct state_slot *slot = state_slot_find(idx);
+	state_t *state = NULL;
+
+	if (slot == NULL)
+		return NULL;
+
+	pthread_spin_lock(&stripe->sst_lock);
+
+	if (slot->ss_state != NULL && slot->ss_gen == gen &&
+	    memcmp(slot->ss_state->stateid_other, other, OTHERSIZE) == 0) {
+		state = slot->ss_state;
+		inc_state_t_ref(state);
+	}
+
+	pthread_spin_unlock(&stripe->sst_lock);
+
+	return state;
+}
+
+/**
+ * @brief Release the slot held by a state
+ *
+ * @param[in] state The state
+ * @param[in] idx   Slot index decoded from the state's stateid
+ *
+ * @retval true if the slot was released.
+ * @retval false if the state no longer owned it.
+ */
+static bool state_slot_del(state_t *state, uint32_t idx)
+{
+	struct state_slot_stripe *stripe =
+				&state_slot_stripes[idx % STATE_SLOT_STRIPES];
+	struct state_slot *slot = state_slot_find(idx);
+	uint32_t retired = 0;
+	bool found = false;
+
+	if (slot == NULL)
+		return false;
+
+	pthread_spin_lock(&stripe->sst_lock);
+
+	if (slot->ss_state == state) {
+		slot->ss_state = NULL;
+		found = true;
+
+		if (slot->ss_gen == STATE_SLOT_GEN_MASK) {
+			/* Reusing the slot would repeat a stateid */
+			retired = ++stripe->sst_retired;
+		} else {
+			slot->ss_gen++;
+			slot->ss_next_free = STATE_SLOT_NONE;
+			if (stripe->sst_free_tail == STATE_SLOT_NONE)
+				stripe->sst_free = idx;
+			else
+				state_slot_find(stripe->sst_free_tail)
+					->ss_next_free = idx;
+			stripe->sst_free_tail = idx;
+		}
+	}
+
+	pthread_spin_unlock(&stripe->sst_lock);
+
+	if (retired == STATE_SLOT_MAX / STATE_SLOT_STRIPES)
+		LogInfo(COMPONENT_STATE,
+			"Stateid slot stripe %" PRIu32
+			" exhausted, its stateids will be hashed",
+			idx % STATE_SLOT_STRIPES);
+
+	return found;
+}
+
 /**
  * @brief Init the hashtable for stateids
  *
@@ -448,6 +735,8 @@ int nfs4_Init_state_id(void)
 	memset(all_zero, 0, OTHERSIZE);
 	memset(all_ones, 0xFF, OTHERSIZE);
 
+	state_slot_init();
+
 	ht_state_id = hashtable_init(&state_id_param);
 
 	if (ht_state_id == NULL) {
@@ -468,14 +757,17 @@ int nfs4_Init_state_id(void)
 /**
  * @brief Build the 12 byte "other" portion of a stateid
  *
- * It is built from the ServerEpoch and a 64 bit global counter.
+ * It is built from the ServerEpoch and a 64 bit global counter.  The
+ * counter word built here is the legacy (hashed) form;
+ * nfs4_State_Set replaces it with a slot index when it can.
  *
  * @param[in] other stateid.other object (a char[OTHERSIZE] string)
  */
 void nfs4_BuildStateId_Other(nfs_client_id_t *clientid, char *other)
 {
 	uint32_t my_stateid =
-	    atomic_inc_uint32_t(&clientid->cid_stateid_counter);
+	    atomic_inc_uint32_t(&clientid->cid_stateid_counter) &
+	    ~STATE_SLOT_FLAG;
 
 	/* The first part of the other is the 64 bit clientid, which
 	 * consists of the epoch in the high order 32 bits followed by
@@ -524,10 +816,13 @@ void dec_nfs4_state_ref(struct state_t *state)
 }
 
 /**
- * @brief Set a state into the stateid hashtable.
+ * @brief Index a state by its stateid
  *
- * @param[in] other stateid4.other
- * @param[in] state The state to add
+ * The state is put into the slot table if a slot is free, in which
+ * case the counter word of state->stateid_other is rewritten to encode
+ * the slot.  Otherwise the state goes into the stateid hashtable.
+ *
+ * @param[in,out] state The state to add
  *
  * @retval STATE_SUCCESS if able to insert the new state.
  * @retval STATE_ENTRY_EXISTS if state is already there.
@@ -537,26 +832,29 @@ state_status_t nfs4_State_Set(state_t *state)
 	struct gsh_buffdesc buffkey;
 	struct gsh_buffdesc buffval;
 	hash_error_t err;
+	uint32_t idx, gen;
 
-	buffkey.addr = state->stateid_other;
-	buffkey.len = OTHERSIZE;
+	if (!state_slot_insert(state)) {
+		buffkey.addr = state->stateid_other;
+		buffkey.len = OTHERSIZE;
 
-	buffval.addr = state;
-	buffval.len = sizeof(state_t);
+		buffval.addr = state;
+		buffval.len = sizeof(state_t);
 
-	err = hashtable_test_and_set(ht_state_id,
-				     &buffkey,
-				     &buffval,
-				     HASHTABLE_SET_HOW_SET_NO_OVERWRITE);
+		err = hashtable_test_and_set(ht_state_id,
+					     &buffkey,
+					     &buffval,
+					     HASHTABLE_SET_HOW_SET_NO_OVERWRITE);
 
-	switch (err) {
-	case HASHTABLE_SUCCESS:
-		break;
-	default:
-		LogCrit(COMPONENT_STATE,
-			"ht_state_id hashtable_test_and_set failed %s for key %p",
-			hash_table_err_to_str(err), buffkey.addr);
-		return STATE_ENTRY_EXISTS; /* likely reason */
+		switch (err) {
+		case HASHTABLE_SUCCESS:
+			break;
+		default:
+			LogCrit(COMPONENT_STATE,
+				"ht_state_id hashtable_test_and_set failed %s for key %p",
+				hash_table_err_to_str(err), buffkey.addr);
+			return STATE_ENTRY_EXISTS; /* likely reason */
+		}
 	}
 
 	/* If stateid is a LOCK or SHARE state, we also index by entry/owner */
@@ -604,6 +902,11 @@ state_status_t nfs4_State_Set(state_t *state)
 			}
 		}
 
+		if (state_slot_decode(state->stateid_other, &idx, &gen)) {
+			state_slot_del(state, idx);
+			return STATE_ENTRY_EXISTS; /* likely reason */
+		}
+
 		buffkey.addr = state->stateid_other;
 		buffkey.len = OTHERSIZE;
 		err = HashTable_Del(ht_state_id, &buffkey, NULL, NULL);
@@ -631,6 +934,11 @@ struct state_t *nfs4_State_Get_Pointer(char *other)
 	hash_error_t rc;
 	struct hash_latch latch;
 	struct state_t *state;
+	uint32_t idx, gen;
+
+	/* Slot-indexed stateids never live in the hashtable */
+	if (state_slot_decode(other, &idx, &gen))
+		return state_slot_get(idx, gen, other);
 
 	buffkey.addr = other;
 	buffkey.len = OTHERSIZE;
@@ -718,6 +1026,18 @@ bool nfs4_State_Del(state_t *state)
 	struct gsh_buffdesc buffkey, old_key, old_value;
 	struct hash_latch latch;
 	hash_error_t err;
+	uint32_t idx, gen;
+
+	if (state_slot_decode(state->stateid_other, &idx, &gen)) {
+		if (!state_slot_del(state, idx)) {
+			/* Already gone */
+			return false;
+		}
+
+		old_value.addr = state;
+		old_value.len = sizeof(state_t);
+		goto del_obj;
+	}
 
 	buffkey.addr = state->stateid_other;
 	buffkey.len = OTHERSIZE;
@@ -742,6 +1062,8 @@ bool nfs4_State_Del(state_t *state)
 
 	assert(state == old_value.addr);
 
+ del_obj:
+
 	/* If stateid is a LOCK or SHARE state, we had also indexed by
 	 * entry/owner
 	 */
@@ -0,0 +1,922 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file recovery_journal.c
+ * @brief Append-only journal recovery backend
+ *
+ * Client records are kept as a log of ADD/RM/REVOKE records in a
+ * single file per node, instead of one directory hierarchy per client
+ * as the fs backends do.  Every change is one small append, and
+ * concurrent callers share a single write + fdatasync (group commit):
+ * the first caller to find no flush in progress becomes the leader and
+ * flushes everything appended so far, the others wait for it.
+ *
+ * The live set is mirrored in memory so the journal can be compacted
+ * (rewritten to a temporary file and renamed over) once it has grown
+ * well beyond what it describes.
+ *
+ * Clients of the previous epoch are kept in a separate "old" journal
+ * until the grace period ends, so a restart during grace still allows
+ * them to reclaim, just like v4old for the fs backend.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "nfs_core.h"
+#include "nfs4.h"
+#include "sal_functions.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <netdb.h>
+#include "bsd-base64.h"
+#include "avltree.h"
+#include "murmur3.h"
+#include "fsal.h"
+#include "recovery_fs.h"
+
+#define JRNL_MAGIC 0x4a524e4c		/* "JRNL" */
+#define JRNL_SEED 0x6e667334
+
+/** Don't bother compacting journals smaller than this */
+#define JRNL_COMPACT_MIN (1024 * 1024)
+
+enum jrnl_rec_type {
+	JRNL_ADD = 1,
+	JRNL_RM = 2,
+	JRNL_REVOKE = 3,
+};
+
+/**
+ * @brief On-disk record header
+ *
+ * Followed by jr_taglen bytes of recovery tag and jr_fhlen bytes of
+ * base64 encoded file handle (REVOKE only).  The checksum covers the
+ * header, with jr_csum zeroed, and the payload.
+ */
+struct jrnl_rec_hdr {
+	uint32_t jr_magic;
+	uint32_t jr_csum;
+	uint16_t jr_type;
+	uint16_t jr_taglen;
+	uint16_t jr_fhlen;
+	uint16_t jr_pad;
+};
+
+struct jrnl_rfh {
+	struct glist_head jf_list;
+	char *jf_handle;
+};
+
+/** A client in the live set, keyed by recovery tag */
+struct jrnl_client {
+	struct avltree_node jc_node;
+	struct glist_head jc_rfh_list;
+	char *jc_tag;
+};
+
+struct jrnl_buf {
+	char *jb_data;
+	size_t jb_len;
+	size_t jb_cap;
+};
+
+static struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	int fd;				/*< Current journal, O_APPEND */
+	struct jrnl_buf pending;	/*< Records not yet written */
+	struct jrnl_buf spare;		/*< Buffer being flushed */
+	uint64_t append_seq;		/*< Last record appended */
+	uint64_t durable_seq;		/*< Last record on stable storage */
+	struct glist_head waiters;	/*< Committers waiting for a flush */
+	bool flushing;			/*< A leader is writing */
+	size_t file_bytes;		/*< Size of the journal file */
+	size_t live_bytes;		/*< Size of a compacted journal */
+	struct avltree live;		/*< Clients of the current epoch */
+} jrnl = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.fd = -1,
+	.waiters = GLIST_HEAD_INIT(jrnl.waiters),
+};
+
+/** A committer waiting for its record to be flushed */
+struct jrnl_waiter {
+	struct glist_head jw_list;
+	uint64_t jw_seq;	/*< Sequence of the record */
+	int jw_type;		/*< The record, applied to the live set */
+	const char *jw_tag;	/*  once it is durable */
+	const char *jw_handle;
+	int jw_rc;		/*< Outcome of the flush */
+	bool jw_done;		/*< Flush of the record is over */
+};
+
+static char jrnl_path[PATH_MAX];
+static char jrnl_old_path[PATH_MAX];
+
+static int jrnl_client_cmpf(const struct avltree_node *lhs,
+			    const struct avltree_node *rhs)
+{
+	struct jrnl_client *lk, *rk;
+
+	lk = avltree_container_of(lhs, struct jrnl_client, jc_node);
+	rk = avltree_container_of(rhs, struct jrnl_client, jc_node);
+
+	return strcmp(lk->jc_tag, rk->jc_tag);
+}
+
+static struct jrnl_client *jrnl_client_lookup(struct avltree *tree,
+					      const char *tag)
+{
+	struct jrnl_client key;
+	struct avltree_node *node;
+
+	key.jc_tag = (char *)tag;
+	node = avltree_lookup(&key.jc_node, tree);
+	if (node == NULL)
+		return NULL;
+
+	return avltree_container_of(node, struct jrnl_client, jc_node);
+}
+
+static size_t jrnl_rec_size(size_t taglen, size_t fhlen)
+{
+	return sizeof(struct jrnl_rec_hdr) + taglen + fhlen;
+}
+
+static void jrnl_client_free(struct jrnl_client *clnt)
+{
+	struct jrnl_rfh *rfh;
+
+	while ((rfh = glist_first_entry(&clnt->jc_rfh_list, struct jrnl_rfh,
+					jf_list)) != NULL) {
+		glist_del(&rfh->jf_list);
+		gsh_free(rfh->jf_handle);
+		gsh_free(rfh);
+	}
+	gsh_free(clnt->jc_tag);
+	gsh_free(clnt);
+}
+
+/**
+ * @brief Apply one record to a live set
+ *
+ * Records are idempotent, replaying a record that already took effect
+ * (e.g. after a crash in the middle of a compaction) is harmless.
+ *
+ * @return Change in size of the compacted journal.
+ */
+static ssize_t jrnl_apply(struct avltree *tree, int type,
+			  const char *tag, const char *handle)
+{
+	struct jrnl_client *clnt = jrnl_client_lookup(tree, tag);
+	struct jrnl_rfh *rfh;
+	struct glist_head *glist;
+	size_t taglen = strlen(tag);
+	ssize_t delta = 0;
+
+	switch (type) {
+	case JRNL_ADD:
+		if (clnt != NULL)
+			break;
+		clnt = gsh_calloc(1, sizeof(*clnt));
+		glist_init(&clnt->jc_rfh_list);
+		clnt->jc_tag = gsh_strdup(tag);
+		avltree_insert(&clnt->jc_node, tree);
+		delta = jrnl_rec_size(taglen, 0);
+		break;
+
+	case JRNL_RM:
+		if (clnt == NULL)
+			break;
+		delta = -(ssize_t)jrnl_rec_size(taglen, 0);
+		glist_for_each(glist, &clnt->jc_rfh_list) {
+			rfh = glist_entry(glist, struct jrnl_rfh, jf_list);
+			delta -= jrnl_rec_size(taglen, strlen(rfh->jf_handle));
+		}
+		avltree_remove(&clnt->jc_node, tree);
+		jrnl_client_free(clnt);
+		break;
+
+	case JRNL_REVOKE:
+		if (clnt == NULL)
+			break;
+		glist_for_each(glist, &clnt->jc_rfh_list) {
+			rfh = glist_entry(glist, struct jrnl_rfh, jf_list);
+			if (!strcmp(rfh->jf_handle, handle))
+				return 0;
+		}
+		rfh = gsh_malloc(sizeof(*rfh));
+		rfh->jf_handle = gsh_strdup(handle);
+		glist_add_tail(&clnt->jc_rfh_list, &rfh->jf_list);
+		delta = jrnl_rec_size(taglen, strlen(handle));
+		break;
+	}
+
+	return delta;
+}
+
+static void jrnl_free_tree(struct avltree *tree)
+{
+	struct avltree_node *node;
+
+	while ((node = avltree_first(tree)) != NULL) {
+		avltree_remove(node, tree);
+		jrnl_client_free(avltree_container_of(node, struct jrnl_client,
+						      jc_node));
+	}
+}
+
+/**
+ * @brief Encode a record at the end of a buffer
+ */
+static void jrnl_encode(struct jrnl_buf *buf, int type, const char *tag,
+			const char *handle)
+{
+	struct jrnl_rec_hdr hdr;
+	size_t taglen = strlen(tag);
+	size_t fhlen = handle ? strlen(handle) : 0;
+	size_t size = jrnl_rec_size(taglen, fhlen);
+	char *rec;
+	uint32_t csum;
+
+	if (buf->jb_len + size > buf->jb_cap) {
+		buf->jb_cap = buf->jb_cap * 2;
+		if (buf->jb_cap < buf->jb_len + size)
+			buf->jb_cap = buf->jb_len + size;
+		buf->jb_data = gsh_realloc(buf->jb_data, buf->jb_cap);
+	}
+
+	rec = buf->jb_data + buf->jb_len;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.jr_magic = JRNL_MAGIC;
+	hdr.jr_type = type;
+	hdr.jr_taglen = taglen;
+	hdr.jr_fhlen = fhlen;
+
+	memcpy(rec, &hdr, sizeof(hdr));
+	memcpy(rec + sizeof(hdr), tag, taglen);
+	if (fhlen)
+		memcpy(rec + sizeof(hdr) + taglen, handle, fhlen);
+
+	MurmurHash3_x86_32(rec, size, JRNL_SEED, &csum);
+	memcpy(rec + offsetof(struct jrnl_rec_hdr, jr_csum), &csum,
+	       sizeof(csum));
+
+	buf->jb_len += size;
+}
+
+/**
+ * @brief Encode a whole live set
+ */
+static void jrnl_encode_tree(struct jrnl_buf *buf, struct avltree *tree)
+{
+	struct avltree_node *node;
+	struct glist_head *glist;
+
+	for (node = avltree_first(tree); node; node = avltree_next(node)) {
+		struct jrnl_client *clnt;
+
+		clnt = avltree_container_of(node, struct jrnl_client, jc_node);
+		jrnl_encode(buf, JRNL_ADD, clnt->jc_tag, NULL);
+
+		glist_for_each(glist, &clnt->jc_rfh_list) {
+			struct jrnl_rfh *rfh;
+
+			rfh = glist_entry(glist, struct jrnl_rfh, jf_list);
+			jrnl_encode(buf, JRNL_REVOKE, clnt->jc_tag,
+				    rfh->jf_handle);
+		}
+	}
+}
+
+static int jrnl_write_all(int fd, const char *data, size_t len)
+{
+	ssize_t rc;
+
+	while (len > 0) {
+		rc = write(fd, data, len);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		data += rc;
+		len -= rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Replay a journal file into a live set
+ *
+ * Replay stops at the first short or corrupt record, which can only be
+ * the tail of an append that was interrupted by a crash.
+ *
+ * @param[in]  path     Journal to replay
+ * @param[in]  tree     Live set to update
+ * @param[out] validlen Length of the intact prefix of the file
+ *
+ * @return 0 on success (including a missing file), -errno otherwise.
+ */
+static int jrnl_replay(const char *path, struct avltree *tree,
+		       size_t *validlen)
+{
+	struct stat st;
+	struct jrnl_rec_hdr hdr;
+	char tag[PATH_MAX];
+	char handle[NAME_MAX];
+	char *data, *rec;
+	size_t off = 0, size;
+	uint32_t csum, ocsum;
+	int fd, rc = 0;
+
+	if (validlen)
+		*validlen = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return errno == ENOENT ? 0 : -errno;
+
+	if (fstat(fd, &st) < 0) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+
+	data = gsh_malloc(st.st_size + 1);
+
+	for (size = 0; size < st.st_size; ) {
+		ssize_t n = read(fd, data + size, st.st_size - size);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		size += n;
+	}
+	close(fd);
+
+	while (off + sizeof(hdr) <= size) {
+		rec = data + off;
+		memcpy(&hdr, rec, sizeof(hdr));
+
+		if (hdr.jr_magic != JRNL_MAGIC ||
+		    hdr.jr_taglen == 0 || hdr.jr_taglen >= sizeof(tag) ||
+		    hdr.jr_fhlen >= sizeof(handle) ||
+		    off + jrnl_rec_size(hdr.jr_taglen, hdr.jr_fhlen) > size)
+			break;
+
+		ocsum = hdr.jr_csum;
+		memset(rec + offsetof(struct jrnl_rec_hdr, jr_csum), 0,
+		       sizeof(ocsum));
+		MurmurHash3_x86_32(rec,
+				   jrnl_rec_size(hdr.jr_taglen, hdr.jr_fhlen),
+				   JRNL_SEED, &csum);
+		if (csum != ocsum)
+			break;
+
+		memcpy(tag, rec + sizeof(hdr), hdr.jr_taglen);
+		tag[hdr.jr_taglen] = '\0';
+		memcpy(handle, rec + sizeof(hdr) + hdr.jr_taglen,
+		       hdr.jr_fhlen);
+		handle[hdr.jr_fhlen] = '\0';
+
+		jrnl_apply(tree, hdr.jr_type, tag, handle);
+		off += jrnl_rec_size(hdr.jr_taglen, hdr.jr_fhlen);
+	}
+
+	if (off != size)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Ignoring %zu trailing bytes of recovery journal %s",
+			 size - off, path);
+
+	if (validlen)
+		*validlen = off;
+
+	gsh_free(data);
+	return rc;
+}
+
+/**
+ * @brief Atomically replace a journal with the encoding of a live set
+ *
+ * @return Open O_APPEND descriptor on the new file, or -errno.
+ */
+static int jrnl_rewrite(const char *path, struct avltree *tree,
+			size_t *newlen)
+{
+	struct jrnl_buf buf = { NULL, 0, 0 };
+	char tmp_path[PATH_MAX];
+	char dir_path[PATH_MAX];
+	int fd, dfd, rc;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+	if (fd < 0) {
+		rc = -errno;
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to create recovery journal %s: %s",
+			 tmp_path, strerror(-rc));
+		return rc;
+	}
+
+	jrnl_encode_tree(&buf, tree);
+
+	rc = jrnl_write_all(fd, buf.jb_data, buf.jb_len);
+	if (rc == 0 && fdatasync(fd) < 0)
+		rc = -errno;
+	if (rc == 0 && rename(tmp_path, path) < 0)
+		rc = -errno;
+
+	if (rc != 0) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to rewrite recovery journal %s: %s",
+			 path, strerror(-rc));
+		close(fd);
+		unlink(tmp_path);
+		gsh_free(buf.jb_data);
+		return rc;
+	}
+
+	/* Make the rename itself durable */
+	strlcpy(dir_path, path, sizeof(dir_path));
+	dfd = open(dirname(dir_path), O_RDONLY | O_DIRECTORY);
+	if (dfd >= 0) {
+		(void) fsync(dfd);
+		close(dfd);
+	}
+
+	if (newlen)
+		*newlen = buf.jb_len;
+
+	gsh_free(buf.jb_data);
+	return fd;
+}
+
+/**
+ * @brief Compact the current journal if it is mostly dead records
+ *
+ * Called by the flush leader with the mutex held and nothing pending.
+ */
+static void jrnl_maybe_compact(void)
+{
+	size_t newlen;
+	int fd;
+
+	if (jrnl.file_bytes < JRNL_COMPACT_MIN ||
+	    jrnl.file_bytes < 2 * jrnl.live_bytes)
+		return;
+
+	fd = jrnl_rewrite(jrnl_path, &jrnl.live, &newlen);
+	if (fd < 0)
+		return;
+
+	LogDebug(COMPONENT_CLIENTID,
+		 "Compacted recovery journal from %zu to %zu bytes",
+		 jrnl.file_bytes, newlen);
+
+	close(jrnl.fd);
+	jrnl.fd = fd;
+	jrnl.file_bytes = newlen;
+	jrnl.live_bytes = newlen;
+}
+
+/**
+ * @brief Cut a failed flush off the end of the journal
+ *
+ * Whatever part of the batch reached the file would stop replay at the
+ * first torn record and hide every record written after it, so the
+ * journal is truncated back to its last good size.  If even that fails
+ * it is rewritten from the live set.  Called with the mutex held.
+ */
+static void jrnl_undo_flush(void)
+{
+	size_t newlen;
+	int fd;
+
+	if (ftruncate(jrnl.fd, jrnl.file_bytes) == 0)
+		return;
+
+	LogCrit(COMPONENT_CLIENTID,
+		"Failed to truncate recovery journal %s: %s",
+		jrnl_path, strerror(errno));
+
+	fd = jrnl_rewrite(jrnl_path, &jrnl.live, &newlen);
+	if (fd < 0)
+		return;
+
+	close(jrnl.fd);
+	jrnl.fd = fd;
+	jrnl.file_bytes = newlen;
+	jrnl.live_bytes = newlen;
+}
+
+/**
+ * @brief Append a record and wait until it is on stable storage
+ *
+ * @param[in] type   Record type
+ * @param[in] tag    Client recovery tag
+ * @param[in] handle Encoded file handle, REVOKE only
+ *
+ * The record only goes into the in-memory live set once it is durable,
+ * so a failed record can't be written back by a later compaction.
+ *
+ * @return 0 once the record is durable, -errno if it could not be
+ *         written, in which case it is not in the journal.
+ */
+static int jrnl_commit(int type, const char *tag, const char *handle)
+{
+	struct jrnl_waiter waiter = {
+		.jw_type = type,
+		.jw_tag = tag,
+		.jw_handle = handle,
+		.jw_rc = 0,
+		.jw_done = false
+	};
+	struct jrnl_buf flush;
+	struct glist_head *glist, *glistn;
+	uint64_t target;
+	int rc;
+
+	PTHREAD_MUTEX_lock(&jrnl.mtx);
+
+	if (jrnl.fd < 0) {
+		PTHREAD_MUTEX_unlock(&jrnl.mtx);
+		return 0;
+	}
+
+	jrnl_encode(&jrnl.pending, type, tag, handle);
+	waiter.jw_seq = ++jrnl.append_seq;
+	glist_add_tail(&jrnl.waiters, &waiter.jw_list);
+
+	while (!waiter.jw_done) {
+		if (jrnl.flushing) {
+			pthread_cond_wait(&jrnl.cond, &jrnl.mtx);
+			continue;
+		}
+
+		/* Become the leader and flush everything appended so far,
+		 * new records accumulate in the other buffer meanwhile.
+		 */
+		jrnl.flushing = true;
+		flush = jrnl.pending;
+		jrnl.pending = jrnl.spare;
+		jrnl.pending.jb_len = 0;
+		target = jrnl.append_seq;
+
+		PTHREAD_MUTEX_unlock(&jrnl.mtx);
+
+		rc = jrnl_write_all(jrnl.fd, flush.jb_data, flush.jb_len);
+		if (rc == 0 && fdatasync(jrnl.fd) < 0)
+			rc = -errno;
+
+		if (rc != 0)
+			LogCrit(COMPONENT_CLIENTID,
+				"Failed to write recovery journal %s: %s",
+				jrnl_path, strerror(-rc));
+
+		PTHREAD_MUTEX_lock(&jrnl.mtx);
+
+		jrnl.spare = flush;
+
+		if (rc == 0) {
+			jrnl.file_bytes += flush.jb_len;
+			jrnl.durable_seq = target;
+		} else {
+			jrnl_undo_flush();
+		}
+
+		/* Tell everyone in the batch how it went, the waiters are in
+		 * append order so the live set sees the records in the order
+		 * the journal has them.
+		 */
+		glist_for_each_safe(glist, glistn, &jrnl.waiters) {
+			struct jrnl_waiter *w;
+
+			w = glist_entry(glist, struct jrnl_waiter, jw_list);
+			if (w->jw_seq > target)
+				break;
+
+			if (rc == 0)
+				jrnl.live_bytes += jrnl_apply(&jrnl.live,
+							      w->jw_type,
+							      w->jw_tag,
+							      w->jw_handle);
+			w->jw_rc = rc;
+			w->jw_done = true;
+			glist_del(&w->jw_list);
+		}
+
+		jrnl.flushing = false;
+
+		if (rc == 0 && jrnl.pending.jb_len == 0)
+			jrnl_maybe_compact();
+
+		pthread_cond_broadcast(&jrnl.cond);
+	}
+
+	PTHREAD_MUTEX_unlock(&jrnl.mtx);
+
+	return waiter.jw_rc;
+}
+
+static int jrnl_init(void)
+{
+	char host[NI_MAXHOST];
+	char dir[PATH_MAX];
+	int err;
+
+	err = mkdir(NFS_V4_RECOV_ROOT, 0700);
+	if (err == -1 && errno != EEXIST) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to create v4 recovery dir (%s): %s",
+			 NFS_V4_RECOV_ROOT, strerror(errno));
+	}
+
+	snprintf(dir, sizeof(dir), "%s/%s", NFS_V4_RECOV_ROOT,
+		 NFS_V4_RECOV_DIR);
+	err = mkdir(dir, 0700);
+	if (err == -1 && errno != EEXIST) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to create v4 recovery dir(%s): %s",
+			 dir, strerror(errno));
+	}
+
+	if (nfs_param.core_param.clustered) {
+		snprintf(host, sizeof(host), "node%d", g_nodeid);
+	} else {
+		err = gethostname(host, sizeof(host));
+		if (err) {
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to gethostname: %s",
+				 strerror(errno));
+			return -errno;
+		}
+	}
+
+	snprintf(jrnl_path, sizeof(jrnl_path), "%s/%s.jrnl", dir, host);
+	snprintf(jrnl_old_path, sizeof(jrnl_old_path), "%s.old", jrnl_path);
+
+	avltree_init(&jrnl.live, jrnl_client_cmpf, 0);
+
+	return 0;
+}
+
+static void jrnl_shutdown(void)
+{
+	PTHREAD_MUTEX_lock(&jrnl.mtx);
+
+	while (jrnl.flushing)
+		pthread_cond_wait(&jrnl.cond, &jrnl.mtx);
+
+	if (jrnl.fd >= 0) {
+		close(jrnl.fd);
+		jrnl.fd = -1;
+	}
+
+	jrnl_free_tree(&jrnl.live);
+	gsh_free(jrnl.pending.jb_data);
+	gsh_free(jrnl.spare.jb_data);
+	memset(&jrnl.pending, 0, sizeof(jrnl.pending));
+	memset(&jrnl.spare, 0, sizeof(jrnl.spare));
+
+	PTHREAD_MUTEX_unlock(&jrnl.mtx);
+}
+
+/**
+ * @brief Hand a live set to SAL as the reclaim list
+ */
+static void jrnl_load_clids(struct avltree *tree,
+			    add_clid_entry_hook add_clid_entry,
+			    add_rfh_entry_hook add_rfh_entry)
+{
+	struct avltree_node *node;
+	struct glist_head *glist;
+
+	for (node = avltree_first(tree); node; node = avltree_next(node)) {
+		struct jrnl_client *clnt;
+		clid_entry_t *new_ent;
+
+		clnt = avltree_container_of(node, struct jrnl_client, jc_node);
+		new_ent = add_clid_entry(clnt->jc_tag);
+
+		glist_for_each(glist, &clnt->jc_rfh_list) {
+			struct jrnl_rfh *rfh;
+
+			rfh = glist_entry(glist, struct jrnl_rfh, jf_list);
+			add_rfh_entry(new_ent, rfh->jf_handle);
+		}
+
+		LogDebug(COMPONENT_CLIENTID, "added %s to clid list",
+			 new_ent->cl_name);
+	}
+}
+
+/**
+ * @brief Start a new epoch
+ *
+ * Everything recorded by the previous epochs (the old journal, plus the
+ * current one) becomes the reclaim list and is persisted as the old
+ * journal until the grace period ends.  The current journal starts out
+ * empty.
+ */
+static void jrnl_read_clids_recover(add_clid_entry_hook add_clid_entry,
+				    add_rfh_entry_hook add_rfh_entry)
+{
+	struct avltree old;
+	size_t len;
+	int fd, rc;
+
+	avltree_init(&old, jrnl_client_cmpf, 0);
+
+	rc = jrnl_replay(jrnl_old_path, &old, NULL);
+	if (rc == 0)
+		rc = jrnl_replay(jrnl_path, &old, NULL);
+	if (rc != 0)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to read recovery journal: %s",
+			 strerror(-rc));
+
+	jrnl_load_clids(&old, add_clid_entry, add_rfh_entry);
+
+	fd = jrnl_rewrite(jrnl_old_path, &old, NULL);
+	if (fd >= 0)
+		close(fd);
+	jrnl_free_tree(&old);
+
+	/* Only truncate the current journal once the old one is safe */
+	if (fd < 0)
+		return;
+
+	PTHREAD_MUTEX_lock(&jrnl.mtx);
+
+	jrnl_free_tree(&jrnl.live);
+	fd = jrnl_rewrite(jrnl_path, &jrnl.live, &len);
+	if (fd >= 0) {
+		if (jrnl.fd >= 0)
+			close(jrnl.fd);
+		jrnl.fd = fd;
+		jrnl.file_bytes = len;
+		jrnl.live_bytes = len;
+	}
+
+	PTHREAD_MUTEX_unlock(&jrnl.mtx);
+}
+
+/**
+ * @brief Load clients for recovery
+ *
+ * @param[in] gsp Grace start info, NULL at startup
+ */
+static void jrnl_read_clids(nfs_grace_start_t *gsp,
+			    add_clid_entry_hook add_clid_entry,
+			    add_rfh_entry_hook add_rfh_entry)
+{
+	struct avltree tree;
+	char path[PATH_MAX];
+	int rc;
+
+	if (!gsp) {
+		jrnl_read_clids_recover(add_clid_entry, add_rfh_entry);
+		return;
+	}
+
+	switch (gsp->event) {
+	case EVENT_UPDATE_CLIENTS:
+		PTHREAD_MUTEX_lock(&jrnl.mtx);
+		jrnl_load_clids(&jrnl.live, add_clid_entry, add_rfh_entry);
+		PTHREAD_MUTEX_unlock(&jrnl.mtx);
+		return;
+	case EVENT_TAKE_NODEID:
+		snprintf(path, sizeof(path), "%s/%s/node%d.jrnl",
+			 NFS_V4_RECOV_ROOT, NFS_V4_RECOV_DIR,
+			 gsp->nodeid);
+		break;
+	default:
+		LogWarn(COMPONENT_STATE, "Recovery unknown event: %d",
+			gsp->event);
+		return;
+	}
+
+	LogEvent(COMPONENT_CLIENTID, "Recovery for nodeid %d journal (%s)",
+		 gsp->nodeid, path);
+
+	avltree_init(&tree, jrnl_client_cmpf, 0);
+
+	rc = jrnl_replay(path, &tree, NULL);
+	if (rc != 0) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to read recovery journal (%s): %s",
+			 path, strerror(-rc));
+	} else {
+		jrnl_load_clids(&tree, add_clid_entry, add_rfh_entry);
+	}
+
+	jrnl_free_tree(&tree);
+}
+
+static void jrnl_end_grace(void)
+{
+	if (unlink(jrnl_old_path) < 0 && errno != ENOENT)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to remove old recovery journal %s: %s",
+			 jrnl_old_path, strerror(errno));
+}
+
+static void jrnl_add_clid(nfs_client_id_t *clientid)
+{
+	int rc;
+
+	fs_create_clid_name(clientid);
+
+	if (clientid->cid_recov_tag == NULL)
+		return;
+
+	rc = jrnl_commit(JRNL_ADD, clientid->cid_recov_tag, NULL);
+	if (rc != 0)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Client %s not recorded in recovery journal: %s",
+			 clientid->cid_recov_tag, strerror(-rc));
+}
+
+static void jrnl_rm_clid(nfs_client_id_t *clientid)
+{
+	char *recov_tag = clientid->cid_recov_tag;
+	int rc;
+
+	if (recov_tag == NULL)
+		return;
+
+	clientid->cid_recov_tag = NULL;
+	rc = jrnl_commit(JRNL_RM, recov_tag, NULL);
+	if (rc != 0)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Removal of client %s not recorded in recovery journal: %s",
+			 recov_tag, strerror(-rc));
+	gsh_free(recov_tag);
+}
+
+static void jrnl_add_revoke_fh(nfs_client_id_t *delr_clid,
+			       nfs_fh4 *delr_handle)
+{
+	char rhdlstr[NAME_MAX];
+	int retval;
+
+	if (delr_clid->cid_recov_tag == NULL)
+		return;
+
+	retval = base64url_encode(delr_handle->nfs_fh4_val,
+				  delr_handle->nfs_fh4_len,
+				  rhdlstr, sizeof(rhdlstr));
+	if (retval == -1) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to encode revoked handle");
+		return;
+	}
+
+	retval = jrnl_commit(JRNL_REVOKE, delr_clid->cid_recov_tag, rhdlstr);
+	if (retval != 0)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Revoked handle of client %s not recorded in recovery journal: %s",
+			 delr_clid->cid_recov_tag, strerror(-retval));
+}
+
+static struct nfs4_recovery_backend journal_backend = {
+	.recovery_init = jrnl_init,
+	.recovery_shutdown = jrnl_shutdown,
+	.end_grace = jrnl_end_grace,
+	.recovery_read_clids = jrnl_read_clids,
+	.add_clid = jrnl_add_clid,
+	.rm_clid = jrnl_rm_clid,
+	.add_revoke_fh = jrnl_add_revoke_fh,
+};
+
+void journal_backend_init(struct nfs4_recovery_backend **backend)
+{
+	*backend = &journal_backend;
+}
@@ -160,7 +160,13 @@ state_status_t acquire_lease_lock(struct state_hdl *ostate,
 state_status_t release_lease_lock(struct fsal_obj_handle *obj, state_t *state)
 {
 	state_status_t status;
-	state_owner_t *owner = get_state_owner_ref(state);
+	state_owner_t *owner;
+
+	/* Directory delegations are handled in SAL, the FSAL has no lease */
+	if (obj->type == DIRECTORY)
+		return STATE_SUCCESS;
+
+	owner = get_state_owner_ref(state);
 
 	/* Something is going stale? */
 	if (owner == NULL)
@@ -214,8 +220,12 @@ static int advance_avg(time_t prev_avg, time_t new_time,
  */
 void reset_cbgetattr_stats(struct fsal_obj_handle *obj)
 {
-	cbgetattr_t *cbgetattr = &obj->state_hdl->file.cbgetattr;
+	cbgetattr_t *cbgetattr;
+
+	if (obj->type != REGULAR_FILE)
+		return;
 
+	cbgetattr = &obj->state_hdl->file.cbgetattr;
 	cbgetattr->state = CB_GETATTR_NONE;
 	cbgetattr->modified = false;
 }
@@ -233,17 +243,26 @@ void deleg_heuristics_recall(struct fsal_obj_handle *obj,
 			     struct state_t *deleg)
 {
 	nfs_client_id_t *client = owner->so_owner.so_nfs4_owner.so_clientrec;
-	/* Update delegation stats for file. */
-	struct file_deleg_stats *statistics =
-		&obj->state_hdl->file.fdeleg_stats;
-
-	statistics->fds_curr_delegations--;
-	statistics->fds_recall_count++;
+	struct file_deleg_stats *statistics;
 
 	/* Update delegation stats for client. */
 	dec_grants(client->gsh_client);
 	client->curr_deleg_grants--;
 
+	if (obj->type == DIRECTORY) {
+		struct dir_deleg_stats *dir_stats =
+			&obj->state_hdl->dir.ddeleg_stats;
+
+		atomic_dec_uint32_t(&dir_stats->dds_curr_delegations);
+		dir_stats->dds_recall_count++;
+		return;
+	}
+
+	/* Update delegation stats for file. */
+	statistics = &obj->state_hdl->file.fdeleg_stats;
+	statistics->fds_curr_delegations--;
+	statistics->fds_recall_count++;
+
 	/* Update delegation stats for file. */
 	statistics->fds_avg_hold = advance_avg(statistics->fds_avg_hold,
 					   time(NULL)
@@ -739,3 +758,179 @@ bool can_we_grant_deleg(struct state_hdl *ostate, state_t *open_state)
 
 	return true;
 }
+
+/**
+ * @brief Check whether directory delegations may be granted at all
+ *
+ * Directory delegations never reach the FSAL; conflicts are detected
+ * by MDCACHE on its own mutation paths, so only the global and export
+ * configuration is checked here.
+ *
+ * @param[in] obj          Directory the delegation would be on
+ * @param[in] export_perms Export permissions of the request
+ *
+ * @return true if a directory delegation could be granted.
+ */
+bool dir_deleg_supported(struct fsal_obj_handle *obj,
+			 struct export_perms *export_perms)
+{
+	if (!nfs_param.nfsv4_param.allow_delegations)
+		return false;
+	if (obj->type != DIRECTORY)
+		return false;
+	if (!(export_perms->options & EXPORT_OPTION_READ_DELEG))
+		return false;
+
+	return true;
+}
+
+/* A directory must not have changed for this long before it is delegated,
+ * any shorter and we would just be recalling it again right away.
+ */
+#define DIR_DELEG_STABLE_TIME 30
+
+/**
+ * @brief Decide if a directory delegation should be granted
+ *
+ * Directories whose entries are churning are never delegated: every
+ * change would cost a recall or a CB_NOTIFY per holder.
+ *
+ * @note The state_lock MUST be held for write
+ *
+ * @param[in] ostate Directory state the delegation will be on.
+ * @param[in] client Client that would own the delegation.
+ *
+ * @return true if the delegation should be granted.
+ */
+bool should_we_grant_dir_deleg(struct state_hdl *ostate,
+			       nfs_client_id_t *client)
+{
+	struct dir_deleg_stats *dir_stats = &ostate->dir.ddeleg_stats;
+	time_t now = time(NULL);
+	time_t last_change;
+
+	if (get_cb_chan_down(client)) {
+		LogFullDebug(COMPONENT_STATE,
+			     "Callback channel down, no directory delegation");
+		return false;
+	}
+
+	/* Check if this is a misbehaving or unreliable client */
+	if (client->num_revokes > 2)
+		return false;
+
+	last_change = atomic_fetch_time_t(&dir_stats->dds_last_change);
+	if (last_change != 0 && now - last_change < DIR_DELEG_STABLE_TIME) {
+		LogFullDebug(COMPONENT_STATE,
+			     "Directory changed %ld seconds ago, not delegating",
+			     (long) (now - last_change));
+		return false;
+	}
+
+	/* Same as for files, give the client whose change caused the recall
+	 * a chance to get in first.
+	 */
+	if (dir_stats->dds_last_recall != 0 &&
+	    now - dir_stats->dds_last_recall < RECALL2DELEG_TIME)
+		return false;
+
+	return true;
+}
+
+/**
+ * @brief Update statistics on a granted directory delegation
+ *
+ * @note The state_lock MUST be held for write
+ *
+ * @param[in] ostate Directory state
+ * @param[in] owner  Clientid owner holding the delegation
+ */
+void update_dir_delegation_stats(struct state_hdl *ostate,
+				 state_owner_t *owner)
+{
+	nfs_client_id_t *client = owner->so_owner.so_nfs4_owner.so_clientrec;
+	struct dir_deleg_stats *dir_stats = &ostate->dir.ddeleg_stats;
+
+	atomic_inc_uint32_t(&dir_stats->dds_curr_delegations);
+	dir_stats->dds_delegation_count++;
+
+	inc_grants(client->gsh_client);
+	client->curr_deleg_grants++;
+}
+
+/**
+ * @brief Update statistics on a directory delegation dropped unrecalled
+ *
+ * Used when the directory itself goes away with delegations on it.
+ *
+ * @note The state_lock MUST be held for write
+ *
+ * @param[in] ostate Directory state
+ * @param[in] owner  Clientid owner holding the delegation
+ */
+void dir_deleg_heuristics_wipe(struct state_hdl *ostate,
+			       state_owner_t *owner)
+{
+	nfs_client_id_t *client = owner->so_owner.so_nfs4_owner.so_clientrec;
+
+	atomic_dec_uint32_t(&ostate->dir.ddeleg_stats.dds_curr_delegations);
+
+	dec_grants(client->gsh_client);
+	client->curr_deleg_grants--;
+}
+
+/**
+ * @brief Check if a directory has delegations out
+ *
+ * Lets callers skip work only needed to notify holders.  The answer may
+ * change as soon as it is given.
+ *
+ * @param[in] dir Directory
+ *
+ * @return true if @a dir is delegated to some client.
+ */
+bool state_dir_deleg_held(struct fsal_obj_handle *dir)
+{
+	if (dir->type != DIRECTORY || dir->state_hdl == NULL)
+		return false;
+
+	return atomic_fetch_uint32_t(
+		&dir->state_hdl->dir.ddeleg_stats.dds_curr_delegations) != 0;
+}
+
+/**
+ * @brief Tell directory delegation holders that an entry changed
+ *
+ * Called by the cache after an entry has been added, removed or renamed
+ * in @a dir. The change is always recorded for the grant heuristics;
+ * only if the directory is delegated is the recall or CB_NOTIFY queued,
+ * so this is cheap on the common path.
+ *
+ * @param[in] dir      Directory that changed
+ * @param[in] type     NOTIFY4_ADD_ENTRY, NOTIFY4_REMOVE_ENTRY or
+ *                     NOTIFY4_RENAME_ENTRY
+ * @param[in] name     Name added or removed, old name for a rename
+ * @param[in] new_name New name for a rename, NULL otherwise
+ */
+void state_dir_deleg_notify(struct fsal_obj_handle *dir, notify_type4 type,
+			    const char *name, const char *new_name)
+{
+	struct dir_deleg_stats *dir_stats;
+
+	if (dir->type != DIRECTORY || dir->state_hdl == NULL)
+		return;
+
+	dir_stats = &dir->state_hdl->dir.ddeleg_stats;
+	atomic_store_time_t(&dir_stats->dds_last_change, time(NULL));
+
+	if (atomic_fetch_uint32_t(&dir_stats->dds_curr_delegations) == 0)
+		return;
+
+	LogDebug(COMPONENT_STATE,
+		 "Directory %p is delegated, notifying change %d of %s",
+		 dir, type, name);
+
+	if (async_dir_notify(general_fridge, dir, type, name, new_name) != 0)
+		LogCrit(COMPONENT_STATE,
+			"Failed to start thread to notify directory delegations.");
+}
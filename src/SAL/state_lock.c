@@ -92,6 +92,11 @@ struct glist_head state_blocked_locks = GLIST_HEAD_INIT(state_blocked_locks);
  */
 pthread_mutex_t blocked_locks_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/**
+ * @brief Pool for lock entries
+ */
+static pool_t *state_lock_entry_pool;
+
 /**
  * @brief Owner of state with no defined owner
  */
@@ -154,7 +159,12 @@ state_status_t state_lock_init(void)
 	status = state_async_init();
 
 	state_owner_pool =
-		pool_basic_init("NFSv4 state owners", sizeof(state_owner_t));
+		pool_slab_init("NFSv4 state owners", sizeof(state_owner_t),
+			       NULL, NULL);
+
+	state_lock_entry_pool =
+		pool_slab_init("State lock entries", sizeof(state_lock_entry_t),
+			       NULL, NULL);
 
 	return status;
 }
@@ -576,7 +586,7 @@ static state_lock_entry_t *create_state_lock_entry(struct fsal_obj_handle *obj,
 {
 	state_lock_entry_t *new_entry;
 
-	new_entry = gsh_calloc(1, sizeof(*new_entry));
+	new_entry = pool_alloc(state_lock_entry_pool);
 
 	LogFullDebug(COMPONENT_STATE, "new_entry = %p owner %p", new_entry,
 		     owner);
@@ -708,7 +718,7 @@ static void lock_entry_dec_ref(state_lock_entry_t *lock_entry)
 		lock_entry->sle_obj->obj_ops->put_ref(lock_entry->sle_obj);
 		put_gsh_export(lock_entry->sle_export);
 		PTHREAD_MUTEX_destroy(&lock_entry->sle_mutex);
-		gsh_free(lock_entry);
+		pool_free(state_lock_entry_pool, lock_entry);
 	}
 }
 
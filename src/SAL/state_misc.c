@@ -1291,12 +1291,30 @@ bool hold_state_owner(state_owner_t *owner)
 void state_wipe_file(struct fsal_obj_handle *obj)
 {
 	bool release;
+	struct glist_head *glist, *glistn;
+
 	/*
-	 * currently, only REGULAR files can have state; byte range locks and
-	 * stateid (for v4).  In the future, 4.1, directories could have
-	 * delegations, which is state.  At that point, we may need to modify
-	 * this routine to clear state on directories.
+	 * Only REGULAR files can have byte range locks and open stateids,
+	 * directories can only hold NFSv4.1 directory delegations.
 	 */
+	if (obj->type == DIRECTORY) {
+		PTHREAD_RWLOCK_wrlock(&obj->state_hdl->state_lock);
+
+		glist_for_each_safe(glist, glistn,
+				    &obj->state_hdl->dir.list_of_states) {
+			state_t *state = glist_entry(glist, state_t,
+						     state_list);
+
+			/* Give the client back its grant */
+			dir_deleg_heuristics_wipe(obj->state_hdl,
+						  state->state_owner);
+			state_del_locked(state);
+		}
+
+		PTHREAD_RWLOCK_unlock(&obj->state_hdl->state_lock);
+		return;
+	}
+
 	if (obj->type != REGULAR_FILE)
 		return;
 
@@ -0,0 +1,16 @@
+FIND_PATH(LIBURING_INCLUDE_DIR liburing.h)
+FIND_LIBRARY(LIBURING_LIBRARY NAMES uring)
+
+IF (LIBURING_INCLUDE_DIR AND LIBURING_LIBRARY)
+  SET(LIBURING_FOUND TRUE)
+ENDIF (LIBURING_INCLUDE_DIR AND LIBURING_LIBRARY)
+
+IF (LIBURING_FOUND)
+  IF (NOT LIBURING_FIND_QUIETLY)
+    MESSAGE(STATUS "Found io_uring library: ${LIBURING_LIBRARY}")
+  ENDIF (NOT LIBURING_FIND_QUIETLY)
+ELSE (LIBURING_FOUND)
+  IF (LibURing_FIND_REQUIRED)
+    MESSAGE(FATAL_ERROR "Could not find liburing")
+  ENDIF (LibURing_FIND_REQUIRED)
+ENDIF (LIBURING_FOUND)
@@ -0,0 +1,280 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/*
+ * Race SETATTR and REMOVE against MDCACHE's getattrs_async and lookup_async.
+ * FSAL_MEM does the work when it is called and holds the callback back for
+ * Async_Delay, so the result that comes back predates the change.  MDCACHE
+ * must not cache it.
+ *
+ * The export must be FSAL_MEM with Async_Type = fixed and Async_Delay = 1000.
+ * Without the delay the racing call loses and the test proves nothing.
+ */
+
+#include <sys/types.h>
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <boost/program_options.hpp>
+
+extern "C" {
+/* Manually forward this, as 9P is not C++ safe */
+void admin_halt(void);
+/* Ganesha headers */
+#include "export_mgr.h"
+#include "nfs_exports.h"
+#include "sal_data.h"
+#include "fsal.h"
+#include "common_utils.h"
+/* For MDCACHE bypass.  Use with care */
+#include "../FSAL/Stackable_FSALs/FSAL_MDCACHE/mdcache_debug.h"
+}
+
+#include "gtest.hh"
+
+#define TEST_ROOT "async_md_race"
+#define TEST_FILE "race_file"
+#define LOOP_COUNT 100
+
+namespace {
+
+  char* ganesha_conf = nullptr;
+  char* lpath = nullptr;
+  int dlevel = -1;
+  uint16_t export_id = 77;
+
+  struct async_result {
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool done = false;
+    fsal_status_t status;
+    struct fsal_obj_handle *obj = nullptr;
+  };
+
+  void getattrs_cb(struct fsal_obj_handle *obj, fsal_status_t ret,
+		   void *obj_data, void *caller_data)
+  {
+    struct async_result *res = (struct async_result *) caller_data;
+    std::lock_guard<std::mutex> lock(res->mtx);
+
+    res->status = ret;
+    res->done = true;
+    res->cv.notify_one();
+  }
+
+  void lookup_cb(struct fsal_obj_handle *obj, fsal_status_t ret,
+		 void *obj_data, void *caller_data)
+  {
+    struct async_result *res = (struct async_result *) caller_data;
+    std::lock_guard<std::mutex> lock(res->mtx);
+
+    res->status = ret;
+    res->obj = (struct fsal_obj_handle *) obj_data;
+    res->done = true;
+    res->cv.notify_one();
+  }
+
+  void wait_for(struct async_result *res)
+  {
+    std::unique_lock<std::mutex> lock(res->mtx);
+
+    res->cv.wait(lock, [res] { return res->done; });
+  }
+
+  class AsyncMdRaceTest : public gtest::GaneshaFSALBaseTest {
+  protected:
+
+    virtual void SetUp() {
+      gtest::GaneshaFSALBaseTest::SetUp();
+    }
+
+    virtual void TearDown() {
+      gtest::GaneshaFSALBaseTest::TearDown();
+    }
+  };
+
+} /* namespace */
+
+TEST_F(AsyncMdRaceTest, GETATTRS_SETATTR)
+{
+  fsal_status_t status;
+  struct fsal_obj_handle *obj;
+  struct attrlist async_attrs, sattrs, outattrs;
+
+  status = fsal_create(test_root, TEST_FILE, REGULAR_FILE, &attrs, NULL,
+		       &obj, NULL);
+  ASSERT_EQ(status.major, 0);
+  ASSERT_NE(obj, nullptr);
+
+  for (int i = 0; i < LOOP_COUNT; ++i) {
+    struct async_result res;
+    uint32_t mode = (i % 2) ? 0600 : 0644;
+
+    /* Make the getattrs go down to FSAL_MEM */
+    mdcdb_invalidate(obj);
+
+    fsal_prepare_attrs(&async_attrs, ATTRS_POSIX);
+    obj->obj_ops->getattrs_async(obj, &async_attrs, getattrs_cb, &res);
+
+    /* FSAL_MEM already has the old mode, change it under the callback */
+    memset(&sattrs, 0, sizeof(sattrs));
+    FSAL_SET_MASK(sattrs.valid_mask, ATTR_MODE);
+    sattrs.mode = mode;
+    status = obj->obj_ops->setattr2(obj, false, NULL, &sattrs);
+    EXPECT_EQ(status.major, 0);
+
+    /* Either mode is a fine answer, the getattrs was concurrent */
+    wait_for(&res);
+    EXPECT_EQ(res.status.major, 0);
+    fsal_release_attrs(&async_attrs);
+
+    /* The cache must not have gone back to the old mode */
+    fsal_prepare_attrs(&outattrs, ATTRS_POSIX);
+    status = obj->obj_ops->getattrs(obj, &outattrs);
+    EXPECT_EQ(status.major, 0);
+    EXPECT_EQ(outattrs.mode, mode);
+    fsal_release_attrs(&outattrs);
+  }
+
+  obj->obj_ops->put_ref(obj);
+  status = fsal_remove(test_root, TEST_FILE);
+  EXPECT_EQ(status.major, 0);
+}
+
+TEST_F(AsyncMdRaceTest, LOOKUP_REMOVE)
+{
+  fsal_status_t status;
+  struct fsal_obj_handle *obj;
+
+  for (int i = 0; i < LOOP_COUNT; ++i) {
+    struct async_result res;
+
+    status = fsal_create(test_root, TEST_FILE, REGULAR_FILE, &attrs, NULL,
+			 &obj, NULL);
+    ASSERT_EQ(status.major, 0);
+    ASSERT_NE(obj, nullptr);
+    obj->obj_ops->put_ref(obj);
+
+    /* Make the lookup go down to FSAL_MEM */
+    mdcdb_invalidate(test_root);
+
+    test_root->obj_ops->lookup_async(test_root, TEST_FILE, NULL, lookup_cb,
+				     &res);
+
+    /* FSAL_MEM already found the name, remove it under the callback */
+    status = fsal_remove(test_root, TEST_FILE);
+    EXPECT_EQ(status.major, 0);
+
+    /* Either answer is fine, the lookup was concurrent */
+    wait_for(&res);
+    EXPECT_TRUE(res.status.major == 0 ||
+		res.status.major == ERR_FSAL_NOENT);
+    if (res.obj != NULL)
+      res.obj->obj_ops->put_ref(res.obj);
+
+    /* The removed name must not have been cached */
+    obj = NULL;
+    status = test_root->obj_ops->lookup(test_root, TEST_FILE, &obj, NULL);
+    EXPECT_EQ(status.major, ERR_FSAL_NOENT);
+    if (obj != NULL)
+      obj->obj_ops->put_ref(obj);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int code = 0;
+  char* session_name = NULL;
+
+  using namespace std;
+  namespace po = boost::program_options;
+
+  po::options_description opts("program options");
+  po::variables_map vm;
+
+  try {
+
+    opts.add_options()
+      ("config", po::value<string>(),
+       "path to Ganesha conf file")
+
+      ("logfile", po::value<string>(),
+       "log to the provided file path")
+
+      ("export", po::value<uint16_t>(),
+       "id of export on which to operate (must exist)")
+
+      ("debug", po::value<string>(),
+       "ganesha debug level")
+
+      ("session", po::value<string>(),
+	"LTTng session name")
+      ;
+
+    po::variables_map::iterator vm_iter;
+    po::command_line_parser parser{argc, argv};
+    parser.options(opts).allow_unregistered();
+    po::store(parser.run(), vm);
+    po::notify(vm);
+
+    // use config vars--leaves them on the stack
+    vm_iter = vm.find("config");
+    if (vm_iter != vm.end()) {
+      ganesha_conf = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("logfile");
+    if (vm_iter != vm.end()) {
+      lpath = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+    vm_iter = vm.find("debug");
+    if (vm_iter != vm.end()) {
+      dlevel = ReturnLevelAscii(
+	(char*) vm_iter->second.as<std::string>().c_str());
+    }
+    vm_iter = vm.find("export");
+    if (vm_iter != vm.end()) {
+      export_id = vm_iter->second.as<uint16_t>();
+    }
+    vm_iter = vm.find("session");
+    if (vm_iter != vm.end()) {
+      session_name = (char*) vm_iter->second.as<std::string>().c_str();
+    }
+
+    ::testing::InitGoogleTest(&argc, argv);
+    gtest::env = new gtest::Environment(ganesha_conf, lpath, dlevel,
+					session_name, TEST_ROOT, export_id);
+    ::testing::AddGlobalTestEnvironment(gtest::env);
+
+    code  = RUN_ALL_TESTS();
+  }
+
+  catch(po::error& e) {
+    cout << "Error parsing opts " << e.what() << endl;
+  }
+
+  catch(...) {
+    cout << "Unhandled exception in main()" << endl;
+  }
+
+  return code;
+}
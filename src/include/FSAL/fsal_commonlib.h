@@ -273,6 +273,9 @@ bool check_verifier_attrlist(struct attrlist *attrs, fsal_verifier_t verifier);
 bool fsal_common_is_referral(struct fsal_obj_handle *obj_hdl,
 			     struct attrlist *attrs, bool cache_attrs);
 
+ssize_t fsal_read_plus_fd(int fd, uint64_t offset, size_t len, char *buffer,
+			  struct io_info *info, bool *eof);
+
 fsal_status_t update_export(struct fsal_module *fsal_hdl,
 			    void *parse_node,
 			    struct config_error_type *err_type,
@@ -40,6 +40,7 @@
 #define ABSTRACT_MEM_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include "log.h"
@@ -272,13 +273,55 @@ gsh_free_size(void *p, size_t n __attribute__ ((unused)))
  * should be made.
  *
  * This allows for flexible growth in the future.
+ *
+ * Pools created with pool_basic_init are thin wrappers around the
+ * general allocator.  Pools created with pool_slab_init are object
+ * caches: objects are carved out of page aligned slabs and recycled
+ * through per-thread magazines, so the common alloc/free pair touches
+ * no lock and no shared cache line.  They are meant for long lived
+ * pools of hot, fixed size objects.
  */
 
 typedef struct pool {
 	char *name; /*< The name of the pool */
 	size_t object_size; /*< The size of the objects created */
+	struct pool_slab *slab; /*< Object cache, NULL for a basic pool */
 } pool_t;
 
+/**
+ * @brief Object constructor and destructor for slab pools
+ *
+ * The constructor runs once when an object is carved out of a new
+ * slab, the destructor once when the slab is given back to the
+ * system.  In between, objects keep their constructed state (mutexes,
+ * list heads...) across pool_free and pool_alloc, so callers must
+ * return them to that state before freeing them.
+ */
+typedef void (*pool_constructor_t)(void *object);
+typedef void (*pool_destructor_t)(void *object);
+
+/**
+ * @brief Snapshot of the statistics of a slab pool
+ */
+struct pool_stats {
+	const char *name;	/*< Pool name */
+	size_t object_size;	/*< Size of the objects */
+	uint64_t slabs;		/*< Slabs currently allocated */
+	uint64_t objects;	/*< Objects out of the slabs (in use or
+				    cached in magazines) */
+	uint64_t depot_mags;	/*< Full magazines in the depot */
+	uint64_t mag_hits;	/*< Operations served by a thread magazine */
+	uint64_t depot_hits;	/*< Magazine exchanges with the depot */
+	uint64_t slab_ops;	/*< Operations that went to the slab layer */
+};
+
+pool_t *pool_slab_init(const char *name, size_t object_size,
+		       pool_constructor_t ctor, pool_destructor_t dtor);
+void *pool_slab_alloc(pool_t *pool);
+void pool_slab_free(pool_t *pool, void *object);
+void pool_slab_destroy(pool_t *pool);
+void pool_slab_foreach(void (*cb)(struct pool_stats *, void *), void *arg);
+
 /**
  * @brief Create a basic object pool
  *
@@ -310,6 +353,7 @@ pool_basic_init(const char *name, size_t object_size)
 	pool_t *pool = (pool_t *) gsh_malloc(sizeof(pool_t));
 
 	pool->object_size = object_size;
+	pool->slab = NULL;
 
 	if (name)
 		pool->name = gsh_strdup(name);
@@ -331,6 +375,11 @@ pool_basic_init(const char *name, size_t object_size)
 static inline void
 pool_destroy(pool_t *pool)
 {
+	if (pool->slab) {
+		pool_slab_destroy(pool);
+		return;
+	}
+
 	gsh_free(pool->name);
 	gsh_free(pool);
 }
@@ -359,7 +408,11 @@ pool_destroy(pool_t *pool)
  * @return A pointer to the allocated pool item.
  */
 
-#define pool_alloc(pool) gsh_calloc(1, (pool)->object_size)
+#define pool_alloc(pool) ({ \
+		pool_t *pool_ = (pool); \
+		pool_->slab ? pool_slab_alloc(pool_) \
+			    : gsh_calloc(1, pool_->object_size); \
+	})
 
 /**
  * @brief Return an entry to a pool
@@ -380,6 +433,11 @@ pool_destroy(pool_t *pool)
 static inline void
 pool_free(pool_t *pool, void *object)
 {
+	if (pool->slab) {
+		pool_slab_free(pool, object);
+		return;
+	}
+
 	gsh_free(object);
 }
 
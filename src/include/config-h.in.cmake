@@ -46,6 +46,7 @@
 #cmakedefine HAVE_DAEMON 1
 #cmakedefine USE_LTTNG 1
 #cmakedefine ENABLE_VFS_DEBUG_ACL 1
+#cmakedefine USE_IO_URING 1
 #cmakedefine ENABLE_RFC_ACL 1
 #cmakedefine USE_GLUSTER_XREADDIRPLUS 1
 #cmakedefine USE_GLUSTER_UPCALL_REGISTER 1
@@ -69,6 +70,8 @@
 #cmakedefine USE_LLAPI 1
 #cmakedefine USE_GLUSTER_STAT_FETCH_API 1
 #cmakedefine HAVE_URCU_REF_GET_UNLESS_ZERO 1
+#cmakedefine HAVE_COPY_FILE_RANGE 1
+#cmakedefine HAVE_STATX 1
 #define NFS_GANESHA 1
 
 #define GANESHA_CONFIG_PATH "@SYSCONFDIR@/ganesha/ganesha.conf"
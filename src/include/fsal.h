@@ -323,6 +323,11 @@ fsal_status_t fsal_lookup(struct fsal_obj_handle *parent,
 			  const char *name,
 			  struct fsal_obj_handle **obj,
 			  struct attrlist *attrs_out);
+void fsal_lookup_async(struct fsal_obj_handle *parent,
+		       const char *name,
+		       struct attrlist *attrs_out,
+		       fsal_async_cb done_cb,
+		       void *caller_arg);
 fsal_status_t fsal_lookupp(struct fsal_obj_handle *obj,
 			   struct fsal_obj_handle **parent,
 			   struct attrlist *attrs_out);
@@ -319,7 +319,7 @@ struct state_t;
  * rules), increment the minor version
  */
 
-#define FSAL_MINOR_VERSION 0
+#define FSAL_MINOR_VERSION 4
 
 /* Forward references for object methods */
 
@@ -348,10 +348,34 @@ struct fsal_dsh_ops;
 #define SEEK_HOLE 4
 #endif
 
+/**
+ * @brief Maximum number of data/hole segments returned by a READ_PLUS
+ */
+#define IO_INFO_MAX_SEGS 32
+
+/**
+ * @brief One data or hole segment of a sparse read
+ */
+struct io_seg {
+	data_content4 what;	/*< NFS4_CONTENT_DATA or NFS4_CONTENT_HOLE */
+	uint64_t offset;	/*< File offset of the segment */
+	uint64_t length;	/*< Length of the segment */
+};
+
+/**
+ * @brief Information about a READ_PLUS, SEEK or IO_ADVISE
+ *
+ * When io_nsegs is set by read2, the read buffer holds only the data
+ * segments of io_segs, packed in order from the start of the buffer, and
+ * io_amount is the number of data bytes.  An FSAL that leaves io_nsegs at
+ * zero returned plain data, which is reported as a single data segment.
+ */
 struct io_info {
 	contents io_content;
 	uint32_t io_advise;
 	bool_t   io_eof;
+	uint32_t io_nsegs;
+	struct io_seg io_segs[IO_INFO_MAX_SEGS];
 };
 
 struct io_hints {
@@ -2534,14 +2558,204 @@ struct fsal_obj_ops {
 
 /**@{*/
 
+/**
+ * Server side copy
+ */
+
+/**
+ * @brief Copy a range of bytes from one file to another
+ *
+ * Both handles belong to the same FSAL and export.  The FSAL may copy
+ * fewer bytes than requested, the caller is expected to call again for
+ * the remainder.  A copy of zero bytes with no error means the source
+ * range is at or beyond end of file.
+ *
+ * @param[in]  src_hdl    File to copy from
+ * @param[in]  src_state  Open stateid for the source, may be NULL
+ * @param[in]  src_offset Offset in the source file
+ * @param[in]  dst_hdl    File to copy to
+ * @param[in]  dst_state  Open stateid for the destination, may be NULL
+ * @param[in]  dst_offset Offset in the destination file
+ * @param[in]  count      Number of bytes to copy
+ * @param[out] copied     Number of bytes actually copied
+ *
+ * @return FSAL status.
+ */
+	 fsal_status_t (*copy)(struct fsal_obj_handle *src_hdl,
+			       struct state_t *src_state,
+			       uint64_t src_offset,
+			       struct fsal_obj_handle *dst_hdl,
+			       struct state_t *dst_state,
+			       uint64_t dst_offset,
+			       uint64_t count,
+			       uint64_t *copied);
+
+/**
+ * @brief Share a range of blocks between two files
+ *
+ * The destination range is made to reference the same storage as the
+ * source range (reflink).  Unlike copy, this is all or nothing.  A count
+ * of zero means to the end of the source file.
+ *
+ * @param[in] src_hdl    File to clone from
+ * @param[in] src_state  Open stateid for the source, may be NULL
+ * @param[in] src_offset Offset in the source file
+ * @param[in] dst_hdl    File to clone to
+ * @param[in] dst_state  Open stateid for the destination, may be NULL
+ * @param[in] dst_offset Offset in the destination file
+ * @param[in] count      Number of bytes to clone
+ *
+ * @return FSAL status.
+ */
+	 fsal_status_t (*clone)(struct fsal_obj_handle *src_hdl,
+				struct state_t *src_state,
+				uint64_t src_offset,
+				struct fsal_obj_handle *dst_hdl,
+				struct state_t *dst_state,
+				uint64_t dst_offset,
+				uint64_t count);
+/**@}*/
+
+/**@{*/
+
 /**
  * ASYNC API functions.
  *
- * These are asyncronous versions of some of the API functions.  FSALs are
- * expected to implement these, but the upper layers are not expected to call
- * them.  Instead, they will be called by MDCACHE at the appropriate points.
+ * These are asyncronous versions of some of the API functions.  The default
+ * methods call the synchronous version and invoke the callback inline, so an
+ * FSAL only needs to implement them if it can actually complete them later.
+ * The callback may be called before the method returns, or from another
+ * thread with a root op context for the same export.  The caller must keep a
+ * reference on the object until the callback has been called.
+ */
+
+/**
+ * @brief Get attributes asynchronously
+ *
+ * Same semantics as getattrs(), but the result is delivered to @a done_cb
+ * with @a attrs as obj_data.
+ *
+ * @param[in]     obj_hdl    Object to query
+ * @param[in,out] attrs      Attribute list, must stay valid until callback
+ * @param[in]     done_cb    Callback to call when attributes are available
+ * @param[in]     caller_arg Opaque arg from the caller for callback
+ */
+	 void (*getattrs_async)(struct fsal_obj_handle *obj_hdl,
+				struct attrlist *attrs,
+				fsal_async_cb done_cb,
+				void *caller_arg);
+
+/**
+ * @brief Look up a filename asynchronously
+ *
+ * Same semantics as lookup(), but the result is delivered to @a done_cb.
+ * The callback is passed the directory as obj and the new object, with an
+ * INITIAL reference, as obj_data.  obj_data is NULL on error.
+ *
+ * @param[in]     dir_hdl    Directory to search
+ * @param[in]     path       Name to look up, must stay valid until callback
+ * @param[in,out] attrs_out  Optional attributes for the new object
+ * @param[in]     done_cb    Callback to call when the lookup is done
+ * @param[in]     caller_arg Opaque arg from the caller for callback
  */
+	 void (*lookup_async)(struct fsal_obj_handle *dir_hdl,
+			      const char *path,
+			      struct attrlist *attrs_out,
+			      fsal_async_cb done_cb,
+			      void *caller_arg);
+/**@}*/
 
+/**@{*/
+
+/**
+ * Encoded attribute cache.
+ *
+ * A protocol layer may hand the FSAL its wire encoding of an object's
+ * attributes, so a later request for the same attributes can skip both the
+ * getattrs and the encode.  The key is opaque to the FSAL, it only has to
+ * compare equal for encodings that are interchangeable.  An FSAL that caches
+ * attributes must forget the encodings whenever the attributes change.  The
+ * default methods cache nothing.
+ */
+
+/**
+ * @brief Fetch a cached attribute encoding
+ *
+ * On a hit, @a blob->addr is set to a copy of the encoding allocated with
+ * gsh_malloc, the caller must free it.  On a miss, @a gen is set to a
+ * token to pass to put_encoded_attrs() once the attributes have been
+ * fetched and encoded.
+ *
+ * @param[in]  obj_hdl  Object whose attributes are wanted
+ * @param[in]  key      Protocol key for the encoding
+ * @param[in]  mask     Attributes the encoding depends on
+ * @param[out] blob     The cached encoding
+ * @param[out] gen      Attribute generation on a miss
+ *
+ * @return true if @a blob was filled in.
+ */
+	 bool (*get_encoded_attrs)(struct fsal_obj_handle *obj_hdl,
+				   const struct gsh_buffdesc *key,
+				   attrmask_t mask,
+				   struct gsh_buffdesc *blob,
+				   uint64_t *gen);
+
+/**
+ * @brief Remember an attribute encoding
+ *
+ * The encoding is dropped if the attributes changed since @a gen was
+ * returned by get_encoded_attrs().
+ *
+ * @param[in] obj_hdl  Object the attributes were fetched from
+ * @param[in] key      Protocol key for the encoding
+ * @param[in] gen      Generation returned by get_encoded_attrs()
+ * @param[in] blob     The encoding, copied by the FSAL
+ */
+	 void (*put_encoded_attrs)(struct fsal_obj_handle *obj_hdl,
+				   const struct gsh_buffdesc *key,
+				   uint64_t gen,
+				   const struct gsh_buffdesc *blob);
+/**@}*/
+
+/**@{*/
+
+/**
+ * Multi-component path cache.
+ *
+ * A protocol layer resolving several names in a row may ask the FSAL to
+ * remember where the whole path leads, and later resolve it in one step.
+ * A path is only returned while no directory it crosses has changed, and
+ * only if looking it up name by name could not have failed an access
+ * check past the first directory; the caller checks that one itself.
+ * The epoch is the caller's own generation, a path cached under another
+ * epoch is never returned.  The default methods cache nothing.
+ */
+
+/**
+ * @brief Resolve a cached path
+ *
+ * @param[in]  parent  Directory the path starts from
+ * @param[in]  path    Names separated by '/'
+ * @param[in]  epoch   Caller's namespace generation
+ * @param[out] handle  Object found, with a reference
+ *
+ * @return true if @a handle was filled in.
+ */
+	 bool (*lookup_cached_path)(struct fsal_obj_handle *parent,
+				    const char *path,
+				    uint64_t epoch,
+				    struct fsal_obj_handle **handle);
+
+/**
+ * @brief Remember a path just resolved name by name
+ *
+ * @param[in] parent  Directory the path starts from
+ * @param[in] path    Names separated by '/'
+ * @param[in] epoch   Caller's namespace generation
+ */
+	 void (*cache_path)(struct fsal_obj_handle *parent,
+			    const char *path,
+			    uint64_t epoch);
 /**@}*/
 };
 
@@ -322,10 +322,15 @@ fsal_status_t up_async_delegrecall(struct fridgethr *fr,
 
 /** @} */
 int async_delegrecall(struct fridgethr *fr, struct fsal_obj_handle *obj);
+int async_delegrecall_one(struct fridgethr *fr, struct fsal_obj_handle *obj,
+			  struct state_t *state);
 
 int async_cbgetattr(struct fridgethr *fr, struct fsal_obj_handle *obj,
 		    nfs_client_id_t *client);
 
+int async_dir_notify(struct fridgethr *fr, struct fsal_obj_handle *dir,
+		     notify_type4 type, const char *name, const char *new_name);
+
 void up_ready_init(struct fsal_up_vector *up_ops);
 void up_ready_set(struct fsal_up_vector *up_ops);
 void up_ready_wait(struct fsal_up_vector *up_ops);
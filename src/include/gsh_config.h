@@ -495,6 +495,16 @@ typedef struct nfs_version4_parameter {
 	unsigned int minor_versions;
 	/** Number of allowed slots in the 4.1 slot table */
 	uint32_t nb_slots;
+	/** Most slots a busy 4.1 session may grow to.  Defaults to
+	    NFS41_MAX_SLOTS_DEF and settable with max_slot_table_size */
+	uint32_t max_slots;
+	/** Fewest slots an idle 4.1 session is shrunk to.  Defaults to
+	    NFS41_MIN_SLOTS_DEF and settable with min_slot_table_size */
+	uint32_t min_slots;
+	/** Total slots offered across all 4.1 sessions, growth stops
+	    beyond that.  Defaults to NFS41_SLOTS_BUDGET_DEF and settable
+	    with slot_table_budget */
+	uint32_t slots_budget;
 } nfs_version4_parameter_t;
 
 /** @} */
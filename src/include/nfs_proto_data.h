@@ -357,6 +357,15 @@ struct compound_data {
 				   (if applicable) */
 	uint32_t resp_size;	/*< Running total response size. */
 	uint32_t op_resp_size;	/*< Current op's response size. */
+	uint32_t lookup_skip;	/*< LOOKUPs already resolved by the path
+				    cache */
+	uint32_t lookup_left;	/*< LOOKUPs left in a run being resolved
+				    name by name */
+	struct fsal_obj_handle *lookup_start;	/*< Directory the run
+						    started from */
+	char *lookup_path;	/*< Names of the run, '/' separated */
+	uint16_t lookup_export_id;	/*< Export the run started in */
+	uint64_t lookup_epoch;	/*< Junction generation at start of run */
 };
 
 #define VARIABLE_RESP_SIZE (0)
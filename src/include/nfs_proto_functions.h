@@ -170,6 +170,14 @@ enum nfs_req_result nfs4_op_read_resume(struct nfs_argop4 *op,
 					compound_data_t *data,
 					struct nfs_resop4 *resp);
 
+enum nfs_req_result nfs4_op_getattr_resume(struct nfs_argop4 *op,
+					   compound_data_t *data,
+					   struct nfs_resop4 *resp);
+
+enum nfs_req_result nfs4_op_lookup_resume(struct nfs_argop4 *op,
+					  compound_data_t *data,
+					  struct nfs_resop4 *resp);
+
 enum nfs_req_result nfs4_op_write_resume(struct nfs_argop4 *op,
 					 compound_data_t *data,
 					 struct nfs_resop4 *resp);
@@ -317,6 +325,10 @@ enum nfs_req_result nfs4_op_getdevicelist(struct nfs_argop4 *,
 enum nfs_req_result nfs4_op_free_stateid(struct nfs_argop4 *, compound_data_t *,
 					 struct nfs_resop4 *);
 
+enum nfs_req_result nfs4_op_get_dir_delegation(struct nfs_argop4 *,
+					       compound_data_t *,
+					       struct nfs_resop4 *);
+
 enum nfs_req_result nfs4_op_getdeviceinfo(struct nfs_argop4 *,
 					  compound_data_t *,
 					  struct nfs_resop4 *);
@@ -396,6 +408,28 @@ enum nfs_req_result nfs4_op_layoutstats(struct nfs_argop4 *, compound_data_t *,
 
 void nfs4_op_layoutstats_Free(nfs_resop4 *resp);
 
+enum nfs_req_result nfs4_op_copy(struct nfs_argop4 *, compound_data_t *,
+				 struct nfs_resop4 *);
+
+void nfs4_op_copy_Free(nfs_resop4 *resp);
+
+enum nfs_req_result nfs4_op_offload_status(struct nfs_argop4 *,
+					   compound_data_t *,
+					   struct nfs_resop4 *);
+
+void nfs4_op_offload_status_Free(nfs_resop4 *resp);
+
+enum nfs_req_result nfs4_op_offload_cancel(struct nfs_argop4 *,
+					   compound_data_t *,
+					   struct nfs_resop4 *);
+
+void nfs4_op_offload_cancel_Free(nfs_resop4 *resp);
+
+enum nfs_req_result nfs4_op_clone(struct nfs_argop4 *, compound_data_t *,
+				  struct nfs_resop4 *);
+
+void nfs4_op_clone_Free(nfs_resop4 *resp);
+
 /* NFSv4.3 */
 enum nfs_req_result nfs4_op_getxattr(struct nfs_argop4 *, compound_data_t *,
 				     struct nfs_resop4 *);
@@ -536,6 +570,7 @@ void nfs4_op_create_session_Free(nfs_resop4 *);
 void nfs4_op_getdevicelist_Free(nfs_resop4 *);
 void nfs4_op_getdeviceinfo_Free(nfs_resop4 *);
 void nfs4_op_free_stateid_Free(nfs_resop4 *);
+void nfs4_op_get_dir_delegation_Free(nfs_resop4 *);
 void nfs4_op_destroy_session_Free(nfs_resop4 *);
 void nfs4_op_lock_Free(nfs_resop4 *);
 void nfs4_op_lockt_Free(nfs_resop4 *);
@@ -549,9 +584,11 @@ void nfs4_op_destroy_clientid_Free(nfs_resop4 *);
 void nfs4_op_reclaim_complete_Free(nfs_resop4 *);
 
 void compound_data_Free(compound_data_t *);
+void nfs4_lookup_run_release(compound_data_t *data);
 bool xdr_COMPOUND4res_extended(XDR *xdrs, struct COMPOUND4res_extended **objp);
 
 /* Pseudo FS functions */
+extern uint64_t pseudofs_junction_gen;
 bool pseudo_mount_export(struct gsh_export *exp);
 void create_pseudofs(void);
 void pseudo_unmount_export(struct gsh_export *exp);
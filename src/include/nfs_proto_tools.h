@@ -262,17 +262,48 @@ typedef enum {
 	UTF8_SCAN_SYMLINK = 12	/* a symlink, allow '/', ".", "..", utf8 */
 } utf8_scantype_t;
 
+nfsstat4 nfs4_path_filter(const char *name, size_t len, utf8_scantype_t scan);
+nfsstat4 nfs4_path_filter_scalar(const char *name, size_t len,
+				 utf8_scantype_t scan);
+#if defined(__x86_64__) && defined(__GNUC__)
+nfsstat4 nfs4_path_filter_sse4(const char *name, size_t len,
+			       utf8_scantype_t scan);
+nfsstat4 nfs4_path_filter_avx2(const char *name, size_t len,
+			       utf8_scantype_t scan);
+#endif
+
 nfsstat4 nfs4_utf8string2dynamic(const utf8string *input, utf8_scantype_t scan,
 				 char **obj_name);
 
 int bitmap4_to_attrmask_t(bitmap4 *bitmap4, attrmask_t *mask);
 
+nfsstat4 file_To_Fattr_access(compound_data_t *data, struct bitmap4 *Bitmap);
+
+nfsstat4 file_attrs_To_Fattr(compound_data_t *data,
+			     attrmask_t request_mask,
+			     struct attrlist *attr,
+			     fattr4 *Fattr,
+			     struct bitmap4 *Bitmap);
+
 nfsstat4 file_To_Fattr(compound_data_t *data,
 		       attrmask_t mask,
 		       struct attrlist *attr,
 		       fattr4 *Fattr,
 		       struct bitmap4 *Bitmap);
 
+bool nfs4_Fattr_cache_get(compound_data_t *data,
+			  struct fsal_obj_handle *obj,
+			  struct bitmap4 *Bitmap,
+			  attrmask_t mask,
+			  fattr4 *Fattr,
+			  uint64_t *gen);
+
+void nfs4_Fattr_cache_put(compound_data_t *data,
+			  struct fsal_obj_handle *obj,
+			  struct bitmap4 *Bitmap,
+			  uint64_t gen,
+			  fattr4 *Fattr);
+
 bool nfs4_Fattr_Check_Access(fattr4 *, int);
 bool nfs4_Fattr_Check_Access_Bitmap(struct bitmap4 *, int);
 bool nfs4_Fattr_Supported(fattr4 *);
@@ -2612,10 +2612,13 @@ typedef struct {
 	};
 } contents;
 
+/* rpr_contents_count and rpr_contents overlay data_len and data_val of
+ * READ4resok, see nfs4_op_read.c.
+ */
 typedef struct {
 	bool_t            rpr_eof;
 	count4            rpr_contents_count;
-	contents          rpr_contents;
+	contents         *rpr_contents;
 } read_plus_res4;
 
 typedef struct {
@@ -2624,9 +2627,11 @@ typedef struct {
 } seek_res4;
 
 typedef struct OFFLOAD_STATUS4resok {
-	length4         osr_bytes_copied;
-	count4          osr_count_complete;
-	nfsstat4        osr_complete;
+	length4         osr_count;
+	struct {
+		u_int osr_complete_len;
+		nfsstat4 osr_complete_val;
+	} osr_complete;
 } OFFLOAD_STATUS4resok;
 
 struct COPY_NOTIFY4args {
@@ -2666,39 +2671,59 @@ struct OFFLOAD_REVOKE4res {
 };
 typedef struct OFFLOAD_REVOKE4res OFFLOAD_REVOKE4res;
 
+struct netloc4 {
+	netloc_type4        nl_type;
+	union {
+		utf8str_cis nl_name;
+		utf8str_cis nl_url;
+		netaddr4    nl_addr;
+	};
+};
+typedef struct netloc4 netloc4;
+
 struct COPY4args {
 	stateid4        ca_src_stateid;
 	stateid4        ca_dst_stateid;
 	offset4         ca_src_offset;
 	offset4         ca_dst_offset;
 	length4         ca_count;
-	netloc_type4        ca_type;
-	union {
-		utf8str_cis ca_name;
-		utf8str_cis ca_url;
-		netaddr4    ca_addr;
-	};
+	bool_t          ca_consecutive;
+	bool_t          ca_synchronous;
+	struct {
+		u_int ca_source_server_len;
+		netloc4 *ca_source_server_val;
+	} ca_source_server;
 };
 typedef struct COPY4args COPY4args;
 
+typedef struct {
+	bool_t          cr_consecutive;
+	bool_t          cr_synchronous;
+} copy_requirements4;
+
+typedef struct {
+	write_response4    cr_response;
+	copy_requirements4 cr_requirements;
+} COPY4resok;
+
 struct COPY4res {
 	nfsstat4 cr_status;
 	union {
-		write_response4 cr_resok4;
-		length4         cr_bytes_copied;
+		COPY4resok         cr_resok4;
+		copy_requirements4 cr_requirements;
 	} COPY4res_u;
 };
 typedef struct COPY4res COPY4res;
 
-struct OFFLOAD_ABORT4args {
-	stateid4        oaa_stateid;
+struct OFFLOAD_CANCEL4args {
+	stateid4        oca_stateid;
 };
-typedef struct OFFLOAD_ABORT4args OFFLOAD_ABORT4args;
+typedef struct OFFLOAD_CANCEL4args OFFLOAD_CANCEL4args;
 
-struct OFFLOAD_ABORT4res {
-	stateid4        oar_stateid;
+struct OFFLOAD_CANCEL4res {
+	nfsstat4        ocr_status;
 };
-typedef struct OFFLOAD_ABORT4res OFFLOAD_ABORT4res;
+typedef struct OFFLOAD_CANCEL4res OFFLOAD_CANCEL4res;
 
 struct OFFLOAD_STATUS4args {
 	stateid4        osa_stateid;
@@ -2713,6 +2738,20 @@ struct OFFLOAD_STATUS4res {
 };
 typedef struct OFFLOAD_STATUS4res OFFLOAD_STATUS4res;
 
+struct CLONE4args {
+	stateid4        cl_src_stateid;
+	stateid4        cl_dst_stateid;
+	offset4         cl_src_offset;
+	offset4         cl_dst_offset;
+	length4         cl_count;
+};
+typedef struct CLONE4args CLONE4args;
+
+struct CLONE4res {
+	nfsstat4        cl_status;
+};
+typedef struct CLONE4res CLONE4res;
+
 struct WRITE_SAME4args {
 	stateid4        wp_stateid;
 	stable_how4     wp_stable;
@@ -3232,8 +3271,9 @@ struct nfs_argop4 {
 		COPY_NOTIFY4args opoffload_notify;
 		OFFLOAD_REVOKE4args opcopy_revoke;
 		COPY4args opcopy;
-		OFFLOAD_ABORT4args opoffload_abort;
+		OFFLOAD_CANCEL4args opoffload_cancel;
 		OFFLOAD_STATUS4args opoffload_status;
+		CLONE4args opclone;
 		WRITE_SAME4args opwrite_same;
 		ALLOCATE4args opallocate;
 		DEALLOCATE4args opdeallocate;
@@ -3317,8 +3357,9 @@ struct nfs_resop4 {
 		COPY_NOTIFY4res opoffload_notify;
 		OFFLOAD_REVOKE4res opcopy_revoke;
 		COPY4res opcopy;
-		OFFLOAD_ABORT4res opoffload_abort;
+		OFFLOAD_CANCEL4res opoffload_cancel;
 		OFFLOAD_STATUS4res opoffload_status;
+		CLONE4res opclone;
 		WRITE_SAME4res opwrite_same;
 		ALLOCATE4res opallocate;
 		DEALLOCATE4res opdeallocate;
@@ -3673,6 +3714,29 @@ struct CB_NOTIFY_DEVICEID4res {
 };
 typedef struct CB_NOTIFY_DEVICEID4res CB_NOTIFY_DEVICEID4res;
 
+/* NFSv4.2 */
+
+struct offload_info4 {
+	nfsstat4 coa_status;
+	union {
+		write_response4 coa_resok4;
+		length4 coa_bytes_copied;
+	};
+};
+typedef struct offload_info4 offload_info4;
+
+struct CB_OFFLOAD4args {
+	nfs_fh4 coa_fh;
+	stateid4 coa_stateid;
+	offload_info4 coa_offload_info;
+};
+typedef struct CB_OFFLOAD4args CB_OFFLOAD4args;
+
+struct CB_OFFLOAD4res {
+	nfsstat4 cor_status;
+};
+typedef struct CB_OFFLOAD4res CB_OFFLOAD4res;
+
 /* Callback operations new to NFSv4.1 */
 
 enum nfs_cb_opnum4 {
@@ -3688,6 +3752,7 @@ enum nfs_cb_opnum4 {
 	NFS4_OP_CB_WANTS_CANCELLED = 12,
 	NFS4_OP_CB_NOTIFY_LOCK = 13,
 	NFS4_OP_CB_NOTIFY_DEVICEID = 14,
+	NFS4_OP_CB_OFFLOAD = 15,
 	NFS4_OP_CB_ILLEGAL = 10044,
 };
 typedef enum nfs_cb_opnum4 nfs_cb_opnum4;
@@ -3707,6 +3772,7 @@ struct nfs_cb_argop4 {
 		CB_WANTS_CANCELLED4args opcbwants_cancelled;
 		CB_NOTIFY_LOCK4args opcbnotify_lock;
 		CB_NOTIFY_DEVICEID4args opcbnotify_deviceid;
+		CB_OFFLOAD4args opcboffload;
 	} nfs_cb_argop4_u;
 };
 typedef struct nfs_cb_argop4 nfs_cb_argop4;
@@ -3726,6 +3792,7 @@ struct nfs_cb_resop4 {
 		CB_WANTS_CANCELLED4res opcbwants_cancelled;
 		CB_NOTIFY_LOCK4res opcbnotify_lock;
 		CB_NOTIFY_DEVICEID4res opcbnotify_deviceid;
+		CB_OFFLOAD4res opcboffload;
 		CB_ILLEGAL4res opcbillegal;
 	} nfs_cb_resop4_u;
 };
@@ -3775,6 +3842,98 @@ extern CB_COMPOUND4res *cb_compound_1_svc(CB_COMPOUND4args *,
 
 /* the xdr functions */
 
+/*
+ * The routines used by the hot operations (SEQUENCE, PUTFH, GETATTR,
+ * READ, WRITE, LOOKUP, ACCESS and GETFH) move their fixed size parts in
+ * one go when the XDR buffer is contiguous, and fall back to the field
+ * by field path when it is not (e.g. across a buffer boundary).
+ * Defining NFS4_XDR_NO_INLINE forces the fallback so the two can be
+ * compared, see test/test_xdr_nfs4.c.
+ */
+#ifdef NFS4_XDR_NO_INLINE
+#define nfs4_inline_decode(xdrs, len) ((int32_t *)NULL)
+#define nfs4_inline_encode(xdrs, len) ((int32_t *)NULL)
+#else
+#define nfs4_inline_decode(xdrs, len) \
+	((int32_t *)xdr_inline_decode(xdrs, len))
+#define nfs4_inline_encode(xdrs, len) \
+	((int32_t *)xdr_inline_encode(xdrs, len))
+#endif
+
+static inline uint64_t nfs4_ixdr_get_u_int64(int32_t **buf)
+{
+	uint64_t hi = IXDR_GET_U_INT32(*buf);
+
+	return (hi << 32) | IXDR_GET_U_INT32(*buf);
+}
+
+static inline int32_t *nfs4_ixdr_put_u_int64(int32_t *buf, uint64_t val)
+{
+	IXDR_PUT_U_INT32(buf, val >> 32);
+	IXDR_PUT_U_INT32(buf, val);
+	return buf;
+}
+
+/**
+ * @brief Counted opaque data, copied in one go when contiguous
+ *
+ * Same contract as inline_xdr_bytes: decoded data goes to the caller's
+ * buffer if there is one and is allocated otherwise, so XDR_FREE works
+ * unchanged. Nothing ever points into the XDR buffer.
+ */
+static inline bool nfs4_xdr_bytes(XDR *xdrs, char **cpp, u_int *sizep,
+				  u_int maxsize)
+{
+	int32_t *buf;
+	char *sp;
+	u_int size;
+
+	switch (xdrs->x_op) {
+	case XDR_DECODE:
+		buf = nfs4_inline_decode(xdrs, BYTES_PER_XDR_UNIT);
+		if (buf == NULL)
+			break;
+		size = IXDR_GET_U_INT32(buf);
+		if (size > maxsize)
+			return false;
+		*sizep = size;
+		if (size == 0)
+			return true;
+		sp = *cpp != NULL ? *cpp : (char *)mem_alloc(size);
+		buf = nfs4_inline_decode(xdrs, RNDUP(size));
+		if (buf != NULL) {
+			memcpy(sp, buf, size);
+		} else if (!xdr_opaque(xdrs, sp, size)) {
+			if (*cpp == NULL)
+				mem_free(sp, size);
+			return false;
+		}
+		*cpp = sp;
+		return true;
+
+	case XDR_ENCODE:
+		size = *sizep;
+		if (size > maxsize)
+			return false;
+		buf = nfs4_inline_encode(xdrs,
+					 BYTES_PER_XDR_UNIT + RNDUP(size));
+		if (buf == NULL)
+			break;
+		IXDR_PUT_U_INT32(buf, size);
+		if (size == 0)
+			return true;
+		/* clear the padding before the data lands on it */
+		buf[RNDUP(size) / BYTES_PER_XDR_UNIT - 1] = 0;
+		memcpy(buf, *cpp, size);
+		return true;
+
+	default:
+		break;
+	}
+
+	return inline_xdr_bytes(xdrs, cpp, sizep, maxsize);
+}
+
 static inline bool xdr_nfs_ftype4(XDR *xdrs, nfs_ftype4 *objp)
 {
 	if (!inline_xdr_enum(xdrs, (enum_t *) objp))
@@ -3792,7 +3951,7 @@ static inline bool xdr_nfsstat4(XDR *xdrs, nfsstat4 *objp)
 
 static inline bool xdr_attrlist4(XDR *xdrs, attrlist4 *objp)
 {
-	if (!inline_xdr_bytes(xdrs,
+	if (!nfs4_xdr_bytes(xdrs,
 	    (char **)&objp->attrlist4_val,
 	    &objp->attrlist4_len, XDR_BYTES_MAXLEN))
 		return false;
@@ -3803,6 +3962,7 @@ static inline bool xdr_bitmap4(XDR *xdrs, struct bitmap4 *objp)
 {
 	u_int32_t *map = objp->map;
 	u_int i, mapsize;
+	int32_t *buf;
 
 /* short circuit the free pass (done at the end) because we don't
  * allocate an array in the "conventional" sense here.  There is
@@ -3810,6 +3970,18 @@ static inline bool xdr_bitmap4(XDR *xdrs, struct bitmap4 *objp)
  */
 	if (xdrs->x_op == XDR_FREE)
 		return true;
+
+	if (xdrs->x_op == XDR_ENCODE && objp->bitmap4_len <= BITMAP4_MAPLEN) {
+		buf = nfs4_inline_encode(xdrs, (1 + objp->bitmap4_len) *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			/* most likely */
+			IXDR_PUT_U_INT32(buf, objp->bitmap4_len);
+			for (i = 0; i < objp->bitmap4_len; i++)
+				IXDR_PUT_U_INT32(buf, map[i]);
+			return true;
+		}
+	}
 /* for the same reason, calling xdr_array doesn't work for us (we need
  * to accept bitmaps bigger than BITMAP4_MAPLEN, but throw the rest away
  * so manually do the looping and skip the end
@@ -3817,6 +3989,16 @@ static inline bool xdr_bitmap4(XDR *xdrs, struct bitmap4 *objp)
 	if (!inline_xdr_u_int(xdrs, &objp->bitmap4_len))
 		return false;
 	mapsize = MIN(objp->bitmap4_len, BITMAP4_MAPLEN);
+	if (xdrs->x_op == XDR_DECODE && mapsize > 0 &&
+	    mapsize == objp->bitmap4_len) {
+		buf = nfs4_inline_decode(xdrs, mapsize * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			/* most likely */
+			for (i = 0; i < mapsize; i++)
+				map[i] = IXDR_GET_U_INT32(buf);
+			return true;
+		}
+	}
 	for (i = 0; i < mapsize; i++)
 		if (!inline_xdr_u_int32_t(xdrs, &map[i]))
 			return false;
@@ -3875,7 +4057,7 @@ static inline bool xdr_nfs_cookie4(XDR *xdrs, nfs_cookie4 *objp)
 
 static inline bool xdr_nfs_fh4(XDR *xdrs, nfs_fh4 *objp)
 {
-	if (!inline_xdr_bytes(xdrs,
+	if (!nfs4_xdr_bytes(xdrs,
 	    (char **) &objp->nfs_fh4_val,
 	    &objp->nfs_fh4_len, NFS4_FHSIZE))
 		return false;
@@ -3935,7 +4117,7 @@ static inline bool xdr_slotid4(XDR *xdrs, slotid4 *objp)
 
 static inline bool xdr_utf8string(XDR *xdrs, utf8string *objp)
 {
-	if (!inline_xdr_bytes(xdrs,
+	if (!nfs4_xdr_bytes(xdrs,
 	    &objp->utf8string_val,
 	    &objp->utf8string_len, XDR_STRING_MAXLEN)) {
 		return false;
@@ -4179,8 +4361,43 @@ static inline bool xdr_nfs_impl_id4(XDR *xdrs, nfs_impl_id4 *objp)
 	return true;
 }
 
+/* A stateid is 4 XDR units: the seqid and 12 opaque bytes */
+#define NFS4_STATEID_XDR_UNITS 4
+
+static inline int32_t *nfs4_ixdr_get_stateid4(int32_t *buf, stateid4 *objp)
+{
+	objp->seqid = IXDR_GET_U_INT32(buf);
+	memcpy(objp->other, buf, sizeof(objp->other));
+	return buf + 3;
+}
+
+static inline int32_t *nfs4_ixdr_put_stateid4(int32_t *buf, stateid4 *objp)
+{
+	IXDR_PUT_U_INT32(buf, objp->seqid);
+	memcpy(buf, objp->other, sizeof(objp->other));
+	return buf + 3;
+}
+
 static inline bool xdr_stateid4(XDR *xdrs, stateid4 *objp)
 {
+	int32_t *buf;
+
+	if (xdrs->x_op == XDR_DECODE) {
+		buf = nfs4_inline_decode(xdrs, NFS4_STATEID_XDR_UNITS *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			nfs4_ixdr_get_stateid4(buf, objp);
+			return true;
+		}
+	} else if (xdrs->x_op == XDR_ENCODE) {
+		buf = nfs4_inline_encode(xdrs, NFS4_STATEID_XDR_UNITS *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			nfs4_ixdr_put_stateid4(buf, objp);
+			return true;
+		}
+	}
+
 	if (!inline_xdr_u_int32_t(xdrs, &objp->seqid))
 		return false;
 	if (!xdr_opaque(xdrs, objp->other, 12))
@@ -5362,6 +5579,24 @@ static inline bool xdr_ACCESS4args(XDR *xdrs, ACCESS4args *objp)
 
 static inline bool xdr_ACCESS4resok(XDR *xdrs, ACCESS4resok *objp)
 {
+	int32_t *buf;
+
+	if (xdrs->x_op == XDR_ENCODE) {
+		buf = nfs4_inline_encode(xdrs, 2 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			IXDR_PUT_U_INT32(buf, objp->supported);
+			IXDR_PUT_U_INT32(buf, objp->access);
+			return true;
+		}
+	} else if (xdrs->x_op == XDR_DECODE) {
+		buf = nfs4_inline_decode(xdrs, 2 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			objp->supported = IXDR_GET_U_INT32(buf);
+			objp->access = IXDR_GET_U_INT32(buf);
+			return true;
+		}
+	}
+
 	if (!inline_xdr_u_int32_t(xdrs, &objp->supported))
 		return false;
 	if (!inline_xdr_u_int32_t(xdrs, &objp->access))
@@ -6327,6 +6562,30 @@ static inline bool xdr_PUTROOTFH4res(XDR *xdrs, PUTROOTFH4res *objp)
 
 static inline bool xdr_READ4args(XDR *xdrs, READ4args *objp)
 {
+	int32_t *buf;
+
+	/* stateid, offset and count */
+	if (xdrs->x_op == XDR_DECODE) {
+		buf = nfs4_inline_decode(xdrs, (NFS4_STATEID_XDR_UNITS + 3) *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			/* most likely */
+			buf = nfs4_ixdr_get_stateid4(buf, &objp->stateid);
+			objp->offset = nfs4_ixdr_get_u_int64(&buf);
+			objp->count = IXDR_GET_U_INT32(buf);
+			return true;
+		}
+	} else if (xdrs->x_op == XDR_ENCODE) {
+		buf = nfs4_inline_encode(xdrs, (NFS4_STATEID_XDR_UNITS + 3) *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			buf = nfs4_ixdr_put_stateid4(buf, &objp->stateid);
+			buf = nfs4_ixdr_put_u_int64(buf, objp->offset);
+			IXDR_PUT_U_INT32(buf, objp->count);
+			return true;
+		}
+	}
+
 	if (!xdr_stateid4(xdrs, &objp->stateid))
 		return false;
 	if (!xdr_offset4(xdrs, &objp->offset))
@@ -6711,12 +6970,36 @@ static inline bool xdr_stable_how4(XDR *xdrs, stable_how4 *objp)
 
 static inline bool xdr_WRITE4args(XDR *xdrs, WRITE4args *objp)
 {
-	if (!xdr_stateid4(xdrs, &objp->stateid))
-		return false;
-	if (!xdr_offset4(xdrs, &objp->offset))
-		return false;
-	if (!xdr_stable_how4(xdrs, &objp->stable))
-		return false;
+	int32_t *buf = NULL;
+
+	/* stateid, offset and stable, the data follows */
+	if (xdrs->x_op == XDR_DECODE) {
+		buf = nfs4_inline_decode(xdrs, (NFS4_STATEID_XDR_UNITS + 3) *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			/* most likely */
+			buf = nfs4_ixdr_get_stateid4(buf, &objp->stateid);
+			objp->offset = nfs4_ixdr_get_u_int64(&buf);
+			objp->stable = (stable_how4)IXDR_GET_INT32(buf);
+		}
+	} else if (xdrs->x_op == XDR_ENCODE) {
+		buf = nfs4_inline_encode(xdrs, (NFS4_STATEID_XDR_UNITS + 3) *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			buf = nfs4_ixdr_put_stateid4(buf, &objp->stateid);
+			buf = nfs4_ixdr_put_u_int64(buf, objp->offset);
+			IXDR_PUT_INT32(buf, objp->stable);
+		}
+	}
+
+	if (buf == NULL) {
+		if (!xdr_stateid4(xdrs, &objp->stateid))
+			return false;
+		if (!xdr_offset4(xdrs, &objp->offset))
+			return false;
+		if (!xdr_stable_how4(xdrs, &objp->stable))
+			return false;
+	}
 	if (!inline_xdr_bytes(xdrs,
 	    (char **)&objp->data.data_val,
 	    &objp->data.data_len, XDR_BYTES_MAXLEN_IO))
@@ -6726,6 +7009,28 @@ static inline bool xdr_WRITE4args(XDR *xdrs, WRITE4args *objp)
 
 static inline bool xdr_WRITE4resok(XDR *xdrs, WRITE4resok *objp)
 {
+	int32_t *buf;
+
+	/* count, committed and the verifier */
+	if (xdrs->x_op == XDR_ENCODE) {
+		buf = nfs4_inline_encode(xdrs, 4 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			/* most likely */
+			IXDR_PUT_U_INT32(buf, objp->count);
+			IXDR_PUT_INT32(buf, objp->committed);
+			memcpy(buf, objp->writeverf, NFS4_VERIFIER_SIZE);
+			return true;
+		}
+	} else if (xdrs->x_op == XDR_DECODE) {
+		buf = nfs4_inline_decode(xdrs, 4 * BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			objp->count = IXDR_GET_U_INT32(buf);
+			objp->committed = (stable_how4)IXDR_GET_INT32(buf);
+			memcpy(objp->writeverf, buf, NFS4_VERIFIER_SIZE);
+			return true;
+		}
+	}
+
 	if (!xdr_count4(xdrs, &objp->count))
 		return false;
 	if (!xdr_stable_how4(xdrs, &objp->committed))
@@ -7566,8 +7871,41 @@ static inline bool xdr_SECINFO_NO_NAME4res(XDR *xdrs,
 	return true;
 }
 
+/* A sessionid is 4 XDR units */
+#define NFS4_SESSIONID_XDR_UNITS (NFS4_SESSIONID_SIZE / BYTES_PER_XDR_UNIT)
+
 static inline bool xdr_SEQUENCE4args(XDR *xdrs, SEQUENCE4args *objp)
 {
+	int32_t *buf;
+
+	if (xdrs->x_op == XDR_DECODE) {
+		buf = nfs4_inline_decode(xdrs, (NFS4_SESSIONID_XDR_UNITS + 4) *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			/* most likely */
+			memcpy(objp->sa_sessionid, buf, NFS4_SESSIONID_SIZE);
+			buf += NFS4_SESSIONID_XDR_UNITS;
+			objp->sa_sequenceid = IXDR_GET_U_INT32(buf);
+			objp->sa_slotid = IXDR_GET_U_INT32(buf);
+			objp->sa_highest_slotid = IXDR_GET_U_INT32(buf);
+			/* as xdr_bool, anything but 0 is true */
+			objp->sa_cachethis = IXDR_GET_U_INT32(buf) != 0;
+			return true;
+		}
+	} else if (xdrs->x_op == XDR_ENCODE) {
+		buf = nfs4_inline_encode(xdrs, (NFS4_SESSIONID_XDR_UNITS + 4) *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			memcpy(buf, objp->sa_sessionid, NFS4_SESSIONID_SIZE);
+			buf += NFS4_SESSIONID_XDR_UNITS;
+			IXDR_PUT_U_INT32(buf, objp->sa_sequenceid);
+			IXDR_PUT_U_INT32(buf, objp->sa_slotid);
+			IXDR_PUT_U_INT32(buf, objp->sa_highest_slotid);
+			IXDR_PUT_BOOL(buf, objp->sa_cachethis);
+			return true;
+		}
+	}
+
 	if (!xdr_sessionid4(xdrs, objp->sa_sessionid))
 		return false;
 	if (!xdr_sequenceid4(xdrs, &objp->sa_sequenceid))
@@ -7583,6 +7921,37 @@ static inline bool xdr_SEQUENCE4args(XDR *xdrs, SEQUENCE4args *objp)
 
 static inline bool xdr_SEQUENCE4resok(XDR *xdrs, SEQUENCE4resok *objp)
 {
+	int32_t *buf;
+
+	if (xdrs->x_op == XDR_ENCODE) {
+		buf = nfs4_inline_encode(xdrs, (NFS4_SESSIONID_XDR_UNITS + 5) *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			/* most likely */
+			memcpy(buf, objp->sr_sessionid, NFS4_SESSIONID_SIZE);
+			buf += NFS4_SESSIONID_XDR_UNITS;
+			IXDR_PUT_U_INT32(buf, objp->sr_sequenceid);
+			IXDR_PUT_U_INT32(buf, objp->sr_slotid);
+			IXDR_PUT_U_INT32(buf, objp->sr_highest_slotid);
+			IXDR_PUT_U_INT32(buf, objp->sr_target_highest_slotid);
+			IXDR_PUT_U_INT32(buf, objp->sr_status_flags);
+			return true;
+		}
+	} else if (xdrs->x_op == XDR_DECODE) {
+		buf = nfs4_inline_decode(xdrs, (NFS4_SESSIONID_XDR_UNITS + 5) *
+						BYTES_PER_XDR_UNIT);
+		if (buf != NULL) {
+			memcpy(objp->sr_sessionid, buf, NFS4_SESSIONID_SIZE);
+			buf += NFS4_SESSIONID_XDR_UNITS;
+			objp->sr_sequenceid = IXDR_GET_U_INT32(buf);
+			objp->sr_slotid = IXDR_GET_U_INT32(buf);
+			objp->sr_highest_slotid = IXDR_GET_U_INT32(buf);
+			objp->sr_target_highest_slotid = IXDR_GET_U_INT32(buf);
+			objp->sr_status_flags = IXDR_GET_U_INT32(buf);
+			return true;
+		}
+	}
+
 	if (!xdr_sessionid4(xdrs, objp->sr_sessionid))
 		return false;
 	if (!xdr_sequenceid4(xdrs, &objp->sr_sequenceid))
@@ -7843,36 +8212,42 @@ static inline bool xdr_READ_PLUS4args(XDR *xdrs, READ_PLUS4args *objp)
 	return true;
 }
 
-static inline bool xdr_READ_PLUS4resok(XDR *xdrs, read_plus_res4 *objp)
+static inline bool xdr_data_contents(XDR *xdrs, contents *objp)
 {
-	if (!inline_xdr_bool(xdrs, &objp->rpr_eof))
-		return false;
-	if (objp->rpr_contents_count != 1)  /* an array of 1 for now */
-		return false;
-	if (!xdr_count4(xdrs, &objp->rpr_contents_count))
-		return false;
-	if (!inline_xdr_enum(xdrs, (enum_t *)&objp->rpr_contents.what))
+	if (!inline_xdr_enum(xdrs, (enum_t *)&objp->what))
 		return false;
-	if (objp->rpr_contents.what == NFS4_CONTENT_DATA) {
-		if (!xdr_offset4(xdrs, &objp->rpr_contents.data.d_offset))
+	if (objp->what == NFS4_CONTENT_DATA) {
+		if (!xdr_offset4(xdrs, &objp->data.d_offset))
 			return false;
 		if (!inline_xdr_bytes(xdrs,
-		    (char **)&objp->rpr_contents.data.d_data.data_val,
-		    &objp->rpr_contents.data.d_data.data_len,
+		    (char **)&objp->data.d_data.data_val,
+		    &objp->data.d_data.data_len,
 		    XDR_BYTES_MAXLEN_IO))
 			return false;
 		return true;
 	}
-	if (objp->rpr_contents.what == NFS4_CONTENT_HOLE) {
-		if (!xdr_offset4(xdrs, &objp->rpr_contents.hole.di_offset))
+	if (objp->what == NFS4_CONTENT_HOLE) {
+		if (!xdr_offset4(xdrs, &objp->hole.di_offset))
 			return false;
-		if (!xdr_length4(xdrs, &objp->rpr_contents.hole.di_length))
+		if (!xdr_length4(xdrs, &objp->hole.di_length))
 			return false;
 		return true;
 	} else
 		return false;
 }
 
+static inline bool xdr_READ_PLUS4resok(XDR *xdrs, read_plus_res4 *objp)
+{
+	if (!inline_xdr_bool(xdrs, &objp->rpr_eof))
+		return false;
+	if (!xdr_array(xdrs,
+	    (char **)&objp->rpr_contents,
+	    &objp->rpr_contents_count, XDR_ARRAY_MAXLEN,
+	    sizeof(contents), (xdrproc_t) xdr_data_contents))
+		return false;
+	return true;
+}
+
 static inline bool xdr_READ_PLUS4res(XDR *xdrs, READ_PLUS4res *objp)
 {
 	if (!xdr_nfsstat4(xdrs, &objp->rpr_status))
@@ -7936,27 +8311,6 @@ static inline bool xdr_DEALLOCATE4args(XDR *xdrs, DEALLOCATE4args *objp)
 	return true;
 }
 
-static inline bool xdr_data_contents(XDR *xdrs, contents *objp)
-{
-	if (!inline_xdr_enum(xdrs, (enum_t *)&objp->what))
-		return false;
-	if (objp->what == NFS4_CONTENT_DATA) {
-		if (!xdr_offset4(xdrs, &objp->hole.di_offset))
-			return false;
-		if (!xdr_length4(xdrs, &objp->hole.di_length))
-			return false;
-		return true;
-	}
-	if (objp->what == NFS4_CONTENT_HOLE) {
-		if (!xdr_offset4(xdrs, &objp->hole.di_offset))
-			return false;
-		if (!xdr_length4(xdrs, &objp->hole.di_length))
-			return false;
-		return true;
-	} else
-		return false;
-}
-
 static inline bool xdr_SEEK4resok(XDR *xdrs, seek_res4 *objp)
 {
 	if (!inline_xdr_bool(xdrs, &objp->sr_eof))
@@ -7995,6 +8349,158 @@ static inline bool xdr_DEALLOCATE4res(XDR *xdrs, DEALLOCATE4res *objp)
 	return true;
 }
 
+static inline bool xdr_netloc4(XDR *xdrs, netloc4 *objp)
+{
+	if (!inline_xdr_enum(xdrs, (enum_t *)&objp->nl_type))
+		return false;
+	switch (objp->nl_type) {
+	case NL4_NAME:
+		if (!xdr_utf8str_cis(xdrs, &objp->nl_name))
+			return false;
+		break;
+	case NL4_URL:
+		if (!xdr_utf8str_cis(xdrs, &objp->nl_url))
+			return false;
+		break;
+	case NL4_NETADDR:
+		if (!xdr_netaddr4(xdrs, &objp->nl_addr))
+			return false;
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+static inline bool xdr_COPY4args(XDR *xdrs, COPY4args *objp)
+{
+	if (!xdr_stateid4(xdrs, &objp->ca_src_stateid))
+		return false;
+	if (!xdr_stateid4(xdrs, &objp->ca_dst_stateid))
+		return false;
+	if (!xdr_offset4(xdrs, &objp->ca_src_offset))
+		return false;
+	if (!xdr_offset4(xdrs, &objp->ca_dst_offset))
+		return false;
+	if (!xdr_length4(xdrs, &objp->ca_count))
+		return false;
+	if (!inline_xdr_bool(xdrs, &objp->ca_consecutive))
+		return false;
+	if (!inline_xdr_bool(xdrs, &objp->ca_synchronous))
+		return false;
+	if (!xdr_array(xdrs,
+	    (char **)&objp->ca_source_server.ca_source_server_val,
+	    &objp->ca_source_server.ca_source_server_len, XDR_ARRAY_MAXLEN,
+	    sizeof(netloc4), (xdrproc_t) xdr_netloc4))
+		return false;
+	return true;
+}
+
+static inline bool xdr_copy_requirements4(XDR *xdrs, copy_requirements4 *objp)
+{
+	if (!inline_xdr_bool(xdrs, &objp->cr_consecutive))
+		return false;
+	if (!inline_xdr_bool(xdrs, &objp->cr_synchronous))
+		return false;
+	return true;
+}
+
+static inline bool xdr_COPY4res(XDR *xdrs, COPY4res *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->cr_status))
+		return false;
+	switch (objp->cr_status) {
+	case NFS4_OK:
+		if (!xdr_WRITE_SAME4resok(xdrs,
+				&objp->COPY4res_u.cr_resok4.cr_response))
+			return false;
+		if (!xdr_copy_requirements4(xdrs,
+				&objp->COPY4res_u.cr_resok4.cr_requirements))
+			return false;
+		break;
+	case NFS4ERR_OFFLOAD_NO_REQS:
+		if (!xdr_copy_requirements4(xdrs,
+				&objp->COPY4res_u.cr_requirements))
+			return false;
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+static inline bool xdr_OFFLOAD_CANCEL4args(XDR *xdrs,
+					   OFFLOAD_CANCEL4args *objp)
+{
+	if (!xdr_stateid4(xdrs, &objp->oca_stateid))
+		return false;
+	return true;
+}
+
+static inline bool xdr_OFFLOAD_CANCEL4res(XDR *xdrs, OFFLOAD_CANCEL4res *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->ocr_status))
+		return false;
+	return true;
+}
+
+static inline bool xdr_OFFLOAD_STATUS4args(XDR *xdrs,
+					   OFFLOAD_STATUS4args *objp)
+{
+	if (!xdr_stateid4(xdrs, &objp->osa_stateid))
+		return false;
+	return true;
+}
+
+static inline bool xdr_OFFLOAD_STATUS4res(XDR *xdrs, OFFLOAD_STATUS4res *objp)
+{
+	OFFLOAD_STATUS4resok *resok = &objp->OFFLOAD_STATUS4res_u.osr_resok4;
+
+	if (!xdr_nfsstat4(xdrs, &objp->osr_status))
+		return false;
+	switch (objp->osr_status) {
+	case NFS4_OK:
+		if (!xdr_length4(xdrs, &resok->osr_count))
+			return false;
+		/* osr_complete<1> */
+		if (!inline_xdr_u_int(xdrs,
+				      &resok->osr_complete.osr_complete_len))
+			return false;
+		if (resok->osr_complete.osr_complete_len > 1)
+			return false;
+		if (resok->osr_complete.osr_complete_len == 1 &&
+		    !xdr_nfsstat4(xdrs,
+				  &resok->osr_complete.osr_complete_val))
+			return false;
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+static inline bool xdr_CLONE4args(XDR *xdrs, CLONE4args *objp)
+{
+	if (!xdr_stateid4(xdrs, &objp->cl_src_stateid))
+		return false;
+	if (!xdr_stateid4(xdrs, &objp->cl_dst_stateid))
+		return false;
+	if (!xdr_offset4(xdrs, &objp->cl_src_offset))
+		return false;
+	if (!xdr_offset4(xdrs, &objp->cl_dst_offset))
+		return false;
+	if (!xdr_length4(xdrs, &objp->cl_count))
+		return false;
+	return true;
+}
+
+static inline bool xdr_CLONE4res(XDR *xdrs, CLONE4res *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->cl_status))
+		return false;
+	return true;
+}
+
 static inline bool xdr_IO_ADVISE4args(XDR *xdrs, IO_ADVISE4args *objp)
 {
 	if (!xdr_stateid4(xdrs, &objp->iaa_stateid))
@@ -8405,10 +8911,24 @@ static inline bool xdr_nfs_argop4(XDR *xdrs, nfs_argop4 *objp)
 		break;
 
 	case NFS4_OP_COPY:
-	case NFS4_OP_COPY_NOTIFY:
+		if (!xdr_COPY4args(xdrs, &objp->nfs_argop4_u.opcopy))
+			return false;
+		break;
 	case NFS4_OP_OFFLOAD_CANCEL:
+		if (!xdr_OFFLOAD_CANCEL4args(xdrs,
+				&objp->nfs_argop4_u.opoffload_cancel))
+			return false;
+		break;
 	case NFS4_OP_OFFLOAD_STATUS:
+		if (!xdr_OFFLOAD_STATUS4args(xdrs,
+				&objp->nfs_argop4_u.opoffload_status))
+			return false;
+		break;
 	case NFS4_OP_CLONE:
+		if (!xdr_CLONE4args(xdrs, &objp->nfs_argop4_u.opclone))
+			return false;
+		break;
+	case NFS4_OP_COPY_NOTIFY:
 		break;
 
 	/* NFSv4.3 */
@@ -8735,10 +9255,24 @@ static inline bool xdr_nfs_resop4(XDR *xdrs, nfs_resop4 *objp)
 		break;
 
 	case NFS4_OP_COPY:
-	case NFS4_OP_COPY_NOTIFY:
+		if (!xdr_COPY4res(xdrs, &objp->nfs_resop4_u.opcopy))
+			return false;
+		break;
 	case NFS4_OP_OFFLOAD_CANCEL:
+		if (!xdr_OFFLOAD_CANCEL4res(xdrs,
+				&objp->nfs_resop4_u.opoffload_cancel))
+			return false;
+		break;
 	case NFS4_OP_OFFLOAD_STATUS:
+		if (!xdr_OFFLOAD_STATUS4res(xdrs,
+				&objp->nfs_resop4_u.opoffload_status))
+			return false;
+		break;
 	case NFS4_OP_CLONE:
+		if (!xdr_CLONE4res(xdrs, &objp->nfs_resop4_u.opclone))
+			return false;
+		break;
+	case NFS4_OP_COPY_NOTIFY:
 
 	/* NFSv4.3 */
 	case NFS4_OP_GETXATTR:
@@ -9529,6 +10063,41 @@ static inline bool xdr_CB_NOTIFY_DEVICEID4res(XDR *xdrs,
 	return true;
 }
 
+static inline bool xdr_offload_info4(XDR *xdrs, offload_info4 *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->coa_status))
+		return false;
+	switch (objp->coa_status) {
+	case NFS4_OK:
+		if (!xdr_WRITE_SAME4resok(xdrs, &objp->coa_resok4))
+			return false;
+		break;
+	default:
+		if (!xdr_length4(xdrs, &objp->coa_bytes_copied))
+			return false;
+		break;
+	}
+	return true;
+}
+
+static inline bool xdr_CB_OFFLOAD4args(XDR *xdrs, CB_OFFLOAD4args *objp)
+{
+	if (!xdr_nfs_fh4(xdrs, &objp->coa_fh))
+		return false;
+	if (!xdr_stateid4(xdrs, &objp->coa_stateid))
+		return false;
+	if (!xdr_offload_info4(xdrs, &objp->coa_offload_info))
+		return false;
+	return true;
+}
+
+static inline bool xdr_CB_OFFLOAD4res(XDR *xdrs, CB_OFFLOAD4res *objp)
+{
+	if (!xdr_nfsstat4(xdrs, &objp->cor_status))
+		return false;
+	return true;
+}
+
 /* Callback operations new to NFSv4.1 */
 
 static inline bool xdr_nfs_cb_opnum4(XDR *xdrs, nfs_cb_opnum4 *objp)
@@ -9603,6 +10172,11 @@ static inline bool xdr_nfs_cb_argop4(XDR *xdrs, nfs_cb_argop4 *objp)
 		    &objp->nfs_cb_argop4_u.opcbnotify_deviceid))
 			return false;
 		break;
+	case NFS4_OP_CB_OFFLOAD:
+		if (!xdr_CB_OFFLOAD4args(xdrs,
+		    &objp->nfs_cb_argop4_u.opcboffload))
+			return false;
+		break;
 	case NFS4_OP_CB_ILLEGAL:
 		break;
 	default:
@@ -9676,6 +10250,11 @@ static inline bool xdr_nfs_cb_resop4(XDR *xdrs, nfs_cb_resop4 *objp)
 		    &objp->nfs_cb_resop4_u.opcbnotify_deviceid))
 			return false;
 		break;
+	case NFS4_OP_CB_OFFLOAD:
+		if (!xdr_CB_OFFLOAD4res(xdrs,
+		    &objp->nfs_cb_resop4_u.opcboffload))
+			return false;
+		break;
 	case NFS4_OP_CB_ILLEGAL:
 		if (!xdr_CB_ILLEGAL4res(xdrs,
 		    &objp->nfs_cb_resop4_u.opcbillegal))
@@ -47,6 +47,7 @@
 #include "abstract_atomic.h"
 #include "abstract_mem.h"
 #include "hashtable.h"
+#include "timer_wheel.h"
 #include "fsal_pnfs.h"
 #include "config_parsing.h"
 
@@ -123,6 +124,31 @@ extern hash_table_t *ht_session_id;
  */
 #define NFS41_NB_SLOTS_DEF 64
 
+/**
+ * @brief Default for the most forechannel slots a busy session can get
+ */
+#define NFS41_MAX_SLOTS_DEF 256
+
+/**
+ * @brief Default for the fewest forechannel slots an idle session keeps
+ */
+#define NFS41_MIN_SLOTS_DEF 4
+
+/**
+ * @brief Default for the forechannel slots offered across all sessions
+ */
+#define NFS41_SLOTS_BUDGET_DEF 65536
+
+/**
+ * @brief Seconds between reconsiderations of a session's slot table size
+ */
+#define NFS41_SLOT_RESIZE_PERIOD 5
+
+/**
+ * @brief Forechannel slots allocated at a time as a session grows
+ */
+#define NFS41_SLOT_CHUNK 16
+
 /**
  * @brief Members in the slot table
  */
@@ -191,8 +217,20 @@ struct nfs41_session {
 	uint32_t cb_program;	/*< Callback program ID */
 	uint32_t flags;		/*< Flags pertaining to this session */
 	int32_t refcount;
-	uint32_t nb_slots;	/**< Number of slots in this session */
-	nfs41_session_slot_t *fc_slots;	/**< Forechannel slot table*/
+	uint32_t nb_slots;	/**< Number of slots this session may grow to */
+	uint32_t nb_slot_chunks;	/**< Forechannel chunks allocated */
+	uint32_t highest_slotid;	/**< Highest forechannel slot id we
+					     accept */
+	uint32_t target_highest_slotid;	/**< Highest forechannel slot id we
+					     want the client to use */
+	uint32_t slot_max_used;	/**< Highest slot id seen this period */
+	uint32_t slot_requests;	/**< SEQUENCEs seen this period */
+	time_t slot_period_end;	/**< End of the current sizing period */
+	pthread_mutex_t slot_resize_mutex;	/**< Serializes resizing */
+	nfs41_session_slot_t **fc_slot_chunks;	/**< Forechannel slot table,
+						     in chunks of
+						     NFS41_SLOT_CHUNK
+						     allocated on demand */
 	nfs41_cb_session_slot_t *bc_slots;	/**< Backchannel slot table */
 };
 
@@ -331,6 +369,8 @@ struct state_deleg {
 	struct cf_deleg_stats sd_clfile_stats;  /* client specific */
 	uint32_t share_access;	/*< The NFSv4 Share Access state */
 	uint32_t share_deny;	/*< The NFSv4 Share Deny state */
+	uint32_t sd_notify_types;	/*< notify_type4 bits sent as CB_NOTIFY
+					    (directory delegations only) */
 };
 
 /**
@@ -714,6 +754,8 @@ struct nfs_client_id_t {
 	int32_t cid_refcount;	/*< Reference count for lifecycle */
 	int cid_lease_reservations;	/*< Counted lease reservations, to spare
 					   this clientid from the reaper */
+	struct tw_node cid_lease_timer;	/*< Lease expiry timer, protected by
+					   the lease wheel mutex */
 	uint32_t cid_minorversion;
 	uint32_t cid_stateid_counter;
 
@@ -872,6 +914,22 @@ struct file_deleg_stats {
 					   num_opens */
 };
 
+/**
+ * @brief Stats for directory delegation heuristics
+ *
+ * dds_curr_delegations and dds_last_change are read and updated with
+ * atomics from the directory mutation paths, the rest is protected by
+ * state_lock.
+ */
+
+struct dir_deleg_stats {
+	uint32_t dds_curr_delegations;  /* number of delegations on dir */
+	uint32_t dds_delegation_count;  /* times dir has been delegated */
+	uint32_t dds_recall_count;      /* times dir has been recalled */
+	time_t dds_last_change;         /* last entry add/remove/rename */
+	time_t dds_last_recall;
+};
+
 enum cbgetattr_state {
 	CB_GETATTR_NONE = 0, /* initial state or reset to as
 				and when finished processing
@@ -931,6 +989,10 @@ struct state_dir {
 	/** List of exports that have this cache inode as their root.
 	 * Protected by state_lock */
 	struct glist_head export_roots;
+	/** Directory delegations on this directory. Protected by state_lock */
+	struct glist_head list_of_states;
+	/** Directory delegation statistics. */
+	struct dir_deleg_stats ddeleg_stats;
 	/** There is one export root reference counted for each export
 	    for which this entry is a root for. This field is used
 	    with the atomic inc/dec/fetch routines. */
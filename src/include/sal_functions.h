@@ -115,6 +115,7 @@ static inline void state_hdl_init(struct state_hdl *ostate,
 		break;
 	case DIRECTORY:
 		glist_init(&ostate->dir.export_roots);
+		glist_init(&ostate->dir.list_of_states);
 		break;
 	default:
 		break;
@@ -386,6 +387,25 @@ int nfs41_Session_Get_Pointer(char sessionid[NFS4_SESSIONID_SIZE],
 int nfs41_Session_Del(char sessionid[NFS4_SESSIONID_SIZE]);
 void nfs41_Build_sessionid(clientid4 *clientid, char *sessionid);
 void nfs41_Session_PrintAll(void);
+void nfs41_session_slots_init(nfs41_session_t *session, uint32_t initial);
+void nfs41_session_slot_used(nfs41_session_t *session, uint32_t slotid);
+
+/**
+ * @brief Get a forechannel slot of a session
+ *
+ * @param[in] session The session
+ * @param[in] slotid  Slot id, no higher than the session's highest_slotid
+ *
+ * @return The slot.
+ */
+static inline nfs41_session_slot_t *
+nfs41_session_slot(nfs41_session_t *session, uint32_t slotid)
+{
+	nfs41_session_slot_t *chunk = atomic_fetch_voidptr(
+		(void **)&session->fc_slot_chunks[slotid / NFS41_SLOT_CHUNK]);
+
+	return &chunk[slotid % NFS41_SLOT_CHUNK];
+}
 
 bool check_session_conn(nfs41_session_t *session,
 			compound_data_t *data,
@@ -493,6 +513,11 @@ uint64_t state_id_rbt_hash_func(hash_parameter_t *hparam,
 int reserve_lease(nfs_client_id_t *clientid);
 void update_lease(nfs_client_id_t *clientid);
 bool valid_lease(nfs_client_id_t *clientid);
+void lease_timer_init(void);
+void lease_timer_arm(nfs_client_id_t *clientid);
+void lease_timer_cancel(nfs_client_id_t *clientid);
+int lease_timer_collect(struct glist_head *expired);
+nfs_client_id_t *lease_timer_next(struct glist_head *expired);
 
 /******************************************************************************
  *
@@ -902,6 +927,8 @@ void get_deleg_perm(nfsace4 *permissions, open_delegation_type4 type);
 void update_delegation_stats(struct state_hdl *ostate,
 			     state_owner_t *owner);
 state_status_t delegrecall_impl(struct fsal_obj_handle *obj);
+state_status_t delegrecall_one_impl(struct fsal_obj_handle *obj,
+				    struct state_t *state);
 nfsstat4 deleg_revoke(struct fsal_obj_handle *obj, struct state_t *deleg_state);
 void state_deleg_revoke(struct fsal_obj_handle *obj, state_t *state);
 bool state_deleg_conflict(struct fsal_obj_handle *obj, bool write);
@@ -914,6 +941,21 @@ nfsstat4 handle_deleg_getattr(struct fsal_obj_handle *obj,
 int cbgetattr_impl(struct fsal_obj_handle *obj, nfs_client_id_t *client,
 		   struct gsh_export *ctx_exp);
 
+bool dir_deleg_supported(struct fsal_obj_handle *obj,
+			 struct export_perms *export_perms);
+bool should_we_grant_dir_deleg(struct state_hdl *ostate,
+			       nfs_client_id_t *client);
+void update_dir_delegation_stats(struct state_hdl *ostate,
+				 state_owner_t *owner);
+void dir_deleg_heuristics_wipe(struct state_hdl *ostate,
+			       state_owner_t *owner);
+bool state_dir_deleg_held(struct fsal_obj_handle *dir);
+void state_dir_deleg_notify(struct fsal_obj_handle *dir, notify_type4 type,
+			    const char *name, const char *new_name);
+state_status_t dir_notify_impl(struct fsal_obj_handle *dir,
+			       notify_type4 type, const char *name,
+			       const char *new_name, clientid4 changer);
+
 /******************************************************************************
  *
  * Layout functions
@@ -1062,6 +1104,7 @@ struct nfs4_recovery_backend {
 
 void fs_backend_init(struct nfs4_recovery_backend **);
 void fs_ng_backend_init(struct nfs4_recovery_backend **);
+void journal_backend_init(struct nfs4_recovery_backend **);
 #ifdef USE_RADOS_RECOV
 int rados_kv_set_param_from_conf(config_file_t, struct config_error_type *);
 void rados_kv_backend_init(struct nfs4_recovery_backend **);
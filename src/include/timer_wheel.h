@@ -0,0 +1,104 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel with one second resolution
+ *
+ * Timers are bucketed by expiry time into TW_LEVELS levels of
+ * TW_SLOTS slots each.  Level 0 slots are one second wide, each
+ * following level is TW_SLOTS times coarser.  Scheduling and
+ * cancelling are O(1), and advancing the wheel only touches the slots
+ * that come due (plus an occasional cascade of a coarser slot into
+ * finer ones).
+ *
+ * The wheel does no locking of its own; callers serialize access.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "gsh_list.h"
+
+#define TW_BITS 6
+#define TW_SLOTS (1 << TW_BITS)
+#define TW_MASK (TW_SLOTS - 1)
+#define TW_LEVELS 4
+
+/** Longest delay the wheel can represent without clamping */
+#define TW_MAX_DELAY ((time_t)1 << (TW_BITS * TW_LEVELS))
+
+struct tw_node {
+	struct glist_head tn_list;	/**< Slot or expired list linkage */
+	time_t tn_expire;		/**< Absolute expiry time */
+	bool tn_armed;			/**< On a slot of the wheel */
+};
+
+struct timer_wheel {
+	time_t tw_now;			/**< Next second to be processed */
+	unsigned int tw_count;		/**< Number of armed timers */
+	struct glist_head tw_slots[TW_LEVELS][TW_SLOTS];
+};
+
+void tw_init(struct timer_wheel *tw, time_t now);
+void tw_schedule(struct timer_wheel *tw, struct tw_node *node,
+		 time_t expire);
+int tw_advance(struct timer_wheel *tw, time_t now,
+	       struct glist_head *expired);
+
+static inline void tw_node_init(struct tw_node *node)
+{
+	node->tn_list.next = NULL;
+	node->tn_list.prev = NULL;
+	node->tn_expire = 0;
+	node->tn_armed = false;
+}
+
+static inline bool tw_armed(struct tw_node *node)
+{
+	return node->tn_armed;
+}
+
+/**
+ * @brief Take a timer off the wheel
+ *
+ * Does nothing if the timer is not armed, in particular if it has
+ * already been handed out by tw_advance.
+ *
+ * @param[in] tw   The wheel
+ * @param[in] node The timer
+ *
+ * @return true if the timer was armed.
+ */
+static inline bool tw_cancel(struct timer_wheel *tw, struct tw_node *node)
+{
+	if (!node->tn_armed)
+		return false;
+
+	glist_del(&node->tn_list);
+	node->tn_armed = false;
+	tw->tw_count--;
+	return true;
+}
+
+#endif /* TIMER_WHEEL_H */
@@ -279,6 +279,14 @@ class InodeStats():
         self.cache_conflict = stats[3][7]
         self.cache_add = stats[3][9]
         self.cache_mapping = stats[3][11]
+        self.access_hit = stats[3][13]
+        self.access_miss = stats[3][15]
+        self.encoded_hit = stats[3][17]
+        self.encoded_miss = stats[3][19]
+        self.path_hit = stats[3][21]
+        self.path_miss = stats[3][23]
+        self.xattr_hit = stats[3][25]
+        self.xattr_miss = stats[3][27]
     def __str__(self):
         if self.status != "OK":
             return "No NFS activity, GANESHA RESPONSE STATUS: " + self.status
@@ -288,7 +296,15 @@ class InodeStats():
                  "\nInode Cache Misses: " + str(self.cache_miss) +
                  "\nInode Cache Conflicts:: " + str(self.cache_conflict) +
                  "\nInode Cache Adds: " + str(self.cache_add) +
-                 "\nInode Cache Mapping: " + str(self.cache_mapping) )
+                 "\nInode Cache Mapping: " + str(self.cache_mapping) +
+                 "\nAccess Cache Hits: " + str(self.access_hit) +
+                 "\nAccess Cache Misses: " + str(self.access_miss) +
+                 "\nEncoded Attrs Hits: " + str(self.encoded_hit) +
+                 "\nEncoded Attrs Misses: " + str(self.encoded_miss) +
+                 "\nPath Cache Hits: " + str(self.path_hit) +
+                 "\nPath Cache Misses: " + str(self.path_miss) +
+                 "\nXattr Cache Hits: " + str(self.xattr_hit) +
+                 "\nXattr Cache Misses: " + str(self.xattr_miss) )
 
 class FastStats():
     def __init__(self, stats):
@@ -0,0 +1,65 @@
+#!/bin/sh
+
+# Runs fio read and write jobs against a Ganesha mount and prints the
+# throughput and completion latency of each, to compare FSAL_VFS with
+# async_io on and off.  Mount the export over loopback, e.g.
+#   mount -t nfs -o vers=4.1 localhost:/export /mnt
+# run this once with async_io = false and once with async_io = true in
+# the VFS block, then compare the two outputs.
+
+TEST_DIR=$1
+RUNTIME=${2:-30}
+SIZE=${SIZE:-1g}
+NUMJOBS=${NUMJOBS:-8}
+IODEPTH=${IODEPTH:-16}
+
+if [ "$TEST_DIR" = "" ]; then
+  echo "usage : $0 <test_dir> [runtime]"
+  exit 1
+fi
+
+if [ ! -d "$TEST_DIR" ]; then
+  echo "$TEST_DIR is not a directory"
+  exit 1
+fi
+
+if ! which fio > /dev/null 2>&1; then
+  echo "fio not found"
+  exit 1
+fi
+
+run_job()
+{
+  NAME=$1
+  RW=$2
+  BS=$3
+  shift 3
+
+  fio --name="$NAME" --directory="$TEST_DIR" --rw="$RW" --bs="$BS" \
+      --size="$SIZE" --numjobs="$NUMJOBS" --iodepth="$IODEPTH" \
+      --ioengine=libaio --direct=1 --time_based --runtime="$RUNTIME" \
+      --group_reporting --output-format=json "$@" |
+  python3 -c '
+import json, sys
+job = json.load(sys.stdin)["jobs"][0]
+for rw in ("read", "write"):
+    r = job[rw]
+    if r["io_bytes"] == 0:
+        continue
+    pct = r["clat_ns"].get("percentile", {})
+    print("%-16s %-5s %9d KiB/s %8d IOPS clat %8.1f us p99 %8.1f us" %
+          (sys.argv[1], rw, r["bw"], r["iops"], r["clat_ns"]["mean"] / 1000,
+           pct.get("99.000000", 0) / 1000))
+' "$NAME"
+}
+
+run_job seq-read read 1m
+run_job rand-read randread 4k
+run_job seq-write write 1m
+run_job rand-write randwrite 4k
+run_job rand-write-sync randwrite 4k --sync=1
+run_job mixed randrw 64k --rwmixread=70
+
+rm -f "$TEST_DIR"/seq-read.* "$TEST_DIR"/rand-read.* "$TEST_DIR"/seq-write.* \
+      "$TEST_DIR"/rand-write.* "$TEST_DIR"/rand-write-sync.* \
+      "$TEST_DIR"/mixed.*
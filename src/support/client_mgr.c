@@ -559,6 +559,94 @@ static struct gsh_dbus_method cltmgr_show_clients = {
 		 END_ARG_LIST}
 };
 
+struct showsessions_state {
+	DBusMessageIter session_iter;
+};
+
+static void session_to_dbus(struct rbt_node *pn, void *arg)
+{
+	struct showsessions_state *iter_state = arg;
+	struct hash_data *pdata = RBT_OPAQ(pn);
+	nfs41_session_t *session = pdata->val.addr;
+	char str[LOG_BUFF_LEN] = "\0";
+	struct display_buffer dspbuf = {sizeof(str), str, str};
+	char *strp = str;
+	uint64_t clientid = session->clientid;
+	uint32_t highest = atomic_fetch_uint32_t(&session->highest_slotid);
+	uint32_t target =
+		atomic_fetch_uint32_t(&session->target_highest_slotid);
+	uint32_t allocated = MIN(atomic_fetch_uint32_t(
+					&session->nb_slot_chunks) *
+							NFS41_SLOT_CHUNK,
+				 session->nb_slots);
+	uint32_t cached = 0;
+	uint32_t i;
+	DBusMessageIter struct_iter;
+
+	(void)display_session_id(&dspbuf, session->session_id);
+
+	/* Unlocked snapshot, good enough for reporting */
+	for (i = 0; i < allocated; i++)
+		if (nfs41_session_slot(session, i)->cached_result != NULL)
+			cached++;
+
+	dbus_message_iter_open_container(&iter_state->session_iter,
+					 DBUS_TYPE_STRUCT, NULL, &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &clientid);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &strp);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &allocated);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &highest);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &target);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &cached);
+	dbus_message_iter_close_container(&iter_state->session_iter,
+					  &struct_iter);
+}
+
+/**
+ * DBUS method to report NFSv4.1 session slot table usage
+ *
+ * For each session: clientid, sessionid, slots allocated, highest
+ * slotid accepted, target highest slotid and slots holding a cached
+ * reply.
+ */
+
+static bool gsh_client_showsessions(DBusMessageIter *args,
+				    DBusMessage *reply,
+				    DBusError *error)
+{
+	DBusMessageIter iter;
+	struct showsessions_state iter_state;
+	struct timespec timestamp;
+
+	now(&timestamp);
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_append_timestamp(&iter, &timestamp);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					 "(tsuuuu)",
+					 &iter_state.session_iter);
+
+	hashtable_for_each(ht_session_id, session_to_dbus, &iter_state);
+
+	dbus_message_iter_close_container(&iter, &iter_state.session_iter);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_sessions = {
+	.name = "ShowSessions",
+	.method = gsh_client_showsessions,
+	.args = {TIMESTAMP_REPLY,
+		 {
+		  .name = "sessions",
+		  .type = "a(tsuuuu)",
+		  .direction = "out"},
+		 END_ARG_LIST}
+};
+
 /* Reset Client specific stats counters
  */
 void reset_client_stats(void)
@@ -582,6 +670,7 @@ static struct gsh_dbus_method *cltmgr_client_methods[] = {
 	&cltmgr_add_client,
 	&cltmgr_remove_client,
 	&cltmgr_show_clients,
+	&cltmgr_show_sessions,
 	NULL
 };
 
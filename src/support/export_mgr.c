@@ -2599,6 +2599,72 @@ static struct gsh_dbus_method cache_inode_show = {
 		 END_ARG_LIST}
 };
 
+static void pool_stats_to_dbus(struct pool_stats *stats, void *arg)
+{
+	DBusMessageIter *array_iter = arg;
+	DBusMessageIter struct_iter;
+	uint64_t size = stats->object_size;
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
+				       &stats->name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &size);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->slabs);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->objects);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->depot_mags);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->mag_hits);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->depot_hits);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->slab_ops);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * DBUS method to report slab pool statistics
+ *
+ * For each pool: name, object size, slabs, objects out of the slabs,
+ * full magazines in the depot, magazine hits, depot exchanges and
+ * slab layer operations.
+ */
+
+static bool show_mem_pools(DBusMessageIter *args,
+			   DBusMessage *reply,
+			   DBusError *error)
+{
+	DBusMessageIter iter, array_iter;
+	struct timespec timestamp;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, true, "OK");
+	now(&timestamp);
+	dbus_append_timestamp(&iter, &timestamp);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					 "(sttttttt)", &array_iter);
+	pool_slab_foreach(pool_stats_to_dbus, &array_iter);
+	dbus_message_iter_close_container(&iter, &array_iter);
+
+	return true;
+}
+
+static struct gsh_dbus_method mem_pools_show = {
+	.name = "ShowMemPools",
+	.method = show_mem_pools,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 {
+		  .name = "pools",
+		  .type = "a(sttttttt)",
+		  .direction = "out"},
+		 END_ARG_LIST}
+};
+
 /**
  * @brief Report all IO stats of all exports in one call
  *
@@ -2668,6 +2734,7 @@ static struct gsh_dbus_method *export_stats_methods[] = {
 	&global_show_total_ops,
 	&global_show_fast_ops,
 	&cache_inode_show,
+	&mem_pools_show,
 	&export_show_all_io,
 	&reset_statistics,
 	&fsal_statistics,
@@ -286,6 +286,13 @@ static struct config_item version4_params[] = {
 		       minor_versions, nfs_version4_parameter, minor_versions),
 	CONF_ITEM_UI32("slot_table_size", 1, 1024, NFS41_NB_SLOTS_DEF,
 		       nfs_version4_parameter, nb_slots),
+	CONF_ITEM_UI32("max_slot_table_size", 1, 1024, NFS41_MAX_SLOTS_DEF,
+		       nfs_version4_parameter, max_slots),
+	CONF_ITEM_UI32("min_slot_table_size", 1, 1024, NFS41_MIN_SLOTS_DEF,
+		       nfs_version4_parameter, min_slots),
+	CONF_ITEM_UI32("slot_table_budget", 1, UINT32_MAX,
+		       NFS41_SLOTS_BUDGET_DEF,
+		       nfs_version4_parameter, slots_budget),
 	CONFIG_EOL
 };
 
@@ -0,0 +1,602 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file pool_slab.c
+ * @brief Slab object cache with per-thread magazines
+ *
+ * Three layers, after Bonwick's magazine allocator:
+ *
+ * - Each thread has a loaded and a previous magazine (a small stack of
+ *   free objects) per pool.  alloc pops and free pushes without any
+ *   locking.
+ * - When both magazines of a thread are empty (alloc) or full (free),
+ *   it exchanges one with the pool's depot of full and empty magazines
+ *   under the pool mutex.
+ * - Behind the depot, objects are carved out of power-of-two aligned
+ *   slabs.  The slab of an object is found by masking its address.
+ *   Completely free slabs are given back to the system, keeping one
+ *   around to avoid thrashing.
+ *
+ * Constructors only run when a slab is created and destructors when
+ * it is released, so objects recycled through the magazines keep their
+ * constructed state.  Pools without a constructor get zeroed objects,
+ * the same as pool_basic_init pools.
+ *
+ * Only the first POOL_SLAB_MAX slab pools get thread magazines, later
+ * ones go straight to the slab layer.  Magazine slots are not recycled
+ * since other threads may still hold magazines for a destroyed pool.
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include <stdint.h>
+#include "abstract_mem.h"
+#include "common_utils.h"
+#include "gsh_list.h"
+#include "log.h"
+
+#define POOL_SLAB_MAX 64	/*< Pools with per-thread magazines */
+#define POOL_MAG_ROUNDS 32	/*< Objects per magazine */
+#define POOL_DEPOT_MAX 16	/*< Full magazines kept in a depot */
+#define POOL_SLAB_SIZE (64 * 1024)
+#define POOL_SLAB_MIN_OBJS 16
+#define POOL_ALIGN 16
+
+struct pool_magazine {
+	struct pool_magazine *pm_next;
+	unsigned int pm_rounds;
+	void *pm_objs[POOL_MAG_ROUNDS];
+};
+
+/**
+ * @brief Slab header, at the start of each slab
+ *
+ * Free objects are tracked by index rather than by a link stored in
+ * the object, which would clobber its constructed state.
+ */
+struct slab {
+	struct glist_head sl_list;	/*< partial, full or empty list */
+	unsigned int sl_nfree;		/*< Free objects */
+	uint16_t sl_free[];		/*< Stack of free object indexes */
+};
+
+struct pool_slab {
+	struct glist_head ps_list;	/*< All slab pools */
+	pool_t *ps_pool;
+	int ps_index;			/*< Magazine slot, -1 if none */
+	size_t ps_stride;		/*< Object size, rounded up */
+	size_t ps_slab_size;		/*< Power of two */
+	size_t ps_hdr_size;		/*< Offset of the first object */
+	unsigned int ps_nobjs;		/*< Objects per slab */
+	pool_constructor_t ps_ctor;
+	pool_destructor_t ps_dtor;
+	pthread_mutex_t ps_mutex;	/*< Protects everything below */
+	struct glist_head ps_partial;
+	struct glist_head ps_full;
+	struct glist_head ps_empty;
+	struct pool_magazine *ps_full_mags;
+	struct pool_magazine *ps_empty_mags;
+	unsigned int ps_nfull_mags;
+	unsigned int ps_nempty_slabs;
+	uint64_t ps_slabs;
+	uint64_t ps_objects;
+	uint64_t ps_mag_hits;
+	uint64_t ps_depot_hits;
+	uint64_t ps_slab_ops;
+};
+
+struct pool_tcache {
+	struct pool_magazine *tc_loaded;
+	struct pool_magazine *tc_prev;
+	uint64_t tc_hits;
+};
+
+static __thread struct pool_tcache pool_tcache[POOL_SLAB_MAX];
+static __thread bool pool_tcache_armed;
+
+static pthread_mutex_t pool_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pool_slab *pool_slabs[POOL_SLAB_MAX];
+static int pool_slab_next;
+static struct glist_head pool_slab_list = GLIST_HEAD_INIT(pool_slab_list);
+static pthread_key_t pool_tcache_key;
+static pthread_once_t pool_tcache_once = PTHREAD_ONCE_INIT;
+
+static inline struct slab *pool_obj_slab(struct pool_slab *ps, void *obj)
+{
+	return (struct slab *)((uintptr_t)obj & ~(ps->ps_slab_size - 1));
+}
+
+static inline void *pool_slab_obj(struct pool_slab *ps, struct slab *sl,
+				  unsigned int idx)
+{
+	return (char *)sl + ps->ps_hdr_size + idx * ps->ps_stride;
+}
+
+static inline void pool_slab_move(struct glist_head *list, struct slab *sl)
+{
+	glist_del(&sl->sl_list);
+	glist_add_tail(list, &sl->sl_list);
+}
+
+static void pool_slab_release(struct pool_slab *ps, struct slab *sl)
+{
+	unsigned int idx;
+
+	if (ps->ps_dtor)
+		for (idx = 0; idx < ps->ps_nobjs; idx++)
+			ps->ps_dtor(pool_slab_obj(ps, sl, idx));
+
+	glist_del(&sl->sl_list);
+	ps->ps_slabs--;
+	gsh_free(sl);
+}
+
+static struct slab *pool_slab_create(struct pool_slab *ps)
+{
+	struct slab *sl = gsh_malloc_aligned(ps->ps_slab_size,
+					     ps->ps_slab_size);
+	unsigned int idx;
+
+	sl->sl_nfree = ps->ps_nobjs;
+	for (idx = 0; idx < ps->ps_nobjs; idx++) {
+		/* Hand out low addresses first */
+		sl->sl_free[idx] = ps->ps_nobjs - 1 - idx;
+		if (ps->ps_ctor)
+			ps->ps_ctor(pool_slab_obj(ps, sl, idx));
+	}
+
+	glist_add(&ps->ps_partial, &sl->sl_list);
+	ps->ps_slabs++;
+
+	return sl;
+}
+
+/**
+ * @brief Take an object from the slab layer, pool mutex held
+ */
+static void *pool_slab_get(struct pool_slab *ps)
+{
+	struct slab *sl;
+
+	sl = glist_first_entry(&ps->ps_partial, struct slab, sl_list);
+	if (sl == NULL) {
+		sl = glist_first_entry(&ps->ps_empty, struct slab, sl_list);
+		if (sl != NULL) {
+			ps->ps_nempty_slabs--;
+			pool_slab_move(&ps->ps_partial, sl);
+		} else {
+			sl = pool_slab_create(ps);
+		}
+	}
+
+	sl->sl_nfree--;
+	if (sl->sl_nfree == 0)
+		pool_slab_move(&ps->ps_full, sl);
+
+	ps->ps_objects++;
+	ps->ps_slab_ops++;
+
+	return pool_slab_obj(ps, sl, sl->sl_free[sl->sl_nfree]);
+}
+
+/**
+ * @brief Give an object back to the slab layer, pool mutex held
+ */
+static void pool_slab_put(struct pool_slab *ps, void *obj)
+{
+	struct slab *sl = pool_obj_slab(ps, obj);
+	size_t off = (char *)obj - (char *)sl - ps->ps_hdr_size;
+
+	assert(off % ps->ps_stride == 0);
+
+	if (sl->sl_nfree == 0)
+		pool_slab_move(&ps->ps_partial, sl);
+
+	sl->sl_free[sl->sl_nfree++] = off / ps->ps_stride;
+	ps->ps_objects--;
+	ps->ps_slab_ops++;
+
+	if (sl->sl_nfree < ps->ps_nobjs)
+		return;
+
+	/* Keep one empty slab around, release the others */
+	if (ps->ps_nempty_slabs > 0) {
+		pool_slab_release(ps, sl);
+	} else {
+		pool_slab_move(&ps->ps_empty, sl);
+		ps->ps_nempty_slabs++;
+	}
+}
+
+static void pool_mag_drain(struct pool_slab *ps, struct pool_magazine *mag)
+{
+	while (mag->pm_rounds > 0)
+		pool_slab_put(ps, mag->pm_objs[--mag->pm_rounds]);
+}
+
+/**
+ * @brief Return the magazines of an exiting thread
+ */
+static void pool_tcache_destroy(void *arg)
+{
+	struct pool_tcache *tc;
+	struct pool_slab *ps;
+	int idx;
+
+	PTHREAD_MUTEX_lock(&pool_registry_mutex);
+
+	for (idx = 0; idx < pool_slab_next; idx++) {
+		tc = &pool_tcache[idx];
+		ps = pool_slabs[idx];
+
+		if (ps != NULL &&
+		    (tc->tc_loaded != NULL || tc->tc_prev != NULL)) {
+			PTHREAD_MUTEX_lock(&ps->ps_mutex);
+			ps->ps_mag_hits += tc->tc_hits;
+			if (tc->tc_loaded)
+				pool_mag_drain(ps, tc->tc_loaded);
+			if (tc->tc_prev)
+				pool_mag_drain(ps, tc->tc_prev);
+			PTHREAD_MUTEX_unlock(&ps->ps_mutex);
+		}
+
+		gsh_free(tc->tc_loaded);
+		gsh_free(tc->tc_prev);
+		memset(tc, 0, sizeof(*tc));
+	}
+
+	PTHREAD_MUTEX_unlock(&pool_registry_mutex);
+}
+
+/**
+ * @brief Make sure the magazines of this thread are returned at exit
+ */
+static inline void pool_tcache_arm(void)
+{
+	if (!pool_tcache_armed) {
+		(void) pthread_setspecific(pool_tcache_key, pool_tcache);
+		pool_tcache_armed = true;
+	}
+}
+
+static void pool_tcache_key_init(void)
+{
+	(void) pthread_key_create(&pool_tcache_key, pool_tcache_destroy);
+}
+
+/**
+ * @brief Create a slab pool
+ *
+ * @param[in] name        The name of this pool
+ * @param[in] object_size The size of objects to allocate
+ * @param[in] ctor        Object constructor, may be NULL
+ * @param[in] dtor        Object destructor, may be NULL
+ *
+ * @return The pool, to be disposed of with pool_destroy.
+ */
+pool_t *pool_slab_init(const char *name, size_t object_size,
+		       pool_constructor_t ctor, pool_destructor_t dtor)
+{
+	pool_t *pool = pool_basic_init(name, object_size);
+	struct pool_slab *ps = gsh_calloc(1, sizeof(*ps));
+
+	(void) pthread_once(&pool_tcache_once, pool_tcache_key_init);
+
+	ps->ps_pool = pool;
+	ps->ps_ctor = ctor;
+	ps->ps_dtor = dtor;
+	ps->ps_stride = (object_size + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+
+	/* Grow the slab until it holds a reasonable number of objects */
+	for (ps->ps_slab_size = POOL_SLAB_SIZE; ; ps->ps_slab_size <<= 1) {
+		size_t hdr;
+		unsigned int nobjs;
+
+		nobjs = (ps->ps_slab_size - sizeof(struct slab)) /
+			(ps->ps_stride + sizeof(uint16_t));
+		if (nobjs > UINT16_MAX)
+			nobjs = UINT16_MAX;
+		hdr = sizeof(struct slab) + nobjs * sizeof(uint16_t);
+		hdr = (hdr + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+		nobjs = (ps->ps_slab_size - hdr) / ps->ps_stride;
+
+		if (nobjs >= POOL_SLAB_MIN_OBJS) {
+			ps->ps_hdr_size = hdr;
+			ps->ps_nobjs = nobjs;
+			break;
+		}
+	}
+
+	PTHREAD_MUTEX_init(&ps->ps_mutex, NULL);
+	glist_init(&ps->ps_partial);
+	glist_init(&ps->ps_full);
+	glist_init(&ps->ps_empty);
+
+	PTHREAD_MUTEX_lock(&pool_registry_mutex);
+
+	if (pool_slab_next < POOL_SLAB_MAX) {
+		ps->ps_index = pool_slab_next++;
+		pool_slabs[ps->ps_index] = ps;
+	} else {
+		ps->ps_index = -1;
+		LogInfo(COMPONENT_MEM_ALLOC,
+			"No thread magazines left for pool %s",
+			name ? name : "(unnamed)");
+	}
+	glist_add_tail(&pool_slab_list, &ps->ps_list);
+
+	PTHREAD_MUTEX_unlock(&pool_registry_mutex);
+
+	pool->slab = ps;
+
+	LogDebug(COMPONENT_MEM_ALLOC,
+		 "Pool %s: %zu byte objects, %u per %zu byte slab",
+		 name ? name : "(unnamed)", object_size, ps->ps_nobjs,
+		 ps->ps_slab_size);
+
+	return pool;
+}
+
+/**
+ * @brief Destroy a slab pool
+ *
+ * All objects must have been returned.  Magazines that other threads
+ * still hold for this pool are abandoned.
+ */
+void pool_slab_destroy(pool_t *pool)
+{
+	struct pool_slab *ps = pool->slab;
+	struct pool_magazine *mag;
+	struct slab *sl;
+
+	PTHREAD_MUTEX_lock(&pool_registry_mutex);
+	if (ps->ps_index >= 0)
+		pool_slabs[ps->ps_index] = NULL;
+	glist_del(&ps->ps_list);
+	PTHREAD_MUTEX_unlock(&pool_registry_mutex);
+
+	PTHREAD_MUTEX_lock(&ps->ps_mutex);
+
+	if (ps->ps_index >= 0) {
+		struct pool_tcache *tc = &pool_tcache[ps->ps_index];
+
+		if (tc->tc_loaded)
+			pool_mag_drain(ps, tc->tc_loaded);
+		if (tc->tc_prev)
+			pool_mag_drain(ps, tc->tc_prev);
+		gsh_free(tc->tc_loaded);
+		gsh_free(tc->tc_prev);
+		memset(tc, 0, sizeof(*tc));
+	}
+
+	while ((mag = ps->ps_full_mags) != NULL) {
+		ps->ps_full_mags = mag->pm_next;
+		pool_mag_drain(ps, mag);
+		gsh_free(mag);
+	}
+
+	while ((mag = ps->ps_empty_mags) != NULL) {
+		ps->ps_empty_mags = mag->pm_next;
+		gsh_free(mag);
+	}
+
+	if (ps->ps_objects != 0)
+		LogWarn(COMPONENT_MEM_ALLOC,
+			"Pool %s destroyed with %" PRIu64 " objects outstanding",
+			pool->name ? pool->name : "(unnamed)",
+			ps->ps_objects);
+
+	while ((sl = glist_first_entry(&ps->ps_empty, struct slab,
+				       sl_list)) != NULL)
+		pool_slab_release(ps, sl);
+	while ((sl = glist_first_entry(&ps->ps_partial, struct slab,
+				       sl_list)) != NULL)
+		pool_slab_release(ps, sl);
+	while ((sl = glist_first_entry(&ps->ps_full, struct slab,
+				       sl_list)) != NULL)
+		pool_slab_release(ps, sl);
+
+	PTHREAD_MUTEX_unlock(&ps->ps_mutex);
+	PTHREAD_MUTEX_destroy(&ps->ps_mutex);
+
+	gsh_free(ps);
+	gsh_free(pool->name);
+	gsh_free(pool);
+}
+
+/**
+ * @brief Allocate an object from a slab pool
+ */
+void *pool_slab_alloc(pool_t *pool)
+{
+	struct pool_slab *ps = pool->slab;
+	struct pool_tcache *tc;
+	struct pool_magazine *mag;
+	void *obj;
+
+	if (ps->ps_index < 0) {
+		PTHREAD_MUTEX_lock(&ps->ps_mutex);
+		obj = pool_slab_get(ps);
+		PTHREAD_MUTEX_unlock(&ps->ps_mutex);
+		goto out;
+	}
+
+	tc = &pool_tcache[ps->ps_index];
+
+	if (tc->tc_loaded && tc->tc_loaded->pm_rounds > 0)
+		goto hit;
+
+	if (tc->tc_prev && tc->tc_prev->pm_rounds > 0) {
+		mag = tc->tc_prev;
+		tc->tc_prev = tc->tc_loaded;
+		tc->tc_loaded = mag;
+		goto hit;
+	}
+
+	PTHREAD_MUTEX_lock(&ps->ps_mutex);
+
+	ps->ps_mag_hits += tc->tc_hits;
+	tc->tc_hits = 0;
+
+	mag = ps->ps_full_mags;
+	if (mag == NULL) {
+		obj = pool_slab_get(ps);
+		PTHREAD_MUTEX_unlock(&ps->ps_mutex);
+		goto out;
+	}
+
+	pool_tcache_arm();
+
+	/* Swap an empty magazine for a full one from the depot */
+	ps->ps_full_mags = mag->pm_next;
+	ps->ps_nfull_mags--;
+	ps->ps_depot_hits++;
+
+	if (tc->tc_prev) {
+		tc->tc_prev->pm_next = ps->ps_empty_mags;
+		ps->ps_empty_mags = tc->tc_prev;
+	}
+	tc->tc_prev = tc->tc_loaded;
+	tc->tc_loaded = mag;
+
+	PTHREAD_MUTEX_unlock(&ps->ps_mutex);
+
+hit:
+	tc->tc_hits++;
+	obj = tc->tc_loaded->pm_objs[--tc->tc_loaded->pm_rounds];
+
+out:
+	if (ps->ps_ctor == NULL)
+		memset(obj, 0, pool->object_size);
+
+	return obj;
+}
+
+/**
+ * @brief Return an object to a slab pool
+ */
+void pool_slab_free(pool_t *pool, void *object)
+{
+	struct pool_slab *ps = pool->slab;
+	struct pool_tcache *tc;
+	struct pool_magazine *mag;
+
+	if (ps->ps_index < 0) {
+		PTHREAD_MUTEX_lock(&ps->ps_mutex);
+		pool_slab_put(ps, object);
+		PTHREAD_MUTEX_unlock(&ps->ps_mutex);
+		return;
+	}
+
+	tc = &pool_tcache[ps->ps_index];
+
+	if (tc->tc_loaded && tc->tc_loaded->pm_rounds < POOL_MAG_ROUNDS)
+		goto hit;
+
+	if (tc->tc_prev && tc->tc_prev->pm_rounds < POOL_MAG_ROUNDS) {
+		mag = tc->tc_prev;
+		tc->tc_prev = tc->tc_loaded;
+		tc->tc_loaded = mag;
+		goto hit;
+	}
+
+	pool_tcache_arm();
+
+	PTHREAD_MUTEX_lock(&ps->ps_mutex);
+
+	ps->ps_mag_hits += tc->tc_hits;
+	tc->tc_hits = 0;
+
+	/* Both magazines (if any) are full, give one to the depot */
+	if (tc->tc_prev) {
+		ps->ps_depot_hits++;
+		tc->tc_prev->pm_next = ps->ps_full_mags;
+		ps->ps_full_mags = tc->tc_prev;
+		ps->ps_nfull_mags++;
+
+		if (ps->ps_nfull_mags > POOL_DEPOT_MAX) {
+			/* Depot is full, push a magazine back to the slabs
+			 * so memory can eventually be released.
+			 */
+			mag = ps->ps_full_mags;
+			ps->ps_full_mags = mag->pm_next;
+			ps->ps_nfull_mags--;
+			pool_mag_drain(ps, mag);
+			mag->pm_next = ps->ps_empty_mags;
+			ps->ps_empty_mags = mag;
+		}
+	}
+	tc->tc_prev = tc->tc_loaded;
+
+	mag = ps->ps_empty_mags;
+	if (mag != NULL)
+		ps->ps_empty_mags = mag->pm_next;
+
+	PTHREAD_MUTEX_unlock(&ps->ps_mutex);
+
+	if (mag == NULL)
+		mag = gsh_calloc(1, sizeof(*mag));
+
+	tc->tc_loaded = mag;
+
+hit:
+	tc->tc_hits++;
+	tc->tc_loaded->pm_objs[tc->tc_loaded->pm_rounds++] = object;
+}
+
+/**
+ * @brief Report the statistics of every slab pool
+ *
+ * Magazine hits are only folded into the pool when a thread goes to
+ * the depot, so they lag a little.
+ *
+ * @param[in] cb  Called for each pool
+ * @param[in] arg Passed to @a cb
+ */
+void pool_slab_foreach(void (*cb)(struct pool_stats *, void *), void *arg)
+{
+	struct glist_head *glist;
+	struct pool_stats stats;
+
+	PTHREAD_MUTEX_lock(&pool_registry_mutex);
+
+	glist_for_each(glist, &pool_slab_list) {
+		struct pool_slab *ps = glist_entry(glist, struct pool_slab,
+						   ps_list);
+
+		PTHREAD_MUTEX_lock(&ps->ps_mutex);
+		stats.name = ps->ps_pool->name ? ps->ps_pool->name
+					       : "(unnamed)";
+		stats.object_size = ps->ps_pool->object_size;
+		stats.slabs = ps->ps_slabs;
+		stats.objects = ps->ps_objects;
+		stats.depot_mags = ps->ps_nfull_mags;
+		stats.mag_hits = ps->ps_mag_hits;
+		stats.depot_hits = ps->ps_depot_hits;
+		stats.slab_ops = ps->ps_slab_ops;
+		PTHREAD_MUTEX_unlock(&ps->ps_mutex);
+
+		cb(&stats, arg);
+	}
+
+	PTHREAD_MUTEX_unlock(&pool_registry_mutex);
+}
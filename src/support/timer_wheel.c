@@ -0,0 +1,172 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file timer_wheel.c
+ * @brief Hierarchical timer wheel
+ */
+
+#include "config.h"
+#include "timer_wheel.h"
+
+/**
+ * @brief Initialize an empty wheel
+ *
+ * @param[in] tw  The wheel
+ * @param[in] now Current time, the first second to be processed
+ */
+void tw_init(struct timer_wheel *tw, time_t now)
+{
+	int level, slot;
+
+	tw->tw_now = now;
+	tw->tw_count = 0;
+
+	for (level = 0; level < TW_LEVELS; level++)
+		for (slot = 0; slot < TW_SLOTS; slot++)
+			glist_init(&tw->tw_slots[level][slot]);
+}
+
+/**
+ * @brief Put an unarmed timer in the slot matching its expiry
+ */
+static void tw_insert(struct timer_wheel *tw, struct tw_node *node)
+{
+	time_t expire = node->tn_expire;
+	time_t delta = expire - tw->tw_now;
+	struct glist_head *slot;
+	int level;
+
+	if (delta < 0) {
+		/* Already due, fire on the next tick */
+		slot = &tw->tw_slots[0][tw->tw_now & TW_MASK];
+	} else {
+		if (delta >= TW_MAX_DELAY) {
+			/* Park in the coarsest slot, the real expiry is
+			 * recomputed when it cascades down.
+			 */
+			expire = tw->tw_now + TW_MAX_DELAY - 1;
+			delta = TW_MAX_DELAY - 1;
+		}
+
+		for (level = 0; level < TW_LEVELS - 1; level++)
+			if (delta < ((time_t)1 << (TW_BITS * (level + 1))))
+				break;
+
+		slot = &tw->tw_slots[level]
+				    [(expire >> (TW_BITS * level)) & TW_MASK];
+	}
+
+	glist_add_tail(slot, &node->tn_list);
+}
+
+/**
+ * @brief Arm or re-arm a timer
+ *
+ * @param[in] tw     The wheel
+ * @param[in] node   The timer
+ * @param[in] expire Absolute expiry time
+ */
+void tw_schedule(struct timer_wheel *tw, struct tw_node *node, time_t expire)
+{
+	if (node->tn_armed)
+		glist_del(&node->tn_list);
+	else
+		tw->tw_count++;
+
+	node->tn_expire = expire;
+	node->tn_armed = true;
+	tw_insert(tw, node);
+}
+
+/**
+ * @brief Redistribute the current slot of a coarse level
+ *
+ * @return The slot index that was cascaded.
+ */
+static int tw_cascade(struct timer_wheel *tw, int level)
+{
+	int idx = (tw->tw_now >> (TW_BITS * level)) & TW_MASK;
+	struct glist_head list;
+	struct glist_head *glist, *glistn;
+
+	glist_init(&list);
+	glist_splice_tail(&list, &tw->tw_slots[level][idx]);
+
+	glist_for_each_safe(glist, glistn, &list) {
+		glist_del(glist);
+		tw_insert(tw, glist_entry(glist, struct tw_node, tn_list));
+	}
+
+	return idx;
+}
+
+/**
+ * @brief Advance the wheel and collect the timers that came due
+ *
+ * Every second up to and including @a now is processed.  Expired
+ * timers are disarmed and moved to the tail of @a expired, where the
+ * caller owns them.
+ *
+ * @param[in]  tw      The wheel
+ * @param[in]  now     Current time
+ * @param[out] expired List head to receive expired timers
+ *
+ * @return Number of expired timers.
+ */
+int tw_advance(struct timer_wheel *tw, time_t now, struct glist_head *expired)
+{
+	struct glist_head *glist, *glistn;
+	struct glist_head *slot;
+	int count = 0;
+	int level;
+
+	while (tw->tw_now <= now) {
+		if (tw->tw_count == 0) {
+			/* Nothing armed, skip straight ahead */
+			tw->tw_now = now + 1;
+			break;
+		}
+
+		if ((tw->tw_now & TW_MASK) == 0) {
+			for (level = 1; level < TW_LEVELS; level++)
+				if (tw_cascade(tw, level) != 0)
+					break;
+		}
+
+		slot = &tw->tw_slots[0][tw->tw_now & TW_MASK];
+
+		glist_for_each_safe(glist, glistn, slot) {
+			struct tw_node *node;
+
+			node = glist_entry(glist, struct tw_node, tn_list);
+			glist_del(glist);
+			node->tn_armed = false;
+			tw->tw_count--;
+			glist_add_tail(expired, glist);
+			count++;
+		}
+
+		tw->tw_now++;
+	}
+
+	return count;
+}
@@ -0,0 +1,116 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * Walk a directory through the life of its delegations and check the
+ * grant heuristics and the per-directory and per-client accounting:
+ * grant, recall of one holder, wipe of the directory, changes to an
+ * undelegated directory and a client whose back channel is down.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include "sal_functions.h"
+#include "nfs_rpc_callback.h"
+
+static int errors;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: %s\n", __FILE__, __LINE__, #cond);\
+			errors++;					\
+		}							\
+	} while (0)
+
+static void init_dir(struct fsal_obj_handle *dir, struct state_hdl *hdl)
+{
+	memset(dir, 0, sizeof(*dir));
+	memset(hdl, 0, sizeof(*hdl));
+	dir->type = DIRECTORY;
+	dir->state_hdl = hdl;
+	glist_init(&hdl->dir.list_of_states);
+}
+
+int main(int argc, char *argv[])
+{
+	struct fsal_obj_handle dir, dir2;
+	struct state_hdl hdl, hdl2;
+	nfs_client_id_t clients[2];
+	state_owner_t owners[2];
+	int i;
+
+	memset(clients, 0, sizeof(clients));
+	memset(owners, 0, sizeof(owners));
+	for (i = 0; i < 2; i++)
+		owners[i].so_owner.so_nfs4_owner.so_clientrec = &clients[i];
+
+	/* A quiet directory may be delegated to both clients */
+	init_dir(&dir, &hdl);
+	CHECK(!state_dir_deleg_held(&dir));
+	CHECK(should_we_grant_dir_deleg(&hdl, &clients[0]));
+	CHECK(should_we_grant_dir_deleg(&hdl, &clients[1]));
+
+	update_dir_delegation_stats(&hdl, &owners[0]);
+	update_dir_delegation_stats(&hdl, &owners[1]);
+	CHECK(state_dir_deleg_held(&dir));
+	CHECK(hdl.dir.ddeleg_stats.dds_curr_delegations == 2);
+	CHECK(clients[0].curr_deleg_grants == 1);
+	CHECK(clients[1].curr_deleg_grants == 1);
+
+	/* Recalling one holder leaves the other delegated */
+	hdl.dir.ddeleg_stats.dds_last_recall = time(NULL);
+	deleg_heuristics_recall(&dir, &owners[0], NULL);
+	CHECK(state_dir_deleg_held(&dir));
+	CHECK(hdl.dir.ddeleg_stats.dds_curr_delegations == 1);
+	CHECK(hdl.dir.ddeleg_stats.dds_recall_count == 1);
+	CHECK(clients[0].curr_deleg_grants == 0);
+	CHECK(clients[1].curr_deleg_grants == 1);
+
+	/* Just recalled, don't hand it right back out */
+	CHECK(!should_we_grant_dir_deleg(&hdl, &clients[0]));
+
+	/* The directory going away gives the other client its grant back
+	 * without counting as a recall.
+	 */
+	dir_deleg_heuristics_wipe(&hdl, &owners[1]);
+	CHECK(!state_dir_deleg_held(&dir));
+	CHECK(hdl.dir.ddeleg_stats.dds_curr_delegations == 0);
+	CHECK(hdl.dir.ddeleg_stats.dds_recall_count == 1);
+	CHECK(clients[1].curr_deleg_grants == 0);
+
+	/* A change to an undelegated directory is only recorded, and keeps
+	 * it from being delegated for a while.
+	 */
+	init_dir(&dir2, &hdl2);
+	state_dir_deleg_notify(&dir2, NOTIFY4_ADD_ENTRY, "new", NULL);
+	CHECK(hdl2.dir.ddeleg_stats.dds_last_change != 0);
+	CHECK(!state_dir_deleg_held(&dir2));
+	CHECK(!should_we_grant_dir_deleg(&hdl2, &clients[0]));
+
+	/* No delegation without a back channel to notify through */
+	init_dir(&dir2, &hdl2);
+	set_cb_chan_down(&clients[1], true);
+	CHECK(!should_we_grant_dir_deleg(&hdl2, &clients[1]));
+	CHECK(should_we_grant_dir_deleg(&hdl2, &clients[0]));
+
+	printf("%d errors\n", errors);
+
+	return errors != 0;
+}
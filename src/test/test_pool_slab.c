@@ -0,0 +1,155 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "abstract_mem.h"
+
+#define NTHREADS 8
+#define NOBJS 4096
+#define NROUNDS 200
+
+struct myobj {
+	unsigned int magic;	/* set by the constructor */
+	unsigned int owner;
+	char payload[200];
+};
+
+static pool_t *zero_pool;
+static pool_t *ctor_pool;
+static int ctor_calls, dtor_calls;
+
+static void myobj_ctor(void *object)
+{
+	struct myobj *obj = object;
+
+	obj->magic = 0xfeedbeef;
+	__sync_fetch_and_add(&ctor_calls, 1);
+}
+
+static void myobj_dtor(void *object)
+{
+	__sync_fetch_and_add(&dtor_calls, 1);
+}
+
+static void *worker(void *arg)
+{
+	unsigned int id = (unsigned long) arg;
+	struct myobj **objs = calloc(NOBJS, sizeof(*objs));
+	long errors = 0;
+	int round, ix;
+
+	for (round = 0; round < NROUNDS; round++) {
+		pool_t *pool = (round & 1) ? ctor_pool : zero_pool;
+
+		for (ix = 0; ix < NOBJS; ix++) {
+			objs[ix] = pool_alloc(pool);
+			if (pool == zero_pool && objs[ix]->owner != 0)
+				errors++;
+			if (pool == ctor_pool &&
+			    objs[ix]->magic != 0xfeedbeef)
+				errors++;
+			objs[ix]->owner = id + 1;
+		}
+
+		/* Nobody else may have been handed the same object */
+		for (ix = 0; ix < NOBJS; ix++)
+			if (objs[ix]->owner != id + 1)
+				errors++;
+
+		/* Free in a scrambled order */
+		for (ix = 0; ix < NOBJS; ix++) {
+			int jx = (ix * 7919) % NOBJS;
+
+			if (pool == zero_pool)
+				objs[jx]->owner = 0xdead;
+			pool_free(pool, objs[jx]);
+		}
+	}
+
+	free(objs);
+	return (void *) errors;
+}
+
+static void print_stats(struct pool_stats *stats, void *arg)
+{
+	printf("%-10s size %zu slabs %" PRIu64 " objects %" PRIu64
+	       " mag_hits %" PRIu64 " depot_hits %" PRIu64
+	       " slab_ops %" PRIu64 "\n",
+	       stats->name, stats->object_size, stats->slabs,
+	       stats->objects, stats->mag_hits, stats->depot_hits,
+	       stats->slab_ops);
+}
+
+static double timed_loop(pool_t *pool)
+{
+	struct timespec start, end;
+	void *obj;
+	int ix;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (ix = 0; ix < 10000000; ix++) {
+		obj = pool_alloc(pool);
+		pool_free(pool, obj);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t threads[NTHREADS];
+	long errors = 0;
+	void *rc;
+	pool_t *basic;
+	unsigned long ix;
+
+	zero_pool = pool_slab_init("zeroed", sizeof(struct myobj), NULL, NULL);
+	ctor_pool = pool_slab_init("ctor", sizeof(struct myobj),
+				   myobj_ctor, myobj_dtor);
+
+	for (ix = 0; ix < NTHREADS; ix++)
+		pthread_create(&threads[ix], NULL, worker, (void *) ix);
+	for (ix = 0; ix < NTHREADS; ix++) {
+		pthread_join(threads[ix], &rc);
+		errors += (long) rc;
+	}
+
+	pool_slab_foreach(print_stats, NULL);
+
+	basic = pool_basic_init("basic", sizeof(struct myobj));
+	printf("10M alloc/free: basic %.3fs slab %.3fs\n",
+	       timed_loop(basic), timed_loop(zero_pool));
+	pool_destroy(basic);
+
+	pool_destroy(zero_pool);
+	pool_destroy(ctor_pool);
+
+	if (ctor_calls != dtor_calls) {
+		printf("%d constructor calls but %d destructor calls\n",
+		       ctor_calls, dtor_calls);
+		errors++;
+	}
+
+	printf("%s\n", errors ? "FAILED" : "PASSED");
+	return errors != 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * Read a sparse file the way READ and READ_PLUS do, check that the
+ * segments returned by fsal_read_plus_fd() describe the same bytes as a
+ * plain read, and compare the XDR encoded size of both replies.
+ *
+ * Usage: test_read_plus_sparse [directory]
+ *
+ * The directory must be on a filesystem that reports holes (tmpfs, ext4,
+ * xfs, ...) for the size comparison to be meaningful.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "fsal.h"
+#include "FSAL/fsal_commonlib.h"
+#include "nfsv41.h"
+
+#define FILE_SIZE (64 * 1024 * 1024)
+#define EXTENT_SIZE (64 * 1024)
+#define EXTENT_STRIDE (8 * 1024 * 1024)
+#define READ_SIZE (1024 * 1024)
+
+static char xdrbuf[2 * READ_SIZE];
+
+static u_int encoded_size(xdrproc_t proc, void *res)
+{
+	XDR xdrs;
+
+	xdrmem_create(&xdrs, xdrbuf, sizeof(xdrbuf), XDR_ENCODE);
+	if (!proc(&xdrs, res))
+		return 0;
+	return XDR_GETPOS(&xdrs);
+}
+
+/* Rebuild the range from the segments and compare with a plain read */
+static int check_segments(struct io_info *info, char *packed, char *plain,
+			  uint64_t offset, size_t len)
+{
+	uint32_t i;
+	uint64_t pos = offset;
+	char *datap = packed;
+	size_t j;
+
+	for (i = 0; i < info->io_nsegs; i++) {
+		struct io_seg *seg = &info->io_segs[i];
+
+		if (seg->offset != pos)
+			return 1;
+		if (seg->what == NFS4_CONTENT_DATA) {
+			if (memcmp(datap, plain + (pos - offset), seg->length))
+				return 1;
+			datap += seg->length;
+		} else {
+			for (j = 0; j < seg->length; j++)
+				if (plain[pos - offset + j] != 0)
+					return 1;
+		}
+		pos += seg->length;
+	}
+
+	/* Segments may stop short, but never run past the range */
+	return pos > offset + len;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dir = argc > 1 ? argv[1] : "/tmp";
+	char path[PATH_MAX];
+	char *packed, *plain;
+	uint64_t read_bytes = 0, read_plus_bytes = 0;
+	uint64_t offset, ix;
+	bool sparse;
+	int fd, errors = 0;
+
+	snprintf(path, sizeof(path), "%s/read_plus_XXXXXX", dir);
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	unlink(path);
+
+	packed = malloc(READ_SIZE);
+	plain = malloc(READ_SIZE);
+
+	/* Mostly holes, like a freshly installed VM image */
+	memset(plain, 0xa5, EXTENT_SIZE);
+	for (ix = 0; ix < FILE_SIZE; ix += EXTENT_STRIDE)
+		if (pwrite(fd, plain, EXTENT_SIZE, ix) != EXTENT_SIZE) {
+			perror("pwrite");
+			return 1;
+		}
+	if (ftruncate(fd, FILE_SIZE) < 0) {
+		perror("ftruncate");
+		return 1;
+	}
+
+	sparse = lseek(fd, 0, SEEK_HOLE) < FILE_SIZE;
+
+	for (offset = 0; offset < FILE_SIZE;) {
+		struct io_info info;
+		contents segs[IO_INFO_MAX_SEGS];
+		READ_PLUS4res rplus;
+		READ4res rd;
+		char *datap = packed;
+		ssize_t nb_read, nb_plain;
+		bool eof;
+		uint32_t i;
+		uint64_t covered = 0;
+
+		memset(&info, 0, sizeof(info));
+		nb_read = fsal_read_plus_fd(fd, offset, READ_SIZE, packed,
+					    &info, &eof);
+		nb_plain = pread(fd, plain, READ_SIZE, offset);
+
+		if (nb_read < 0 || nb_plain < 0 ||
+		    check_segments(&info, packed, plain, offset, nb_plain)) {
+			printf("segment mismatch at %" PRIu64 "\n", offset);
+			errors++;
+			break;
+		}
+
+		memset(&rplus, 0, sizeof(rplus));
+		rplus.rpr_status = NFS4_OK;
+		rplus.rpr_resok4.rpr_eof = eof;
+		rplus.rpr_resok4.rpr_contents_count = info.io_nsegs;
+		rplus.rpr_resok4.rpr_contents = segs;
+		for (i = 0; i < info.io_nsegs; i++) {
+			segs[i].what = info.io_segs[i].what;
+			if (segs[i].what == NFS4_CONTENT_DATA) {
+				segs[i].data.d_offset = info.io_segs[i].offset;
+				segs[i].data.d_data.data_len =
+						info.io_segs[i].length;
+				segs[i].data.d_data.data_val = datap;
+				datap += info.io_segs[i].length;
+			} else {
+				segs[i].hole.di_offset = info.io_segs[i].offset;
+				segs[i].hole.di_length = info.io_segs[i].length;
+			}
+			covered += info.io_segs[i].length;
+		}
+
+		memset(&rd, 0, sizeof(rd));
+		rd.status = NFS4_OK;
+		/* Charge READ for the same range READ_PLUS covered */
+		rd.READ4res_u.resok4.eof = offset + covered >= FILE_SIZE;
+		rd.READ4res_u.resok4.data.data_len = covered;
+		rd.READ4res_u.resok4.data.data_val = plain;
+
+		read_plus_bytes += encoded_size((xdrproc_t) xdr_READ_PLUS4res,
+						&rplus);
+		read_bytes += encoded_size((xdrproc_t) xdr_READ4res, &rd);
+
+		if (covered == 0) {
+			printf("no progress at %" PRIu64 "\n", offset);
+			errors++;
+			break;
+		}
+		offset += covered;
+	}
+
+	printf("%s: READ %" PRIu64 " bytes, READ_PLUS %" PRIu64 " bytes\n",
+	       sparse ? "sparse" : "not sparse", read_bytes, read_plus_bytes);
+
+	if (sparse && read_plus_bytes * 4 > read_bytes) {
+		printf("READ_PLUS did not skip the holes\n");
+		errors++;
+	}
+
+	close(fd);
+	free(packed);
+	free(plain);
+
+	printf("%s\n", errors ? "FAILED" : "PASSED");
+	return errors != 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * Compare the cost of recording client create/destroy with the
+ * directory based "fs" backend and the append-only "journal" backend,
+ * then the cost of reading the clients back for reclaim after a
+ * restart.
+ *
+ * Both backends write under NFS_V4_RECOV_ROOT, do NOT run this on a
+ * server that is in service.
+ *
+ * Usage: test_recovery_bench [fs|fs_ng|journal] [threads] [clients]
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "sal_functions.h"
+
+static struct nfs4_recovery_backend *backend;
+static int nclients = 10000;
+static bool populate;		/*< Leave the clients for the reclaim pass */
+static nfs_client_id_t **thread_clids;
+static long reclaimed_clids;
+static long reclaimed_rfhs;
+
+static clid_entry_t *count_clid(char *name)
+{
+	static clid_entry_t ent;
+
+	reclaimed_clids++;
+	return &ent;
+}
+
+static rdel_fh_t *count_rfh(clid_entry_t *ent, char *name)
+{
+	reclaimed_rfhs++;
+	return NULL;
+}
+
+static void rm_clids(nfs_client_id_t *clids)
+{
+	int ix;
+
+	for (ix = 0; ix < nclients; ix++) {
+		backend->rm_clid(&clids[ix]);
+		free(clids[ix].cid_client_record);
+	}
+
+	free(clids);
+}
+
+static void *worker(void *arg)
+{
+	long id = (long) arg;
+	nfs_client_id_t *clids;
+	nfs_fh4 fh;
+	char fhbuf[32];
+	int ix;
+
+	clids = calloc(nclients, sizeof(*clids));
+
+	for (ix = 0; ix < nclients; ix++) {
+		nfs_client_record_t *rec;
+
+		rec = calloc(1, sizeof(*rec) + 64);
+		rec->cr_client_val_len = snprintf(rec->cr_client_val, 64,
+						  "bench-client-%ld-%d",
+						  id, ix);
+		clids[ix].cid_client_record = rec;
+		backend->add_clid(&clids[ix]);
+	}
+
+	/* Revoke a delegation for one client out of ten */
+	memset(fhbuf, 0x5a, sizeof(fhbuf));
+	fh.nfs_fh4_val = fhbuf;
+	fh.nfs_fh4_len = sizeof(fhbuf);
+	for (ix = 0; ix < nclients; ix += 10)
+		backend->add_revoke_fh(&clids[ix], &fh);
+
+	if (populate)
+		thread_clids[id] = clids;
+	else
+		rm_clids(clids);
+
+	return NULL;
+}
+
+static void run_workers(int nthreads)
+{
+	pthread_t *threads;
+	long ix;
+
+	threads = calloc(nthreads, sizeof(*threads));
+	for (ix = 0; ix < nthreads; ix++)
+		pthread_create(&threads[ix], NULL, worker, (void *) ix);
+	for (ix = 0; ix < nthreads; ix++)
+		pthread_join(threads[ix], NULL);
+	free(threads);
+}
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) +
+	       (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *name = argc > 1 ? argv[1] : "journal";
+	int nthreads = argc > 2 ? atoi(argv[2]) : 8;
+	struct timespec start;
+	double secs;
+	long ix;
+
+	if (argc > 3)
+		nclients = atoi(argv[3]);
+
+	if (!strcmp(name, "fs"))
+		fs_backend_init(&backend);
+	else if (!strcmp(name, "fs_ng"))
+		fs_ng_backend_init(&backend);
+	else if (!strcmp(name, "journal"))
+		journal_backend_init(&backend);
+	else {
+		fprintf(stderr, "unknown backend %s\n", name);
+		return 1;
+	}
+
+	if (backend->recovery_init()) {
+		fprintf(stderr, "recovery_init failed\n");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	backend->recovery_read_clids(NULL, count_clid, count_rfh);
+	run_workers(nthreads);
+	backend->end_grace();
+	secs = elapsed(&start);
+
+	printf("%s: %d threads x %d clients: %.3f s, %.0f updates/s\n",
+	       name, nthreads, nclients, secs,
+	       nthreads * (nclients * 2.1) / secs);
+
+	/* Leave the clients behind, restart and time the reclaim */
+	populate = true;
+	thread_clids = calloc(nthreads, sizeof(*thread_clids));
+	run_workers(nthreads);
+
+	if (backend->recovery_shutdown)
+		backend->recovery_shutdown();
+
+	if (backend->recovery_init()) {
+		fprintf(stderr, "recovery_init failed on restart\n");
+		return 1;
+	}
+
+	reclaimed_clids = 0;
+	reclaimed_rfhs = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	backend->recovery_read_clids(NULL, count_clid, count_rfh);
+	secs = elapsed(&start);
+
+	printf("%s: reclaim of %ld clients, %ld revoked handles: %.3f s, %.0f clients/s\n",
+	       name, reclaimed_clids, reclaimed_rfhs, secs,
+	       reclaimed_clids / secs);
+	if (reclaimed_clids != (long) nthreads * nclients)
+		printf("%s: expected %ld clients\n", name,
+		       (long) nthreads * nclients);
+
+	for (ix = 0; ix < nthreads; ix++)
+		rm_clids(thread_clids[ix]);
+	free(thread_clids);
+	backend->end_grace();
+
+	if (backend->recovery_shutdown)
+		backend->recovery_shutdown();
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sal_functions.h"
+
+/* Slots are spread over 64 stripes and a slot has 8192 generations, so
+ * this reuses every slot the single state goes through past the point
+ * where its generation would wrap.
+ */
+#define NROUNDS (64 * 8192 + 64 * 300)
+
+static char (*seen)[OTHERSIZE];
+
+static int cmp_other(const void *a, const void *b)
+{
+	return memcmp(a, b, OTHERSIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	state_t state, *found;
+	char first[OTHERSIZE];
+	long ix, errors = 0;
+
+	if (nfs4_Init_state_id() != 0) {
+		fprintf(stderr, "nfs4_Init_state_id failed\n");
+		return 1;
+	}
+
+	seen = calloc(NROUNDS, OTHERSIZE);
+	memset(&state, 0, sizeof(state));
+	state.state_type = STATE_TYPE_DELEG;
+
+	for (ix = 0; ix < NROUNDS; ix++) {
+		/* Same client every time, as nfs4_BuildStateId_Other would */
+		memset(state.stateid_other, 0x5a, OTHERSIZE);
+
+		if (nfs4_State_Set(&state) != STATE_SUCCESS) {
+			printf("round %ld: nfs4_State_Set failed\n", ix);
+			return 1;
+		}
+
+		memcpy(seen[ix], state.stateid_other, OTHERSIZE);
+		if (ix == 0)
+			memcpy(first, state.stateid_other, OTHERSIZE);
+
+		found = nfs4_State_Get_Pointer(state.stateid_other);
+		if (found != &state) {
+			printf("round %ld: live stateid not found\n", ix);
+			errors++;
+		}
+
+		/* The stateid of the first round is long stale */
+		if (ix > 0 && nfs4_State_Get_Pointer(first) != NULL) {
+			printf("round %ld: stale stateid resolved\n", ix);
+			errors++;
+		}
+
+		if (!nfs4_State_Del(&state)) {
+			printf("round %ld: nfs4_State_Del failed\n", ix);
+			return 1;
+		}
+
+		if (nfs4_State_Get_Pointer(seen[ix]) != NULL) {
+			printf("round %ld: deleted stateid resolved\n", ix);
+			errors++;
+		}
+
+		if (errors > 10)
+			break;
+	}
+
+	qsort(seen, NROUNDS, OTHERSIZE, cmp_other);
+
+	for (ix = 1; ix < NROUNDS; ix++) {
+		if (memcmp(seen[ix - 1], seen[ix], OTHERSIZE) == 0) {
+			printf("stateid handed out twice\n");
+			errors++;
+			break;
+		}
+	}
+
+	free(seen);
+	printf("%ld rounds, %ld errors\n", NROUNDS, errors);
+
+	return errors != 0;
+}
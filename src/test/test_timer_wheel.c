@@ -0,0 +1,113 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "timer_wheel.h"
+
+#define NTIMERS 20000
+#define HORIZON 400000
+
+struct mytimer {
+	struct tw_node node;
+	time_t expire;
+	int fired;
+};
+
+static struct mytimer timers[NTIMERS];
+
+/* Every timer must fire exactly once, in the second it expires */
+static int check_expiry(time_t start)
+{
+	struct timer_wheel tw;
+	struct glist_head expired;
+	struct glist_head *glist, *glistn;
+	time_t now;
+	int ix, errors = 0;
+
+	tw_init(&tw, start);
+	srandom(42);
+
+	for (ix = 0; ix < NTIMERS; ix++) {
+		tw_node_init(&timers[ix].node);
+		timers[ix].expire = start + random() % HORIZON;
+		timers[ix].fired = 0;
+		tw_schedule(&tw, &timers[ix].node, timers[ix].expire);
+	}
+
+	/* Re-arm a third of them, as a lease renewal would */
+	for (ix = 0; ix < NTIMERS; ix += 3) {
+		timers[ix].expire = start + random() % HORIZON;
+		tw_schedule(&tw, &timers[ix].node, timers[ix].expire);
+	}
+
+	/* And cancel a few */
+	for (ix = 1; ix < NTIMERS; ix += 101)
+		tw_cancel(&tw, &timers[ix].node);
+
+	glist_init(&expired);
+
+	/* Advance with irregular steps like a reaper would */
+	for (now = start; now < start + HORIZON + 10; now += 1 + random() % 9) {
+		tw_advance(&tw, now, &expired);
+
+		glist_for_each_safe(glist, glistn, &expired) {
+			struct mytimer *t = glist_entry(glist, struct mytimer,
+							node.tn_list);
+
+			glist_del(glist);
+			t->fired++;
+
+			if (t->expire > now || t->expire < now - 9) {
+				printf("timer %d expire %ld fired at %ld\n",
+				       (int) (t - timers), (long) t->expire,
+				       (long) now);
+				errors++;
+			}
+		}
+	}
+
+	for (ix = 0; ix < NTIMERS; ix++) {
+		int want = (ix % 101 == 1) ? 0 : 1;
+
+		if (timers[ix].fired != want) {
+			printf("timer %d fired %d times, expected %d\n",
+			       ix, timers[ix].fired, want);
+			errors++;
+		}
+	}
+
+	if (tw.tw_count != 0) {
+		printf("%u timers left armed\n", tw.tw_count);
+		errors++;
+	}
+
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	int errors = 0;
+
+	errors += check_expiry(0);
+	errors += check_expiry(1571000000);
+	errors += check_expiry(63);
+
+	printf("%s\n", errors ? "FAILED" : "PASSED");
+	return errors != 0;
+}
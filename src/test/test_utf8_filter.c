@@ -0,0 +1,332 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * Check that the vector name scanners give the same answer as the scalar
+ * one, on known names, on every 2 and 3 byte sequence and on random
+ * names, then time them.
+ *
+ * Usage: test_utf8_filter [iterations]
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nfs_proto_tools.h"
+
+#define MAX_NAME 300
+#define BENCH_NAMES 1024
+
+typedef nfsstat4 (*filter_fn)(const char *, size_t, utf8_scantype_t);
+
+struct filter {
+	const char *name;
+	filter_fn fn;
+	bool usable;
+};
+
+static struct filter filters[] = {
+	{ "scalar", nfs4_path_filter_scalar, true },
+#if defined(__x86_64__) && defined(__GNUC__)
+	{ "sse4", nfs4_path_filter_sse4, false },
+	{ "avx2", nfs4_path_filter_avx2, false },
+#endif
+	{ "dispatch", nfs4_path_filter, true },
+};
+
+#define NFILTERS (sizeof(filters) / sizeof(filters[0]))
+
+static const utf8_scantype_t scans[] = {
+	UTF8_SCAN_NOSLASH,
+	UTF8_SCAN_NAME,
+	UTF8_SCAN_CKUTF8,
+	UTF8_SCAN_ALL,
+	UTF8_SCAN_SYMLINK,
+};
+
+#define NSCANS (sizeof(scans) / sizeof(scans[0]))
+
+static int errors;
+
+static void dump(const char *name, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		printf("%02x", (unsigned char)name[i]);
+	printf("\n");
+}
+
+/* Every scanner must agree with the scalar one */
+static void check(const char *name, size_t len)
+{
+	size_t i, j;
+	nfsstat4 ref, res;
+
+	for (i = 0; i < NSCANS; i++) {
+		ref = nfs4_path_filter_scalar(name, len, scans[i]);
+
+		for (j = 1; j < NFILTERS; j++) {
+			if (!filters[j].usable)
+				continue;
+
+			res = filters[j].fn(name, len, scans[i]);
+			if (res == ref)
+				continue;
+
+			if (errors++ < 10) {
+				printf("%s scan %d: %d, scalar %d, len %zu: ",
+				       filters[j].name, scans[i], res, ref,
+				       len);
+				dump(name, len);
+			}
+		}
+	}
+}
+
+static void expect(const char *name, size_t len, utf8_scantype_t scan,
+		   nfsstat4 want)
+{
+	nfsstat4 res = nfs4_path_filter_scalar(name, len, scan);
+
+	if (res != want) {
+		errors++;
+		printf("scalar scan %d: %d, expected %d: ", scan, res, want);
+		dump(name, len);
+	}
+	check(name, len);
+}
+
+static void known_names(void)
+{
+	expect(".", 1, UTF8_SCAN_ALL, NFS4ERR_BADNAME);
+	expect("..", 2, UTF8_SCAN_ALL, NFS4ERR_BADNAME);
+	expect("...", 3, UTF8_SCAN_ALL, NFS4_OK);
+	expect("..", 2, UTF8_SCAN_SYMLINK, NFS4_OK);
+	expect("a/b", 3, UTF8_SCAN_ALL, NFS4ERR_BADCHAR);
+	expect("a/b", 3, UTF8_SCAN_SYMLINK, NFS4_OK);
+	expect("a\0b", 3, UTF8_SCAN_SYMLINK, NFS4ERR_BADCHAR);
+	expect("\xc0\x80", 2, UTF8_SCAN_ALL, NFS4ERR_INVAL);
+	expect("\xc0\x80", 2, UTF8_SCAN_NAME, NFS4_OK);
+	expect("\xc3\xa9", 2, UTF8_SCAN_ALL, NFS4_OK);
+	expect("\xed\xa0\x80", 3, UTF8_SCAN_ALL, NFS4ERR_INVAL);
+	expect("\xef\xbf\xbd", 3, UTF8_SCAN_ALL, NFS4_OK);
+	expect("\xef\xbf\xbe", 3, UTF8_SCAN_ALL, NFS4ERR_INVAL);
+	expect("\xf0\x9f\x98\x80", 4, UTF8_SCAN_ALL, NFS4_OK);
+	expect("\xf4\x90\x80\x80", 4, UTF8_SCAN_ALL, NFS4ERR_INVAL);
+	expect("\xf0\x9f\x98", 3, UTF8_SCAN_ALL, NFS4ERR_INVAL);
+	expect("0123456789abcdef0123456789abcdef/", 33, UTF8_SCAN_ALL,
+	       NFS4ERR_BADCHAR);
+	expect("0123456789abcdef0123456789abcde\xc3", 32, UTF8_SCAN_ALL,
+	       NFS4ERR_INVAL);
+	expect("0123456789abcde\xe2\x82\xac", 18, UTF8_SCAN_ALL, NFS4_OK);
+}
+
+/* Every 2 and 3 byte sequence, across each block boundary we use */
+static void all_sequences(void)
+{
+	static const size_t offsets[] = { 0, 13, 14, 15, 29, 30, 31, 40 };
+	char name[48];
+	size_t o;
+	unsigned int a, b, c;
+
+	for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+		memset(name, 'x', sizeof(name));
+		for (a = 0x80; a < 0x100; a++)
+			for (b = 0; b < 0x100; b++) {
+				name[offsets[o]] = a;
+				name[offsets[o] + 1] = b;
+				check(name, sizeof(name));
+				check(name, offsets[o] + 2);
+			}
+	}
+
+	memset(name, 'x', sizeof(name));
+	for (a = 0xe0; a < 0x100; a++)
+		for (b = 0x80; b < 0xc0; b++)
+			for (c = 0; c < 0x100; c++) {
+				name[30] = a;
+				name[31] = b;
+				name[32] = c;
+				check(name, sizeof(name));
+			}
+}
+
+/* A random piece of a name, mostly ascii, sometimes broken */
+static size_t random_piece(char *p)
+{
+	static const unsigned int points[] = {
+		0x80, 0x7ff, 0x800, 0xd7ff, 0xd800, 0xdfff, 0xe000, 0xfffd,
+		0xfffe, 0xffff, 0x10000, 0x10ffff, 0x110000, 0x1fffff
+	};
+	unsigned int cp;
+	int r = random() % 100;
+
+	if (r < 70) {
+		p[0] = 'a' + random() % 26;
+		return 1;
+	}
+	if (r < 72) {
+		p[0] = '/';
+		return 1;
+	}
+	if (r < 73) {
+		p[0] = '\0';
+		return 1;
+	}
+	if (r < 76) {
+		p[0] = '.';
+		return 1;
+	}
+	if (r < 80) {
+		/* any byte at all */
+		p[0] = random();
+		return 1;
+	}
+
+	if (r < 85)
+		cp = points[random() % (sizeof(points) / sizeof(points[0]))];
+	else
+		cp = 0x80 + random() % 0x110000;
+
+	if (cp < 0x800) {
+		p[0] = 0xc0 | (cp >> 6);
+		p[1] = 0x80 | (cp & 0x3f);
+		return 2;
+	}
+	if (cp < 0x10000) {
+		p[0] = 0xe0 | (cp >> 12);
+		p[1] = 0x80 | ((cp >> 6) & 0x3f);
+		p[2] = 0x80 | (cp & 0x3f);
+		return r < 98 ? 3 : 2;	/* sometimes truncated */
+	}
+	p[0] = 0xf0 | (cp >> 18);
+	p[1] = 0x80 | ((cp >> 12) & 0x3f);
+	p[2] = 0x80 | ((cp >> 6) & 0x3f);
+	p[3] = 0x80 | (cp & 0x3f);
+	return r < 98 ? 4 : 3;
+}
+
+static size_t random_name(char *name, size_t max)
+{
+	size_t target = random() % max;
+	size_t len = 0;
+	char piece[4];
+	size_t n;
+
+	while (len < target) {
+		n = random_piece(piece);
+		if (len + n > max)
+			break;
+		memcpy(name + len, piece, n);
+		len += n;
+	}
+
+	return len;
+}
+
+static void fuzz(long iterations)
+{
+	char name[MAX_NAME];
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		check(name, random_name(name, sizeof(name)));
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Time each scanner on valid names of min to max bytes */
+static void bench(const char *what, bool ascii, size_t min, size_t max,
+		  long iterations)
+{
+	static char names[BENCH_NAMES][MAX_NAME];
+	static size_t lens[BENCH_NAMES];
+	size_t i, j;
+	long k, bad;
+	double start;
+
+	for (i = 0; i < BENCH_NAMES; i++) {
+		do {
+			lens[i] = random_name(names[i], max + 1);
+		} while (lens[i] < min ||
+			 nfs4_path_filter_scalar(names[i], lens[i],
+						 UTF8_SCAN_ALL) != NFS4_OK);
+
+		if (ascii)
+			for (j = 0; j < lens[i]; j++)
+				names[i][j] = 'a' + (names[i][j] & 0xf);
+	}
+
+	for (j = 0; j < NFILTERS; j++) {
+		if (!filters[j].usable)
+			continue;
+
+		bad = 0;
+		start = seconds();
+		for (k = 0; k < iterations; k++)
+			for (i = 0; i < BENCH_NAMES; i++)
+				bad += filters[j].fn(names[i], lens[i],
+						     UTF8_SCAN_ALL) != NFS4_OK;
+
+		printf("%-6s %3zu-%3zu %-8s %6.1f ns/name%s\n", what, min, max,
+		       filters[j].name,
+		       (seconds() - start) * 1e9 / (iterations * BENCH_NAMES),
+		       bad ? " (rejected names)" : "");
+		if (bad)
+			errors++;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+
+	srandom(time(NULL));
+
+#if defined(__x86_64__) && defined(__GNUC__)
+	__builtin_cpu_init();
+	filters[1].usable = __builtin_cpu_supports("sse4.1");
+	filters[2].usable = __builtin_cpu_supports("avx2");
+#endif
+
+	known_names();
+	all_sequences();
+	fuzz(iterations);
+
+	/* The vector scanners only pay off from 16 bytes on, shorter names
+	 * must not get slower for them.
+	 */
+	bench("ascii", true, 1, 15, iterations / 1000 + 1);
+	bench("ascii", true, 16, 63, iterations / 1000 + 1);
+	bench("ascii", true, 64, 255, iterations / 1000 + 1);
+	bench("utf8", false, 1, 15, iterations / 1000 + 1);
+	bench("utf8", false, 16, 63, iterations / 1000 + 1);
+	bench("utf8", false, 64, 255, iterations / 1000 + 1);
+
+	printf("%s\n", errors ? "FAILED" : "PASSED");
+	return errors != 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * Hammer vfs_wg_write() from several threads writing interleaved blocks
+ * of one file, with two sets of credentials, and check that:
+ *  - every write completes, on its own thread, with its full length,
+ *  - a thread only ever issues writes with its own credentials and fd,
+ *  - no thread issues more than one batch of writes per call,
+ *  - the file ends up with the right content.
+ *
+ * pwritev is wrapped to see which thread issues which writes.
+ *
+ * Usage: test_write_gather [directory]
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include "fsal.h"
+#include "../FSAL/FSAL_VFS/vfs_methods.h"
+
+#define NTHREADS 8
+#define NBLOCKS 4096
+#define BLOCK 4096
+#define MAX_PER_CALL 32		/* VFS_WG_MAX_BATCH */
+
+static struct vfs_write_gather wg;
+static int fds[2];
+static struct user_cred creds[2] = {
+	{ .caller_uid = 1000, .caller_gid = 1000 },
+	{ .caller_uid = 1001, .caller_gid = 1001 },
+};
+static char blocks[NBLOCKS][BLOCK];
+
+static __thread int my_id = -1;
+static __thread int my_calls_iovs;
+static long errors, gathered, calls;
+
+/* The first half of the threads use creds[0] and fds[0], the others
+ * creds[1] and fds[1].  Thread n writes blocks n, n + NTHREADS, ...
+ */
+static inline int group(int id)
+{
+	return id / (NTHREADS / 2);
+}
+
+static int block_of(const void *base)
+{
+	return ((const char (*)[BLOCK]) base) - blocks;
+}
+
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+	int i;
+
+	if (my_id >= 0) {
+		for (i = 0; i < iovcnt; i++) {
+			int b = block_of(iov[i].iov_base);
+
+			if (group(b % NTHREADS) != group(my_id) ||
+			    fd != fds[group(my_id)]) {
+				printf("thread %d wrote block %d on fd %d\n",
+				       my_id, b, fd);
+				__sync_fetch_and_add(&errors, 1);
+			}
+		}
+
+		my_calls_iovs += iovcnt;
+		__sync_fetch_and_add(&calls, 1);
+		if (iovcnt > 1)
+			__sync_fetch_and_add(&gathered, iovcnt - 1);
+
+		/* Give the others time to queue up behind us */
+		usleep(20);
+	}
+
+	return syscall(SYS_pwritev, fd, iov, iovcnt, offset, 0);
+}
+
+static void *writer(void *arg)
+{
+	struct req_op_context ctx;
+	struct fsal_io_arg *io;
+	fsal_status_t status;
+	int b;
+
+	my_id = (long) arg;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.creds = &creds[group(my_id)];
+	op_ctx = &ctx;
+
+	io = calloc(1, sizeof(*io) + sizeof(struct iovec));
+
+	for (b = my_id; b < NBLOCKS; b += NTHREADS) {
+		memset(io, 0, sizeof(*io));
+		io->iov_count = 1;
+		io->iov[0].iov_base = blocks[b];
+		io->iov[0].iov_len = BLOCK;
+		io->offset = (uint64_t) b * BLOCK;
+		my_calls_iovs = 0;
+
+		if (!vfs_wg_write(&wg, fds[group(my_id)], io, &status)) {
+			printf("block %d not gathered\n", b);
+			__sync_fetch_and_add(&errors, 1);
+			continue;
+		}
+
+		if (FSAL_IS_ERROR(status) || io->io_amount != BLOCK) {
+			printf("block %d: status %d amount %zu\n", b,
+			       status.major, io->io_amount);
+			__sync_fetch_and_add(&errors, 1);
+		}
+
+		if (my_calls_iovs > MAX_PER_CALL) {
+			printf("thread %d issued %d writes in one call\n",
+			       my_id, my_calls_iovs);
+			__sync_fetch_and_add(&errors, 1);
+		}
+	}
+
+	free(io);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dir = argc > 1 ? argv[1] : "/tmp";
+	pthread_t threads[NTHREADS];
+	char path[PATH_MAX], buf[BLOCK];
+	long ix;
+	int b;
+
+	snprintf(path, sizeof(path), "%s/test_write_gather.XXXXXX", dir);
+	fds[0] = mkstemp(path);
+	if (fds[0] < 0) {
+		perror(path);
+		return 1;
+	}
+	fds[1] = open(path, O_WRONLY);
+	unlink(path);
+
+	for (b = 0; b < NBLOCKS; b++)
+		memset(blocks[b], 'a' + b % 26, BLOCK);
+
+	vfs_wg_init(&wg);
+
+	for (ix = 0; ix < NTHREADS; ix++)
+		pthread_create(&threads[ix], NULL, writer, (void *) ix);
+	for (ix = 0; ix < NTHREADS; ix++)
+		pthread_join(threads[ix], NULL);
+
+	for (b = 0; b < NBLOCKS; b++) {
+		if (pread(fds[0], buf, BLOCK, (off_t) b * BLOCK) != BLOCK ||
+		    memcmp(buf, blocks[b], BLOCK) != 0) {
+			printf("block %d has the wrong content\n", b);
+			errors++;
+			break;
+		}
+	}
+
+	vfs_wg_fini(&wg);
+	close(fds[0]);
+	close(fds[1]);
+
+	printf("%d writes in %ld pwritev, %ld gathered, %ld errors\n",
+	       NBLOCKS, calls, gathered, errors);
+
+	return errors != 0;
+}
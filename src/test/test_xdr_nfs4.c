@@ -0,0 +1,403 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * Check that the inline XDR fast paths of the hot NFSv4 operations
+ * produce and accept exactly what the field by field routines do, then
+ * time both on the compounds a Linux client sends most: GETATTR, READ,
+ * WRITE, LOOKUP and ACCESS, each behind SEQUENCE and PUTFH.
+ *
+ * Every truncation of each encoded compound is decoded as well, which
+ * runs the fallback path whenever the buffer runs out mid operation.
+ *
+ * Usage: test_xdr_nfs4 [iterations]
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nfsv41.h"
+
+#define MAX_OPS 5
+#define BUF_SIZE 16384
+#define IO_SIZE 4096
+
+/* test_xdr_nfs4_generic.c, built with NFS4_XDR_NO_INLINE */
+bool generic_xdr_COMPOUND4args(XDR *xdrs, COMPOUND4args *objp);
+bool generic_xdr_COMPOUND4res(XDR *xdrs, COMPOUND4res *objp);
+
+static bool fast_xdr_COMPOUND4args(XDR *xdrs, COMPOUND4args *objp)
+{
+	return xdr_COMPOUND4args(xdrs, objp);
+}
+
+static bool fast_xdr_COMPOUND4res(XDR *xdrs, COMPOUND4res *objp)
+{
+	return xdr_COMPOUND4res(xdrs, objp);
+}
+
+struct codec {
+	const char *name;
+	bool (*args)(XDR *, COMPOUND4args *);
+	bool (*res)(XDR *, COMPOUND4res *);
+};
+
+static const struct codec codecs[] = {
+	{ "generic", generic_xdr_COMPOUND4args, generic_xdr_COMPOUND4res },
+	{ "inline", fast_xdr_COMPOUND4args, fast_xdr_COMPOUND4res },
+};
+
+struct compound {
+	const char *name;
+	nfs_argop4 argops[MAX_OPS];
+	nfs_resop4 resops[MAX_OPS];
+	COMPOUND4args args;
+	COMPOUND4res res;
+	char args_xdr[BUF_SIZE];
+	char res_xdr[BUF_SIZE];
+	u_int args_len;
+	u_int res_len;
+};
+
+static struct compound corpus[] = {
+	{ .name = "getattr" },
+	{ .name = "read" },
+	{ .name = "write" },
+	{ .name = "lookup" },
+	{ .name = "access" },
+};
+
+#define NCOMPOUNDS (sizeof(corpus) / sizeof(corpus[0]))
+
+static int errors;
+
+static char fh[64];
+static char attrs[120];
+static char io_data[IO_SIZE];
+static char name[] = "Makefile";
+static stateid4 stateid = { 1, "0123456789ab" };
+
+/* The attributes the Linux client asks for on a plain GETATTR */
+static const struct bitmap4 getattr_mask = {
+	.bitmap4_len = 2,
+	.map = { 0x0010011a, 0x00b0a23a },
+};
+
+static void add_op(struct compound *c, nfs_opnum4 op)
+{
+	u_int i = c->args.argarray.argarray_len++;
+
+	c->argops[i].argop = op;
+	c->resops[i].resop = op;
+	c->res.resarray.resarray_len++;
+}
+
+static void add_sequence(struct compound *c)
+{
+	SEQUENCE4args *sa;
+	SEQUENCE4resok *sr;
+	u_int i = c->args.argarray.argarray_len;
+
+	add_op(c, NFS4_OP_SEQUENCE);
+	sa = &c->argops[i].nfs_argop4_u.opsequence;
+	memcpy(sa->sa_sessionid, "session-0123456", NFS4_SESSIONID_SIZE);
+	sa->sa_sequenceid = 4242;
+	sa->sa_slotid = 3;
+	sa->sa_highest_slotid = 63;
+	sa->sa_cachethis = false;
+
+	sr = &c->resops[i].nfs_resop4_u.opsequence.SEQUENCE4res_u.sr_resok4;
+	memcpy(sr->sr_sessionid, sa->sa_sessionid, NFS4_SESSIONID_SIZE);
+	sr->sr_sequenceid = sa->sa_sequenceid;
+	sr->sr_slotid = sa->sa_slotid;
+	sr->sr_highest_slotid = 63;
+	sr->sr_target_highest_slotid = 63;
+	sr->sr_status_flags = 0;
+}
+
+static void add_putfh(struct compound *c)
+{
+	PUTFH4args *pa;
+	u_int i = c->args.argarray.argarray_len;
+
+	add_op(c, NFS4_OP_PUTFH);
+	pa = &c->argops[i].nfs_argop4_u.opputfh;
+	pa->object.nfs_fh4_len = 36;
+	pa->object.nfs_fh4_val = fh;
+}
+
+static void add_getattr(struct compound *c)
+{
+	fattr4 *fattr;
+	u_int i = c->args.argarray.argarray_len;
+
+	add_op(c, NFS4_OP_GETATTR);
+	c->argops[i].nfs_argop4_u.opgetattr.attr_request = getattr_mask;
+
+	fattr = &c->resops[i].nfs_resop4_u.opgetattr.GETATTR4res_u.resok4
+		.obj_attributes;
+	fattr->attrmask = getattr_mask;
+	fattr->attr_vals.attrlist4_len = sizeof(attrs);
+	fattr->attr_vals.attrlist4_val = attrs;
+}
+
+static void build_corpus(void)
+{
+	struct compound *c;
+	READ4args *ra;
+	READ4resok *rr;
+	WRITE4args *wa;
+	WRITE4resok *wr;
+	u_int i;
+
+	for (i = 0; i < sizeof(fh); i++)
+		fh[i] = random();
+	for (i = 0; i < sizeof(attrs); i++)
+		attrs[i] = random();
+	for (i = 0; i < sizeof(io_data); i++)
+		io_data[i] = random();
+
+	for (i = 0; i < NCOMPOUNDS; i++) {
+		c = &corpus[i];
+		c->args.minorversion = 1;
+		c->args.argarray.argarray_val = c->argops;
+		c->res.resarray.resarray_val = c->resops;
+		add_sequence(c);
+		add_putfh(c);
+	}
+
+	add_getattr(&corpus[0]);
+
+	c = &corpus[1];
+	add_op(c, NFS4_OP_READ);
+	ra = &c->argops[2].nfs_argop4_u.opread;
+	ra->stateid = stateid;
+	ra->offset = 1024 * 1024 * 1024 + 8192;
+	ra->count = IO_SIZE;
+	rr = &c->resops[2].nfs_resop4_u.opread.READ4res_u.resok4;
+	rr->eof = false;
+	rr->data.data_len = IO_SIZE;
+	rr->data.data_val = io_data;
+
+	c = &corpus[2];
+	add_op(c, NFS4_OP_WRITE);
+	wa = &c->argops[2].nfs_argop4_u.opwrite;
+	wa->stateid = stateid;
+	wa->offset = 8192;
+	wa->stable = UNSTABLE4;
+	wa->data.data_len = IO_SIZE;
+	wa->data.data_val = io_data;
+	wr = &c->resops[2].nfs_resop4_u.opwrite.WRITE4res_u.resok4;
+	wr->count = IO_SIZE;
+	wr->committed = UNSTABLE4;
+	memcpy(wr->writeverf, "verifier", NFS4_VERIFIER_SIZE);
+	add_getattr(c);
+
+	c = &corpus[3];
+	add_op(c, NFS4_OP_LOOKUP);
+	c->argops[2].nfs_argop4_u.oplookup.objname.utf8string_len =
+		strlen(name);
+	c->argops[2].nfs_argop4_u.oplookup.objname.utf8string_val = name;
+	add_op(c, NFS4_OP_GETFH);
+	c->resops[3].nfs_resop4_u.opgetfh.GETFH4res_u.resok4.object
+		.nfs_fh4_len = 37;
+	c->resops[3].nfs_resop4_u.opgetfh.GETFH4res_u.resok4.object
+		.nfs_fh4_val = fh;
+	add_getattr(c);
+
+	c = &corpus[4];
+	add_op(c, NFS4_OP_ACCESS);
+	c->argops[2].nfs_argop4_u.opaccess.access = 0x3f;
+	c->resops[2].nfs_resop4_u.opaccess.ACCESS4res_u.resok4.supported =
+		0x3f;
+	c->resops[2].nfs_resop4_u.opaccess.ACCESS4res_u.resok4.access = 0x2d;
+	add_getattr(c);
+}
+
+static u_int encode_args(const struct codec *codec, COMPOUND4args *args,
+			 char *buf)
+{
+	XDR xdrs;
+	u_int len = 0;
+
+	xdrmem_create(&xdrs, buf, BUF_SIZE, XDR_ENCODE);
+	if (codec->args(&xdrs, args))
+		len = xdr_getpos(&xdrs);
+	xdr_destroy(&xdrs);
+	return len;
+}
+
+static u_int encode_res(const struct codec *codec, COMPOUND4res *res,
+			char *buf)
+{
+	XDR xdrs;
+	u_int len = 0;
+
+	xdrmem_create(&xdrs, buf, BUF_SIZE, XDR_ENCODE);
+	if (codec->res(&xdrs, res))
+		len = xdr_getpos(&xdrs);
+	xdr_destroy(&xdrs);
+	return len;
+}
+
+static bool decode_args(const struct codec *codec, char *buf, u_int len,
+			COMPOUND4args *args)
+{
+	XDR xdrs;
+	bool ok;
+
+	memset(args, 0, sizeof(*args));
+	xdrmem_create(&xdrs, buf, len, XDR_DECODE);
+	ok = codec->args(&xdrs, args);
+	xdr_destroy(&xdrs);
+	return ok;
+}
+
+static bool decode_res(const struct codec *codec, char *buf, u_int len,
+		       COMPOUND4res *res)
+{
+	XDR xdrs;
+	bool ok;
+
+	memset(res, 0, sizeof(*res));
+	xdrmem_create(&xdrs, buf, len, XDR_DECODE);
+	ok = codec->res(&xdrs, res);
+	xdr_destroy(&xdrs);
+	return ok;
+}
+
+static void fail(const char *what, struct compound *c, const char *codec)
+{
+	errors++;
+	printf("%s %s: %s\n", c->name, what, codec);
+}
+
+/*
+ * Both codecs must encode the same bytes, decode them back to something
+ * that encodes the same again, and reject every truncation.
+ */
+static void check(struct compound *c)
+{
+	static char buf[BUF_SIZE];
+	COMPOUND4args args;
+	COMPOUND4res res;
+	u_int i, len, cut;
+
+	c->args_len = encode_args(&codecs[0], &c->args, c->args_xdr);
+	c->res_len = encode_res(&codecs[0], &c->res, c->res_xdr);
+	if (c->args_len == 0 || c->res_len == 0) {
+		fail("encode", c, codecs[0].name);
+		return;
+	}
+
+	for (i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+		len = encode_args(&codecs[i], &c->args, buf);
+		if (len != c->args_len || memcmp(buf, c->args_xdr, len))
+			fail("args encode", c, codecs[i].name);
+
+		len = encode_res(&codecs[i], &c->res, buf);
+		if (len != c->res_len || memcmp(buf, c->res_xdr, len))
+			fail("res encode", c, codecs[i].name);
+
+		if (!decode_args(&codecs[i], c->args_xdr, c->args_len,
+				 &args)) {
+			fail("args decode", c, codecs[i].name);
+		} else {
+			len = encode_args(&codecs[0], &args, buf);
+			if (len != c->args_len ||
+			    memcmp(buf, c->args_xdr, len))
+				fail("args round trip", c, codecs[i].name);
+		}
+		xdr_free((xdrproc_t) xdr_COMPOUND4args, &args);
+
+		if (!decode_res(&codecs[i], c->res_xdr, c->res_len, &res)) {
+			fail("res decode", c, codecs[i].name);
+		} else {
+			len = encode_res(&codecs[0], &res, buf);
+			if (len != c->res_len || memcmp(buf, c->res_xdr, len))
+				fail("res round trip", c, codecs[i].name);
+		}
+		xdr_free((xdrproc_t) xdr_COMPOUND4res, &res);
+
+		for (cut = 0; cut < c->args_len; cut += BYTES_PER_XDR_UNIT) {
+			if (decode_args(&codecs[i], c->args_xdr, cut, &args))
+				fail("args truncation", c, codecs[i].name);
+			xdr_free((xdrproc_t) xdr_COMPOUND4args, &args);
+		}
+
+		for (cut = 0; cut < c->res_len; cut += BYTES_PER_XDR_UNIT) {
+			if (decode_res(&codecs[i], c->res_xdr, cut, &res))
+				fail("res truncation", c, codecs[i].name);
+			xdr_free((xdrproc_t) xdr_COMPOUND4res, &res);
+		}
+	}
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Decode the arguments and encode the results, as the server does */
+static void bench(struct compound *c, long iterations)
+{
+	static char buf[BUF_SIZE];
+	COMPOUND4args args;
+	double start, ns[2];
+	long k;
+	u_int i;
+
+	for (i = 0; i < 2; i++) {
+		start = seconds();
+		for (k = 0; k < iterations; k++) {
+			if (!decode_args(&codecs[i], c->args_xdr, c->args_len,
+					 &args))
+				errors++;
+			xdr_free((xdrproc_t) xdr_COMPOUND4args, &args);
+			if (encode_res(&codecs[i], &c->res, buf) != c->res_len)
+				errors++;
+		}
+		ns[i] = (seconds() - start) * 1e9 / iterations;
+	}
+
+	printf("%-8s %4u+%-5u bytes %8.1f ns generic %8.1f ns inline (%.2fx)\n",
+	       c->name, c->args_len, c->res_len, ns[0], ns[1], ns[0] / ns[1]);
+}
+
+int main(int argc, char *argv[])
+{
+	long iterations = argc > 1 ? atol(argv[1]) : 100000;
+	u_int i;
+
+	srandom(time(NULL));
+	build_corpus();
+
+	for (i = 0; i < NCOMPOUNDS; i++)
+		check(&corpus[i]);
+
+	for (i = 0; i < NCOMPOUNDS; i++)
+		bench(&corpus[i], iterations);
+
+	printf("%s\n", errors ? "FAILED" : "PASSED");
+	return errors != 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * The NFSv4 XDR routines built without their inline fast paths, for
+ * test_xdr_nfs4 to compare against.
+ */
+
+#define NFS4_XDR_NO_INLINE
+
+#include "config.h"
+#include "nfsv41.h"
+
+bool generic_xdr_COMPOUND4args(XDR *xdrs, COMPOUND4args *objp)
+{
+	return xdr_COMPOUND4args(xdrs, objp);
+}
+
+bool generic_xdr_COMPOUND4res(XDR *xdrs, COMPOUND4res *objp)
+{
+	return xdr_COMPOUND4res(xdrs, objp);
+}